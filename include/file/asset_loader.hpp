@@ -0,0 +1,89 @@
+#ifndef _GAME_ASSET_LOADER
+#define _GAME_ASSET_LOADER
+
+#include "asset_manager.hpp"
+#include "utils/class/task_pool.hpp"
+
+#include <nlohmann/json.hpp>
+#include <SFML/Graphics/Image.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Startup loading on a thread pool.
+// Json files are parsed and images are decoded with their alpha grids
+// built by the workers, the textures are uploaded by the calling thread
+// in the order they were requested, while later ones are still decoded.
+// Parsed json (as CBOR) and decoded images (pixels and alpha grid) are
+// kept in a binary cache, keyed by the hash of the source file, so a
+// warm start doesn't parse or decode anything.
+struct AssetLoader
+{
+	struct TextureRequest
+	{
+		std::string name;
+		IVec count = { 1, 1 };
+		IVec divisions = { 1, 1 };
+	};
+
+	// Where the cache is written, relative to the working directory
+	std::string cachePath = "cache";
+	bool useCache = true;
+
+	// Stats of the loading
+	size_t cacheHits = 0u;
+	size_t cacheMisses = 0u;
+
+	AssetLoader(size_t threads = 0u);
+
+	// Parse every file, "files" maps the names to their paths
+	bool load_json(
+		std::map<std::string, nlohmann::json> &out,
+		const std::map<std::string, std::string> &files);
+
+	// Start decoding, returns right away
+	void begin_textures(
+		const AssetManager &assets,
+		const std::vector<TextureRequest> &requests);
+
+	// Upload the textures as they're decoded, returns how many loaded
+	size_t finish_textures(AssetManager &assets);
+
+	static uint64_t hash_bytes(const char *data, size_t size);
+
+	static bool read_file(const std::string &path, std::string &out);
+
+  private:
+	struct JsonJob
+	{
+		std::string path;
+		nlohmann::json json;
+		bool cached = false;
+		// Logged by the calling thread
+		std::string error;
+	};
+
+	struct TextureJob
+	{
+		TextureRequest request;
+		std::string path;
+		sf::Image image;
+		ImageAlphaGrid alphaGrid;
+		bool cached = false;
+		std::string error;
+	};
+
+	void run_json(JsonJob &job) const;
+
+	void run_texture(TextureJob &job) const;
+
+	std::string cache_file(const std::string &dir, const std::string &name) const;
+
+	TaskPool m_pool;
+	std::vector<std::unique_ptr<TextureJob>> m_textures;
+	std::vector<size_t> m_textureTasks;
+};
+
+#endif // _GAME_ASSET_LOADER
@@ -11,162 +11,246 @@
 #include "utils/utils.hpp"
 #include "utils/math.hpp"
 
+#include <bitset>
 #include <cassert>
 #include <functional>
 #include <map>
+#include <memory>
 #include <unordered_map>
 
 constexpr bool ALPHAGRID_TRANSPARENT = 1;
 
-// Converts image to a 2d array repsesenting whether each pixel
-// is transparent or not.
+// Whether each pixel of an image is transparent, one bit per pixel.
+// Rows start on a 64 bit word, so a row's span is a few whole words.
+// The grid is only moved, sprites share it through AlphaGridView.
 struct ImageAlphaGrid
 {
+	typedef uint64_t t_word;
+	static constexpr unsigned WORD_BITS = 64u;
 
 	ImageAlphaGrid()
 	{
 	}
 
-	ImageAlphaGrid(ImageAlphaGrid&& other) noexcept
-	{
-		this->operator=(std::forward<ImageAlphaGrid>(other));
-	}
+	ImageAlphaGrid(ImageAlphaGrid&& other) noexcept = default;
 
-	ImageAlphaGrid(const ImageAlphaGrid& other) noexcept
-	{
-		this->operator=(other);
-	}
+	ImageAlphaGrid(const ImageAlphaGrid& other) = delete;
 
 	ImageAlphaGrid(const sf::Image& img)
 	{
 		loadFromImage(img);
 	}
 
-	ImageAlphaGrid(bool** buffer, unsigned w, unsigned h)
+	ImageAlphaGrid& operator=(const ImageAlphaGrid& other) = delete;
+
+	ImageAlphaGrid& operator=(ImageAlphaGrid&& other) noexcept = default;
+
+	bool loadFromImage(const sf::Image& img)
 	{
-		this->grid = buffer;
-		this->gridW = w;
-		this->gridH = h;
+		return loadFromPixels(
+			img.getPixelsPtr(),
+			img.getSize().x,
+			img.getSize().y);
 	}
 
-	~ImageAlphaGrid()
+	// RGBA pixels, safe to call from any thread
+	bool loadFromPixels(const sf::Uint8* pixels, unsigned w, unsigned h)
 	{
-		if (grid == nullptr)
-			return;
+		allocate(w, h);
 
-		for (unsigned y = 0; y < gridH; ++y)
-			delete[] grid[y];
-		delete[] grid;
-	}
+		if (pixels == nullptr)
+			return false;
 
-	ImageAlphaGrid& operator=(const ImageAlphaGrid& other)
-	{
-		this->gridW = other.gridW;
-		this->gridH = other.gridH;
-		this->grid = new bool* [gridH];
 		for (unsigned y = 0; y < gridH; ++y)
 		{
-			this->grid[y] = new bool[gridW];
-			for (unsigned x = 0; x < gridW; ++x)
+			t_word* row = &words[(size_t)y * stride];
+			const sf::Uint8* alpha = pixels + (size_t)y * gridW * 4u + 3u;
+			for (unsigned x = 0; x < gridW; ++x, alpha += 4)
 			{
-				this->grid[y][x] = other.grid[y][x];
+				if (*alpha == sf::Color::Transparent.a)
+					row[x / WORD_BITS] |= (t_word)1u << (x % WORD_BITS);
 			}
 		}
 
-		return *this;
+		return true;
 	}
 
-	ImageAlphaGrid& operator=(ImageAlphaGrid&& other) noexcept
+	// One bit per pixel, row by row, for the asset cache
+	void toBits(std::vector<sf::Uint8>& out) const
 	{
-		this->grid = other.grid;
-		this->gridW = other.gridW;
-		this->gridH = other.gridH;
-		other.grid = nullptr;
-
-		return *this;
+		out.assign(((size_t)gridW * gridH + 7u) / 8u, 0);
+		size_t i = 0;
+		for (unsigned y = 0; y < gridH; ++y)
+		{
+			for (unsigned x = 0; x < gridW; ++x, ++i)
+			{
+				if (getPixel((int)x, (int)y))
+					out[i / 8u] |= (sf::Uint8)(1u << (i % 8u));
+			}
+		}
 	}
 
-	bool loadFromImage(const sf::Image& img)
+	bool loadFromBits(const sf::Uint8* bits, size_t size, unsigned w, unsigned h)
 	{
-		const sf::Uint8* pixels = img.getPixelsPtr();
-
-		gridW = img.getSize().x;
-		gridH = img.getSize().y;
-
-		grid = new bool* [gridH];
-		for (unsigned y = 0; y < gridH; ++y)
-			grid[y] = new bool[gridW];
-
-		bool* gridPtr = *grid;
-
-		if (pixels == nullptr)
+		if (size < ((size_t)w * h + 7u) / 8u)
 			return false;
 
+		allocate(w, h);
+		size_t i = 0;
 		for (unsigned y = 0; y < gridH; ++y)
 		{
-			gridPtr = grid[y];
-			for (unsigned x = 0; x < gridW; ++x)
+			t_word* row = &words[(size_t)y * stride];
+			for (unsigned x = 0; x < gridW; ++x, ++i)
 			{
-				unsigned isAlpha = 0;
-				if (img.getPixel(x, y).a == sf::Color::Transparent.a)
-					isAlpha = 1;
-				*gridPtr++ = isAlpha;
+				if ((bits[i / 8u] >> (i % 8u)) & 1u)
+					row[x / WORD_BITS] |= (t_word)1u << (x % WORD_BITS);
 			}
 		}
-
 		return true;
 	}
 
-	bool getPixel(int x, int y)
+	// Pixels outside of the grid are transparent
+	bool getPixel(int x, int y) const
 	{
-		if (grid == nullptr)
-			return true;
-
 		if (0 <= x && x < (int)gridW &&
 			0 <= y && y < (int)gridH)
 		{
-			return  grid[y][x];
+			const t_word word = words[(size_t)y * stride + (unsigned)x / WORD_BITS];
+			return (word >> ((unsigned)x % WORD_BITS)) & 1u;
 		}
 
 		return true;
 	}
 
-	ImageAlphaGrid subsection(unsigned x, unsigned y, unsigned w, unsigned h)
+	// Opaque pixels inside the rectangle, the part outside of the grid
+	// is transparent
+	size_t countOpaque(int x, int y, int w, int h) const
 	{
-		if (gridH == 0 || gridW == 0)
-			return{};
+		const int x1 = math_max(x, 0), x2 = math_min(x + w, (int)gridW);
+		const int y1 = math_max(y, 0), y2 = math_min(y + h, (int)gridH);
+		if (x1 >= x2 || y1 >= y2)
+			return 0u;
+
+		const unsigned first = (unsigned)x1 / WORD_BITS;
+		const unsigned last = (unsigned)(x2 - 1) / WORD_BITS;
+		const t_word firstMask = ~(t_word)0u << ((unsigned)x1 % WORD_BITS);
+		const unsigned lastBits = (unsigned)x2 % WORD_BITS;
+		const t_word lastMask = lastBits ? ~(~(t_word)0u << lastBits) : ~(t_word)0u;
+
+		size_t count = 0u;
+		for (int iy = y1; iy < y2; ++iy)
+		{
+			const t_word* row = &words[(size_t)iy * stride];
+			for (unsigned i = first; i <= last; ++i)
+			{
+				t_word mask = ~(t_word)0u;
+				if (i == first)
+					mask &= firstMask;
+				if (i == last)
+					mask &= lastMask;
+				// Set bits are transparent
+				count += popcount(~row[i] & mask);
+			}
+		}
+		return count;
+	}
 
-		if (!grid)
-			return{};
+	bool anyOpaque(int x, int y, int w, int h) const
+	{
+		return countOpaque(x, y, w, h) != 0u;
+	}
 
-		unsigned newGridW = w;
-		unsigned newGridH = h;
+	// Bytes of the mask
+	size_t memory() const
+	{
+		return words.size() * sizeof(t_word);
+	}
 
-		bool** newGrid = new bool* [newGridH];
-		for (unsigned y = 0; y < newGridH; ++y)
-			newGrid[y] = new bool[newGridW];
+	bool empty() const
+	{
+		return words.empty();
+	}
 
+	std::vector<t_word> words;
+	// Words per row
+	size_t stride = 0u;
+	unsigned gridH = 0, gridW = 0;
+
+  private:
+	void allocate(unsigned w, unsigned h)
+	{
+		gridW = w;
+		gridH = h;
+		stride = ((size_t)w + WORD_BITS - 1u) / WORD_BITS;
+		words.assign(stride * h, 0u);
+	}
+
+	// A single instruction where the target has one
+	static inline size_t popcount(t_word v)
+	{
+		return std::bitset<WORD_BITS>(v).count();
+	}
+};
+
+// A rectangle of a shared ImageAlphaGrid, cheap to copy.
+// Pixels outside of the rectangle are transparent.
+struct AlphaGridView
+{
+	std::shared_ptr<const ImageAlphaGrid> grid;
+	int x = 0, y = 0;
+	unsigned w = 0, h = 0;
+
+	AlphaGridView()
+	{
+	}
 
-		bool* newGridPtr = *newGrid;
-		bool* gridPtr = *grid;
-		for (unsigned iy = y; iy < y + h; ++iy)
+	AlphaGridView(std::shared_ptr<const ImageAlphaGrid> grid)
+		: grid(std::move(grid))
+	{
+		if (this->grid)
 		{
-			gridPtr = grid[iy];
-			newGridPtr = newGrid[iy - y];
-			for (unsigned ix = x; ix < x + w; ++ix)
-			{
-				bool bitSource = true;
-				if (ix < gridW && iy < gridH)
-					bitSource = gridPtr[ix];
-				*newGridPtr++ = bitSource;
-			}
+			w = this->grid->gridW;
+			h = this->grid->gridH;
 		}
+	}
 
-		return ImageAlphaGrid{ newGrid, newGridW, newGridH };
+	bool getPixel(int px, int py) const
+	{
+		if (!grid ||
+			px < 0 || px >= (int)w ||
+			py < 0 || py >= (int)h)
+			return true;
+		return grid->getPixel(x + px, y + py);
 	}
 
-	bool** grid = nullptr;
-	unsigned gridH = 0, gridW = 0;
+	size_t countOpaque(int px, int py, int pw, int ph) const
+	{
+		if (!grid)
+			return 0u;
+		const int x1 = math_max(px, 0), x2 = math_min(px + pw, (int)w);
+		const int y1 = math_max(py, 0), y2 = math_min(py + ph, (int)h);
+		if (x1 >= x2 || y1 >= y2)
+			return 0u;
+		return grid->countOpaque(x + x1, y + y1, x2 - x1, y2 - y1);
+	}
+
+	bool anyOpaque(int px, int py, int pw, int ph) const
+	{
+		return countOpaque(px, py, pw, ph) != 0u;
+	}
+
+	AlphaGridView subsection(int px, int py, unsigned pw, unsigned ph) const
+	{
+		AlphaGridView view;
+		if (!grid)
+			return view;
+		view.grid = grid;
+		view.x = x + px;
+		view.y = y + py;
+		view.w = pw;
+		view.h = ph;
+		return view;
+	}
 };
 
 struct AssetKeySprites
@@ -204,8 +288,8 @@ struct AssetSprites
 {
 	// Frames
 	sf::Sprite *sprites = nullptr;
-	// For every sprite, hold a alpga grid
-	ImageAlphaGrid* alphaGrids = nullptr;
+	// For every sprite, a view of the texture's alpha grid
+	AlphaGridView* alphaGrids = nullptr;
 
 	int spriteCount;
 	IVec sectionCount = {1, 1};
@@ -247,28 +331,28 @@ struct AssetSprites
 		return &sprites[i % spriteCount];
 	}
 
-	ImageAlphaGrid& getAlphaGrid(const size_t i)
+	const AlphaGridView& getAlphaGrid(const size_t i) const
 	{
 		if (spriteCount == 0)
 		{
 			WARNING(
-				"ImageAlphaGrid with texture: %s is empty and can't pass sprites.",
+				"AlphaGridView with texture: %s is empty and can't pass sprites.",
 				key.texName.c_str());
 			assert(0);
 		}
 		if (i >= spriteCount && !allowOverflow)
 		{
 			WARNING(
-				"ImageAlphaGrid with texture: %s and sprite count: %zu was asked to get sprite at index: %zu.",
+				"AlphaGridView with texture: %s and sprite count: %zu was asked to get sprite at index: %zu.",
 				key.texName.c_str(),
 				spriteCount,
 				i);
 			assert(0);
 		}
-		if (!sprites)
+		if (!alphaGrids)
 		{
 			WARNING(
-				"\"ImageAlphaGrid\" is null.",
+				"\"alphaGrids\" is null.",
 				key.texName.c_str(),
 				spriteCount,
 				i);
@@ -292,7 +376,8 @@ struct AssetSprites
 struct AssetTexture
 {
 	sf::Texture texture;
-	ImageAlphaGrid alphaGrid;
+	// Shared with the views of the sprites
+	std::shared_ptr<const ImageAlphaGrid> alphaGrid;
 
 	IVec frameSize;
 	IVec frameCount = {1, 1};
@@ -375,7 +460,8 @@ struct AssetManager
 		return nullptr;
 	}
 	
-	int generate_null_texture()
+	// Black and magenta checkers
+	static sf::Image null_image()
 	{
 		sf::Image img;
 		img.create(512, 512);
@@ -393,6 +479,12 @@ struct AssetManager
 				}
 			}
 		}
+		return img;
+	}
+
+	int generate_null_texture()
+	{
+		sf::Image img = null_image();
 		
 		textures.push_back(new AssetTexture{});
 		sf::Texture& t = textures.back()->texture;
@@ -409,38 +501,68 @@ struct AssetManager
 		const char *type = "png")
 	{
 		int texId = -1;
-		textures.push_back(new AssetTexture{});
-
-		sf::Texture& t = textures.back()->texture;
-		char *filePath = new char[path.size() + strlen(name) + strlen(type) + 3];
-		sprintf(filePath, "%s/%s.%s", path.c_str(), name, type);
+		const std::string filePath = texture_path(name, type);
 
 		sf::Image img;
 		if (img.loadFromFile(filePath))
 		{
-			textures.back()->alphaGrid.loadFromImage(img);
-			if (t.loadFromImage(img))
-			{
-				texId = (int)textures.size() - 1u;
-				AssetTexture& atex = *textures.back();
-				atex.frameCount = frameCount;
-				atex.frameSize = {
-					(int)(t.getSize().x / frameCount.x),
-					(int)(t.getSize().y / frameCount.y) };
-				atex.divisions = divisions;
-				texturesHash[str_uppercase(name)] = texId;
-			}
-			else
-			{
-				LOG_ERROR("Can't load texture from image that was originally at path \"%s\"", filePath);
-			}
+			texId = add_texture(name, img, ImageAlphaGrid(img), frameCount, divisions);
 		}
 		else
 		{
-			LOG_ERROR("Can't load image \"%s\"", filePath);
+			textures.push_back(new AssetTexture{});
+			LOG_ERROR("Can't load image \"%s\"", filePath.c_str());
 		}
 
-		delete[] filePath;
+		return texId;
+	}
+
+	std::string texture_path(const char *name, const char *type = "png") const
+	{
+		return path + "/" + name + "." + type;
+	}
+
+	// Stands in for a texture that couldn't be loaded, so the textures
+	// after it keep their index
+	int add_missing_texture(
+		const char *name,
+		const IVec &frameCount = {1, 1},
+		const IVec &divisions = {1, 1})
+	{
+		const sf::Image img = null_image();
+		return add_texture(name, img, ImageAlphaGrid(img), frameCount, divisions);
+	}
+
+	// Upload an image that was decoded already, must be called from the
+	// thread that owns the OpenGL context
+	int add_texture(
+		const char *name,
+		const sf::Image &img,
+		ImageAlphaGrid &&alphaGrid,
+		const IVec &frameCount = {1, 1},
+		const IVec &divisions = {1, 1})
+	{
+		int texId = -1;
+		textures.push_back(new AssetTexture{});
+
+		sf::Texture& t = textures.back()->texture;
+		textures.back()->alphaGrid =
+			std::make_shared<const ImageAlphaGrid>(std::move(alphaGrid));
+		if (t.loadFromImage(img))
+		{
+			texId = (int)textures.size() - 1u;
+			AssetTexture& atex = *textures.back();
+			atex.frameCount = frameCount;
+			atex.frameSize = {
+				(int)(t.getSize().x / frameCount.x),
+				(int)(t.getSize().y / frameCount.y) };
+			atex.divisions = divisions;
+			texturesHash[str_uppercase(name)] = texId;
+		}
+		else
+		{
+			LOG_ERROR("Can't load texture from image \"%s\"", name);
+		}
 
 		return texId;
 	}
@@ -476,6 +598,7 @@ struct AssetManager
 		auto dif = framesEnd - framesStart + sf::Vector2i{1, 1};
 		sprite.spriteCount = vec_prod<int>(dif);
 		sprite.sprites = new sf::Sprite[sprite.spriteCount];
+		sprite.alphaGrids = new AlphaGridView[sprite.spriteCount];
 		sprite.key = key;
 		/*
         if (dif.x != 1)
@@ -616,7 +739,7 @@ struct AssetManager
 		// all of the tiles.
 		spriteOut.spriteCount = cx * cy * vec_prod(size);
 		spriteOut.sprites = new sf::Sprite[spriteOut.spriteCount];
-		spriteOut.alphaGrids = new ImageAlphaGrid[spriteOut.spriteCount];
+		spriteOut.alphaGrids = new AlphaGridView[spriteOut.spriteCount];
 		spriteOut.key = key;
 		spriteOut.sectionCount = sectionCount;
 		spriteOut.frameCount = texture.frameCount;
@@ -624,7 +747,7 @@ struct AssetManager
 
 		if (strcmp(name, DEBUG_SELECT_BUILDING_NAME) == STRCMP_EQUAL)
 		{
-			DEBUG(name);
+			DEBUG("%s", name);
 			DEBUG("frameCount: %s\ndivs: %s",
 				VEC_CSTR(texture.frameCount),
 				VEC_CSTR(divs));
@@ -684,13 +807,12 @@ struct AssetManager
 								(int)index);
 						}
 
-						ImageAlphaGrid g;
-						g = texture.alphaGrid.subsection(
-							pos.x, 
-							pos.y, 
-							size.x, 
-							size.y);
-						spriteOut.alphaGrids[index] = g;
+						spriteOut.alphaGrids[index] =
+							AlphaGridView(texture.alphaGrid).subsection(
+								pos.x,
+								pos.y,
+								size.x,
+								size.y);
 
 						++index;
 					}
@@ -294,6 +294,23 @@ static void from_json(const json &j, VariantPtr<T> &v)
 	v.from_json_ptr(j);
 }
 
+// Saved as a plain array, the handles aren't kept
+template <class T>
+static void to_json(json &j, const NodeArray<T> &v)
+{
+	j = json::array();
+	for (const T &x : v)
+		j.push_back(x);
+}
+
+template <class T>
+static void from_json(const json &j, NodeArray<T> &v)
+{
+	v.clear();
+	for (const json &x : j)
+		v.push_back(x.get<T>());
+}
+
 /**
 * Containts all serializable variants for use in variant initialization
 * Most variants need access to each other when being desirialized,
@@ -37,11 +37,15 @@
 #include "utils/utils.hpp"
 
 #include "file/asset_manager.hpp"
+#include "file/asset_loader.hpp"
+#include "game/game_paging.hpp"
+#include "game/game_worldgen.hpp"
 #include "render/graphics.hpp"
 #include "render/gui.hpp"
 #include "render/FastLabel.hpp"
 
 #include "window/GameWindow.hpp"
+#include "window/info_panel.hpp"
 #include "window/gui_utils.hpp"
 
 extern "C"
@@ -104,8 +108,6 @@ struct WindowGameplay : GameWindow
 	RendererClass renderer;
 	GameMode gameMode = GameMode::VIEW;
 
-	GameTimerManager<t_seconds> timerManager;
-
 	PopupConfirmationData* popupSaveOverride = nullptr;
 	// todo
 	PopupConfirmationData* popupLoadGame = nullptr;
@@ -118,6 +120,10 @@ struct WindowGameplay : GameWindow
 	BuildingBase* buildUpgradeSelected = nullptr;
 
 	std::set<sf::Vector2i, IVecCompare> suggestionBuilds;
+	// Placed and removed buildings, for update_suggestions
+	WorldEventBus::t_cursor suggestionCursor = data.worldEvents.subscribe(
+		WorldEvent::mask(WorldEvent::BUILDING_PLACED) |
+		WorldEvent::mask(WorldEvent::BUILDING_REMOVED));
 
 	int suggestionUpgrade = 0;
 	bool godMode = 1;
@@ -135,12 +141,21 @@ struct WindowGameplay : GameWindow
 	sf::Font font;
 	sf::Text text;
 	CharSpriteSheet charSpriteSheet;
+	// Draws the resource tabs together
+	FastLabelBatcher labelBatcher;
+
+	// Chunks generated in the background
+	WorldGenerator worldGen;
+	// Generated chunks added per tick
+	size_t worldGenChunksPerTick = 2u;
+	// Far chunks kept on disk
+	ChunkPager pager;
 
 	std::unordered_map<size_t, BuildingBase*> guiBInfoPtr;
-	std::unordered_map<size_t, tgui::ChildWindow::Ptr> guiBInfoWin;
+	std::unordered_map<size_t, InfoPanel> guiBInfoWin;
 
 	std::unordered_map<size_t, EntityBody*> guiEInfoPtr;
-	std::unordered_map<size_t, tgui::ChildWindow::Ptr> guiEInfoWin;
+	std::unordered_map<size_t, InfoPanel> guiEInfoWin;
 
 	// todo serialize
 	std::string scenarioName = "Unknown";
@@ -248,6 +263,8 @@ struct WindowGameplay : GameWindow
 
 	t_jsonpack jsonpack_from_game();
 
+	bool save_game(const std::wstring& fileName) override;
+
 	// Gui
 
 	void popup_confirmation_window(PopupConfirmationData*);
@@ -280,16 +297,36 @@ struct WindowGameplay : GameWindow
 
 	void filter_suggestions();
 
+	bool suggestion_valid(const IVec& pos);
+
+	// Drops the suggestions whose tiles changed, once per tick
+	void update_suggestions();
+
 	void filter_upgrade_buildings(const IVec& latest);
 
 	bool has_build_info(BuildingBase* infoBuild);
 
+	// With "update" the window is only marked, see refresh_info_panels
 	void show_build_info(BuildingBase* infoBuild, bool update = false);
 
+	void close_build_info(BuildingBase* infoBuild);
+
+	void refresh_build_info(BuildingBase* infoBuild);
+
 	bool has_entity_info(EntityBody* entity);
 
 	void show_entity_info(EntityBody* entity, bool update = false);
 
+	void close_entity_info(EntityBody* entity);
+
+	void refresh_entity_info(EntityBody* entity);
+
+	// Refresh the marked info windows, once per frame
+	void refresh_info_panels();
+
+	// Before the world is cleared
+	void close_info_panels();
+
 	void grid_change_confirmation(IVec latest);
 
 	void update_upgrade_info();
@@ -0,0 +1,86 @@
+#ifndef _GAME_AI
+#define _GAME_AI
+
+#include "game_entity.hpp"
+
+#include <deque>
+
+struct GameData;
+
+// Spreads the entities' decisions (logic_reset) over ticks.
+// Entities that need a decision are queued in a priority bucket, every
+// tick the buckets are run in order until decisionLimit decisions ran
+// and the rest is carried to the next tick, so a burst of idle
+// entities doesn't stall a single frame.
+// Counting the decisions keeps the ticks the same on every machine,
+// interactive play can opt in to a wall clock budget with timeBudget.
+// Entries that waited too long are moved to the bucket above, so the
+// lower buckets aren't starved. Every bucket is ordered by the tick its
+// entries were first queued at, an aged entry keeps it's place among
+// the older ones.
+struct AIScheduler
+{
+	enum Priority
+	{
+		// Aggressive entities, enemies
+		COMBAT,
+		// Citizens looking for something to do
+		IDLE,
+		// Wandering and other decisions nobody waits for
+		COSMETIC,
+		PRIORITY_COUNT
+	};
+
+	struct Entry
+	{
+		EntityBody *entity = nullptr;
+		// Tick it was queued at, kept when it's moved up
+		long frame = 0;
+	};
+
+	// Decisions of a tick
+	static constexpr size_t DEFAULT_DECISIONS = 32u;
+	// When the constant isn't set, in microseconds
+	static constexpr int DEFAULT_BUDGET = 2000;
+	// Decisions run every tick even if the budget is spent
+	static constexpr size_t MIN_DECISIONS = 4u;
+	// Ticks before an entry is moved to the bucket above
+	static constexpr long MAX_WAIT = 30;
+
+	GameData *context = nullptr;
+
+	size_t decisionLimit = DEFAULT_DECISIONS;
+	// Run until AI_TICK_BUDGET microseconds are spent instead, the
+	// ticks then depend on how fast the machine is, so only for the
+	// real time ticks of interactive play
+	bool timeBudget = false;
+
+	std::deque<Entry> buckets[PRIORITY_COUNT];
+
+	// Metrics of the last run
+	size_t ran = 0u;
+	size_t depth = 0u;
+	t_seconds used = 0.f;
+	// Ticks the decisions waited in the queue
+	long maxLatency = 0;
+	float averageLatency = 0.f;
+
+	AIScheduler(GameData *context = nullptr);
+
+	// Queue a decision, an entity is queued once until it's decision runs
+	void queue(EntityBody *entity);
+
+	// Called when a body is deleted
+	void forget(const GameBody *body);
+
+	// Run the queued decisions inside the limit, returns how many ran
+	size_t run();
+
+	size_t size() const;
+
+	void clear();
+
+	static Priority priority(const EntityBody *entity);
+};
+
+#endif // _GAME_AI
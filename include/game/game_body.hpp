@@ -7,6 +7,9 @@
 #include "../libs/FastNoiseLite.h"
 #include "../file/serialization.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <unordered_set>
 
 struct GameData;
@@ -322,6 +325,35 @@ struct BodyConfigManager
 
 struct GameBody;
 
+// The quad trees a body belongs to, as indices in GameData::treeTable.
+// Worked out once when the body is added and again only when it's
+// classification changes, see GameData::refresh_trees
+struct BodyTrees
+{
+	// Body type, alignment, building type and every bool property
+	static constexpr size_t CAPACITY = 24u;
+
+	std::array<uint16_t, CAPACITY> ids;
+	uint8_t count = 0u;
+	bool valid = false;
+
+	void add(uint16_t id)
+	{
+		assert(count < CAPACITY);
+		if (count < CAPACITY)
+			ids[count++] = id;
+	}
+
+	bool has(uint16_t id) const
+	{
+		return std::find(begin(), end(), id) != end();
+	}
+
+	const uint16_t *begin() const { return ids.data(); }
+
+	const uint16_t *end() const { return ids.data() + count; }
+};
+
 class AbstractCanTarget
 {
 
@@ -345,6 +377,9 @@ struct GameBody : Variant, AbstractCanTarget
 	// Game logic
 	FVec pos;
 	FVec vel;
+	// Position before the last tick, for drawing between ticks
+	FVec prevPos;
+	bool hasPrevPos = false;
 	float z = 0.0f;
 	// AABB game rectangle width and height
 	sf::Vector2f rectSize;
@@ -364,6 +399,8 @@ struct GameBody : Variant, AbstractCanTarget
 	ShapeType shape = ShapeType::POINT;
 	bool visible = true;
 	t_alignment alignment = ALIGNMENT_NONE;
+	// Cached by GameData::get_trees
+	BodyTrees trees;
 
 	std::array<bool, COUNT_PROPERTY_BOOL>
 		arrUseEnums = {false};
@@ -373,6 +410,8 @@ struct GameBody : Variant, AbstractCanTarget
 	static inline int tmpHp = -1; // Null get_hp placeholder
 	bool dead = false; // Add to json copression
 	// And remove dead from entity
+	// Inside BulletPool::targets once a bullet aimed at it
+	NodeHandle bulletTarget;
 
 	// Rendering
 	sf::Vector2i start = {-1, -1};
@@ -445,6 +484,14 @@ struct GameBody : Variant, AbstractCanTarget
 
 	virtual FVec get_pos() { return this->pos;  }
 
+	// Where to draw the body, "alpha" of the way from the last tick
+	FVec render_pos(float alpha) const
+	{
+		if (!hasPrevPos)
+			return pos;
+		return prevPos + (pos - prevPos) * alpha;
+	}
+
 	virtual void apply_data(GameBodyConfig *config) {}
 
 	virtual void update() {}
@@ -3,6 +3,7 @@
 
 #include "game_body.hpp"
 #include "game_entity.hpp"
+#include "../utils/class/timer_wheel.hpp"
 
 struct GameData;
 
@@ -43,13 +44,8 @@ const Resources NULL_RES = Resources();
 
 struct PowerNetwork : Variant
 {
-	// All typedefed containers should be reimplemeted
-	// for wfficency later. (aka Todo)
-	typedef std::vector<VariantPtr<BuildingBase>> t_builds;
-	t_builds output;
-	t_builds input;
-	t_builds station;
-
+	// Membership is owned by the PowerGrid, a network only holds
+	// the values that are solved once every tick.
 	int powerOut = 0;
 	int powerStore = 0;
 	int powerIn = 0;
@@ -57,6 +53,12 @@ struct PowerNetwork : Variant
 	int powerValue = 0;
 	int storeCount = 0;
 
+	// How many buildings of every use are connected
+	std::array<int, 3> counts = {0, 0, 0};
+
+	// Position in the grid's network container
+	size_t index = 0;
+
 	enum Use
 	{
 		IN,
@@ -74,27 +76,11 @@ struct PowerNetwork : Variant
 
 	std::string to_string();
 
-	t_builds &itr(Use use);
-
 	int &value(Use use);
 
-	void add(BuildingBase *base, Use use, bool changeValue = true);
-
-	void add(const t_builds &builds, Use use);
-
-	void add(BuildingBase *base);
-
-	void remove(BuildingBase *base, Use use);
-
-	void remove(BuildingBase *base);
-
 	void clear();
 
 	static int resource(BuildingBase *base, Use use);
-
-	static void merge(PowerNetwork &a, PowerNetwork &b);
-
-	static void merge(PowerNetwork *a, PowerNetwork *b);
 };
 
 struct TextureFrames
@@ -221,14 +207,18 @@ struct BuildingBaseData
 
 	bool operational = true;
 	bool flagDelete = false;
-	// Workers / inhabitants
-	std::vector<VariantPtr<EntityBody>> entities;
+	// Workers / inhabitants, the citizens keep their handles
+	t_obj_ctr<VariantPtr<EntityBody>> entities;
 	// Entities that work inside,
 	// useful only if "areEntitiesInside" is true
-	std::vector<VariantPtr<EntityBody>> storedEntities;
+	t_obj_ctr<VariantPtr<EntityBody>> storedEntities;
 	// Generates/Takes resources every fixed time
 	t_body_timer costTimer;
 	t_body_timer actionTimer;
+	// Scheduler wake-ups of the timers, and how many
+	// times they passed since the last update
+	TimerHandle costWake, actionWake;
+	unsigned costPasses = 0u, actionPasses = 0u;
 
 	// Animation frame
 	int animFrame = -1;
@@ -242,6 +232,8 @@ struct BuildingBaseData
 
 	std::vector<VariantPtr<BuildingBase>> binded;
 	VariantPtr<PowerNetwork> network = nullptr;
+	// Node of the building in the power grid
+	size_t powerNode = SIZE_MAX;
 	bool updateInfo = false;
 	std::vector<VariantPtr<GameBody>> followers;
 
@@ -259,6 +251,8 @@ struct BuildingBase : BuildingBaseInfo,
 	GameData *context = nullptr;
 	BuildingBaseInfo *info = dynamic_cast<BuildingBaseInfo *>(this);
 	BuildingBaseData *data = dynamic_cast<BuildingBaseData *>(this);
+	// Inside GameData::buildingBases
+	NodeHandle slot;
 
 	BuildingBase();
 
@@ -305,6 +299,14 @@ struct BuildingBase : BuildingBaseInfo,
 
 	bool tree_similar(BuildingBase *);
 
+	// Timers
+
+	// Wake up the building when the timers pass,
+	// call again after changing the timers
+	void timers_schedule();
+
+	void timers_cancel();
+
 	// Gameplay
 
 	inline void damage(int attack);
@@ -338,7 +340,7 @@ struct BuildingBase : BuildingBaseInfo,
 	virtual void exit_entity(EntityCitizen *);
 
 	// "Fire" the worker back to a jobless citizen
-	virtual std::vector<VariantPtr<EntityBody>>::iterator
+	virtual t_obj_ctr<VariantPtr<EntityBody>>::iterator
 	remove_entity(EntityCitizen *);
 };
 
@@ -355,6 +357,8 @@ struct BuildingBody
 	sf::Vector2i spriteIndex = {0, 0};
 
 	VariantPtr<BuildingBase> base{nullptr};
+	// Inside GameData::buildings
+	NodeHandle slot;
 
 	BuildingBody() {}
 
@@ -47,57 +47,128 @@ struct BulletStats : GameBodyConfig
 
 };
 
-struct BulletBody : public GameBody
+struct Chunks;
+
+// Swept collision of every bullet, bullets register the segment they
+// moved along this tick and all of them are solved together.
+// Each segment is traced through the tile grid (DDA walk) so only the
+// bodies of the crossed tiles are tested, and fast bullets can't
+// tunnel through their targets.
+struct BulletCollision
 {
-	BulletBody();
-	
-	BulletBody(
-		GameData *context,
-		size_t id,
-		const sf::Vector2f &pos,
-		const sf::Vector2f &vel,
-		t_sprite spriteHolder,
-		t_id alignment);
+	// Input, one element per bullet
+	std::vector<float> x0, y0, x1, y1;
+	std::vector<float> radius;
+	std::vector<t_alignment> alignment;
+	// Slot of the bullet in it's BulletPool
+	std::vector<uint32_t> slot;
 
-	int get_hp() const override;
+	// Output, the earliest hit and where it happend on the segment [0, 1]
+	std::vector<GameBody *> hit;
+	std::vector<float> hitTime;
 
-	void apply_data(GameBodyConfig* config) override;
+	size_t add(
+		uint32_t slot,
+		const FVec &from,
+		const FVec &to,
+		float radius,
+		t_alignment alignment);
 
-	bool confirm_body(GameData* context) override;
+	void solve(const Chunks *chunks);
 
-	int get_direction_frame(int rotation = 0);
+	void clear();
 
-	virtual void update(float delta) override;
+	size_t size() const { return slot.size(); }
 
-	void logic_reset() {}
-
-	json to_json() const override;
-
-	void from_json(const json &j) override;
-
-	void serialize_publish(const SerializeMap &map) override;
-	
-	void serialize_initialize(const SerializeMap &map) override;
-	
-public:
-
-	t_obj_itr<VariantPtr<BulletBody>> objItrBullet;
-	
-	FVec force = { 0.f, 0.f };
-	FVec dir;
-
-	float damage = 10;
-	float lifeSpan = 0;
-	float maxDist = 0;
-	float maxSpeed = 0;
-	float maxForce = 0;
-
-	t_body_timer lifeTimer;
+  private:
+	GameBody *sweep(const Chunks *chunks, size_t i, float &time);
 
+	// Tiles that were already tested by the current sweep
+	std::vector<IVec> m_tested;
+};
 
-	//std::vector<VariantPtr<GameBody>> nearbyObjects;
-	PropertySet<BulletPropertyBools, BulletPropertyNums> props;
+// Storage of every living bullet.
+// Bullets aren't GameBodies, they're columns of a fixed capacity
+// pool that is allocated once, dead slots go to a free list and are
+// reused by the next shots so shooting never touches the heap.
+struct BulletPool
+{
+	static constexpr uint32_t NONE = UINT32_MAX;
+	static constexpr size_t CAPACITY = 8192u;
 
+	enum Flags : uint8_t
+	{
+		FLAG_HOMING = 1u << 0,
+		FLAG_SPECTRAL = 1u << 1,
+	};
+
+	GameData *context = nullptr;
+
+	// Columns, indexed by slot
+	std::vector<float> x, y;
+	// Position before the last tick, for drawing between ticks
+	std::vector<float> px, py;
+	std::vector<float> vx, vy;
+	// Seconds left to live
+	std::vector<float> life;
+	std::vector<float> damage;
+	std::vector<float> radius;
+	std::vector<t_alignment> alignment;
+	std::vector<t_sprite> sprite;
+	std::vector<uint8_t> flags;
+	// Target of homing bullets, in "targets"
+	std::vector<NodeHandle> target;
+	// Bodies bullets aimed at, a body is erased when it's deleted so the
+	// handles of the bullets stop resolving
+	NodeArray<GameBody *> targets;
+
+	// Living slots, packed so updating and rendering don't skip holes
+	std::vector<uint32_t> active;
+	// Position of every slot in "active", NONE for free slots
+	std::vector<uint32_t> activeIndex;
+	std::vector<uint32_t> freeList;
+	// Homing bullets without a target and their nearest query
+	std::vector<std::pair<uint32_t, size_t>> seeking;
+
+	// Shots fired since the pool was cleared, and shots lost
+	// because the pool was full
+	size_t spawned = 0u;
+	size_t dropped = 0u;
+
+	BulletPool(GameData *context = nullptr, size_t capacity = CAPACITY);
+
+	// Returns the slot of the new bullet, or NONE if the pool is full
+	uint32_t spawn(
+		const FVec &pos,
+		const FVec &vel,
+		const BulletStats *stats,
+		t_alignment alignment,
+		GameBody *target = nullptr);
+
+	void release(uint32_t slot);
+
+	// Move every bullet and register it's segment in "collision"
+	void update(float delta, BulletCollision &collision);
+
+	// Apply the hits found by "collision"
+	void resolve(const BulletCollision &collision);
+
+	// Called when a body is deleted, so no bullet points to it
+	void forget_target(GameBody *body);
+
+	// Null if the bullet has no target or it was deleted
+	GameBody *get_target(uint32_t slot) const;
+
+	int get_direction_frame(uint32_t slot, int rotation = 0) const;
+
+	size_t size() const { return active.size(); }
+
+	size_t capacity() const { return x.size(); }
+
+	void clear();
+
+  private:
+	NodeHandle aim(GameBody *body);
 };
 
 #endif // _GAME_BULLET
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef _GAME_CROWD
+#define _GAME_CROWD
+
+#include "game_entity.hpp"
+
+#include <vector>
+
+struct GameData;
+
+// Separation of the entities, computed for all of them once per tick.
+// The entities are binned into a uniform grid of cells as big as the
+// largest radius and sorted by cell, so the neighbours of an entity are
+// three contiguous runs of the sorted positions (one per row of cells).
+// The positions are kept as separate arrays of x and y, the runs are
+// summed a few lanes at a time so the compiler can vectorize them.
+struct CrowdSteering
+{
+	// Lanes summed together by the sweep
+	static constexpr size_t LANES = 8u;
+	// Cells of the grid per entity before the cells are made bigger
+	static constexpr size_t MAX_CELLS_RATIO = 4u;
+
+	GameData *context = nullptr;
+
+	// Added since the last clear, by the order they were added
+	std::vector<EntityBody *> entities;
+	std::vector<float> xs, ys, radii;
+
+	// Results of the last solve, by the order they were added
+	std::vector<FVec> forces;
+	std::vector<int> counts;
+
+	// Stats of the last solve
+	size_t cells = 0u;
+	t_seconds used = 0.f;
+
+	CrowdSteering(GameData *context = nullptr);
+
+	// Bin every living entity and store their separation in them
+	void update();
+
+	void add(EntityBody *entity);
+
+	// Entities aren't needed, for the benchmark
+	void add(const FVec &pos, float radius);
+
+	void solve();
+
+	// Separation at any position against the binned entities, the entity
+	// standing at "pos" is skipped
+	void query(const FVec &pos, float radius, FVec &force, int &count) const;
+
+	void clear();
+
+  private:
+	// Sum the separation from [first, last) of the sorted positions
+	static void sweep(
+		const float *xs,
+		const float *ys,
+		size_t first,
+		size_t last,
+		float x,
+		float y,
+		float radiusSq,
+		FVec &force,
+		int &count);
+
+	uint32_t cell_of(float x, float y) const;
+
+	// The grid
+	IVec m_origin{};
+	int m_width = 0, m_height = 0;
+	float m_cellSize = 1.f;
+	// First sorted entity of every cell, one more for the end
+	std::vector<uint32_t> m_start;
+	// Positions sorted by cell, and their index in "entities"
+	std::vector<float> m_xs, m_ys;
+	std::vector<uint32_t> m_index;
+	// Cell of every entity, by the order they were added
+	std::vector<uint32_t> m_cell;
+	std::vector<uint32_t> m_fill;
+};
+
+#endif // _GAME_CROWD
@@ -8,14 +8,25 @@
 
 #include "../utils/globals.hpp"
 #include "../utils/container/quad_tree.hpp"
+#include "../utils/container/spatial_snapshot.hpp"
+#include "../utils/container/nearest_batch.hpp"
+#include "../utils/class/epoch_publisher.hpp"
+#include "../utils/class/profiler.hpp"
 #include "game_buildings.hpp"
 #include "game_entity.hpp"
 #include "game_grid.hpp"
 #include "game_bullet.hpp"
+#include "game_power.hpp"
+#include "game_dispatch.hpp"
+#include "game_ai.hpp"
+#include "game_lod.hpp"
+#include "game_crowd.hpp"
+#include "game_events.hpp"
 
 #include "../game/scenario/Timeline.hpp"
 
 #include <cfloat>
+#include <functional>
 #include <tuple>
 #include <set>
 
@@ -27,6 +38,7 @@ const static sf::Vector2i VEC_LIMIT = {1, 1};
 const static size_t POINT_LIMIT = 8;
 
 typedef ChunkQuadTree<GameBody *> t_tiletree;
+typedef SpatialSnapshot<GameBody *> t_tilesnapshot;
 
 [[deprecated]] typedef std::pair<t_globalenum, t_tiletree *> t_tree_pair;
 
@@ -264,6 +276,48 @@ struct Constructions : Variant
 	void serialize_initialize(const SerializeMap &map) override;
 };
 
+// Every quad tree as it was at the end of a tick, made for queries
+// from other threads, see GameData::publish_world_snapshot.
+// The bodies are owned by the simulation and might be deleted while
+// a snapshot is held, readers should use them only as handles.
+struct WorldSnapshot
+{
+	typedef t_tilesnapshot::t_def_condition t_def_condition;
+
+	long frame = 0;
+	// Trees that didn't change between ticks share the same copy
+	std::unordered_map<t_idpair, std::shared_ptr<const t_tilesnapshot>> trees;
+
+	const t_tilesnapshot *get_tree(const t_idpair &treeId) const
+	{
+		auto itr = trees.find(treeId);
+		return itr != trees.end() ? itr->second.get() : nullptr;
+	}
+
+	// Nearest bodies ordered by their tile's distance,
+	// "condition" gets the tile, the body and the distance
+	template <class Condition = t_def_condition>
+	std::vector<GameBody *> nearest_bodies(
+		const FVec &pos,
+		size_t limit = t_tilesnapshot::MAX_SIZE,
+		int maxRadius = t_tilesnapshot::MAX_NUM,
+		t_idpair treeId = {ENUM_BODY_TYPE, (t_id)BodyType::BUILDING},
+		const Condition &condition = t_tiletree::DEFAULT_CONDITION) const
+	{
+		std::vector<GameBody *> ret;
+		const t_tilesnapshot *tree = get_tree(treeId);
+		if (!tree)
+			return ret;
+		tree->nearest_k_radius_insertor(
+			vec_pos_to_tile(pos),
+			limit,
+			maxRadius,
+			std::back_inserter(ret),
+			condition);
+		return ret;
+	}
+};
+
 struct GameData : public Variant
 {
 	// The defualt lambda for conditions, enables every input
@@ -308,6 +362,37 @@ struct GameData : public Variant
 	};
 	typedef DEFAULT_COMPARATOR t_def_comparator;
 
+	// The default scorer, the squared distance from "center", lower is better.
+	// Bodies are somewhere inside their tile, so a body can be closer than
+	// it's tile by up to a tile's diagonal, the bound takes that off.
+	struct DEFAULT_SCORER
+	{
+		FVec center;
+
+		DEFAULT_SCORER(const FVec& center = { 0.0f, 0.0f })
+		{
+			this->center = center;
+		}
+
+		inline float operator()(
+			const IVec&,
+			const IVec&,
+			const GameBody* a,
+			const int) const
+		{
+			return vec_distsq(center, a->pos);
+		}
+
+		inline float bound(const int distsq) const
+		{
+			float dist = math_max(0.0f, sqrtf((float)distsq) - 1.41421356f);
+			return dist * dist;
+		}
+	};
+	typedef DEFAULT_SCORER t_def_scorer;
+
+	typedef NearestBatch<GameBody *, int32_t, DEFAULT_SCORER> t_nearest_batch;
+
 	GameData();
 
 	GameData(Chunks *chunks);
@@ -326,7 +411,46 @@ struct GameData : public Variant
 
 	void serialize_initialize(const SerializeMap &map) override;
 
-	std::list<t_idwtree> get_trees(GameBody *body);
+	// The trees the body belongs to, worked out on the first call
+	const BodyTrees &get_trees(GameBody *body);
+
+	// After the body's job, workers or upgrade changed, moves it to the
+	// trees it belongs to now
+	void refresh_trees(GameBody *body);
+
+	// The trees of the body by what it is now, not cached
+	BodyTrees classify_trees(GameBody *body);
+
+	// Index of the tree in treeTable, UINT16_MAX if there is no such tree
+	uint16_t tree_index(const t_group group, const t_id id);
+
+	// Copy the trees that changed since the last tick into a new
+	// snapshot, called by the simulation thread once per tick while
+	// publishSnapshots is set
+	void publish_world_snapshot();
+
+	// Pin the latest snapshot, can be called from any thread
+	EpochPublisher<WorldSnapshot>::Guard read_world_snapshot();
+
+	// Queue a nearest_bodies_quad query, queries are answered together
+	// by solve_nearest, the condition may be called from other threads.
+	// Returns the query's handle, valid until clear_nearest.
+	size_t queue_nearest(
+		const FVec &pos,
+		size_t limit,
+		t_idpair treeId,
+		t_nearest_batch::t_condition condition = nullptr);
+
+	// Answer every queued query, the trees can't change meanwhile
+	void solve_nearest();
+
+	// Drop every query, once per tick
+	void clear_nearest();
+
+	size_t get_nearest_count(size_t query) const;
+
+	// The "index" best result of a solved query, null if there's none
+	GameBody *get_nearest(size_t query, size_t index = 0u) const;
 
 	t_tiletree *get_tree(
 		const t_group group,
@@ -337,13 +461,36 @@ struct GameData : public Variant
 		const t_id id);
 
 	// Defined in main, bad practice? Who caaaarres.
+	// The game clock, the simulated seconds, stops while the game is paused
 	t_seconds get_time();
 
+	// The wall clock, for measuring
+	static t_seconds get_real_time();
+
+	// Moves the game clock by a tick, called once by every tick so the
+	// clock is the same for the same ticks
+	void advance_time(t_seconds step);
+
+	// The game clock in double precision, counted in ticks
+	double sim_time() const;
+
+	// Pausing only stops the game clock,
+	// timers don't need to know about it.
+	void time_pause();
+
+	void time_resume();
+
 	// Timer managment
 
 	t_body_timer create_timer(t_seconds start);
 
-	void add_timer(t_body_timer& timer);
+	// Wake-up for every time the length of the timer passes,
+	// increases "passes" instead of polling the timer every tick.
+	// Must be canceled before "passes" is freed.
+	TimerHandle schedule_timer(t_body_timer timer, unsigned *passes);
+
+	// Fire every expired wake-up, once per tick
+	size_t update_scheduler();
 
 	//
 
@@ -429,9 +576,15 @@ struct GameData : public Variant
 
 	bool can_build(const BuildingQueueData &queue);
 
-	std::vector<BuildingBase *>::iterator delete_building(BuildingBase *build);
+	// Silent publishes no world events, for the buildings of a chunk
+	// that is paged out and not removed from the world
+	t_obj_ctr<BuildingBase *>::iterator delete_building(BuildingBase *build, bool silent = false);
 
-	std::vector<BuildingBase *>::iterator delete_building(const sf::Vector2i &pos);
+	t_obj_ctr<BuildingBase *>::iterator delete_building(const sf::Vector2i &pos);
+
+	// Removes the holes of the building lists once they outnumber the
+	// values and fixes the handles, must not run while they're iterated
+	size_t compact_buildings();
 
 	bool confirm_building_base(BuildingBase *build);
 
@@ -467,12 +620,18 @@ struct GameData : public Variant
 	EntityCitizen *add_entity_citizen(
 		BuildingBase *build);
 
-	BulletBody* add_bullet(
+	// Returns the pool slot of the bullet, or BulletPool::NONE
+	uint32_t add_bullet(
 		const FVec& pos,
-		const FVec& dir,
-		EntityStats* stats = nullptr
+		const FVec& vel,
+		const BulletStats* stats,
+		t_alignment alignment,
+		GameBody* target = nullptr
 	);
 
+	// Move every bullet and solve their hits in one batch
+	void update_bullets(float delta);
+
 	EntityStats *get_entity_stats(
 		const std::string &name,
 		bool *success = nullptr);
@@ -528,6 +687,9 @@ struct GameData : public Variant
 
 	void hide_entity(EntityBody *);
 
+	// Read the barrier changes, once per tick before the entities update
+	void update_path_changes();
+
 	// Nearest Neighrbor
 
 	// Bodies
@@ -540,6 +702,8 @@ struct GameData : public Variant
 		size_t limit = SIZE_MAX,
 		Condition &&additionCondition = DEFAULT_ADDITION())
 	{
+		PROFILE_ZONE("Quadtree query");
+		PROFILE_COUNT("Quadtree queries", 1);
 		auto less = [pos](const GameBody *a, const GameBody *b) {
 			const sf::Vector2f &posA = a->pos, &posB = b->pos;
 			return vec_distsq(posA, pos) < vec_distsq(posB, pos);
@@ -555,8 +719,10 @@ struct GameData : public Variant
 			{
 				if (!this->chunks->has_tile(i, j))
 					continue;
-				Tile &tile = this->chunks->get_tile(i, j);
-				BuildingBody *build = tile.building;
+				auto tilePair = this->chunks->get_pair(i, j);
+				const Grid &grid = *tilePair.first;
+				const Tile &tile = tilePair.second;
+				BuildingBody *build = grid.get_building(tile);
 				GameBody *body;
 
 				if (build)
@@ -583,15 +749,13 @@ struct GameData : public Variant
 					ret.insert(std::lower_bound(
 								   ret.begin(),
 								   ret.end(),
-								   tile.building,
+								   build,
 								   less),
 							   dynamic_cast<Type *>(body));
 				}
 				if (!tile.is_barrier())
 				{
-					for (auto itr = tile.entities.begin(); itr != tile.entities.end(); ++itr)
-					{
-						EntityBody *e = *itr;
+					grid.for_each_entity(tile, [&](EntityBody *e) {
 						body = dynamic_cast<GameBody *>(e);
 						assert(body);
 						float dist = vec_distsq(e->pos, pos);
@@ -599,12 +763,12 @@ struct GameData : public Variant
 						if (dist > radiusSq ||
 							e->pos == pos ||
 							dist == 0.0f)
-							continue;
+							return;
 
 						if (!additionCondition(
 								dynamic_cast<GameBody *>(body),
 								i, j))
-							continue;
+							return;
 
 						ret.insert(std::lower_bound(
 									   ret.begin(),
@@ -612,7 +776,7 @@ struct GameData : public Variant
 									   body,
 									   less),
 								   dynamic_cast<Type *>(body));
-					}
+					});
 				}
 			}
 		}
@@ -660,12 +824,44 @@ struct GameData : public Variant
 		t_idpair treeId = {ENUM_BODY_TYPE, (t_id)BodyType::BUILDING},
 		const Condition &condition = DEFAULT_CONDITION())
 	{
-		return nearest_bodies_quad(
+		return nearest_bodies_scored(
 			pos,
 			limit,
 			treeId,
 			condition,
-			DEFAULT_COMPARATOR(pos));
+			DEFAULT_SCORER(pos));
+	}
+
+	// Best first search, the scorer gives every body a score (lower is better)
+	// and a lower bound of the scores at some tile distance, see
+	// DEFAULT_SCORER. Faster than a comparator which can't prune the search.
+	template <
+		class Condition = t_def_condition,
+		class Scorer = t_def_scorer>
+	std::list<BuildingBody *>
+	nearest_bodies_scored(
+		const sf::Vector2f &pos,
+		size_t limit,
+		t_idpair treeId,
+		const Condition &condition,
+		const Scorer &scorer)
+	{
+		PROFILE_ZONE("Quadtree query");
+		PROFILE_COUNT("Quadtree queries", 1);
+		std::list<BuildingBody *> ret;
+		auto insertor = std::back_inserter(ret);
+
+		t_tiletree *tree = get_tree(treeId.group, treeId.id);
+
+		tree->nearest_k_scored_insertor<decltype(insertor), BuildingBody *>(
+			vec_pos_to_tile(pos),
+			limit,
+			t_tiletree::MAX_FLOAT,
+			insertor,
+			condition,
+			scorer);
+
+		return ret;
 	}
 
 	template <
@@ -679,6 +875,8 @@ struct GameData : public Variant
 		const Condition &condition,
 		const Comparator &comparator)
 	{
+		PROFILE_ZONE("Quadtree query");
+		PROFILE_COUNT("Quadtree queries", 1);
 		std::list<BuildingBody *> ret;
 		auto insertor = std::back_inserter(ret);
 
@@ -703,6 +901,8 @@ struct GameData : public Variant
 		t_idpair treeId = {ENUM_BODY_TYPE, (t_id)BodyType::BUILDING},
 		Condition condition = DEFAULT_CONDITION())
 	{
+		PROFILE_ZONE("Quadtree query");
+		PROFILE_COUNT("Quadtree queries", 1);
 		std::list<BuildingBody *> ret;
 		auto insertor = std::back_inserter(ret);
 
@@ -737,7 +937,15 @@ struct GameData : public Variant
 
 	Chunks *chunks = nullptr;
 	Timeline timeline;
-	GameTimerManager<t_seconds> timerManager;
+	// Wake-ups of bodies and buildings
+	TimerWheel<t_seconds> scheduler;
+	// The game clock counts ticks, adding up float steps would drift
+	uint64_t simTicks = 0u;
+	// Length of the ticks counted since the step last changed
+	double simStep = 0.0;
+	// Seconds simulated before the step last changed
+	double simBase = 0.0;
+	t_seconds timePaused = -1.0f;
 
 	std::array<float, (size_t)ConstantFloating::COUNT>
 		constFloating = {};
@@ -749,7 +957,7 @@ struct GameData : public Variant
 	int power = 0;
 
 	// Connected electricity grids
-	std::vector<VariantPtr<PowerNetwork>> networks;
+	PowerGrid powerGrid{ this };
 	int lpowerTotal = 0;
 	int powerTotal = 0;
 
@@ -760,7 +968,22 @@ struct GameData : public Variant
 	t_obj_ctr<VariantPtr<BuildingBody>> buildings;
 	std::vector<VariantPtr<EntityCitizen>> entityCitizens;
 
-	std::vector<BuildingBase *> buildingBases;
+	t_obj_ctr<BuildingBase *> buildingBases;
+
+	// Bullets aren't GameBodies, they live in their own pool
+	BulletPool bulletPool{ this };
+	// Swept segments of the bullets, solved once per tick
+	BulletCollision bulletCollision;
+	// Queued nearest bodies queries of the current tick
+	t_nearest_batch nearestQueries;
+	// Assigns idle citizens once per tick
+	JobDispatcher dispatcher{ this };
+	// Entity decisions under a per tick budget
+	AIScheduler aiScheduler{ this };
+	// Update rate of the entities per chunk
+	SimulationLod simulationLod{ this };
+	// Separation of every entity, once per tick
+	CrowdSteering crowd{ this };
 
 	Constructions constructions;
 	long frameCount = 0;
@@ -768,13 +991,28 @@ struct GameData : public Variant
 	// 
 	BuildingBase *infoBuild = nullptr;
 	EntityBody* infoEntity = nullptr;
+	// Called before a building or an entity is freed, for the windows
+	// pointing to them
+	std::function<void(BuildingBase *)> beforeDeleteBuilding;
+	std::function<void(EntityBody *)> beforeDeleteEntity;
 
 	// Appending changes to the world
 	std::deque<BuildingBase *> entityQueue;
 	std::deque<BuildingQueueData> buildingQueue;
 	std::vector<BodyQueueData> bodyQueue;
-	std::deque<sf::Vector2i> addedTiles;
-	std::deque<sf::Vector2i> removedTiles;
+
+	// Changes to the world, every consumer reads them with it's cursor
+	WorldEventBus worldEvents{ this };
+
+	// Barriers changed since the last update_path_changes
+	struct PathChanges
+	{
+		ChunkDirtyMap blocked;
+		// A barrier was removed, any path might get shorter
+		bool opened = false;
+	} pathChanges;
+	WorldEventBus::t_cursor pathCursor = worldEvents.subscribe(
+		WorldEvent::mask(WorldEvent::BARRIER_CHANGED));
 
 	std::set<EntityBody *> entityRemoveQueue;
 
@@ -791,9 +1029,17 @@ struct GameData : public Variant
 	// used mostly by the get_tree and get_trees function.
 	// Id Pair -> string + t_tree
 	t_enum_tree mapEnumTree;
+	// The trees bodies were classified into, by BodyTrees index
+	std::vector<t_tiletree *> treeTable;
+	std::map<std::pair<t_group, t_id>, uint16_t> treeIndices;
 
 	// Protecting the trees in multithreading
 	mutable std::recursive_mutex quadTreeMutex;
+	// Lock-free copies of the trees for other threads
+	EpochPublisher<WorldSnapshot> worldSnapshots;
+	// Set while a reader on another thread uses the snapshots, nothing
+	// is copied every tick otherwise
+	bool publishSnapshots = false;
 	QueryPoolPath* threadPath = nullptr;
 	
 	VariantFactory variantFactory{};
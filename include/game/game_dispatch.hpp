@@ -0,0 +1,98 @@
+#ifndef _GAME_DISPATCH
+#define _GAME_DISPATCH
+
+#include "game_entity.hpp"
+#include "game_buildings.hpp"
+
+#include <vector>
+#include <unordered_map>
+
+struct GameData;
+
+// Hands out work to idle citizens once per tick.
+// Citizens queue a request instead of searching on their own, the
+// candidates of every request are found by one batched nearest query
+// and the pairs are assigned greedily from the closest one.
+// The free slots of a workplace and the free weight of a storage are
+// counted while assigning, so citizens don't race for the last slot,
+// and only the chosen pair is path-found instead of every candidate.
+struct JobDispatcher
+{
+	enum class Demand
+	{
+		// An unemployed citizen looking for a workplace
+		WORKPLACE,
+		// A worker dumping resources it's workplace doesn't use
+		STORAGE,
+		// A worker fetching it's workplace's input from a storage
+		GATHER,
+		// A courier bringing it's inventory to a workplace using it
+		DELIVER,
+		// A courier taking the resources a workplace doesn't use
+		PICKUP,
+	};
+
+	struct Request
+	{
+		EntityCitizen *citizen = nullptr;
+		Demand demand = Demand::WORKPLACE;
+		// The resources to dump, only for STORAGE
+		Resources resources;
+		size_t query = 0u;
+	};
+
+	// A possible assignment
+	struct Pair
+	{
+		int distsq = 0;
+		size_t request = 0u;
+		BuildingBody *body = nullptr;
+	};
+
+	// Nearest candidates of every request
+	static constexpr size_t CANDIDATES = 4u;
+
+	GameData *context = nullptr;
+
+	std::vector<Request> requests;
+
+	// Stats of the last solve
+	size_t assigned = 0u;
+	size_t paths = 0u;
+
+	JobDispatcher(GameData *context = nullptr);
+
+	// False if the dispatcher found nothing for "demand" the last time,
+	// see EntityCitizen::dispatchSkip
+	bool request(
+		EntityCitizen *citizen,
+		Demand demand,
+		const Resources &resources = {});
+
+	// Called when a body is deleted, drops it's requests
+	void forget(const GameBody *body);
+
+	// Assign every request, requests that got nothing are dropped
+	void solve();
+
+	void clear();
+
+  private:
+	bool valid(const Request &request) const;
+
+	// Queue the nearest query of the request's candidates
+	size_t queue(const Request &request);
+
+	bool assign(const Request &request, BuildingBody *body);
+
+	// Scratch buffers of solve
+	std::vector<Pair> m_pairs;
+	std::vector<char> m_done;
+	// Free workplace slots, weight reserved to be brought to and to be
+	// taken from the buildings
+	std::unordered_map<BuildingBase *, int> m_slots;
+	std::unordered_map<BuildingBase *, int> m_reserved;
+	std::unordered_map<BuildingBase *, int> m_taken;
+};
+
+#endif // _GAME_DISPATCH
@@ -2,6 +2,7 @@
 #define _GAME_ENTITY
 
 #include "game_body.hpp"
+#include "game_grid.hpp"
 #include "../file/serialization.hpp"
 
 #include <set>
@@ -33,7 +34,7 @@ struct PathData : public Variant
 
 	t_vec_list path;
 	t_vec_list::const_iterator follower;
-	Tile *destination = nullptr;
+	bool hasDestination = false;
 	Vec<int> destPos;
 
 	PathData(size_t id = 0);
@@ -228,6 +229,23 @@ struct EntityBody : public GameBody
 	// If changes, update the path
 	IVec targetLPos{};
 
+	// Waiting for the AIScheduler
+	bool decisionQueued = false;
+	// In the Grid::entityNodes of the chunk it stands in
+	uint16_t tileNode = Tile::NONE;
+
+	// Set by the SimulationLod, the level and ticks of the current update
+	uint8_t lodLevel = 0u;
+	unsigned lodTicks = 1u;
+	// Skipped ticks since the last update
+	float lodDelta = 0.f;
+	unsigned lodPending = 0u;
+
+	// Separation from the other entities, set by the CrowdSteering
+	FVec separation{};
+	int separationCount = 0;
+	long separationFrame = -1;
+
 	PropertySet<EntityPropertyBools, EntityPropertyNums>
 		props;
 
@@ -270,6 +288,15 @@ struct EntityBody : public GameBody
 
 	void update(float delta) override;
 
+	// Cheaper movement of the distant entities, see SimulationLod
+	void update_reduced(float speedScale);
+
+	// Regenerate the path when the grid changed
+	void update_grid_change();
+
+	// Fill nearbyBuilds with the buildings touching the radius
+	void collect_nearby_builds();
+
 	void change_action(Action action);
 
 	virtual void force_stop();
@@ -282,6 +309,9 @@ struct EntityBody : public GameBody
 
 	virtual void logic_reset() {}
 
+	// Run logic_reset once the AI scheduler gets to it
+	void queue_decision();
+
 	void logic_aggresive();
 
 	void variant_initialize() override {};
@@ -345,6 +375,9 @@ struct EntityCitizen : public EntityBody
 	VariantPtr<BuildingBase> home = nullptr;
 	VariantPtr<BuildingBase> workplace = nullptr;
 	bool insideWorkplace = false;
+	// Inside the entities lists of the home and the workplace,
+	// and storedEntities of the workplace
+	NodeHandle homeSlot, workSlot, storedSlot;
 	Resources rInventory, rInventoryCap;
 
 	// When sending an entity to a location,
@@ -355,6 +388,13 @@ struct EntityCitizen : public EntityBody
 	// resources to collect / gather, know what resources to move
 	Resources rActionBool = { 0 };
 
+	// Waiting for the JobDispatcher
+	bool dispatchQueued = false;
+	// Bit per JobDispatcher::Demand it found nothing for, skipped until
+	// logic_reset_worker is called by something else than the dispatcher
+	uint8_t dispatchSkip = 0u;
+	bool dispatchRetry = false;
+
 	EntityCitizen();
 
 	EntityCitizen(
@@ -389,6 +429,8 @@ struct EntityCitizen : public EntityBody
 
 	void logic_test01();
 
+	void logic_reset_test01();
+
 	void logic_reset_worker();
 
 	void logic_reset() override;
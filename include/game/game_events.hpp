@@ -0,0 +1,141 @@
+#ifndef _GAME_EVENTS
+#define _GAME_EVENTS
+
+#include "game_grid.hpp"
+
+#include <bitset>
+#include <unordered_map>
+#include <vector>
+
+struct GameData;
+
+// A change to the world
+struct WorldEvent
+{
+	enum Type : uint8_t
+	{
+		BUILDING_PLACED,
+		BUILDING_REMOVED,
+		// "value" is if the tile is a barrier now
+		BARRIER_CHANGED,
+		ENTITY_ENTERED_CHUNK,
+		ENTITY_LEFT_CHUNK,
+		TYPE_COUNT
+	};
+
+	static constexpr uint32_t ALL = (1u << TYPE_COUNT) - 1u;
+
+	static constexpr uint32_t mask(Type type)
+	{
+		return 1u << type;
+	}
+
+	Type type = TYPE_COUNT;
+	bool value = false;
+	IVec tile{};
+	// The building's base or the entity, only for comparing,
+	// might be deleted by the time the event is read
+	const Variant *subject = nullptr;
+	long frame = 0;
+};
+
+// Changed tiles, one bitmap per chunk
+struct ChunkDirtyMap
+{
+	typedef std::bitset<CHUNK_W * CHUNK_H> t_bits;
+
+	std::unordered_map<unsigned, t_bits> chunks;
+
+	void mark(const IVec &tile);
+
+	bool tile_dirty(const IVec &tile) const;
+
+	bool chunk_dirty(const IVec &chunk) const;
+
+	// Null if nothing changed in the chunk
+	const t_bits *get(const IVec &chunk) const;
+
+	bool empty() const
+	{
+		return chunks.empty();
+	}
+
+	void clear()
+	{
+		chunks.clear();
+	}
+
+	static IVec chunk_of(const IVec &tile);
+};
+
+// Feed of the world's changes.
+// Events are appended to a ring buffer, every consumer subscribes to
+// some types and reads from it's own cursor, so consumers never miss a
+// change or see it twice no matter when in the tick they read.
+// A consumer that falls more than the ring behind loses events and is
+// told so by read(), it should rebuild everything.
+struct WorldEventBus
+{
+	typedef size_t t_cursor;
+
+	static constexpr size_t CAPACITY = 1u << 14u;
+
+	GameData *context = nullptr;
+
+	WorldEventBus(GameData *context = nullptr);
+
+	t_cursor subscribe(uint32_t types = WorldEvent::ALL);
+
+	void unsubscribe(t_cursor cursor);
+
+	void push(WorldEvent event);
+
+	// Calls "f" with every event since the last read,
+	// returns false if events were lost
+	template <class F>
+	bool read(t_cursor cursor, F f)
+	{
+		Cursor &c = m_cursors[cursor];
+		bool complete = !c.lost;
+		c.lost = false;
+		if (m_head - c.pos > CAPACITY)
+		{
+			complete = false;
+			c.pos = m_head - CAPACITY;
+		}
+		for (; c.pos < m_head; ++c.pos)
+		{
+			const WorldEvent &e = m_ring[c.pos % CAPACITY];
+			if (c.types & WorldEvent::mask(e.type))
+				f(e);
+		}
+		return complete;
+	}
+
+	// Marks the tiles of every event since the last read
+	bool read(t_cursor cursor, ChunkDirtyMap &out);
+
+	// Events pushed since the start
+	uint64_t count() const
+	{
+		return m_head;
+	}
+
+	// The consumers are told that they lost the events
+	void clear();
+
+  private:
+	struct Cursor
+	{
+		uint64_t pos = 0u;
+		uint32_t types = 0u;
+		bool active = false;
+		bool lost = false;
+	};
+
+	std::vector<WorldEvent> m_ring;
+	uint64_t m_head = 0u;
+	std::vector<Cursor> m_cursors;
+};
+
+#endif // _GAME_EVENTS
@@ -4,6 +4,7 @@
 #include "../file/serialization.hpp"
 #include "../utils/container/quad_tree.hpp"
 
+#include <bitset>
 #include <mutex>
 
 struct EntityBody;
@@ -12,32 +13,67 @@ struct BuildingBase;
 struct EntityCitizen;
 struct EntityEnemy;
 
-// Single 1x1 tile
+// Single 1x1 tile, 8 bytes.
+// The building and the entities are kept by the tile's Grid, the tile
+// only has their indices. The position is the tile's index in the Grid.
 struct Tile
 {
+	static constexpr uint16_t NONE = UINT16_MAX;
+	static constexpr t_byte MAX_ROUGHNESS = 3u;
+	// Speed lost on every level of roughness
+	static constexpr float ROUGHNESS_SLOWDOWN = 0.1f;
+
 	// Tile properties
-	bool visible = true;
-	bool active = true;
-	t_byte speedBonus = 0u;
+	bool visible : 1;
+	bool active : 1;
+	bool _selected : 1;
+	// Copy of the building's BARRIER property
+	bool barrier : 1;
+	// Terrain from the world generator, 0 is flat ground and
+	// MAX_ROUGHNESS slows the entities walking on it the most
+	t_byte roughness = 0u;
 	t_byte attackBonud = 0u;
 	t_byte bodyBonus = 0u;
-	
-	sf::Vector2i tilePos;
-
-	bool _selected = false;
-
-	// GameBody
-	 VariantPtr<BuildingBody> building = nullptr;
-	 std::list<VariantPtr<EntityBody>> entities;
 
-	bool is_barrier() const;
-
-	bool remove_entity(EntityBody *e);
+	// Index in Grid::buildings
+	uint16_t building = NONE;
+	// First of the tile's nodes in Grid::entityNodes
+	uint16_t entities = NONE;
+
+	Tile() : visible(true), active(true), _selected(false), barrier(false) {}
+
+	bool is_barrier() const
+	{
+		return barrier;
+	}
+
+	// Multiplier of the walking speed on the tile
+	float speed() const
+	{
+		return 1.f - ROUGHNESS_SLOWDOWN * (float)roughness;
+	}
+
+	bool has_building() const
+	{
+		return building != NONE;
+	}
+
+	bool has_entities() const
+	{
+		return entities != NONE;
+	}
+};
 
-	BuildingBase* get_building();
+static_assert(sizeof(Tile) == 8, "Tile should stay 8 bytes.");
 
-	// void serialize_post(const SerializeMap &map);
-	
+// An entity on one of the chunk's tiles, the nodes of a tile are chained
+struct TileEntityNode
+{
+	EntityBody *entity = nullptr;
+	uint16_t prev = Tile::NONE;
+	uint16_t next = Tile::NONE;
+	// Index of the tile in the chunk
+	uint16_t tile = Tile::NONE;
 };
 
 // 16x16 chunk
@@ -60,6 +96,13 @@ struct Grid
 	t_set<t_ptr<EntityCitizen>> setCitizens;
 	t_set<t_ptr<EntityEnemy>> setEnemies;
 
+	// Bodies of the buildings on the tiles, empty slots are reused
+	std::vector<BuildingBody *> buildings;
+	std::vector<uint16_t> freeBuildings;
+	// Entities on the tiles, EntityBody::tileNode is it's node
+	std::vector<TileEntityNode> entityNodes;
+	uint16_t freeEntityNode = Tile::NONE;
+
 	Grid();
 
 	Grid(int cx, int cy, int idx, int idy);
@@ -68,6 +111,34 @@ struct Grid
 
 	Tile &operator()(int x, int y) const;
 
+	IVec tile_pos(const Tile &tile) const;
+
+	BuildingBody *get_building(const Tile &tile) const;
+
+	// Null to clear the tile
+	void set_building(Tile &tile, BuildingBody *building);
+
+	// After the building's BARRIER property changed
+	void update_barrier(Tile &tile);
+
+	// O(1), the entity keeps it's node
+	void link_entity(Tile &tile, EntityBody *entity);
+
+	// False if the entity isn't on the tile
+	bool unlink_entity(Tile &tile, EntityBody *entity);
+
+	template <class F>
+	void for_each_entity(const Tile &tile, F f) const
+	{
+		for (uint16_t i = tile.entities; i != Tile::NONE;)
+		{
+			// "f" may unlink the entity
+			const uint16_t next = entityNodes[i].next;
+			f(entityNodes[i].entity);
+			i = next;
+		}
+	}
+
 	void remove_entity(EntityBody*entity);
 
 	void insert_entity(EntityBody *entity);
@@ -77,12 +148,47 @@ struct Grid
 	void remove_building(BuildingBody *build);
 };
 
+// What is left of a chunk that was paged out of memory, enough for
+// pathfinding to go around it's barriers
+struct ChunkSummary
+{
+	enum Side : uint8_t
+	{
+		NORTH,
+		SOUTH,
+		WEST,
+		EAST,
+		SIDE_COUNT
+	};
+
+	static_assert(CHUNK_W <= 32 && CHUNK_H <= 32, "A portal mask is 32 bits.");
+
+	std::bitset<CHUNK_W * CHUNK_H> barriers;
+	// Walkable tiles on each border, one bit per tile
+	uint32_t portals[SIDE_COUNT] = {};
+
+	bool is_barrier(int localX, int localY) const
+	{
+		return barriers.test(localY * CHUNK_W + localX);
+	}
+
+	// Nothing can walk in or out
+	bool sealed() const
+	{
+		return !(portals[NORTH] | portals[SOUTH] | portals[WEST] | portals[EAST]);
+	}
+
+	static ChunkSummary from_grid(const Grid &grid);
+};
+
 //
 struct Chunks : Variant
 {
 	mutable std::recursive_mutex chunksMutex;
 
 	std::unordered_map<unsigned, Grid *> available;
+	// Chunks paged out of memory, see ChunkPager
+	std::unordered_map<unsigned, ChunkSummary> summaries;
 	size_t gridw, gridh;
 
 	static unsigned gen_key(short x, short y);
@@ -105,6 +211,9 @@ struct Chunks : Variant
 	
 	void add(Grid *grid);
 
+	// Takes the chunk out without deleting it, null if it isn't loaded
+	Grid *remove(short indexX, short indexY);
+
 	bool has_tile(int x, int y) const;
 
 	Grid *get(short indexX, short indexY) const;
@@ -123,6 +232,35 @@ struct Chunks : Variant
 	bool has_build(int x, int y) const;
 
 	BuildingBody *get_build(int x, int y) const;
+
+	// Null if there is no building or it has no base
+	BuildingBase *get_base(int x, int y) const;
+
+	void set_build(int x, int y, BuildingBody *building);
+
+	// After the building's BARRIER property changed
+	void update_barrier(int x, int y);
+
+	void add_entity(int x, int y, EntityBody *entity);
+
+	// False if the entity isn't on the tile
+	bool remove_entity(int x, int y, EntityBody *entity);
+
+	template <class F>
+	void for_each_entity(int x, int y, F f) const
+	{
+		auto pair = get_pair(x, y);
+		pair.first->for_each_entity(pair.second, f);
+	}
+
+	// Null if the chunk is loaded or was never made
+	const ChunkSummary *get_summary(short indexX, short indexY) const;
+
+	// The barriers of paged out chunks, false anywhere else
+	bool is_paged_barrier(int x, int y) const;
+
+	// If the tile is in a paged out chunk that can't be entered
+	bool is_sealed(int x, int y) const;
 };
 
 #endif // _GAME_GRID
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef _GAME_LOD
+#define _GAME_LOD
+
+#include "game_entity.hpp"
+
+#include <unordered_map>
+
+struct GameData;
+
+// Level of detail of the entities' simulation, chosen per chunk.
+// Chunks around the camera and chunks with combat update every tick,
+// farther chunks update every few ticks with the skipped ticks' delta,
+// their entities are moved along their path's nodes without the
+// separation and the idle wandering.
+// Decisions and timers run on the game's time, so the economy doesn't
+// depend on the level, only on where the entities stand.
+// The levels are computed every tick, so chunks are promoted and
+// demoted as the camera moves and fights start.
+struct SimulationLod
+{
+	enum Level : uint8_t
+	{
+		FULL,
+		REDUCED,
+		FAR,
+		LEVEL_COUNT
+	};
+
+	// Ticks between updates of every level
+	static constexpr unsigned PERIODS[LEVEL_COUNT] = { 1u, 4u, 16u };
+	// Distance in chunks from the camera's chunk
+	static constexpr int FULL_RADIUS = 1;
+	static constexpr int REDUCED_RADIUS = 3;
+	// A chunk stays at full detail this long after a hit
+	static constexpr t_seconds COMBAT_TIME = 5.f;
+
+	GameData *context = nullptr;
+
+	// The camera's chunk
+	IVec camera{};
+	// Last hit in every chunk
+	std::unordered_map<unsigned, t_seconds> combat;
+
+	// Entities per level that were scheduled in the last tick
+	size_t counts[LEVEL_COUNT]{};
+
+	SimulationLod(GameData *context = nullptr);
+
+	// Called every tick before the entities are updated
+	void set_camera(const FVec &pos);
+
+	// Keeps the chunk at full detail for a while
+	void mark_combat(const FVec &pos);
+
+	Level level(const EntityBody *entity) const;
+
+	// Returns if the entity updates in this tick, if so "delta" is
+	// replaced with the time since it's last update
+	bool schedule(EntityBody *entity, float &delta);
+
+	void clear();
+
+	static IVec chunk_of(const FVec &pos);
+};
+
+#endif // _GAME_LOD
@@ -0,0 +1,115 @@
+#ifndef _GAME_PAGING
+#define _GAME_PAGING
+
+#include "game_worldgen.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct GameData;
+
+// Moves the chunks far from the colonies and the camera out of memory.
+// A paged out chunk is written to a region file, a file for every
+// REGION_SIZE x REGION_SIZE chunks, and only it's summary stays in
+// Chunks::summaries for pathfinding. It's read back on a worker when a
+// colony, an entity or the camera comes near again, and added like a
+// generated chunk.
+// Only chunks of bare ground and untouched resources are paged out, a
+// chunk with entities or colony buildings stays, so nothing but
+// tiles and resource amounts has to be written.
+struct ChunkPager
+{
+	static constexpr int REGION_SIZE = 8;
+
+	struct Settings
+	{
+		// Chunks kept in memory around the camera and colony buildings
+		int keepRadius = 3;
+		// Chunks kept around chunks with entities
+		int entityRadius = 1;
+		// Extra chunks before paging out, so a chunk on the edge doesn't
+		// go back and forth
+		int margin = 1;
+		// Ticks between looking for chunks to page
+		unsigned interval = 30u;
+		size_t evictPerTick = 2u;
+		size_t loadPerTick = 2u;
+	};
+
+	Settings settings;
+
+	// Makes a region directory of it's own for this run
+	ChunkPager();
+
+	// Finishes the writes and deletes the region files
+	~ChunkPager();
+
+	// Pages the chunks out and in, a few every tick
+	void update(GameData &data, Chunks &chunks, const IVec &cameraTile);
+
+	// Reads back every paged out chunk and waits for it, before saving
+	void restore_all(GameData &data, Chunks &chunks);
+
+	// Forgets every paged out chunk, after the world was cleaned
+	void reset();
+
+	bool paged_out(const IVec &chunk) const;
+
+	size_t paged_count() const
+	{
+		return m_paged.size();
+	}
+
+	// Bytes written to the region files since the start
+	size_t bytes_written() const
+	{
+		return m_written;
+	}
+
+	const std::string &directory() const
+	{
+		return m_directory;
+	}
+
+  private:
+	struct Load
+	{
+		WorldGenerator::ChunkPlan plan;
+		size_t task = 0u;
+	};
+
+	void scan(GameData &data, Chunks &chunks, const IVec &cameraTile);
+
+	bool can_page_out(const Grid &grid) const;
+
+	bool page_out(GameData &data, Chunks &chunks, const IVec &chunk);
+
+	void page_in(const IVec &chunk);
+
+	// Deletes the region files this pager wrote, and it's directory if
+	// nothing else is in it
+	void remove_regions();
+
+	// Adds the loaded chunks in the order they were read
+	size_t commit(GameData &data, Chunks &chunks, size_t maxChunks);
+
+	// Single worker, the region files are read and written in order
+	TaskPool m_io{ 1u };
+	// The chunk of every key, the keys can't be turned back into chunks
+	std::unordered_map<unsigned, IVec> m_paged;
+	std::unordered_set<unsigned> m_loading;
+	std::vector<std::unique_ptr<Load>> m_loads;
+	size_t m_nextLoad = 0u;
+	std::vector<IVec> m_evictions;
+	std::vector<IVec> m_requests;
+	unsigned m_tick = 0u;
+	size_t m_written = 0u;
+	// Under the system's temporary directory, a new one every run
+	std::string m_directory;
+	std::unordered_set<std::string> m_regions;
+};
+
+#endif // _GAME_PAGING
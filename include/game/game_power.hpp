@@ -0,0 +1,116 @@
+#ifndef _GAME_POWER
+#define _GAME_POWER
+
+#include "game_buildings.hpp"
+
+#include <vector>
+#include <deque>
+
+struct GameData;
+
+// Connectivity graph of every power network building.
+// Buildings are nodes and two buildings are connected if they're
+// inside each other's effect radius.
+// The connected components (the networks) are tracked by an
+// union-find, so connecting buildings is (almost) constant time.
+// Removing a building runs a BFS from each of it's neighbours at
+// the same time, the searches stop as soon as all of them meet, so
+// the cost is bounded by the removed node's degree and the size of
+// the smaller pieces and not by the size of the whole network.
+struct PowerGrid
+{
+	static constexpr size_t NULL_NODE = SIZE_MAX;
+	// Minimum tombstones before the nodes array is compacted
+	static constexpr size_t COMPACT_LIMIT = 64u;
+
+	struct Node
+	{
+		BuildingBase *base = nullptr;
+		// Union-find
+		size_t parent = NULL_NODE;
+		unsigned rank = 0u;
+		// Living buildings in the component, valid only for roots
+		size_t size = 0u;
+		// The network of the component, valid only for roots
+		PowerNetwork *network = nullptr;
+		// Connected nodes
+		std::vector<size_t> adj;
+		// Removed nodes are kept as tombstones so the parent
+		// chains going through them stay valid
+		bool alive = false;
+	};
+
+	// Flow of a single network, solved once per tick
+	struct Flow
+	{
+		int out = 0;
+		int in = 0;
+		int store = 0;
+		// Power left for consumers
+		int value = 0;
+		// Power left for the stations
+		int storeCount = 0;
+	};
+
+	GameData *context = nullptr;
+
+	std::vector<Node> nodes;
+	size_t aliveCount = 0u;
+	size_t deadCount = 0u;
+
+	// Connected electricity grids, every network knows it's index
+	std::vector<VariantPtr<PowerNetwork>> networks;
+	// Networks that were merged into another, deleted on the next solve
+	// so buildings holding them won't point to freed memory
+	std::vector<PowerNetwork *> retired;
+
+	// Dense array of flows, indexed by PowerNetwork::index
+	std::vector<Flow> flows;
+
+	PowerGrid(GameData *context = nullptr);
+
+	~PowerGrid();
+
+	// Add a building and connect it to it's neighbours
+	void add(BuildingBase *base, const std::vector<BuildingBase *> &neighbours);
+
+	// Remove a building, splits the network if it was a bridge
+	void remove(BuildingBase *base);
+
+	size_t find(size_t node);
+
+	void unite(size_t a, size_t b);
+
+	PowerNetwork *get_network(const BuildingBase *base);
+
+	// Solve every network and write the results into the buildings,
+	// returns the total power of all networks, and the power
+	// given to the stations via "power"
+	int solve(int &power);
+
+	void clear();
+
+	// The output a building adds to it's network
+	static int output(const BuildingBase *base);
+
+  private:
+	// Search for split from the neighbours of a removed node
+	void split(const std::vector<size_t> &neighbours, size_t root);
+
+	// Move a piece that lost it's connection into a new component
+	void detach(const std::vector<size_t> &piece, size_t oldRoot);
+
+	// Rebuild the nodes array without the tombstones
+	void compact();
+
+	PowerNetwork *network_new();
+
+	void network_retire(PowerNetwork *network);
+
+	// Scratch buffers of the split search
+	std::vector<unsigned> m_stamp;
+	std::vector<size_t> m_owner;
+	unsigned m_stampCounter = 0u;
+};
+
+#endif // _GAME_POWER
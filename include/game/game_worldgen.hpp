@@ -0,0 +1,95 @@
+#ifndef _GAME_WORLDGEN
+#define _GAME_WORLDGEN
+
+#include "game_grid.hpp"
+#include "../libs/FastNoiseLite.h"
+#include "../utils/class/task_pool.hpp"
+
+#include <climits>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+struct GameData;
+
+// Chunks generated by worker threads.
+// A chunk depends only on the seed and it's index, so it comes out the
+// same in every run and in any order. The terrain is fractal noise and
+// the resource deposits are cells of cellular noise, both sampled in
+// world coordinates so deposits continue across chunk borders.
+// Workers build the Grid and the list of buildings to spawn, the main
+// thread adds them in commit() a few chunks at a time, so generating a
+// big area doesn't stall a frame.
+struct WorldGenerator
+{
+	struct Spawn
+	{
+		IVec pos;
+		BuildingType type = BuildingType::RAW_ORE;
+		int resourceId = 0;
+		int amount = 0;
+	};
+
+	struct ChunkPlan
+	{
+		IVec index;
+		Grid *grid = nullptr;
+		std::vector<Spawn> spawns;
+	};
+
+	struct Settings
+	{
+		int seed = 1337;
+		float terrainFrequency = 0.02f;
+		int terrainOctaves = 4;
+		float depositFrequency = 0.06f;
+		// Distance from a cell's center, in cells, that is still deposit
+		float depositRadius = 0.1f;
+		// Share of the cells holding gems and ore
+		float gemChance = 0.05f;
+		float oreChance = 0.18f;
+		int oreMin = 10, oreMax = 50;
+		int gemMin = 3, gemMax = 15;
+	};
+
+	Settings settings;
+
+	WorldGenerator(size_t threads = 0u);
+
+	// Drops the chunks that weren't committed
+	~WorldGenerator();
+
+	void request(const IVec &chunk);
+
+	// Every chunk within "radius" chunks of "center", nearest first
+	void request_area(const IVec &center, int radius);
+
+	// Adds the finished chunks in the order they were requested, stops at
+	// the first one that isn't ready, returns how many were added
+	size_t commit(GameData &data, Chunks &chunks, size_t maxChunks = SIZE_MAX);
+
+	// Requested but not committed
+	size_t pending() const
+	{
+		return m_plans.size() - m_next;
+	}
+
+	// Blocks until every requested chunk is generated
+	void wait();
+
+	// Adds the plan's chunk and buildings, false if the chunk is
+	// loaded or paged out already. Takes the plan's grid either way
+	static bool place(GameData &data, Chunks &chunks, ChunkPlan &plan);
+
+	// Runs on any thread
+	static ChunkPlan generate(const Settings &settings, const IVec &chunk);
+
+  private:
+	TaskPool m_pool;
+	std::vector<std::unique_ptr<ChunkPlan>> m_plans;
+	std::vector<size_t> m_tasks;
+	size_t m_next = 0u;
+	std::unordered_set<unsigned> m_requested;
+};
+
+#endif // _GAME_WORLDGEN
@@ -71,11 +71,16 @@ inline PathData generate_path(
 	float radius = -1.f,
 	bool ignoreBarriers = false)
 {
+	PROFILE_ZONE("Path");
+	PROFILE_COUNT("Paths computed", 1);
 	const auto isBarrier = [chunks, ignoreBarriers](const sf::Vector2i &pos) {
 		if (ignoreBarriers)
 		  return false;
 		const Tile *tile = chunks->get_tile_safe(pos.x, pos.y);
-		return (tile && tile->is_barrier());
+		if (tile)
+			return tile->is_barrier();
+		// Paged out chunks are walked by their summary
+		return chunks->is_paged_barrier(pos.x, pos.y);
 	};
 
 	const auto euclideanHeuristicDist = [](const sf::Vector2i &a, const sf::Vector2i &b) {
@@ -102,6 +107,14 @@ inline PathData generate_path(
 	if (start == end)
 	  return {};
 
+	// The end is in a paged out chunk that can't be entered,
+	// don't search the whole map for it
+	if (!ignoreBarriers &&
+		chunks->is_sealed(end.x, end.y) &&
+		(math_floordiv(start.x, CHUNK_W) != math_floordiv(end.x, CHUNK_W) ||
+		 math_floordiv(start.y, CHUNK_H) != math_floordiv(end.y, CHUNK_H)))
+		return {};
+
 	while (!openSet.empty() && iterationCount < BIG_INFINITY)
 	{
 		++iterationCount;
@@ -216,7 +229,7 @@ inline PathData generate_path(
 
 	if (chunks->has_tile(end.x, end.y))
 	{
-		ret.destination = &chunks->get_tile(end.x, end.y);
+		ret.hasDestination = true;
 		ret.destPos = end;
 	}
 
@@ -261,7 +274,7 @@ inline void pathdata_update_path(
 
 	pathData.append(pathAdditional);
 	pathData.destPos = pathAdditional.destPos;
-	pathData.destination = pathAdditional.destination;
+	pathData.hasDestination = pathAdditional.hasDestination;
 }
 
 template <
@@ -279,6 +292,7 @@ static PathData find_build_path(
 	float maxRadius = -1.f,
 	Condition condition = DEFAULT_PATHFIND_CONDITION())
 {
+	PROFILE_ZONE("Build path");
 	const int dijkstra = (int)context->get_const(
 		t_constnum::A_STAR_DIJKSTRA_VALUE);
 	const int greed = (int)context->get_const(
@@ -7,6 +7,9 @@
 
 #include <SFML/Graphics.hpp>
 
+#include <string>
+#include <vector>
+
 constexpr const char* CHARS_ARRAY =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
     "abcdefghijklmnopqrstuvwxyz"
@@ -14,6 +17,43 @@ constexpr const char* CHARS_ARRAY =
     ":!? ";
 constexpr size_t CHARS_ARRAY_LEN = 67;
 
+// Appends two triangles per glyph of "str" to "out", starting at "origin".
+// "rectOf" returns the texture rect of a character, or nullptr if the
+// character has no glyph, which is skipped.
+// Doesn't need a window or a texture, returns the width of the text.
+template <class RectOf>
+float fastlabel_quads(
+    std::vector<sf::Vertex>& out,
+    const std::string& str,
+    int spacing,
+    RectOf&& rectOf,
+    sf::Vector2f origin = { 0.f, 0.f },
+    sf::Color color = sf::Color::White)
+{
+    float x = origin.x;
+    for (char c : str)
+    {
+        const sf::IntRect* rect = rectOf(c);
+        if (!rect)
+            continue;
+
+        const float l = x, t = origin.y;
+        const float r = l + (float)rect->width, b = t + (float)rect->height;
+        const float u1 = (float)rect->left, v1 = (float)rect->top;
+        const float u2 = u1 + (float)rect->width, v2 = v1 + (float)rect->height;
+
+        out.push_back({ { l, t }, color, { u1, v1 } });
+        out.push_back({ { r, t }, color, { u2, v1 } });
+        out.push_back({ { l, b }, color, { u1, v2 } });
+        out.push_back({ { l, b }, color, { u1, v2 } });
+        out.push_back({ { r, t }, color, { u2, v1 } });
+        out.push_back({ { r, b }, color, { u2, v2 } });
+
+        x += (float)(rect->width + spacing);
+    }
+    return x - origin.x;
+}
+
 struct CharSpriteSheet
 {
 
@@ -131,6 +171,18 @@ struct CharSpriteSheet
         return sprites[c]->getTextureRect();
     }
 
+    // Nullptr if the character isn't in the sheet
+    const sf::IntRect* findRect(char c) const
+    {
+        const sf::Sprite* sprite = sprites[(unsigned char)c];
+        return sprite ? &sprite->getTextureRect() : nullptr;
+    }
+
+    const sf::Texture& getTexture() const
+    {
+        return texFinal.getTexture();
+    }
+
     sf::Vector2i getSize(char c) const
     {
         assert(sprites[c]);
@@ -149,6 +201,46 @@ struct CharSpriteSheet
     }
 };
 
+// Collects the glyphs of many FastLabels and draws them in one call.
+// Every label must use the same CharSpriteSheet.
+struct FastLabelBatcher
+{
+    std::vector<sf::Vertex> vertices;
+    const sf::Texture* texture = nullptr;
+
+    // Labels drawn in the last flush
+    size_t labels = 0;
+    size_t pending = 0;
+
+    void add(
+        const std::vector<sf::Vertex>& quads,
+        const sf::Transform& transform,
+        const sf::Texture* texture)
+    {
+        assert(!this->texture || this->texture == texture);
+        this->texture = texture;
+        for (const sf::Vertex& v : quads)
+        {
+            vertices.push_back(v);
+            vertices.back().position = transform.transformPoint(v.position);
+        }
+        ++pending;
+    }
+
+    void flush(sf::RenderTarget& target)
+    {
+        labels = pending;
+        pending = 0;
+        if (vertices.empty())
+            return;
+
+        sf::RenderStates states;
+        states.texture = texture;
+        target.draw(vertices.data(), vertices.size(), sf::Triangles, states);
+        vertices.clear();
+    }
+};
+
 class FastLabel : public tgui::Label
 {
 public:
@@ -160,9 +252,13 @@ public:
     CharSpriteSheet* spriteSheet = nullptr;
 
     sf::RenderWindow* renderWindow = nullptr;
+    // If set the label is drawn by the batcher's flush
+    FastLabelBatcher* batcher = nullptr;
     int spacing = 2;
     std::string stdString = "";
     tgui::Vector2i textRect = { 0, 0 };
+    // Glyph quads of the text, built when the text changes
+    std::vector<sf::Vertex> vertices;
 
 
     FastLabel(const char* typeName = "Label", bool initRenderer = true) :
@@ -207,24 +303,38 @@ public:
     void setCharSpriteSheet(CharSpriteSheet* spriteSheet)
     {
         this->spriteSheet = spriteSheet;
+        buildQuads();
     }
 
 
     void setTextSpacing(int spacing)
     {
         this->spacing = spacing;
+        buildQuads();
     }
 
     void setText(const tgui::String& string)
     {
-        stdString = string.toStdString();
+        std::string str = string.toStdString();
+        if (str == stdString && !vertices.empty())
+            return;
+        stdString = std::move(str);
+        buildQuads();
+    }
 
-        float x = 0, y;
-        for (size_t i = 0; i < stdString.size(); ++i)
-        {
-            x += spriteSheet->getSize(stdString[i]).x + spacing;
-        }
-        y = (float)spriteSheet->getMaxHeight();
+    void buildQuads()
+    {
+        vertices.clear();
+        if (!spriteSheet)
+            return;
+
+        const CharSpriteSheet* sheet = spriteSheet;
+        float x = fastlabel_quads(
+            vertices,
+            stdString,
+            spacing,
+            [sheet](char c) { return sheet->findRect(c); });
+        float y = (float)spriteSheet->getMaxHeight();
 
         this->textRect = { (int)x, (int)y };
     }
@@ -285,20 +395,17 @@ public:
 
         sfStates.transform.translate(vecAlgmnt);
 
-        sf::Vector2i textPos = { 0, 0 };
-        for (size_t i = 0; i < stdString.size(); ++i)
+        if (vertices.empty())
+            return;
+
+        if (batcher)
         {
-            sf::RenderStates s = sfStates;
-            s.transform.translate(
-                (float)textPos.x, 
-                (float)0
-            );
-            renderWindow->draw((*spriteSheet)[stdString[i]], s);
-            
-            textPos.x += spriteSheet->getSize(stdString[i]).x + spacing;
+            batcher->add(vertices, sfStates.transform, &spriteSheet->getTexture());
+            return;
         }
 
-        
+        sfStates.texture = &spriteSheet->getTexture();
+        renderWindow->draw(vertices.data(), vertices.size(), sf::Triangles, sfStates);
     }
 
     void draw(tgui::BackendRenderTargetBase& target, tgui::RenderStates states) const
@@ -148,9 +148,15 @@ struct RendererClass
 	t_sprite spriteTmpBullet = -1;
 
 	size_t renderFrame = 0;
+	// How far the frame is between the last two ticks, moving things are
+	// drawn between their positions
+	float alpha = 1.f;
 
 	AssetManager *assets = nullptr;
 
+	// Reused by render_bullets
+	sf::VertexArray bulletVertices{ sf::Quads };
+
 	RendererClass()
 	{
 	}
@@ -187,13 +193,13 @@ struct RendererClass
 		}
 	}
 
-	FRect render_object(GameBody* body, bool bSearch, ImageAlphaGrid* gridOut = nullptr)
+	FRect render_object(GameBody* body, bool bSearch, const AlphaGridView** gridOut = nullptr)
 	{
 		
 		if (!body->visible)
 			return{};
 
-		FVec bodyPos = body->pos;
+		FVec bodyPos = body->render_pos(alpha);
 		bodyPos.y -= body->z;
 		
 		sf::Vector2i pos = world_pos_to_screen_pos(
@@ -230,23 +236,12 @@ struct RendererClass
 			->get_sprite(spriteHolder);
 
 		sf::Sprite* sTile;
-		size_t spriteId;
-		if (body->type == BodyType::BULLET)
-		{
-			BulletBody* bullet;
-			bullet = dynamic_cast<BulletBody*>(body);
-			assert(bullet);
-
-			spriteId = (size_t)bullet->get_direction_frame(orientation.rotation);
-		}
-		else
-		{
-			spriteId = body->animFrame;
-		}
+		size_t spriteId = body->animFrame;
 		sTile = sprites->get(spriteId);
 
+		// The view of the sprite, not a copy of it's grid
 		if (bSearch)
-			*gridOut = sprites->getAlphaGrid(spriteId);
+			*gridOut = &sprites->getAlphaGrid(spriteId);
 
 		IVec textureSize = sprites->spriteSize;
 
@@ -304,8 +299,7 @@ struct RendererClass
 			GameBody* body = *bodyItr;
 			assert(body);
 
-			ImageAlphaGrid alphaGrid;
-			ImageAlphaGrid* alphaGridPtr = &alphaGrid;
+			const AlphaGridView* alphaGrid = nullptr;
 			FRect rect = render_object(body, searchEntity, &alphaGrid);
 
 			IVec iSearchPos = (IVec)( (searchEntityPos - rect.pos) / orientation.scale.x);
@@ -323,7 +317,7 @@ struct RendererClass
 					!alphaGrid.getPixel(iSearchPos.x, iSearchPos.y));
 					*/
 
-				if (rect.size == FVec{ 0.f, 0.f })
+				if (rect.size == FVec{ 0.f, 0.f } || !alphaGrid)
 					continue;
 
 
@@ -333,7 +327,7 @@ struct RendererClass
 				// pixel is not transparent.
 				if (maskPass &&
 					vec_inside(searchEntityPos, rect.pos, rect.size) &&
-					alphaGrid.getPixel(iSearchPos.x, iSearchPos.y) != ALPHAGRID_TRANSPARENT)
+					alphaGrid->getPixel(iSearchPos.x, iSearchPos.y) != ALPHAGRID_TRANSPARENT)
 				{
 					out = body;
 				}
@@ -344,6 +338,71 @@ struct RendererClass
 		return out;
 	}
 
+	// Draw every bullet, bullets sharing a texture are put
+	// in one vertex array and drawn with a single call
+	void render_bullets(const BulletPool &pool)
+	{
+		assert(window);
+		assert(view);
+
+		const sf::Texture *texture = nullptr;
+		bulletVertices.clear();
+
+		const auto flush = [this, &texture]() {
+			if (bulletVertices.getVertexCount())
+			{
+				PROFILE_COUNT("Draw calls", 1);
+				window->draw(bulletVertices, sf::RenderStates(texture));
+			}
+			bulletVertices.clear();
+		};
+
+		for (uint32_t slot : pool.active)
+		{
+			const t_sprite holder = pool.sprite[slot];
+			if (holder == -1)
+				continue;
+
+			const sf::Vector2i pos = world_pos_to_screen_pos(
+				FVec{
+					pool.px[slot] + (pool.x[slot] - pool.px[slot]) * alpha,
+					pool.py[slot] + (pool.y[slot] - pool.py[slot]) * alpha },
+				orientation);
+			if (!vec_inside<float>(
+				(sf::Vector2f)pos,
+				0,
+				0,
+				view->getSize().x,
+				view->getSize().y))
+				continue;
+
+			const sf::Sprite *s = assets->get_sprite(holder)->get(
+				(size_t)pool.get_direction_frame(slot, orientation.rotation));
+			if (!s)
+				continue;
+
+			if (s->getTexture() != texture)
+			{
+				flush();
+				texture = s->getTexture();
+			}
+
+			// Centered, the same as TextureOrigin::CENTERED
+			const sf::IntRect &rect = s->getTextureRect();
+			const float hw = 0.5f * rect.width * orientation.scale.x;
+			const float hh = 0.5f * rect.height * orientation.scale.y;
+			const float x = (float)pos.x, y = (float)pos.y;
+			const float u0 = (float)rect.left, v0 = (float)rect.top;
+			const float u1 = u0 + rect.width, v1 = v0 + rect.height;
+
+			bulletVertices.append(sf::Vertex({ x - hw, y - hh }, { u0, v0 }));
+			bulletVertices.append(sf::Vertex({ x + hw, y - hh }, { u1, v0 }));
+			bulletVertices.append(sf::Vertex({ x + hw, y + hh }, { u1, v1 }));
+			bulletVertices.append(sf::Vertex({ x - hw, y + hh }, { u0, v1 }));
+		}
+		flush();
+	}
+
 	void render_suggestion(
 		UpgradeTree *buildTree,
 		Chunks *chunks,
@@ -449,6 +508,7 @@ struct RendererClass
 		cs.setRadius(16.f);
 		cs.setOrigin(16, 16);
 		cs.setPosition(view->getCenter());
+		PROFILE_COUNT("Draw calls", 1);
 		window->draw(cs);
 
 		static char infoRes[60] = "";
@@ -494,7 +554,7 @@ struct RendererClass
 					continue;
 
 				Tile &tile = (*grid)(x, y);
-				BuildingBody *building = tile.building;
+				BuildingBody *building = grid->get_building(tile);
 
 				// gridDraw2.rotation = WorldRotation::ROT0;
 				bool bMouseTile = tilePos == screen_pos_to_tile_pos(
@@ -580,6 +640,7 @@ struct RendererClass
 		*/
 		s.setOrigin(originX, originY);
 
+		PROFILE_COUNT("Draw calls", 1);
 		window->draw(s);
 	}
 
@@ -623,6 +684,7 @@ struct RendererClass
 		s.setPosition(x, y);
 		s.setScale(scale);
 
+		PROFILE_COUNT("Draw calls", 1);
 		window->draw(s);
 
 		// Draw rect representing the bounds of the sprite
@@ -638,6 +700,7 @@ struct RendererClass
 			rectShape.setFillColor(sf::Color::Transparent);
 			rectShape.setOutlineColor(sf::Color::Black);
 			rectShape.setOutlineThickness(4);
+			PROFILE_COUNT("Draw calls", 1);
 			window->draw(rectShape);
 		}
 
@@ -650,6 +713,7 @@ struct RendererClass
 
 			circle.setPosition(x, y);
 
+			PROFILE_COUNT("Draw calls", 1);
 			window->draw(circle);
 		}
 
@@ -689,11 +753,13 @@ struct RendererClass
 				sf::Vertex line[2] = {
 					sf::Vertex(pos1),
 					sf::Vertex(pos2)};
+				PROFILE_COUNT("Draw calls", 1);
 				window->draw(line, 2, sf::Lines);
 			}
 			{
 				auto pos = world_pos_to_screen_pos(a, orientation);
 				circle.setPosition((sf::Vector2f)pos);
+				PROFILE_COUNT("Draw calls", 1);
 				window->draw(circle);
 			}
 
@@ -0,0 +1,177 @@
+#ifndef GAME_EPOCH_PUBLISHER
+#define GAME_EPOCH_PUBLISHER
+
+// Single writer, many readers publication of immutable objects.
+// The writer swaps in a new object once in a while (every tick), readers
+// on any thread pin the current object without taking a lock.
+// Replaced objects are freed with epoch based reclamation: a reader
+// writes the epoch it started at into a slot, and an object retired at
+// some epoch is freed only once every pinned reader started after it.
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+template <typename T, size_t READERS = 64>
+class EpochPublisher
+{
+  public:
+    // Keeps the object it was given alive until it's destroyed,
+    // guards are cheap and should be short lived.
+    class Guard
+    {
+      public:
+        explicit Guard(EpochPublisher &publisher)
+            : m_publisher(publisher)
+        {
+            m_slot = publisher.pin();
+            m_value = publisher.m_current.load();
+        }
+
+        ~Guard()
+        {
+            m_publisher.unpin(m_slot);
+        }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+        const T *get() const
+        {
+            return m_value;
+        }
+
+        const T *operator->() const
+        {
+            assert(m_value);
+            return m_value;
+        }
+
+        const T &operator*() const
+        {
+            assert(m_value);
+            return *m_value;
+        }
+
+        explicit operator bool() const
+        {
+            return m_value != nullptr;
+        }
+
+      private:
+        EpochPublisher &m_publisher;
+        const T *m_value = nullptr;
+        size_t m_slot = 0u;
+    };
+
+    EpochPublisher()
+    {
+    }
+
+    // No reader may hold a guard at this point
+    ~EpochPublisher()
+    {
+        delete m_current.exchange(nullptr);
+        for (auto &retired : m_retired)
+            delete retired.first;
+    }
+
+    EpochPublisher(const EpochPublisher &) = delete;
+    EpochPublisher &operator=(const EpochPublisher &) = delete;
+
+    // Can be called from any thread
+    Guard read()
+    {
+        return Guard(*this);
+    }
+
+    // Writer only, the returned object may be read but never changed
+    const T *current() const
+    {
+        return m_current.load();
+    }
+
+    // Writer only, takes the ownership of "value"
+    void publish(const T *value)
+    {
+        const T *old = m_current.exchange(value);
+        if (old)
+            m_retired.emplace_back(old, m_epoch.load());
+        m_epoch.fetch_add(1u);
+        collect();
+    }
+
+    // Writer only, frees every retired object no reader can hold,
+    // returns how many are still waiting.
+    size_t collect()
+    {
+        uint64_t oldest = UINT64_MAX;
+        for (size_t i = 0; i < READERS; ++i)
+        {
+            const uint64_t epoch = m_slots[i].epoch.load();
+            if (epoch && epoch < oldest)
+                oldest = epoch;
+        }
+
+        size_t kept = 0u;
+        for (size_t i = 0; i < m_retired.size(); ++i)
+        {
+            if (m_retired[i].second < oldest)
+                delete m_retired[i].first;
+            else
+                m_retired[kept++] = m_retired[i];
+        }
+        m_retired.resize(kept);
+        return kept;
+    }
+
+    size_t retired() const
+    {
+        return m_retired.size();
+    }
+
+  private:
+    // Take a free slot and write the current epoch in it, the
+    // epoch must be visible before the object is loaded
+    size_t pin()
+    {
+        const size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id()) % READERS;
+        while (true)
+        {
+            for (size_t i = 0; i < READERS; ++i)
+            {
+                const size_t slot = (start + i) % READERS;
+                uint64_t expected = 0u;
+                if (m_slots[slot].epoch.compare_exchange_strong(expected, m_epoch.load()))
+                    return slot;
+            }
+            // Every slot is taken
+            std::this_thread::yield();
+        }
+    }
+
+    void unpin(size_t slot)
+    {
+        m_slots[slot].epoch.store(0u);
+    }
+
+    struct alignas(64) Slot
+    {
+        // Zero when free
+        std::atomic<uint64_t> epoch{0u};
+    };
+
+    std::atomic<const T *> m_current{nullptr};
+    // Starts from one, zero marks a free slot
+    std::atomic<uint64_t> m_epoch{1u};
+    Slot m_slots[READERS];
+
+    // Objects replaced by the writer and the epoch they were replaced at
+    std::vector<std::pair<const T *, uint64_t>> m_retired;
+};
+
+#endif // GAME_EPOCH_PUBLISHER
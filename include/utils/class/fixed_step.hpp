@@ -0,0 +1,70 @@
+#ifndef GAME_FIXED_STEP
+#define GAME_FIXED_STEP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Turns the time between frames into a whole number of simulation ticks
+// of the same length.
+// The time that isn't a whole tick is carried to the next frame, alpha()
+// is how far into the next tick the frame is, for drawing between the
+// last two ticks. A slow frame runs at most "maxTicks" ticks, the rest
+// of the time is dropped so the simulation slows down instead of taking
+// longer every frame.
+struct FixedStep
+{
+	explicit FixedStep(float step = 1.f / 60.f, size_t maxTicks = 5u)
+		: step(step), maxTicks(maxTicks)
+	{
+	}
+
+	// Returns the ticks to run for "elapsed" seconds
+	size_t advance(float elapsed)
+	{
+		m_accumulator += std::max(elapsed, 0.f);
+		size_t count = (size_t)(m_accumulator / step);
+		if (count > maxTicks)
+		{
+			m_dropped += m_accumulator - (float)maxTicks * step;
+			count = maxTicks;
+			m_accumulator = (float)maxTicks * step;
+		}
+		m_accumulator -= (float)count * step;
+		m_ticks += count;
+		return count;
+	}
+
+	// Between 0, the last tick, and 1, the next one
+	float alpha() const
+	{
+		return std::min(m_accumulator / step, 1.f);
+	}
+
+	// After a pause, the time meanwhile isn't simulated
+	void reset()
+	{
+		m_accumulator = 0.f;
+	}
+
+	uint64_t ticks() const
+	{
+		return m_ticks;
+	}
+
+	// Seconds that weren't simulated because of slow frames
+	float dropped() const
+	{
+		return m_dropped;
+	}
+
+	float step;
+	size_t maxTicks;
+
+  private:
+	float m_accumulator = 0.f;
+	float m_dropped = 0.f;
+	uint64_t m_ticks = 0u;
+};
+
+#endif // GAME_FIXED_STEP
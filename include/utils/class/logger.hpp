@@ -1,16 +1,26 @@
 #ifndef GAME_UTILS_LOGGER
 #define GAME_UTILS_LOGGER
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
-#include <type_traits>
+#include <cwchar>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
-
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
-#include <map>
 #include <unordered_set>
+#include <vector>
 
 #ifdef __FILE_NAME__
 #define FILE_NAME __FILE_NAME__
@@ -32,6 +42,12 @@ const static std::string OS_PATH_SLASH = "\\";
 #define FUNC_NAME __FUNCTION__
 #endif
 
+// Levels that are compiled in, the LOG/DEBUG/WARNING/LOG_ERROR calls of
+// the others are removed with their arguments. A mask of Logger::LogType
+#ifndef LOGGER_LEVELS
+#define LOGGER_LEVELS 0b1111u
+#endif
+
 #ifdef __GNUC__
 
 #pragma GCC diagnostic push
@@ -39,200 +55,901 @@ const static std::string OS_PATH_SLASH = "\\";
 
 #endif // __GNUC__
 
-// Static global variables
-// Threading unsafe
-
+// Logging off the calling thread.
+// A call copies it's arguments into a ring buffer of it's thread (the
+// format has to be a string literal) and a writer thread formats and
+// prints them in the order they were made. Every call site has a Site, which limits how many messages
+// it writes in a second and lets the writer fold repeated messages.
+// Errors wait for the writer, so they're out before an assert stops the
+// program, anything else logged right before a crash can be lost.
 namespace Logger
 {
-inline volatile unsigned priority = 0b1111;
 
-/*
-template <class T, class U>
-using t_hmap = std::unordered_map<T, U>;
+enum LogType : unsigned
+{
+    Other = 0,
+    Error = 1,
+    Warning = 2,
+    Log = 4,
+    Debug = 8
+};
 
-template <class T>
-using t_hset = std::unordered_set<T>;
+inline std::atomic<unsigned> priority{ 0b1111u };
+// Messages a call site writes in a second, the rest are counted
+inline std::atomic<unsigned> rateLimit{ 20u };
+// Off to format and print on the calling thread, while debugging
+inline std::atomic<bool> asynchronous{ true };
+
+// Seconds since the writer started, updated by the writer
+inline std::atomic<uint32_t> clockSeconds{ 0u };
+// Orders the messages of all the threads
+inline std::atomic<uint64_t> sequence{ 0u };
+// The writer is gone, the program is exiting
+inline std::atomic<bool> shutdown{ false };
+
+// A LOG/DEBUG/WARNING/LOG_ERROR call, one for every call site
+struct Site
+{
+    char file[64];
+    const char *func;
+    int line;
 
-template <class T, class U>
-using t_bmap = std::map<T, U>;
+    std::atomic<uint32_t> window{ 0u };
+    std::atomic<uint32_t> count{ 0u };
+    std::atomic<uint32_t> suppressed{ 0u };
 
-typedef std::string string;
+    Site(const char *file, const char *func, int line)
+        : func(func), line(line)
+    {
+        strncpy(this->file, file, sizeof(this->file) - 1u);
+        this->file[sizeof(this->file) - 1u] = '\0';
+    }
 
-typedef t_hmap<string, t_bmap<int, t_hset<string>>> t_msgs;
+    // False if the site wrote it's share for this second
+    bool allow(uint32_t &skipped)
+    {
+        const uint32_t now = clockSeconds.load(std::memory_order_relaxed);
+        if (window.load(std::memory_order_relaxed) != now)
+        {
+            window.store(now, std::memory_order_relaxed);
+            count.store(0u, std::memory_order_relaxed);
+        }
+        if (count.fetch_add(1u, std::memory_order_relaxed) >=
+            rateLimit.load(std::memory_order_relaxed))
+        {
+            suppressed.fetch_add(1u, std::memory_order_relaxed);
+            return false;
+        }
+        skipped = suppressed.load(std::memory_order_relaxed)
+                      ? suppressed.exchange(0u, std::memory_order_relaxed)
+                      : 0u;
+        return true;
+    }
+};
 
-struct LineMsg
+// Arguments are kept as a tag and a value
+enum ArgTag : uint8_t
 {
-    std::string file;
-    int line;
-    std::string content;
+    ARG_INT,
+    ARG_UINT,
+    ARG_DOUBLE,
+    ARG_PTR,
+    ARG_STR,
+    ARG_UNKNOWN
 };
 
-static bool has_message(const t_msgs &msgs, const LineMsg &msg)
+// Writes the arguments into a slot, or into "heap" if they don't fit
+struct Encoder
 {
-    decltype(msgs.begin()) itr;
-    if ((itr = msgs.find(msg.file)) == msgs.end())
-        return false;
+    char *data;
+    size_t size;
+    size_t used = 0u;
+    std::vector<char> *heap = nullptr;
+    bool full = false;
 
-    auto lines = (*itr).second;
-    decltype(lines.begin()) litr;
-    if ((litr = lines.find(msg.line)) == lines.end())
-        return false;
+    void put(const void *p, size_t n)
+    {
+        if (heap)
+        {
+            heap->insert(heap->end(), (const char *)p, (const char *)p + n);
+            return;
+        }
+        if (full || used + n > size)
+        {
+            full = true;
+            return;
+        }
+        memcpy(data + used, p, n);
+        used += n;
+    }
 
-    auto contents = (*itr).second;
-    decltype(contents)::iterator citr;
-    citr = std::find(contents.begin(), contents.end(), msg.content);
-    if (citr == contents.end())
-        return false;
+    void put_tag(ArgTag tag)
+    {
+        put(&tag, 1u);
+    }
 
-    return true;
-}
+    void put_str(const char *str, size_t length)
+    {
+        const uint32_t n = (uint32_t)length;
+        put_tag(ARG_STR);
+        put(&n, sizeof(n));
+        put(str, length);
+    }
+
+    // Wide strings are written as UTF-8, UTF-16 where wchar_t is 16 bits
+    void put_wstr(const wchar_t *str, size_t length)
+    {
+        std::string utf8;
+        utf8.reserve(length);
+        for (size_t i = 0u; i < length; ++i)
+        {
+            uint32_t c = (uint32_t)str[i];
+            if (sizeof(wchar_t) == 2u && c >= 0xD800u && c < 0xDC00u &&
+                i + 1u < length &&
+                (uint32_t)str[i + 1u] >= 0xDC00u && (uint32_t)str[i + 1u] < 0xE000u)
+            {
+                c = 0x10000u + ((c - 0xD800u) << 10) + ((uint32_t)str[++i] - 0xDC00u);
+            }
+            if (c < 0x80u)
+                utf8 += (char)c;
+            else if (c < 0x800u)
+            {
+                utf8 += (char)(0xC0u | (c >> 6));
+                utf8 += (char)(0x80u | (c & 0x3Fu));
+            }
+            else if (c < 0x10000u)
+            {
+                utf8 += (char)(0xE0u | (c >> 12));
+                utf8 += (char)(0x80u | ((c >> 6) & 0x3Fu));
+                utf8 += (char)(0x80u | (c & 0x3Fu));
+            }
+            else
+            {
+                utf8 += (char)(0xF0u | ((c >> 18) & 0x07u));
+                utf8 += (char)(0x80u | ((c >> 12) & 0x3Fu));
+                utf8 += (char)(0x80u | ((c >> 6) & 0x3Fu));
+                utf8 += (char)(0x80u | (c & 0x3Fu));
+            }
+        }
+        put_str(utf8.data(), utf8.size());
+    }
+
+    template <class T>
+    void put_arg(const T &value)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+        {
+            const int64_t v = value;
+            put_tag(ARG_INT);
+            put(&v, sizeof(v));
+        }
+        else if constexpr (std::is_enum<T>::value)
+        {
+            put_arg((typename std::underlying_type<T>::type)value);
+        }
+        else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value)
+        {
+            const int64_t v = value;
+            put_tag(ARG_INT);
+            put(&v, sizeof(v));
+        }
+        else if constexpr (std::is_integral<T>::value)
+        {
+            const uint64_t v = value;
+            put_tag(ARG_UINT);
+            put(&v, sizeof(v));
+        }
+        else if constexpr (std::is_floating_point<T>::value)
+        {
+            const double v = (double)value;
+            put_tag(ARG_DOUBLE);
+            put(&v, sizeof(v));
+        }
+        else if constexpr (std::is_same<T, const char *>::value ||
+                           std::is_same<T, char *>::value)
+        {
+            // The string can be gone by the time it's printed
+            if (value)
+                put_str(value, strlen(value));
+            else
+                put_str("(null)", 6u);
+        }
+        else if constexpr (std::is_array<T>::value &&
+                           std::is_same<typename std::remove_cv<typename std::remove_extent<T>::type>::type, char>::value)
+        {
+            put_str(value, strnlen(value, std::extent<T>::value));
+        }
+        else if constexpr (std::is_same<T, std::string>::value)
+        {
+            put_str(value.data(), value.size());
+        }
+        else if constexpr (std::is_same<T, const wchar_t *>::value ||
+                           std::is_same<T, wchar_t *>::value)
+        {
+            if (value)
+                put_wstr(value, wcslen(value));
+            else
+                put_str("(null)", 6u);
+        }
+        else if constexpr (std::is_array<T>::value &&
+                           std::is_same<typename std::remove_cv<typename std::remove_extent<T>::type>::type, wchar_t>::value)
+        {
+            put_wstr(value, wcsnlen(value, std::extent<T>::value));
+        }
+        else if constexpr (std::is_same<T, std::wstring>::value)
+        {
+            put_wstr(value.data(), value.size());
+        }
+        else if constexpr (std::is_pointer<T>::value ||
+                           std::is_null_pointer<T>::value)
+        {
+            const void *v = (const void *)value;
+            put_tag(ARG_PTR);
+            put(&v, sizeof(v));
+        }
+        else
+        {
+            put_tag(ARG_UNKNOWN);
+        }
+    }
+};
 
-static void add_message(t_msgs &msgs, const LineMsg &msg)
+// Two cache lines, the writer only reads it
+struct Record
 {
-    msgs[msg.file][msg.line].insert(msg.content);
-}
+    uint64_t sequence = 0u;
+    Site *site = nullptr;
+    // For records without a site
+    const char *file = "";
+    // A string literal, it outlives the record
+    const char *format = "";
+    // Arguments that didn't fit in "data"
+    std::vector<char> *heap = nullptr;
+    int line = -1;
+    uint32_t suppressed = 0u;
+    uint16_t size = 0u;
+    uint8_t type = Other;
+    char data[73];
+};
 
-static t_msgs msgCounter;
-*/
+static_assert(sizeof(Record) == 128, "Record should stay two cache lines.");
 
-enum LogType : unsigned
+// Written by a single thread, read by the writer
+struct Ring
 {
-    Other = 0,
-    Error = 1,
-    Warning = 2,
-    Log = 4,
-    Debug = 8
+    static constexpr size_t CAPACITY = 512u;
+
+    Record slots[CAPACITY];
+    alignas(64) std::atomic<size_t> head{ 0u };
+    // The producer's last look at "tail", read again only when the ring
+    // looks full, the writer keeps moving "tail"
+    size_t cachedTail = 0u;
+    alignas(64) std::atomic<size_t> tail{ 0u };
+    std::atomic<size_t> dropped{ 0u };
+    // The thread exited, removed once it's empty
+    std::atomic<bool> closed{ false };
 };
 
-static void log(
-    const char *file,
-    const char *func,
-    int line,
-    LogType type,
-    const char *format,
-    ...)
+struct Arg
+{
+    ArgTag tag = ARG_UNKNOWN;
+    int64_t i = 0;
+    uint64_t u = 0u;
+    double d = 0.0;
+    const void *p = nullptr;
+    std::string_view s;
+};
+
+// Reads the arguments back
+struct Decoder
+{
+    const char *data;
+    size_t size;
+    size_t pos = 0u;
+
+    bool next(Arg &arg)
+    {
+        if (pos >= size)
+            return false;
+        arg = Arg{};
+        arg.tag = (ArgTag)data[pos++];
+        switch (arg.tag)
+        {
+        case ARG_INT:
+            memcpy(&arg.i, data + pos, sizeof(arg.i));
+            pos += sizeof(arg.i);
+            arg.u = (uint64_t)arg.i;
+            arg.d = (double)arg.i;
+            break;
+        case ARG_UINT:
+            memcpy(&arg.u, data + pos, sizeof(arg.u));
+            pos += sizeof(arg.u);
+            arg.i = (int64_t)arg.u;
+            arg.d = (double)arg.u;
+            break;
+        case ARG_DOUBLE:
+            memcpy(&arg.d, data + pos, sizeof(arg.d));
+            pos += sizeof(arg.d);
+            arg.i = (int64_t)arg.d;
+            arg.u = (uint64_t)arg.i;
+            break;
+        case ARG_PTR:
+            memcpy(&arg.p, data + pos, sizeof(arg.p));
+            pos += sizeof(arg.p);
+            arg.u = (uint64_t)(uintptr_t)arg.p;
+            arg.i = (int64_t)arg.u;
+            break;
+        case ARG_STR:
+        {
+            uint32_t n;
+            memcpy(&n, data + pos, sizeof(n));
+            pos += sizeof(n);
+            arg.s = std::string_view(data + pos, n);
+            pos += n;
+            break;
+        }
+        default:
+            break;
+        }
+        return true;
+    }
+};
+
+// printf's formatting of the decoded arguments, an argument of the
+// wrong type prints "<?>" instead of reading garbage
+inline void format_record(
+    std::string &out,
+    std::string_view format,
+    const char *data,
+    size_t size)
 {
-    va_list args;
-    va_start(args, format);
+    Decoder in{ data, size };
+    Arg arg;
 
-    FILE *stream = 
-        (((type & Error) || (type & Warning)) ? 
-        stderr : stdout);
-    
-    //bool repeated = has_message(msgCounter, {file, line, format});
-    
-    if (priority & (unsigned)type) // && !repeated)
+    char buf[128];
+    std::string spec;
+    for (size_t i = 0; i < format.size(); ++i)
     {
-        const char *typeStr = "";
-        switch (type)
+        if (format[i] != '%')
+        {
+            out += format[i];
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '%')
+        {
+            out += '%';
+            ++i;
+            continue;
+        }
+
+        // Flags, width and precision are kept, the length is replaced
+        spec = "%";
+        size_t j = i + 1;
+        while (j < format.size() && strchr("-+ #0", format[j]))
+            spec += format[j++];
+        for (int part = 0; part < 2; ++part)
+        {
+            if (part == 1)
+            {
+                if (j >= format.size() || format[j] != '.')
+                    break;
+                spec += format[j++];
+            }
+            if (j < format.size() && format[j] == '*')
+            {
+                ++j;
+                spec += std::to_string(in.next(arg) ? arg.i : 0);
+            }
+            while (j < format.size() && format[j] >= '0' && format[j] <= '9')
+                spec += format[j++];
+        }
+        while (j < format.size() && strchr("hlLzjtq", format[j]))
+            ++j;
+        if (j >= format.size())
+        {
+            out.append(format.substr(i));
+            break;
+        }
+
+        const char conv = format[j];
+        i = j;
+        if (conv == 'n')
+            continue;
+        if (!in.next(arg))
         {
-        case Other:
+            out += "<?>";
+            continue;
+        }
+
+        int n = -1;
+        switch (conv)
+        {
+        case 'd':
+        case 'i':
+            if (arg.tag == ARG_STR || arg.tag == ARG_UNKNOWN)
+                break;
+            spec += "ll";
+            spec += conv;
+            n = snprintf(buf, sizeof(buf), spec.c_str(), (long long)arg.i);
             break;
-        case Error:
-            typeStr = "Error";
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            if (arg.tag == ARG_STR || arg.tag == ARG_UNKNOWN)
+                break;
+            spec += "ll";
+            spec += conv;
+            n = snprintf(buf, sizeof(buf), spec.c_str(), (unsigned long long)arg.u);
             break;
-        case Warning:
-            typeStr = "Warning";
+        case 'c':
+            if (arg.tag == ARG_STR || arg.tag == ARG_UNKNOWN)
+                break;
+            spec += conv;
+            n = snprintf(buf, sizeof(buf), spec.c_str(), (int)arg.i);
             break;
-        case Log:
-            typeStr = "Log";
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (arg.tag == ARG_STR || arg.tag == ARG_UNKNOWN)
+                break;
+            spec += conv;
+            n = snprintf(buf, sizeof(buf), spec.c_str(), arg.d);
             break;
-        case Debug:
-            typeStr = "Debug";
+        case 'p':
+            if (arg.tag == ARG_STR || arg.tag == ARG_UNKNOWN)
+                break;
+            spec += conv;
+            n = snprintf(buf, sizeof(buf), spec.c_str(), (const void *)(uintptr_t)arg.u);
             break;
+        case 's':
+            if (arg.tag == ARG_PTR && !arg.p)
+                arg.s = "(null)";
+            else if (arg.tag != ARG_STR)
+                break;
+            if (spec.size() == 1u)
+            {
+                out.append(arg.s);
+                continue;
+            }
+            else
+            {
+                spec += conv;
+                const std::string str(arg.s);
+                const int length = snprintf(nullptr, 0, spec.c_str(), str.c_str());
+                if (length > 0)
+                {
+                    std::vector<char> big((size_t)length + 1u);
+                    snprintf(big.data(), big.size(), spec.c_str(), str.c_str());
+                    out.append(big.data(), (size_t)length);
+                }
+                continue;
+            }
+        default:
+            out += '%';
+            out += conv;
+            continue;
+        }
+
+        if (n < 0)
+            out += "<?>";
+        else
+            out.append(buf, std::min((size_t)n, sizeof(buf) - 1u));
+    }
+}
+
+inline const char *type_str(LogType type)
+{
+    switch (type)
+    {
+    case Error:
+        return "Error";
+    case Warning:
+        return "Warning";
+    case Log:
+        return "Log";
+    case Debug:
+        return "Debug";
+    default:
+        return "";
+    }
+}
+
+inline void print_line(
+    LogType type,
+    const char *file,
+    int line,
+    const std::string &text,
+    uint32_t suppressed)
+{
+    FILE *stream =
+        (((type & Error) || (type & Warning)) ? stderr : stdout);
+
+    const char *typeStr = type_str(type);
+    if (strcmp(typeStr, ""))
+        fprintf(stream, "%s,\t", typeStr);
+    if (strcmp(file, ""))
+        fprintf(stream, "%s ", file);
+    if (line != -1)
+        fprintf(stream, "%d", line);
+    fprintf(stream, ":\t");
+    fwrite(text.data(), 1u, text.size(), stream);
+    if (suppressed)
+        fprintf(stream, " (%u more suppressed)", suppressed);
+    fprintf(stream, "\n");
+}
+
+// Drains the rings on it's own thread
+struct Writer
+{
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::thread thread;
+    bool stop = false;
+    bool flushing = false;
+    uint64_t passes = 0u;
+
+    // For folding repeated messages of a site
+    struct Last
+    {
+        std::string text;
+        uint32_t repeats = 0u;
+        LogType type = Other;
+    };
+    std::unordered_map<Site *, Last> last;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point lastFold;
+    // Serializes the synchronous writes with the writer's
+    std::mutex printMutex;
+
+    Writer()
+    {
+        start = lastFold = std::chrono::steady_clock::now();
+        thread = std::thread([this]() { run(); });
+    }
+
+    ~Writer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        thread.join();
+        shutdown = true;
+    }
+
+    void add(const std::shared_ptr<Ring> &ring)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rings.push_back(ring);
+    }
+
+    // Waits for everything logged so far to be printed
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        const uint64_t target = passes + 2u;
+        flushing = true;
+        wake.notify_all();
+        drained.wait_for(lock, std::chrono::seconds(1), [this, target]() {
+            return passes >= target || stop;
+        });
+    }
+
+    void run()
+    {
+        std::vector<std::shared_ptr<Ring>> local;
+        for (;;)
+        {
+            bool exiting;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait_for(lock, std::chrono::milliseconds(5), [this]() {
+                    return stop || flushing;
+                });
+                flushing = false;
+                exiting = stop;
+                rings.erase(
+                    std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<Ring> &r) {
+                        return r->closed && r->head.load() == r->tail.load();
+                    }),
+                    rings.end());
+                local = rings;
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            clockSeconds.store(
+                (uint32_t)std::chrono::duration_cast<std::chrono::seconds>(now - start).count(),
+                std::memory_order_relaxed);
+
+            drain(local);
+            if (exiting || now - lastFold > std::chrono::seconds(1))
+            {
+                std::lock_guard<std::mutex> lock(printMutex);
+                fold_all();
+                lastFold = now;
+            }
+            fflush(stdout);
+            fflush(stderr);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++passes;
+            }
+            drained.notify_all();
+            if (exiting)
+                break;
+        }
+    }
+
+    // Prints the records of all the rings in the order of their sequence
+    void drain(std::vector<std::shared_ptr<Ring>> &local)
+    {
+        std::vector<size_t> heads(local.size());
+        for (size_t i = 0; i < local.size(); ++i)
+            heads[i] = local[i]->head.load(std::memory_order_acquire);
+
+        std::lock_guard<std::mutex> lock(printMutex);
+        for (;;)
+        {
+            Ring *best = nullptr;
+            for (size_t i = 0; i < local.size(); ++i)
+            {
+                Ring *r = local[i].get();
+                const size_t tail = r->tail.load(std::memory_order_relaxed);
+                if (tail == heads[i])
+                    continue;
+                if (!best ||
+                    r->slots[tail % Ring::CAPACITY].sequence <
+                        best->slots[best->tail.load(std::memory_order_relaxed) % Ring::CAPACITY].sequence)
+                    best = r;
+            }
+            if (!best)
+                break;
+
+            const size_t tail = best->tail.load(std::memory_order_relaxed);
+            const Record &record = best->slots[tail % Ring::CAPACITY];
+            print(record);
+            delete record.heap;
+            best->tail.store(tail + 1u, std::memory_order_release);
         }
 
-        if (strcmp(typeStr, ""))
-            fprintf(stream, "%s,\t", typeStr);
-        if (strcmp(file, ""))
-            fprintf(stream, "%s ", file);
-        if (line != -1)
-            fprintf(stream, "%d", line);
-        fprintf(stream, ":\t");
-        //fprintf(stream, "%s:\n\tFile: %s, func: %s, line: %d.\n\tMsg:\t", typeStr, file, func, line);
-        vfprintf(stream, format, args);
-        fprintf(stream, "\n");
+        for (std::shared_ptr<Ring> &r : local)
+        {
+            const size_t dropped = r->dropped.exchange(0u);
+            if (dropped)
+                print_line(Warning, "Logger", -1,
+                           "Log buffer full, dropped " + std::to_string(dropped) + " messages",
+                           0u);
+        }
+    }
+
+    void print(const Record &record)
+    {
+        std::string text;
+        if (record.heap)
+            format_record(text, record.format, record.heap->data(), record.heap->size());
+        else
+            format_record(text, record.format, record.data, record.size);
+
+        const LogType type = (LogType)record.type;
+        if (!record.site)
+        {
+            print_line(type, record.file, record.line, text, record.suppressed);
+            return;
+        }
+
+        Last &l = last[record.site];
+        if (l.repeats || !l.text.empty())
+        {
+            if (l.text == text && !record.suppressed)
+            {
+                ++l.repeats;
+                return;
+            }
+            fold(record.site, l);
+        }
+        print_line(type, record.site->file, record.site->line, text, record.suppressed);
+        l.text = std::move(text);
+        l.type = type;
     }
 
-    va_end(args);
+    void fold(const Site *site, Last &l)
+    {
+        if (!l.repeats)
+            return;
+        print_line(l.type, site->file, site->line,
+                   "Last message repeated " + std::to_string(l.repeats) + " times",
+                   0u);
+        l.repeats = 0u;
+    }
+
+    // Once a second, also the messages of the sites that went quiet
+    // after hitting the limit
+    void fold_all()
+    {
+        for (auto &pair : last)
+        {
+            fold(pair.first, pair.second);
+            const uint32_t suppressed = pair.first->suppressed.exchange(0u);
+            if (suppressed)
+                print_line(pair.second.type, pair.first->file, pair.first->line,
+                           std::to_string(suppressed) + " messages suppressed",
+                           0u);
+        }
+    }
+};
+
+inline Writer &writer()
+{
+    static Writer w;
+    return w;
 }
 
-template <
-    typename T,
-    typename = typename std::enable_if<std::is_arithmetic<T>::value, T>::type>
-static void log(
+// Marks it's ring closed when the thread exits
+struct RingHolder
+{
+    std::shared_ptr<Ring> ring;
+
+    ~RingHolder()
+    {
+        if (ring)
+            ring->closed = true;
+    }
+};
+
+inline Ring &local_ring()
+{
+    thread_local RingHolder holder;
+    if (!holder.ring)
+    {
+        holder.ring = std::make_shared<Ring>();
+        writer().add(holder.ring);
+    }
+    return *holder.ring;
+}
+
+inline void flush()
+{
+    if (!shutdown)
+        writer().flush();
+}
+
+template <typename... Args>
+inline void write(
+    Site *site,
     const char *file,
-    const char *func,
     int line,
     LogType type,
-    T format,
-    ...)
+    const char *format,
+    const Args &... args)
 {
-    FILE *stream = (type == Error ? stderr : stdout);
+    if (!(priority.load(std::memory_order_relaxed) & (unsigned)type))
+        return;
+
+    uint32_t suppressed = 0u;
+    if (site && type != Error && !site->allow(suppressed))
+        return;
 
-    if (priority & (unsigned)type)
+    if (!asynchronous || shutdown)
     {
-        const char *typeStr = nullptr;
-        switch (type)
+        std::vector<char> data;
+        Encoder out{ nullptr, 0u };
+        out.heap = &data;
+        (out.put_arg(args), ...);
+        (void)out;
+        std::string text;
+        format_record(text, format, data.data(), data.size());
+        if (shutdown)
         {
-        case Other:
-            break;
-        case Error:
-            typeStr = "Error";
-            break;
-        case Warning:
-            typeStr = "Warning";
-            break;
-        case Log:
-            typeStr = "Log";
-            break;
-        case Debug:
-            typeStr = "Debug";
-            break;
+            print_line(type, site ? site->file : file, site ? site->line : line, text, suppressed);
+            return;
         }
+        std::lock_guard<std::mutex> lock(writer().printMutex);
+        print_line(type, site ? site->file : file, site ? site->line : line, text, suppressed);
+        fflush(stdout);
+        fflush(stderr);
+        return;
+    }
 
-        if (strcmp(typeStr, ""))
-            fprintf(stream, "%s, ", typeStr);
-        if (strcmp(file, ""))
-            fprintf(stream, "%s ", file);
-        if (line != -1)
-            fprintf(stream, "%d: ", line);
-        fprintf(stream, "%s", std::to_string(format).c_str());
-        fprintf(stream, "\n");
+    Ring &ring = local_ring();
+    const size_t head = ring.head.load(std::memory_order_relaxed);
+    while (head - ring.cachedTail >= Ring::CAPACITY &&
+           head - (ring.cachedTail = ring.tail.load(std::memory_order_acquire)) >= Ring::CAPACITY)
+    {
+        // Errors wait for room, the rest are counted and dropped
+        if (type != Error)
+        {
+            ring.dropped.fetch_add(1u, std::memory_order_relaxed);
+            return;
+        }
+        flush();
     }
+
+    Record &record = ring.slots[head % Ring::CAPACITY];
+    record.sequence = sequence.fetch_add(1u, std::memory_order_relaxed);
+    record.site = site;
+    record.file = file;
+    record.format = format;
+    record.line = line;
+    record.type = (uint8_t)type;
+    record.suppressed = suppressed;
+
+    Encoder out{ record.data, sizeof(record.data) };
+    (out.put_arg(args), ...);
+    (void)out;
+    record.size = (uint16_t)out.used;
+    record.heap = nullptr;
+    if (out.full)
+    {
+        // Rare, long strings
+        record.heap = new std::vector<char>();
+        out = Encoder{ nullptr, 0u };
+        out.heap = record.heap;
+        (out.put_arg(args), ...);
+    }
+    ring.head.store(head + 1u, std::memory_order_release);
+
+    if (type == Error)
+        flush();
+}
+
+template <typename... Args>
+inline void log(Site &site, LogType type, const char *format, const Args &... args)
+{
+    write(&site, "", -1, type, format, args...);
 }
 
 static void set_priority(unsigned level)
 {
-    priority = (2u << level) - 1;
+    priority = level >= 31u ? ~0u : (2u << level) - 1u;
 }
 
 static void new_line()
 {
+    flush();
     printf("\n");
 }
 } // namespace Logger
 
+#define LOGGER_WRITE(type, format, ...)                                      \
+    do                                                                       \
+    {                                                                        \
+        if constexpr ((LOGGER_LEVELS & (unsigned)(type)) != 0u)              \
+        {                                                                    \
+            static Logger::Site _loggerSite(FILE_NAME, FUNC_NAME, __LINE__); \
+            Logger::log(_loggerSite, type, "" format, ##__VA_ARGS__);        \
+        }                                                                    \
+    } while (0)
+
 #define LOG(format, ...) \
-    Logger::log(FILE_NAME, FUNC_NAME, __LINE__, Logger::LogType::Log, format, ##__VA_ARGS__)
+    LOGGER_WRITE(Logger::LogType::Log, format, ##__VA_ARGS__)
 
 #define DEBUG(format, ...) \
-    Logger::log(FILE_NAME, FUNC_NAME, __LINE__, Logger::LogType::Debug, format, ##__VA_ARGS__)
+    LOGGER_WRITE(Logger::LogType::Debug, format, ##__VA_ARGS__)
 
 #define LOG_ERROR(format, ...) \
-    Logger::log(FILE_NAME, FUNC_NAME, __LINE__, Logger::LogType::Error, format, ##__VA_ARGS__)
+    LOGGER_WRITE(Logger::LogType::Error, format, ##__VA_ARGS__)
 
 #ifdef WARNING
 #undef WARNING
 #endif
 
 #define WARNING(format, ...) \
-    Logger::log(FILE_NAME, FUNC_NAME, __LINE__, Logger::LogType::Warning, format, ##__VA_ARGS__)
+    LOGGER_WRITE(Logger::LogType::Warning, format, ##__VA_ARGS__)
 
 static void assert_error(bool b, const char *ex, const char *msg, const char *file, int line)
 {
     if (!b)
-        Logger::log(file, "", line, Logger::LogType::Error, "Assertion %s failed: %s", ex, msg);
+        Logger::write(nullptr, file, line, Logger::LogType::Error, "Assertion %s failed: %s", ex, msg);
 }
 
 #ifdef NDEBUG
@@ -248,4 +965,4 @@ static void assert_error(bool b, const char *ex, const char *msg, const char *fi
 
 #endif // __GNUC__
 
-#endif // GAME_UTILS_LOGGER
\ No newline at end of file
+#endif // GAME_UTILS_LOGGER
@@ -0,0 +1,450 @@
+#ifndef GAME_UTILS_PROFILER
+#define GAME_UTILS_PROFILER
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Zones and counters are compiled in unless this is 0
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// Frame profiler.
+// A zone is a named piece of code timed by a Scope, a counter is a named
+// number added to during the frame. Both are summed every frame and
+// averaged for the overlay, that's the always-on part and costs two
+// clock reads and an atomic add per zone.
+// While capturing, every zone is also written as an event into a ring
+// of it's thread, frame() collects the rings and the capture is written
+// as a Chrome trace (chrome://tracing, Perfetto) once it ends. Nothing
+// here needs a window.
+namespace Profiler
+{
+
+typedef uint64_t t_ns;
+
+inline t_ns now()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return (t_ns)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// Registered once by name, zones and counters of the same name in
+// different places are the same
+struct Zone
+{
+    std::string name;
+    std::atomic<t_ns> frameTime{ 0u };
+    std::atomic<uint32_t> frameCalls{ 0u };
+    // Of the last frames, for the overlay
+    float average = 0.f;
+    uint32_t calls = 0u;
+};
+
+struct Counter
+{
+    std::string name;
+    std::atomic<int64_t> frameValue{ 0 };
+    float average = 0.f;
+    int64_t last = 0;
+
+    void add(int64_t n)
+    {
+        frameValue.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+struct Event
+{
+    const Zone *zone = nullptr;
+    t_ns start = 0u;
+    t_ns end = 0u;
+};
+
+// Written by it's thread, collected by frame()
+struct Ring
+{
+    static constexpr size_t CAPACITY = 1u << 15;
+
+    std::unique_ptr<Event[]> events{ new Event[CAPACITY] };
+    alignas(64) std::atomic<size_t> head{ 0u };
+    alignas(64) std::atomic<size_t> tail{ 0u };
+    std::atomic<size_t> dropped{ 0u };
+    uint32_t thread = 0u;
+    std::string threadName;
+};
+
+struct Capture
+{
+    std::string path;
+    // Frames left to capture
+    size_t frames = 0u;
+    struct Item
+    {
+        Event event;
+        uint32_t thread;
+    };
+    std::vector<Item> events;
+    // Frame starts and the counters of every frame
+    std::vector<t_ns> frameStarts;
+    std::vector<std::vector<int64_t>> counters;
+    size_t dropped = 0u;
+};
+
+struct State
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Zone>> zones;
+    std::vector<std::unique_ptr<Counter>> counters;
+    std::vector<std::shared_ptr<Ring>> rings;
+    uint32_t threads = 0u;
+
+    std::atomic<bool> capturing{ false };
+    Capture capture;
+
+    t_ns frameStart = 0u;
+    float frameAverage = 0.f;
+    uint64_t frame = 0u;
+    // The timings stay on, only the text is hidden
+    bool showOverlay = false;
+};
+
+inline State &state()
+{
+    static State s;
+    return s;
+}
+
+inline Zone *zone(const char *name)
+{
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (auto &z : s.zones)
+    {
+        if (z->name == name)
+            return z.get();
+    }
+    s.zones.emplace_back(new Zone());
+    s.zones.back()->name = name;
+    return s.zones.back().get();
+}
+
+inline Counter *counter(const char *name)
+{
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (auto &c : s.counters)
+    {
+        if (c->name == name)
+            return c.get();
+    }
+    s.counters.emplace_back(new Counter());
+    s.counters.back()->name = name;
+    return s.counters.back().get();
+}
+
+inline Ring &local_ring()
+{
+    thread_local std::shared_ptr<Ring> ring;
+    if (!ring)
+    {
+        ring = std::make_shared<Ring>();
+        State &s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        ring->thread = s.threads++;
+        ring->threadName = "Thread " + std::to_string(ring->thread);
+        s.rings.push_back(ring);
+    }
+    return *ring;
+}
+
+// Shown in the trace instead of the thread's number
+inline void set_thread_name(const char *name)
+{
+    Ring &ring = local_ring();
+    std::lock_guard<std::mutex> lock(state().mutex);
+    ring.threadName = name;
+}
+
+struct Scope
+{
+    Zone *zone;
+    t_ns start;
+
+    explicit Scope(Zone *zone)
+        : zone(zone), start(now())
+    {
+    }
+
+    ~Scope()
+    {
+        const t_ns end = now();
+        zone->frameTime.fetch_add(end - start, std::memory_order_relaxed);
+        zone->frameCalls.fetch_add(1u, std::memory_order_relaxed);
+
+        if (!state().capturing.load(std::memory_order_relaxed))
+            return;
+        Ring &ring = local_ring();
+        const size_t head = ring.head.load(std::memory_order_relaxed);
+        if (head - ring.tail.load(std::memory_order_acquire) >= Ring::CAPACITY)
+        {
+            ring.dropped.fetch_add(1u, std::memory_order_relaxed);
+            return;
+        }
+        ring.events[head % Ring::CAPACITY] = Event{ zone, start, end };
+        ring.head.store(head + 1u, std::memory_order_release);
+    }
+};
+
+inline void json_string(FILE *file, const std::string &str)
+{
+    fputc('"', file);
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+            fputc('\\', file);
+        if ((unsigned char)c >= 0x20)
+            fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+// Chrome's trace event format, times in microseconds
+inline bool write_trace(const State &s, const Capture &capture)
+{
+    FILE *file = fopen(capture.path.c_str(), "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    const auto separator = [&first, file]() {
+        if (!first)
+            fprintf(file, ",\n");
+        first = false;
+    };
+
+    for (const auto &ring : s.rings)
+    {
+        separator();
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                ring->thread);
+        json_string(file, ring->threadName);
+        fprintf(file, "}}");
+    }
+
+    for (const Capture::Item &item : capture.events)
+    {
+        separator();
+        fprintf(file, "{\"name\":");
+        json_string(file, item.event.zone->name);
+        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                item.thread,
+                (double)item.event.start / 1e3,
+                (double)(item.event.end - item.event.start) / 1e3);
+    }
+
+    for (size_t f = 0; f < capture.frameStarts.size(); ++f)
+    {
+        const double ts = (double)capture.frameStarts[f] / 1e3;
+        separator();
+        fprintf(file, "{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}", ts);
+
+        const std::vector<int64_t> &values = capture.counters[f];
+        for (size_t c = 0; c < values.size() && c < s.counters.size(); ++c)
+        {
+            separator();
+            fprintf(file, "{\"name\":");
+            json_string(file, s.counters[c]->name);
+            fprintf(file, ",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                    ts,
+                    (long long)values[c]);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+// Captures the next "frames" frames and writes them to "path"
+inline void begin_capture(const std::string &path, size_t frames)
+{
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.capture = Capture{};
+    s.capture.path = path;
+    s.capture.frames = std::max<size_t>(frames, 1u);
+    // Events from before the capture are skipped
+    for (auto &ring : s.rings)
+        ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+    s.capturing = true;
+}
+
+inline bool capturing()
+{
+    return state().capturing.load(std::memory_order_relaxed);
+}
+
+// Moves the events of every thread into the capture
+inline void collect(State &s)
+{
+    for (auto &ring : s.rings)
+    {
+        const size_t head = ring->head.load(std::memory_order_acquire);
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        for (; tail != head; ++tail)
+            s.capture.events.push_back({ ring->events[tail % Ring::CAPACITY], ring->thread });
+        ring->tail.store(tail, std::memory_order_release);
+        s.capture.dropped += ring->dropped.exchange(0u);
+    }
+}
+
+// Ends the capture early and writes it, false if it couldn't be written
+inline bool end_capture()
+{
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.capturing)
+        return false;
+    s.capturing = false;
+    collect(s);
+    const bool written = write_trace(s, s.capture);
+    if (written)
+        fprintf(stdout, "Profiler:\tWrote %zu frames, %zu events to %s, %zu dropped\n",
+                s.capture.frameStarts.size(),
+                s.capture.events.size(),
+                s.capture.path.c_str(),
+                s.capture.dropped);
+    else
+        fprintf(stderr, "Profiler:\tCan't write %s\n", s.capture.path.c_str());
+    s.capture = Capture{};
+    return written;
+}
+
+// Marks the end of a frame, on the main thread
+inline void frame()
+{
+    State &s = state();
+    const t_ns t = now();
+    bool finished = false;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        const t_ns start = s.frameStart;
+        s.frameStart = t;
+        ++s.frame;
+        if (start)
+            s.frameAverage = s.frameAverage * 0.9f + (float)(t - start) * 1e-6f * 0.1f;
+
+        std::vector<int64_t> values;
+        for (auto &c : s.counters)
+        {
+            c->last = c->frameValue.exchange(0, std::memory_order_relaxed);
+            c->average = c->average * 0.9f + (float)c->last * 0.1f;
+            values.push_back(c->last);
+        }
+        for (auto &z : s.zones)
+        {
+            const t_ns time = z->frameTime.exchange(0u, std::memory_order_relaxed);
+            z->calls = z->frameCalls.exchange(0u, std::memory_order_relaxed);
+            z->average = z->average * 0.9f + (float)time * 1e-6f * 0.1f;
+        }
+
+        if (s.capturing)
+        {
+            if (start)
+            {
+                s.capture.frameStarts.push_back(start);
+                s.capture.counters.push_back(std::move(values));
+            }
+            collect(s);
+            finished = s.capture.frameStarts.size() >= s.capture.frames;
+        }
+    }
+    if (finished)
+        end_capture();
+}
+
+inline void toggle_overlay()
+{
+    state().showOverlay = !state().showOverlay;
+}
+
+inline bool overlay_shown()
+{
+    return state().showOverlay;
+}
+
+// The average frame, the slowest zones and the counters, one per line
+inline std::string overlay(size_t maxZones = 8u)
+{
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    char buf[160];
+    std::string ret;
+    snprintf(buf, sizeof(buf), "Frame %.2f ms%s", s.frameAverage, s.capturing ? " (capturing)" : "");
+    ret += buf;
+
+    std::vector<const Zone *> zones;
+    for (auto &z : s.zones)
+        zones.push_back(z.get());
+    std::sort(zones.begin(), zones.end(), [](const Zone *a, const Zone *b) {
+        return a->average > b->average;
+    });
+    if (zones.size() > maxZones)
+        zones.resize(maxZones);
+    for (const Zone *z : zones)
+    {
+        snprintf(buf, sizeof(buf), "\n%s %.2f ms x%u", z->name.c_str(), z->average, z->calls);
+        ret += buf;
+    }
+    for (auto &c : s.counters)
+    {
+        snprintf(buf, sizeof(buf), "\n%s %lld", c->name.c_str(), (long long)c->last);
+        ret += buf;
+    }
+    return ret;
+}
+} // namespace Profiler
+
+#define PROFILER_CAT2(a, b) a##b
+#define PROFILER_CAT(a, b) PROFILER_CAT2(a, b)
+
+#if PROFILER_ENABLED
+
+// Times the rest of the scope
+#define PROFILE_ZONE(name)                                                     \
+    static Profiler::Zone *PROFILER_CAT(_profilerZone, __LINE__) =             \
+        Profiler::zone(name);                                                  \
+    Profiler::Scope PROFILER_CAT(_profilerScope, __LINE__)(                    \
+        PROFILER_CAT(_profilerZone, __LINE__))
+
+// Adds "n" to the named counter of this frame
+#define PROFILE_COUNT(name, n)                                                 \
+    do                                                                         \
+    {                                                                          \
+        static Profiler::Counter *_profilerCounter = Profiler::counter(name);  \
+        _profilerCounter->add((int64_t)(n));                                   \
+    } while (0)
+
+#define PROFILE_FRAME() Profiler::frame()
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_COUNT(name, n) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+
+#endif // PROFILER_ENABLED
+
+#endif // GAME_UTILS_PROFILER
@@ -0,0 +1,129 @@
+#ifndef GAME_TASK_POOL
+#define GAME_TASK_POOL
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs jobs on a few worker threads.
+// Jobs are taken in the order they were added, the caller can wait for a
+// single job and use it's result while the later ones still run.
+// Jobs must not throw.
+struct TaskPool
+{
+	explicit TaskPool(size_t threads = 0u)
+	{
+		if (!threads)
+			threads = (size_t)std::max(1u, std::thread::hardware_concurrency());
+		for (size_t i = 0; i < threads; ++i)
+			m_workers.emplace_back([this]() { work(); });
+	}
+
+	~TaskPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (std::thread &t : m_workers)
+			t.join();
+	}
+
+	TaskPool(const TaskPool &) = delete;
+	TaskPool &operator=(const TaskPool &) = delete;
+
+	// Returns the index of the job
+	size_t add(std::function<void()> job)
+	{
+		size_t index;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			index = m_jobs.size();
+			m_jobs.push_back(std::move(job));
+			m_done.push_back(0);
+		}
+		m_wake.notify_one();
+		return index;
+	}
+
+	void wait(size_t job)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [this, job]() { return m_done[job] != 0; });
+	}
+
+	// Doesn't block
+	bool done(size_t job)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_done[job] != 0;
+	}
+
+	void wait_all()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [this]() {
+			return std::find(m_done.begin(), m_done.end(), 0) == m_done.end();
+		});
+	}
+
+	// Waits for every job and forgets them, so a pool used every tick
+	// doesn't keep growing. The indices of the jobs are invalid after.
+	void clear()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [this]() {
+			return std::find(m_done.begin(), m_done.end(), 0) == m_done.end();
+		});
+		m_jobs.clear();
+		m_done.clear();
+		m_next = 0u;
+	}
+
+	size_t size() const
+	{
+		return m_workers.size();
+	}
+
+  private:
+	void work()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			size_t index;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this]() { return m_stop || m_next < m_jobs.size(); });
+				if (m_next >= m_jobs.size())
+					return;
+				index = m_next++;
+				job = std::move(m_jobs[index]);
+			}
+
+			job();
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_done[index] = 1;
+			}
+			m_finished.notify_all();
+		}
+	}
+
+	std::vector<std::thread> m_workers;
+	std::vector<std::function<void()>> m_jobs;
+	std::vector<char> m_done;
+	size_t m_next = 0u;
+	bool m_stop = false;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_finished;
+};
+
+#endif // GAME_TASK_POOL
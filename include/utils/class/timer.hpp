@@ -156,6 +156,9 @@ class GameTimer
     bool m_paused = false;
 };
 
+// Creates the timers, they aren't kept anywhere so they
+// get released with their owners.
+// Pausing is done by the game clock, see GameData::time_pause
 template <typename U = float>
 class GameTimerManager
 {
@@ -176,45 +179,13 @@ public:
 
     t_timer_ptr make_new(U time)
     {
-        t_timer_ptr timerPtr;
-        timerPtr = make_independent_timer(time);
-        m_data.push_back(timerPtr);
-        return timerPtr;
+        return make_independent_timer(time);
     } 
     
     t_timer_ptr make_new()
     {
-        t_timer_ptr timerPtr;
-        timerPtr = std::make_shared< GameTimer<U>>();
-        m_data.push_back(timerPtr);
-        return timerPtr;
-    }
-
-
-    void add_new(t_timer_ptr& timer)
-    {
-        m_data.push_back(timer);
-    }
-
-    void stop_all(U time)
-    {
-        for (t_timer_ptr& x : m_data)
-        {
-            x.get()->suspend(time);
-        }
-    }
-
-    void resume_all(U time)
-    {
-        for (t_timer_ptr& x : m_data)
-        {
-            x.get()->resume(time);
-        }
+        return std::make_shared< GameTimer<U>>();
     }
-
-private:
-    std::vector< t_timer_ptr > m_data;
-
 };
 
 #endif // GAME_TIMER
\ No newline at end of file
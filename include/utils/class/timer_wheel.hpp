@@ -0,0 +1,351 @@
+#ifndef GAME_TIMER_WHEEL
+#define GAME_TIMER_WHEEL
+
+// Hierarchical timing wheel, replaces polling timers every tick.
+// Entries are put in a slot of the lowest level that can hold their
+// expiration tick, when a level wraps around the slot of the level above
+// is cascaded down. Scheduling, cancelling and firing are all O(1),
+// ticks without any expired entry cost one slot lookup.
+
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+// Handle of a scheduled entry, cancelling an entry that already
+// fired (or was cancelled) does nothing.
+struct TimerHandle
+{
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    uint32_t index = NONE;
+    uint32_t generation = 0u;
+
+    bool valid() const
+    {
+        return index != NONE;
+    }
+};
+
+template <typename U = float, size_t LEVELS = 4, size_t SLOT_BITS = 6>
+class TimerWheel
+{
+    static_assert(!std::is_unsigned<U>::value, "This class uses number subtraction.");
+    static_assert(LEVELS > 0 && SLOT_BITS * LEVELS < 64, "Wheel doesn't fit in 64 bits.");
+
+  public:
+    typedef std::function<void(void)> t_callback;
+
+    static constexpr uint64_t SLOTS = 1ull << SLOT_BITS;
+    static constexpr uint64_t MASK = SLOTS - 1ull;
+    // Maximum ticks an entry can be ahead, further entries are cascaded again
+    static constexpr uint64_t MAX_DELTA = (1ull << (SLOT_BITS * LEVELS)) - 1ull;
+
+    TimerWheel(U resolution = (U)1 / (U)64)
+        : m_resolution(resolution)
+    {
+        assert(resolution > (U)0);
+        clear();
+    }
+
+    /**
+     * Call "callback" once "time" was passed, if "period" is bigger
+     * than zero the entry is rescheduled every "period" until cancelled.
+     */
+    TimerHandle schedule(U time, t_callback callback, U period = (U)0)
+    {
+        uint32_t index;
+        if (m_free.size())
+        {
+            index = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            index = (uint32_t)m_entries.size();
+            m_entries.emplace_back();
+        }
+
+        Entry &entry = m_entries[index];
+        entry.tick = to_tick(time);
+        entry.start = time;
+        entry.period = period > (U)0 ? period : (U)0;
+        entry.periods = 0u;
+        entry.callback = std::move(callback);
+        entry.active = true;
+        ++m_count;
+
+        link(index, false);
+
+        TimerHandle handle;
+        handle.index = index;
+        handle.generation = entry.generation;
+        return handle;
+    }
+
+    // O(1) removal of an entry, resets the handle
+    bool cancel(TimerHandle &handle)
+    {
+        if (!active(handle))
+        {
+            handle = TimerHandle{};
+            return false;
+        }
+
+        Entry &entry = m_entries[handle.index];
+        if (entry.linked)
+            unlink(handle.index);
+        release(handle.index);
+        handle = TimerHandle{};
+        return true;
+    }
+
+    bool active(const TimerHandle &handle) const
+    {
+        return handle.valid() &&
+            handle.index < m_entries.size() &&
+            m_entries[handle.index].active &&
+            m_entries[handle.index].generation == handle.generation;
+    }
+
+    /**
+     * Move the wheel to "time" and fire every expired entry,
+     * returns how many callbacks were called.
+     */
+    size_t advance(U time)
+    {
+        const uint64_t target = time > (U)0 ? (uint64_t)(time / m_resolution) : 0u;
+        size_t fired = 0;
+
+        // Nothing is scheduled, just jump
+        if (m_count == 0)
+        {
+            if (target > m_tick)
+                m_tick = target;
+            return 0;
+        }
+
+        while (m_tick < target)
+        {
+            ++m_tick;
+            cascade();
+            fired += fire(m_tick & MASK);
+        }
+        return fired;
+    }
+
+    // The time of the last tick processed
+    U now() const
+    {
+        return (U)m_tick * m_resolution;
+    }
+
+    U resolution() const
+    {
+        return m_resolution;
+    }
+
+    size_t size() const
+    {
+        return m_count;
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        m_free.clear();
+        m_fire.clear();
+        m_deferred.clear();
+        for (size_t l = 0; l < LEVELS; ++l)
+            for (size_t s = 0; s < SLOTS; ++s)
+                m_heads[l][s] = TimerHandle::NONE;
+        m_count = 0u;
+        m_firing = false;
+    }
+
+  private:
+    struct Entry
+    {
+        uint64_t tick = 0u;
+        // Periodic entries are due at start + periods * period, rounded
+        // to a tick every time so the rounding doesn't add up
+        U start = (U)0;
+        U period = (U)0;
+        uint64_t periods = 0u;
+        t_callback callback;
+        uint32_t generation = 0u;
+        uint32_t prev = TimerHandle::NONE;
+        uint32_t next = TimerHandle::NONE;
+        uint32_t *head = nullptr;
+        bool active = false;
+        bool linked = false;
+    };
+
+    uint64_t to_tick(U time) const
+    {
+        if (time <= (U)0)
+            return 0u;
+        // Round up, an entry never fires before it's time
+        U ticks = time / m_resolution;
+        uint64_t tick = (uint64_t)ticks;
+        if ((U)tick < ticks)
+            ++tick;
+        return tick;
+    }
+
+    // Put an entry in it's slot, when cascading expired
+    // entries go to the current slot so they fire this tick
+    void link(uint32_t index, bool cascading)
+    {
+        Entry &entry = m_entries[index];
+
+        uint64_t tick = entry.tick;
+        if (tick <= m_tick)
+            tick = cascading ? m_tick : m_tick + 1u;
+        if (tick - m_tick > MAX_DELTA)
+            tick = m_tick + MAX_DELTA;
+
+        const uint64_t delta = tick - m_tick;
+        size_t level = 0;
+        while (level + 1 < LEVELS && delta >= (1ull << (SLOT_BITS * (level + 1))))
+            ++level;
+        const uint64_t slot = (tick >> (SLOT_BITS * level)) & MASK;
+
+        uint32_t &head = m_heads[level][slot];
+        entry.prev = TimerHandle::NONE;
+        entry.next = head;
+        if (head != TimerHandle::NONE)
+            m_entries[head].prev = index;
+        head = index;
+        entry.head = &head;
+        entry.linked = true;
+    }
+
+    void unlink(uint32_t index)
+    {
+        Entry &entry = m_entries[index];
+        if (entry.prev != TimerHandle::NONE)
+            m_entries[entry.prev].next = entry.next;
+        else
+            *entry.head = entry.next;
+        if (entry.next != TimerHandle::NONE)
+            m_entries[entry.next].prev = entry.prev;
+        entry.prev = entry.next = TimerHandle::NONE;
+        entry.head = nullptr;
+        entry.linked = false;
+    }
+
+    void release(uint32_t index)
+    {
+        Entry &entry = m_entries[index];
+        entry.active = false;
+        ++entry.generation;
+        --m_count;
+        // Don't reuse the entry while it's callback might be running
+        if (m_firing)
+            m_deferred.push_back(index);
+        else
+        {
+            entry.callback = nullptr;
+            m_free.push_back(index);
+        }
+    }
+
+    // Move the entries of every level that wrapped around to the lower levels
+    void cascade()
+    {
+        size_t top = 0;
+        while (top + 1 < LEVELS &&
+               (m_tick & ((1ull << (SLOT_BITS * (top + 1))) - 1ull)) == 0u)
+            ++top;
+
+        for (size_t level = top; level > 0; --level)
+        {
+            const uint64_t slot = (m_tick >> (SLOT_BITS * level)) & MASK;
+            uint32_t index = m_heads[level][slot];
+            m_heads[level][slot] = TimerHandle::NONE;
+            while (index != TimerHandle::NONE)
+            {
+                uint32_t next = m_entries[index].next;
+                m_entries[index].linked = false;
+                link(index, true);
+                index = next;
+            }
+        }
+    }
+
+    size_t fire(uint64_t slot)
+    {
+        uint32_t index = m_heads[0][slot];
+        if (index == TimerHandle::NONE)
+            return 0u;
+
+        // Detach the whole slot first, callbacks may schedule new entries
+        m_heads[0][slot] = TimerHandle::NONE;
+        m_fire.clear();
+        while (index != TimerHandle::NONE)
+        {
+            Entry &entry = m_entries[index];
+            uint32_t next = entry.next;
+            entry.prev = entry.next = TimerHandle::NONE;
+            entry.head = nullptr;
+            entry.linked = false;
+            // Entries clamped to the wheel's range aren't due yet
+            if (entry.tick > m_tick)
+                link(index, false);
+            else
+                m_fire.push_back(index);
+            index = next;
+        }
+
+        size_t fired = 0;
+        m_firing = true;
+        for (uint32_t i : m_fire)
+        {
+            Entry &entry = m_entries[i];
+            // Cancelled by an earlier callback of this batch
+            if (!entry.active)
+                continue;
+
+            if (entry.period > (U)0)
+            {
+                ++entry.periods;
+                entry.tick = to_tick(entry.start + (U)entry.periods * entry.period);
+                link(i, false);
+            }
+            else
+            {
+                release(i);
+            }
+            // std::deque keeps the references valid even if the
+            // callback schedules new entries
+            m_entries[i].callback();
+            ++fired;
+        }
+        m_firing = false;
+
+        for (uint32_t i : m_deferred)
+        {
+            m_entries[i].callback = nullptr;
+            m_free.push_back(i);
+        }
+        m_deferred.clear();
+
+        return fired;
+    }
+
+    U m_resolution;
+    uint64_t m_tick = 0u;
+    size_t m_count = 0u;
+    bool m_firing = false;
+
+    std::deque<Entry> m_entries;
+    std::vector<uint32_t> m_free;
+    std::vector<uint32_t> m_fire;
+    std::vector<uint32_t> m_deferred;
+    uint32_t m_heads[LEVELS][SLOTS];
+};
+
+#endif // GAME_TIMER_WHEEL
@@ -0,0 +1,401 @@
+#ifndef GAME_NEAREST_BATCH
+#define GAME_NEAREST_BATCH
+
+#include "quad_tree.hpp"
+#include "../class/task_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// K nearest queries of a whole tick answered together.
+// Queries are sorted by their tree and Morton code, neighbouring queries
+// are grouped and walk the tree once per group: nodes are visited best
+// first by their distance to the group's bounding box, and the points of
+// every visited leaf are offered to each query of the group. A query is
+// done once no node left can beat it's worst result.
+// Groups don't share anything, so they're split between the calling
+// thread and a TaskPool kept between solves, the trees must not change
+// and the conditions must be safe to call from any thread while solving.
+template <
+	typename Type,
+	typename NumType = int32_t,
+	typename Scorer = typename ChunkQuadTree<Type, NumType>::DistanceScorer>
+struct NearestBatch
+{
+	static_assert(sizeof(NumType) <= sizeof(uint32_t), "Morton codes are 64 bits.");
+
+	typedef ChunkQuadTree<Type, NumType> t_tree;
+	typedef typename t_tree::Vec Vec;
+	typedef typename t_tree::Node Node;
+	typedef typename t_tree::t_float t_float;
+	typedef std::function<bool(const Vec &, const Type &, const NumType &)> t_condition;
+	typedef decltype(std::declval<const Scorer &>()(
+		Vec(), Vec(), std::declval<const Type &>(), NumType())) t_score;
+
+	constexpr static size_t MAX_SIZE = t_tree::MAX_SIZE;
+	constexpr static t_float MAX_FLOAT = t_tree::MAX_FLOAT;
+	// Queries of a group are inside the same 8x8 block
+	constexpr static size_t GROUP_BITS = 6u;
+	constexpr static size_t GROUP_SIZE = 32u;
+	// Less groups than this are solved on the calling thread
+	constexpr static size_t PARALLEL_GROUPS = 16u;
+
+	struct Query
+	{
+		const t_tree *tree = nullptr;
+		Vec pos;
+		size_t limit = 0u;
+		NumType maxDistSq = t_tree::MAX_NUM;
+		t_condition condition;
+		Scorer scorer;
+		uint64_t code = 0u;
+		// Range in "results", valid once solved
+		uint32_t begin = 0u;
+		uint32_t count = 0u;
+	};
+
+	std::vector<Query> queries;
+	// Results of every solved query, best first
+	std::vector<Type> results;
+	// Threads solving together, the calling one included, zero for the
+	// hardware's count. Read once, when the pool is made.
+	size_t threads = 0u;
+
+	// Stats of the last solve
+	size_t groups = 0u;
+	size_t visited = 0u;
+
+	// Returns the index of the query
+	size_t add(
+		const t_tree *tree,
+		const Vec &pos,
+		size_t limit,
+		t_float maxDistance = MAX_FLOAT,
+		t_condition condition = nullptr,
+		const Scorer &scorer = Scorer())
+	{
+		Query query{};
+		query.tree = tree;
+		query.pos = pos;
+		query.limit = limit;
+		if (maxDistance != MAX_FLOAT)
+			query.maxDistSq = maxDistance * maxDistance;
+		query.condition = std::move(condition);
+		query.scorer = scorer;
+		query.code = morton_code(pos);
+		queries.push_back(std::move(query));
+		return queries.size() - 1u;
+	}
+
+	// Answer every query added since the last solve
+	void solve()
+	{
+		groups = 0u;
+		visited = 0u;
+		if (m_solved == queries.size())
+			return;
+
+		// Sort by the tree and then spatially
+		std::vector<size_t> order(queries.size() - m_solved);
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = m_solved + i;
+		std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+			const Query &qa = queries[a], &qb = queries[b];
+			if (qa.tree != qb.tree)
+				return std::less<const t_tree *>()(qa.tree, qb.tree);
+			return qa.code < qb.code;
+		});
+
+		// Ranges of "order"
+		std::vector<std::pair<size_t, size_t>> ranges;
+		for (size_t i = 0; i < order.size(); )
+		{
+			const Query &first = queries[order[i]];
+			size_t j = i + 1u;
+			while (j < order.size() && j - i < GROUP_SIZE &&
+				   queries[order[j]].tree == first.tree &&
+				   (queries[order[j]].code >> GROUP_BITS) == (first.code >> GROUP_BITS))
+				++j;
+			ranges.emplace_back(i, j);
+			i = j;
+		}
+		groups = ranges.size();
+
+		size_t count = math_max((size_t)1u, ranges.size() / PARALLEL_GROUPS);
+		if (count > 1u && !m_pool)
+		{
+			const size_t total = threads ? threads : (size_t)std::thread::hardware_concurrency();
+			if (total > 1u)
+				m_pool.reset(new TaskPool(total - 1u));
+		}
+		count = math_min(count, m_pool ? m_pool->size() + 1u : (size_t)1u);
+		if (m_workers.size() < count)
+			m_workers.resize(count);
+		m_owner.assign(order.size(), 0u);
+
+		const auto work = [this, &order, &ranges, count](size_t w) {
+			Worker &worker = m_workers[w];
+			worker.arena.clear();
+			worker.visited = 0u;
+			for (size_t g = w; g < ranges.size(); g += count)
+				solve_group(&order[ranges[g].first], &order[0] + ranges[g].second, worker, w);
+		};
+
+		if (count == 1u)
+		{
+			work(0u);
+		}
+		else
+		{
+			for (size_t w = 1; w < count; ++w)
+				m_pool->add([&work, w]() { work(w); });
+			work(0u);
+			m_pool->clear();
+		}
+
+		// Move the results of every worker into one array
+		std::vector<size_t> offset(count);
+		for (size_t w = 0; w < count; ++w)
+		{
+			offset[w] = results.size();
+			results.insert(results.end(), m_workers[w].arena.begin(), m_workers[w].arena.end());
+			visited += m_workers[w].visited;
+		}
+		for (size_t i = m_solved; i < queries.size(); ++i)
+			queries[i].begin += (uint32_t)offset[m_owner[i - m_solved]];
+
+		m_owner.clear();
+		m_solved = queries.size();
+	}
+
+	inline bool solved(size_t query) const
+	{
+		return query < m_solved;
+	}
+
+	inline size_t size(size_t query) const
+	{
+		assert(solved(query));
+		return queries[query].count;
+	}
+
+	inline const Type *begin(size_t query) const
+	{
+		assert(solved(query));
+		return results.data() + queries[query].begin;
+	}
+
+	inline const Type *end(size_t query) const
+	{
+		return begin(query) + size(query);
+	}
+
+	void clear()
+	{
+		queries.clear();
+		results.clear();
+		m_owner.clear();
+		m_solved = 0u;
+	}
+
+  private:
+	struct Candidate
+	{
+		t_score score;
+		Type type;
+	};
+
+	struct Frontier
+	{
+		NumType dist;
+		Node *node;
+	};
+
+	// State of a single thread
+	struct Worker
+	{
+		std::vector<Type> arena;
+		std::vector<std::vector<Candidate>> best;
+		std::vector<Frontier> frontier;
+		std::vector<char> done;
+		size_t visited = 0u;
+	};
+
+	static inline bool candidate_less(const Candidate &a, const Candidate &b)
+	{
+		return a.score < b.score;
+	}
+
+	static inline bool frontier_less(const Frontier &a, const Frontier &b)
+	{
+		return b.dist < a.dist;
+	}
+
+	static inline uint64_t spread(uint64_t v)
+	{
+		v &= 0xFFFFFFFFull;
+		v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+		v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+		v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+		v = (v | (v << 2)) & 0x3333333333333333ull;
+		v = (v | (v << 1)) & 0x5555555555555555ull;
+		return v;
+	}
+
+	// Negative positions are flipped so the order stays continuous
+	static inline uint64_t morton_code(const Vec &pos)
+	{
+		return spread((uint32_t)pos.x ^ 0x80000000u) |
+			(spread((uint32_t)pos.y ^ 0x80000000u) << 1);
+	}
+
+	// The squared distance between a node and a box, never more than
+	// the distance between the node and any position inside the box
+	static inline NumType box_dist(const Node *node, const Vec &min, const Vec &max)
+	{
+		const Vec p1 = node->pos;
+		const Vec p2 = node->pos + node->size;
+		const NumType x = math_max((NumType)0, math_max(p1.x - max.x, min.x - p2.x));
+		const NumType y = math_max((NumType)0, math_max(p1.y - max.y, min.y - p2.y));
+		return x * x + y * y;
+	}
+
+	void solve_group(const size_t *first, const size_t *last, Worker &worker, size_t w)
+	{
+		const size_t n = last - first;
+		for (const size_t *q = first; q != last; ++q)
+		{
+			queries[*q].begin = (uint32_t)worker.arena.size();
+			queries[*q].count = 0u;
+			m_owner[*q - m_solved] = w;
+		}
+
+		const t_tree *tree = queries[*first].tree;
+		if (!tree || !tree->root)
+			return;
+
+		Vec min = queries[*first].pos, max = min;
+		NumType maxDistSq = 0;
+		for (const size_t *q = first; q != last; ++q)
+		{
+			const Query &query = queries[*q];
+			min.x = math_min(min.x, query.pos.x);
+			min.y = math_min(min.y, query.pos.y);
+			max.x = math_max(max.x, query.pos.x);
+			max.y = math_max(max.y, query.pos.y);
+			maxDistSq = math_max(maxDistSq, query.maxDistSq);
+		}
+
+		if (worker.best.size() < n)
+			worker.best.resize(n);
+		worker.done.assign(n, 0);
+		for (size_t i = 0; i < n; ++i)
+		{
+			worker.best[i].clear();
+			if (queries[first[i]].limit == 0u)
+				worker.done[i] = 1;
+		}
+
+		std::vector<Frontier> &frontier = worker.frontier;
+		frontier.clear();
+		frontier.push_back({box_dist(tree->root, min, max), tree->root});
+
+		while (!frontier.empty())
+		{
+			std::pop_heap(frontier.begin(), frontier.end(), frontier_less);
+			const Frontier next = frontier.back();
+			frontier.pop_back();
+			if (next.dist > maxDistSq)
+				break;
+
+			// Queries that can't get any better
+			size_t left = 0u;
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (worker.done[i])
+					continue;
+				const Query &query = queries[first[i]];
+				const std::vector<Candidate> &best = worker.best[i];
+				if (next.dist > query.maxDistSq ||
+					(best.size() >= query.limit &&
+					 !(query.scorer.bound(next.dist) < best.front().score)))
+					worker.done[i] = 1;
+				else
+					++left;
+			}
+			if (!left)
+				break;
+
+			Node *node = next.node;
+			if (!node->is_leaf())
+			{
+				for (size_t i = 0u; i < 4u; ++i)
+				{
+					if (!node->next[i])
+						continue;
+					const NumType dist = box_dist(node->next[i], min, max);
+					if (dist > maxDistSq)
+						continue;
+					frontier.push_back({dist, node->next[i]});
+					std::push_heap(frontier.begin(), frontier.end(), frontier_less);
+				}
+				continue;
+			}
+
+			++worker.visited;
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (worker.done[i])
+					continue;
+				const Query &query = queries[first[i]];
+				std::vector<Candidate> &best = worker.best[i];
+				for (const auto &p : node->points)
+				{
+					const NumType fdist = vec_distsq(p.pos, query.pos);
+					if (fdist > query.maxDistSq ||
+						(query.condition && !query.condition(p.pos, p.type, fdist)))
+						continue;
+
+					const t_score score = query.scorer(query.pos, p.pos, p.type, fdist);
+					if (best.size() < query.limit)
+					{
+						best.push_back({score, p.type});
+						std::push_heap(best.begin(), best.end(), candidate_less);
+					}
+					else if (score < best.front().score)
+					{
+						std::pop_heap(best.begin(), best.end(), candidate_less);
+						best.back() = {score, p.type};
+						std::push_heap(best.begin(), best.end(), candidate_less);
+					}
+				}
+			}
+		}
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			Query &query = queries[first[i]];
+			std::vector<Candidate> &best = worker.best[i];
+			std::sort_heap(best.begin(), best.end(), candidate_less);
+			query.begin = (uint32_t)worker.arena.size();
+			query.count = (uint32_t)best.size();
+			for (const Candidate &c : best)
+				worker.arena.push_back(c.type);
+		}
+	}
+
+	// Queries before this one are answered
+	size_t m_solved = 0u;
+	// The worker that answered each query of the current solve
+	std::vector<size_t> m_owner;
+	std::vector<Worker> m_workers;
+	// Made by the first solve that has enough groups
+	std::unique_ptr<TaskPool> m_pool;
+};
+
+#endif // GAME_NEAREST_BATCH
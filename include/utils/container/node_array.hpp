@@ -1,105 +1,365 @@
+#ifndef GAME_NODE_ARRAY
+#define GAME_NODE_ARRAY
 
-#include "vector"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
 
-// Node based array container
-// Wrapper of std::vector (for simplicity')
-// Iterator only get invalidated when it's value gets deleted
-// No random access and no random insertion
+// Position of a value inside a NodeArray.
+// The generation tells apart the values that used the same slot.
+struct NodeHandle
+{
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	uint32_t index = NONE;
+	uint32_t generation = 0u;
+
+	bool valid() const
+	{
+		return index != NONE;
+	}
+
+	bool operator==(const NodeHandle &other) const
+	{
+		return index == other.index && generation == other.generation;
+	}
+
+	bool operator!=(const NodeHandle &other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// Slot map, the values are kept in one contiguous array.
+// Erased slots are chained in a free list and reused by the next insert,
+// so insert and erase are O(1). Erasing bumps the slot's generation, old
+// handles to it stop resolving.
+// Iterators hold an index, they stay valid while the array grows and are
+// only invalidated when their own value is erased. Iteration goes in slot
+// order and skips the holes, compact() removes them.
 template <class T>
 class NodeArray
 {
-	struct Iterator
+	struct Node
 	{
-		
-		
-		
+		T value{};
+		uint32_t nextFree = NodeHandle::NONE;
+		bool active = false;
 	};
-	
-	
+
+  public:
 	typedef T value_type;
 	typedef std::ptrdiff_t difference_type;
 	typedef std::size_t size_type;
-	typedef Iterator iterator;
-	
-	
-	
+	typedef NodeHandle handle;
 
-	struct Node
+	template <class A, class V>
+	struct Iterator
 	{
-		bool active = true;
-		size_t next = 0;
-		T value;
-	};
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = V *;
+		using reference = V &;
 
-	std::vector<Node> data;
+		Iterator() {}
 
-	void push_back(const T &value)
-	{
-		Node n = {true};
-		n.value = value;
-		if (!data.empty())
+		Iterator(A *array, size_t index)
+			: array(array), index(index)
+		{
+		}
+
+		// iterator to const_iterator
+		template <class A2, class V2>
+		Iterator(const Iterator<A2, V2> &other)
+			: array(other.array), index(other.index)
+		{
+		}
+
+		reference operator*() const { return array->m_nodes[index].value; }
+
+		pointer operator->() const { return &array->m_nodes[index].value; }
+
+		Iterator &operator++()
+		{
+			index = array->next_active(index + 1u);
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator tmp = *this;
+			++(*this);
+			return tmp;
+		}
+
+		bool operator==(const Iterator &other) const
 		{
-			data.back().next = data.size() - 1u;
+			return index == other.index && array == other.array;
 		}
-		data.push_back(value);
+
+		bool operator!=(const Iterator &other) const
+		{
+			return !(*this == other);
+		}
+
+		handle get_handle() const
+		{
+			return array->handle_at(index);
+		}
+
+		A *array = nullptr;
+		size_t index = 0u;
+	};
+
+	typedef Iterator<NodeArray, T> iterator;
+	typedef Iterator<const NodeArray, const T> const_iterator;
+
+	iterator begin() { return iterator(this, next_active(0u)); }
+	iterator end() { return iterator(this, m_nodes.size()); }
+	const_iterator begin() const { return const_iterator(this, next_active(0u)); }
+	const_iterator end() const { return const_iterator(this, m_nodes.size()); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	handle insert(const T &value)
+	{
+		const uint32_t index = take_slot();
+		m_nodes[index].value = value;
+		return handle_at(index);
+	}
+
+	handle insert(T &&value)
+	{
+		const uint32_t index = take_slot();
+		m_nodes[index].value = std::move(value);
+		return handle_at(index);
+	}
+
+	// The value might end up in a hole, not at the end
+	handle push_back(const T &value)
+	{
+		return insert(value);
 	}
-	
-	void pop_back()
+
+	handle push_back(T &&value)
+	{
+		return insert(std::move(value));
+	}
+
+	// Returns the iterator after the erased value
+	iterator erase(const_iterator itr)
+	{
+		assert(itr.array == this && is_active(itr.index));
+		release_slot((uint32_t)itr.index);
+		return iterator(this, next_active(itr.index + 1u));
+	}
+
+	// False if the handle is stale
+	bool erase(handle h)
 	{
-		data.pop_back();
-		while (data.front().active)
+		if (!contains(h))
+			return false;
+		release_slot(h.index);
+		return true;
+	}
+
+	bool contains(handle h) const
+	{
+		return h.index < m_nodes.size() &&
+			m_nodes[h.index].active &&
+			m_generations[h.index] == h.generation;
+	}
+
+	// Null if the handle is stale
+	T *get(handle h)
+	{
+		return contains(h) ? &m_nodes[h.index].value : nullptr;
+	}
+
+	const T *get(handle h) const
+	{
+		return contains(h) ? &m_nodes[h.index].value : nullptr;
+	}
+
+	iterator find(handle h)
+	{
+		return contains(h) ? iterator(this, h.index) : end();
+	}
+
+	// Linear, unless "hint" still points to the value
+	template <class V>
+	iterator find(const V &value, handle hint = {})
+	{
+		if (contains(hint) && m_nodes[hint.index].value == value)
+			return iterator(this, hint.index);
+		for (size_t i = 0; i < m_nodes.size(); ++i)
 		{
-			data.pop_back();
+			if (m_nodes[i].active && m_nodes[i].value == value)
+				return iterator(this, i);
 		}
+		return end();
 	}
-	
-	void insert(const T& value)
+
+	template <class V>
+	bool erase_value(const V &value, handle hint = {})
+	{
+		iterator itr = find(value, hint);
+		if (itr == end())
+			return false;
+		erase(itr);
+		return true;
+	}
+
+	// Moves the values over the holes, keeping their order.
+	// Every handle to a moved value is invalidated, "onMove(value, handle)"
+	// is called with the new handle of each of them.
+	// Returns how many values were moved.
+	template <class F>
+	size_t compact(F onMove)
 	{
-		if (!data.empty() && !data.front().active)
+		size_t moved = 0u;
+		uint32_t to = 0u;
+		for (uint32_t from = 0u; from < m_nodes.size(); ++from)
 		{
-			size_type index = 1;
-			for (; index < data.size(); ++index)
+			if (!m_nodes[from].active)
+				continue;
+			if (from != to)
 			{
-				if (data[index].active)
-				  break;
+				Node &dst = m_nodes[to];
+				dst.value = std::move(m_nodes[from].value);
+				dst.active = true;
+				dst.nextFree = NodeHandle::NONE;
+
+				m_nodes[from].value = T{};
+				m_nodes[from].active = false;
+				++m_generations[from];
+
+				onMove(dst.value, handle_at(to));
+				++moved;
 			}
-			data.front().value = value;
-			data.front().next = index;
+			++to;
 		}
-		
-		for (size_t i = 1; i < data.size(); ++i)
+
+		// Only holes are left past the values, the generations stay so
+		// the handles to them don't resolve once the slots are reused
+		m_nodes.resize(to);
+		m_free = NodeHandle::NONE;
+		m_holes = 0u;
+		return moved;
+	}
+
+	size_t compact()
+	{
+		return compact([](T &, handle) {});
+	}
+
+	void clear()
+	{
+		for (size_t i = 0; i < m_nodes.size(); ++i)
 		{
-			if (!data[i].active)
-			{
-				data[i-1].next = i;
-				Node& node = data[i];
-				node.active = true;
-				node.next = i;
-				node.value = value;
-				return;
-			}
+			if (m_nodes[i].active)
+				++m_generations[i];
 		}
+		m_nodes.clear();
+		m_free = NodeHandle::NONE;
+		m_size = 0u;
+		m_holes = 0u;
 	}
-	
-	
-	
-	T& back()
+
+	size_type size() const
 	{
-		return data.back().value;
+		return m_size;
 	}
-	
-	T& front()
+
+	bool empty() const
 	{
-		return data.front().value;
+		return m_size == 0u;
+	}
+
+	// Erased slots waiting to be reused
+	size_type holes() const
+	{
+		return m_holes;
 	}
 
 	void reserve(size_t x)
 	{
-		data.reserve(x);
+		m_nodes.reserve(x);
+		m_generations.reserve(x);
+	}
+
+	size_type capacity() const
+	{
+		return m_nodes.capacity();
+	}
+
+  private:
+	bool is_active(size_t index) const
+	{
+		return index < m_nodes.size() && m_nodes[index].active;
+	}
+
+	size_t next_active(size_t index) const
+	{
+		while (index < m_nodes.size() && !m_nodes[index].active)
+			++index;
+		return index;
+	}
+
+	handle handle_at(size_t index) const
+	{
+		handle h;
+		h.index = (uint32_t)index;
+		h.generation = m_generations[index];
+		return h;
+	}
+
+	uint32_t take_slot()
+	{
+		uint32_t index;
+		if (m_free != NodeHandle::NONE)
+		{
+			index = m_free;
+			m_free = m_nodes[index].nextFree;
+			--m_holes;
+		}
+		else
+		{
+			index = (uint32_t)m_nodes.size();
+			m_nodes.emplace_back();
+			if (m_generations.size() < m_nodes.size())
+				m_generations.push_back(0u);
+		}
+
+		Node &node = m_nodes[index];
+		node.active = true;
+		node.nextFree = NodeHandle::NONE;
+		++m_size;
+		return index;
 	}
 
-	size_type capacity()
+	void release_slot(uint32_t index)
 	{
-		return data.capacity();
+		Node &node = m_nodes[index];
+		node.value = T{};
+		node.active = false;
+		node.nextFree = m_free;
+		m_free = index;
+		++m_generations[index];
+		++m_holes;
+		--m_size;
 	}
-};
\ No newline at end of file
+
+	std::vector<Node> m_nodes;
+	// Outlives the nodes, a slot dropped by compact() keeps counting
+	std::vector<uint32_t> m_generations;
+	uint32_t m_free = NodeHandle::NONE;
+	size_t m_size = 0u;
+	size_t m_holes = 0u;
+};
+
+#endif // GAME_NODE_ARRAY
@@ -74,6 +74,8 @@ struct ChunkQuadTree
 
 	Node *root = nullptr;
 	bool hardopt = false;
+	// Changed on every insertion, removal or move
+	size_t version = 0u;
 
 	template <class U>
 	struct DistPair
@@ -120,8 +122,6 @@ struct ChunkQuadTree
 		Node *parent = nullptr;
 		Vec pos, size = {(NumType)0, (NumType)0};
 
-		bool _checked = false;
-
 		Node(Vec pos)
 			: pos(pos)
 		{
@@ -378,6 +378,7 @@ struct ChunkQuadTree
 
 	void clear()
 	{
+		++version;
 		destroy(this->root);
 	}
 
@@ -481,6 +482,7 @@ struct ChunkQuadTree
 
 	bool insert(const Point &p)
 	{
+		++version;
 		bool isRoot = root;
 
 		// If there's is no root node, create a node on the
@@ -643,6 +645,7 @@ struct ChunkQuadTree
 
 			return false;
 		}
+		++version;
 
 		auto &points = node->points;
 		/*
@@ -730,6 +733,7 @@ struct ChunkQuadTree
 		{
 			Point &p = *pair.second;
 			p.pos = posNew;
+			++version;
 		}
 		else
 		{
@@ -883,132 +887,251 @@ struct ChunkQuadTree
 
 	// K nearest neighbors algorithms
 
+	// Scores a point by it's squared distance, the default order
+	struct DistanceScorer
+	{
+		inline NumType operator()(
+			const Vec &,
+			const Vec &,
+			const Type &,
+			const NumType distsq) const
+		{
+			return distsq;
+		}
+
+		// The lowest score of a point "distsq" or further away
+		inline NumType bound(const NumType distsq) const
+		{
+			return distsq;
+		}
+	};
+
 	/*
-	Simplest implementation, most efficient
-	Does not iterate through neighbors of higher levels
-	if found any/enough close points
-	
-	Source:
-	https://observablehq.com/@llb4ll/k-nearest-neighbor-search-using-d3-quadtrees
+	Best-first search.
+	Nodes wait in a binary heap ordered by the lowest score any of their
+	points could have (the scorer's bound of the node's distance), and
+	the best points are kept in a bounded max-heap. The search ends once
+	no waiting node can beat the worst kept point.
+	A scorer is any function of the point that is never lower than the
+	bound of it's distance, "Scorer::bound" must be monotone.
+	Nothing in the tree is written, so queries can run concurrently.
 	*/
 	template <
 		class Condition = t_def_condition,
-		class Comparator = t_def_comparator>
-	void
-	k_nearest_rec(
+		class Scorer = DistanceScorer>
+	void k_nearest(
 		std::vector<Point *> &result,
-		const FVec &vec,
+		const Vec &vec,
 		size_t limit,
-		t_float maxDistance = std::numeric_limits<t_float>::max(),
-		const Condition &condition =
-			DEFAULT_CONDITION,
-		const Comparator &comparator =
-			DEFAULT_COMPARATOR)
+		t_float maxDistance = MAX_FLOAT,
+		const Condition &condition = DEFAULT_CONDITION,
+		const Scorer &scorer = Scorer()) const
 	{
-		std::deque<DistPair<Node *>> best;
-		best.push_back({node_dist(root, vec), root});
-		t_float furthest = (t_float)0;
+		if (!root || limit == 0u)
+			return;
 
-		t_float maxDistSq = MAX_FLOAT;
+		typedef decltype(scorer(vec, vec, defaultType, (NumType)0)) t_score;
+
+		struct Frontier
+		{
+			t_score bound;
+			NumType dist;
+			Node *node;
+		};
+		struct Candidate
+		{
+			t_score score;
+			Point *point;
+		};
+		// Min heap of nodes, max heap of points
+		const auto frontierLess = [](const Frontier &a, const Frontier &b) {
+			return b.bound < a.bound;
+		};
+		const auto candidateLess = [](const Candidate &a, const Candidate &b) {
+			return a.score < b.score;
+		};
+
+		NumType maxDistSq = MAX_NUM;
 		if (maxDistance != MAX_FLOAT)
 			maxDistSq = maxDistance * maxDistance;
 
-		while (!best.empty())
-		{
-			// For higher perdormance and lower accurecy
-			if (hardopt)
-			{
-				if (furthest > maxDistSq || result.size() >= limit)
-					break;
-			}
+		std::vector<Frontier> frontier;
+		std::vector<Candidate> best;
+		if (limit != MAX_SIZE)
+			best.reserve(limit);
 
-			Node *back = best.front().data;
-			best.pop_front();
-			back->_checked = 1;
+		const NumType rootDist = node_dist(root, vec);
+		frontier.push_back({scorer.bound(rootDist), rootDist, root});
 
-			// If all remaining nodes are further than the
-			// furthest found point there's no reason to
-			// cheak them
-			if (result.size() > 0 && result.size() == limit && back)
-			{
-				
-				t_float nd = node_dist(back, vec);
-				
-				t_float n2 = vec_distsq(result.back()->pos, vec);
-				
-				if (nd > n2)
-					break;
-			}
+		while (!frontier.empty())
+		{
+			std::pop_heap(frontier.begin(), frontier.end(), frontierLess);
+			const Frontier next = frontier.back();
+			frontier.pop_back();
 
-			if (node_dist(back, vec) >= maxDistSq)
+			if (best.size() >= limit)
 			{
-				break;
+				// Every waiting node is at least as bad as this one
+				if (!(next.bound < best.front().score))
+					break;
+				// For higher performance and lower accuracy
+				if (hardopt)
+					break;
 			}
 
-			if (back->is_leaf())
+			Node *node = next.node;
+			if (node->is_leaf())
 			{
-				for (auto itr = back->points.begin(); itr != back->points.end(); itr++)
+				for (Point &p : node->points)
 				{
-					Point *p = &*itr;
-					// NumType backDist;
-					if (condition(p->pos, p->type, vec_distsq(vec, p->pos)))
+					const NumType fdist = vec_distsq(p.pos, vec);
+					if (fdist > maxDistSq ||
+						!condition(p.pos, p.type, fdist))
+						continue;
+
+					const t_score score = scorer(vec, p.pos, p.type, fdist);
+					if (best.size() < limit)
 					{
-						auto lowerLambda = [&vec, &comparator](Point *a, Point *b) {
-							return comparator(
-								vec,
-								a->pos,
-								a->type,
-								b->pos,
-								b->type);
-						};
-						auto itrLower = std::lower_bound(
-							result.begin(),
-							result.end(),
-							p,
-							lowerLambda);
-
-						// Calculate distance between current node to best node
-						// If there's no best node, declare itself as best node
-						// backDist = (result.size() ? vec_distsq(result.back()->pos, vec) : MAX_NUM);
-
-						NumType fdist = vec_distsq(p->pos, vec);
-						// Insert (and automaticly order by distance to "vec")
-						result.insert(itrLower, p);
-
-						// Remove container tail if need
-						if (result.size() > limit || fdist > maxDistSq)
-						{
-							if (furthest < fdist)
-							{
-								furthest = fdist;
-							}
-							result.pop_back();
-						}
+						best.push_back({score, &p});
+						std::push_heap(best.begin(), best.end(), candidateLess);
+					}
+					else if (score < best.front().score)
+					{
+						std::pop_heap(best.begin(), best.end(), candidateLess);
+						best.back() = {score, &p};
+						std::push_heap(best.begin(), best.end(), candidateLess);
 					}
 				}
-
 				continue;
 			}
 
-			// else...
-			for (size_t i = 0u; i < (size_t)back->count; ++i)
+			for (size_t i = 0u; i < 4u; ++i)
 			{
-				Node *n = back->next[i];
+				Node *n = node->next[i];
 				if (!n)
 					continue;
-				DistPair<Node *> p =
-					DistPair<Node *>{node_dist(n, vec), n};
-				auto itr = std::lower_bound(
-					best.begin(),
-					best.end(),
-					p);
-				best.insert(itr, p);
+				const NumType dist = node_dist(n, vec);
+				if (dist > maxDistSq)
+					continue;
+				frontier.push_back({scorer.bound(dist), dist, n});
+				std::push_heap(frontier.begin(), frontier.end(), frontierLess);
+			}
+		}
+
+		// Best first
+		std::sort_heap(best.begin(), best.end(), candidateLess);
+		result.reserve(result.size() + best.size());
+		for (const Candidate &c : best)
+			result.push_back(c.point);
+	}
+
+	/*
+	A comparator doesn't tell how good a node's points can be, so
+	nothing but "maxDistance" prunes the search, every point inside it
+	is a candidate and the best "limit" of them are kept.
+	The default comparator is searched by k_nearest instead.
+	*/
+	template <
+		class Condition = t_def_condition,
+		class Comparator = t_def_comparator>
+	void k_nearest_rec(
+		std::vector<Point *> &result,
+		const Vec &vec,
+		size_t limit,
+		t_float maxDistance = MAX_FLOAT,
+		const Condition &condition =
+			DEFAULT_CONDITION,
+		const Comparator &comparator =
+			DEFAULT_COMPARATOR) const
+	{
+		if constexpr (std::is_same<Comparator, t_def_comparator>::value)
+		{
+			k_nearest(result, vec, limit, maxDistance, condition);
+			return;
+		}
+
+		if (!root || limit == 0u)
+			return;
+
+		NumType maxDistSq = MAX_NUM;
+		if (maxDistance != MAX_FLOAT)
+			maxDistSq = maxDistance * maxDistance;
+
+		const size_t first = result.size();
+		std::vector<Node *> stack;
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			Node *node = stack.back();
+			stack.pop_back();
+			if (node_dist(node, vec) > maxDistSq)
+				continue;
+
+			if (node->is_leaf())
+			{
+				for (Point &p : node->points)
+				{
+					const NumType fdist = vec_distsq(p.pos, vec);
+					if (fdist <= maxDistSq &&
+						condition(p.pos, p.type, fdist))
+						result.push_back(&p);
+				}
+				continue;
 			}
+
+			for (size_t i = 0u; i < 4u; ++i)
+				if (node->next[i])
+					stack.push_back(node->next[i]);
+		}
+
+		const auto lowerLambda = [&vec, &comparator](Point *a, Point *b) {
+			return comparator(
+				vec,
+				a->pos,
+				a->type,
+				b->pos,
+				b->type);
+		};
+		const auto begin = result.begin() + first;
+		if ((size_t)(result.end() - begin) > limit)
+		{
+			std::partial_sort(begin, begin + limit, result.end(), lowerLambda);
+			result.resize(first + limit);
+		}
+		else
+		{
+			std::sort(begin, result.end(), lowerLambda);
 		}
 	}
 
 	// Insertors
 
+	template <class Inserter,
+			  typename U = Type,
+			  class Condition = t_def_condition,
+			  class Scorer = DistanceScorer>
+	void nearest_k_scored_insertor(
+		const FVec &vec,
+		size_t limit,
+		t_float maxDistance,
+		Inserter inserter,
+		const Condition &condition,
+		const Scorer &scorer) const
+	{
+		if (!root)
+			return;
+		std::vector<Point *> result;
+		k_nearest(
+			result,
+			vec,
+			limit,
+			maxDistance,
+			condition,
+			scorer);
+		for (auto itr = result.begin(); itr != result.end(); ++itr)
+			inserter++ = (U)(*itr)->type;
+	}
+
 	template <class Inserter,
 			  typename U = Type,
 			  class Condition = t_def_condition,
@@ -1021,12 +1144,11 @@ struct ChunkQuadTree
 		const Condition &condition =
 			DEFAULT_CONDITION,
 		const Comparator &comparator =
-			DEFAULT_COMPARATOR)
+			DEFAULT_COMPARATOR) const
 	{
 		if (!root)
 			return;
 		std::vector<Point *> result;
-		result.reserve(limit);
 		k_nearest_rec(
 			result,
 			vec,
@@ -1049,7 +1171,7 @@ struct ChunkQuadTree
 		const Condition &condition =
 			DEFAULT_CONDITION,
 		const Comparator &comparator =
-			DEFAULT_COMPARATOR)
+			DEFAULT_COMPARATOR) const
 	{
 		nearest_k_radius_insertor<Inserter, U, Condition, Comparator>(
 			vec,
@@ -1071,7 +1193,7 @@ struct ChunkQuadTree
 		const Condition &condition =
 			DEFAULT_CONDITION,
 		const Comparator &comparator =
-			DEFAULT_COMPARATOR)
+			DEFAULT_COMPARATOR) const
 	{
 		nearest_k_radius_insertor<Inserter, U, Condition, Comparator>(
 			vec,
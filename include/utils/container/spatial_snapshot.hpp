@@ -0,0 +1,307 @@
+#ifndef GAME_SPATIAL_SNAPSHOT
+#define GAME_SPATIAL_SNAPSHOT
+
+#include "quad_tree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Immutable copy of a ChunkQuadTree, made once per tick so other
+// threads could query it without locks.
+// Points are bucketed into square cells and sorted by their cell,
+// a query walks rings of cells around it's position. Queries don't
+// write anything (unlike ChunkQuadTree's), so any number of threads
+// can run them at the same time.
+template <typename Type, typename NumType = int32_t>
+struct SpatialSnapshot
+{
+	typedef ChunkQuadTree<Type, NumType> t_tree;
+	typedef typename t_tree::Vec Vec;
+	typedef typename t_tree::t_float t_float;
+	typedef typename t_tree::t_def_condition t_def_condition;
+	typedef typename t_tree::t_def_comparator t_def_comparator;
+
+	constexpr static size_t MAX_SIZE = t_tree::MAX_SIZE;
+	constexpr static NumType MAX_NUM = t_tree::MAX_NUM;
+	constexpr static t_float MAX_FLOAT = t_tree::MAX_FLOAT;
+
+	struct Point
+	{
+		Vec pos;
+		Type type;
+	};
+
+	struct Cell
+	{
+		Vec key;
+		// Range in "points"
+		uint32_t begin = 0u;
+		uint32_t end = 0u;
+	};
+
+	NumType cellSize = 8;
+	// Sorted by their cell
+	std::vector<Point> points;
+	// Sorted by key, only cells with points
+	std::vector<Cell> cells;
+	Vec minCell{ 0, 0 }, maxCell{ 0, 0 };
+	// Version of the tree it was made from
+	size_t version = 0u;
+
+	SpatialSnapshot(NumType cellSize = 8)
+		: cellSize(cellSize)
+	{
+		assert(cellSize > 0);
+	}
+
+	// Copy every point of "tree"
+	void build(t_tree &tree)
+	{
+		points.clear();
+		for (auto itr = tree.begin(); itr != tree.end(); ++itr)
+			points.push_back(Point{ itr.pos(), *itr });
+		version = tree.version;
+		finish();
+	}
+
+	// Sort the points added to "points" into cells
+	void finish()
+	{
+		cells.clear();
+		if (points.empty())
+			return;
+
+		std::sort(points.begin(), points.end(),
+			[this](const Point &a, const Point &b) {
+				return key_less(cell_of(a.pos), cell_of(b.pos));
+			});
+
+		minCell = maxCell = cell_of(points.front().pos);
+		for (uint32_t i = 0; i < (uint32_t)points.size(); ++i)
+		{
+			const Vec key = cell_of(points[i].pos);
+			if (cells.empty() || cells.back().key != key)
+				cells.push_back(Cell{ key, i, i });
+			++cells.back().end;
+
+			minCell.x = math_min(minCell.x, key.x);
+			minCell.y = math_min(minCell.y, key.y);
+			maxCell.x = math_max(maxCell.x, key.x);
+			maxCell.y = math_max(maxCell.y, key.y);
+		}
+	}
+
+	inline size_t size() const
+	{
+		return points.size();
+	}
+
+	inline bool empty() const
+	{
+		return points.empty();
+	}
+
+	inline Vec cell_of(const Vec &pos) const
+	{
+		return {
+			math_floordiv(pos.x, cellSize),
+			math_floordiv(pos.y, cellSize) };
+	}
+
+	const Cell *find_cell(const Vec &key) const
+	{
+		auto itr = std::lower_bound(
+			cells.begin(),
+			cells.end(),
+			key,
+			[](const Cell &c, const Vec &k) { return key_less(c.key, k); });
+		if (itr == cells.end() || itr->key != key)
+			return nullptr;
+		return &*itr;
+	}
+
+	// K nearest neighbors, same arguments and order as ChunkQuadTree's
+	template <
+		class Condition = t_def_condition,
+		class Comparator = t_def_comparator>
+	void k_nearest(
+		std::vector<const Point *> &result,
+		const Vec &vec,
+		size_t limit,
+		t_float maxDistance = MAX_FLOAT,
+		const Condition &condition = t_tree::DEFAULT_CONDITION,
+		const Comparator &comparator = t_tree::DEFAULT_COMPARATOR) const
+	{
+		if (points.empty() || limit == 0u)
+			return;
+
+		t_float maxDistSq = MAX_FLOAT;
+		if (maxDistance != MAX_FLOAT)
+			maxDistSq = maxDistance * maxDistance;
+
+		const Vec center = cell_of(vec);
+
+		// Rings closer than the bounds are empty
+		NumType ring = math_max(
+			math_max(minCell.x - center.x, center.x - maxCell.x),
+			math_max(minCell.y - center.y, center.y - maxCell.y));
+		ring = math_max((NumType)0, ring);
+
+		const auto lowerLambda = [&vec, &comparator](const Point *a, const Point *b) {
+			return comparator(vec, a->pos, a->type, b->pos, b->type);
+		};
+
+		// Only the distance order can stop at a ring, another comparator
+		// may prefer a point further away
+		constexpr bool byDistance = std::is_same<Comparator, t_def_comparator>::value;
+		// Max heap in the comparator's order, the worst kept point on top
+		std::vector<const Point *> best;
+		best.reserve(math_min(limit, points.size()));
+
+		const auto visit = [&](const Vec &key) {
+			const Cell *cell = find_cell(key);
+			if (!cell)
+				return;
+			for (uint32_t i = cell->begin; i < cell->end; ++i)
+			{
+				const Point *p = &points[i];
+				const NumType fdist = vec_distsq(p->pos, vec);
+				if (fdist > maxDistSq)
+					continue;
+				if (!condition(p->pos, p->type, fdist))
+					continue;
+				if (best.size() < limit)
+				{
+					best.push_back(p);
+					std::push_heap(best.begin(), best.end(), lowerLambda);
+				}
+				else if (lowerLambda(p, best.front()))
+				{
+					std::pop_heap(best.begin(), best.end(), lowerLambda);
+					best.back() = p;
+					std::push_heap(best.begin(), best.end(), lowerLambda);
+				}
+			}
+		};
+
+		while (true)
+		{
+			// The closest a point of this ring can be
+			const NumType near = math_max((NumType)0, ring - 1) * cellSize;
+			const NumType nearSq = near * near;
+			if (near > 0 && nearSq >= maxDistSq)
+				break;
+			if (byDistance && best.size() == limit &&
+				nearSq > vec_distsq(best.front()->pos, vec))
+				break;
+
+			const NumType y0 = math_max(center.y - ring, minCell.y);
+			const NumType y1 = math_min(center.y + ring, maxCell.y);
+			const NumType x0 = math_max(center.x - ring, minCell.x);
+			const NumType x1 = math_min(center.x + ring, maxCell.x);
+			for (NumType y = y0; y <= y1; ++y)
+			{
+				if (y == center.y - ring || y == center.y + ring)
+				{
+					for (NumType x = x0; x <= x1; ++x)
+						visit(Vec{ x, y });
+				}
+				else
+				{
+					if (center.x - ring >= minCell.x)
+						visit(Vec{ center.x - ring, y });
+					if (ring && center.x + ring <= maxCell.x)
+						visit(Vec{ center.x + ring, y });
+				}
+			}
+
+			// The ring covers every cell
+			if (center.x - ring <= minCell.x && center.x + ring >= maxCell.x &&
+				center.y - ring <= minCell.y && center.y + ring >= maxCell.y)
+				break;
+			++ring;
+		}
+
+		// Best first
+		std::sort_heap(best.begin(), best.end(), lowerLambda);
+		result.insert(result.end(), best.begin(), best.end());
+	}
+
+	// Insertors, the same as ChunkQuadTree's
+
+	template <class Inserter,
+			  typename U = Type,
+			  class Condition = t_def_condition,
+			  class Comparator = t_def_comparator>
+	void nearest_k_radius_insertor(
+		const Vec &vec,
+		size_t limit,
+		t_float maxDistance,
+		Inserter inserter,
+		const Condition &condition =
+			t_tree::DEFAULT_CONDITION,
+		const Comparator &comparator =
+			t_tree::DEFAULT_COMPARATOR) const
+	{
+		std::vector<const Point *> result;
+		if (limit != MAX_SIZE)
+			result.reserve(limit);
+		k_nearest(result, vec, limit, maxDistance, condition, comparator);
+		for (const Point *p : result)
+			inserter++ = (U)p->type;
+	}
+
+	template <class Inserter,
+			  typename U = Type,
+			  class Condition = t_def_condition,
+			  class Comparator = t_def_comparator>
+	void nearest_k_insertor(
+		const Vec &vec,
+		size_t limit,
+		Inserter inserter,
+		const Condition &condition =
+			t_tree::DEFAULT_CONDITION,
+		const Comparator &comparator =
+			t_tree::DEFAULT_COMPARATOR) const
+	{
+		nearest_k_radius_insertor<Inserter, U, Condition, Comparator>(
+			vec,
+			limit,
+			MAX_FLOAT,
+			inserter,
+			condition,
+			comparator);
+	}
+
+	template <class Inserter,
+			  typename U = Type,
+			  class Condition = t_def_condition,
+			  class Comparator = t_def_comparator>
+	void nearest_radius_insertor(
+		const Vec &vec,
+		t_float maxDistance,
+		Inserter inserter,
+		const Condition &condition =
+			t_tree::DEFAULT_CONDITION,
+		const Comparator &comparator =
+			t_tree::DEFAULT_COMPARATOR) const
+	{
+		nearest_k_radius_insertor<Inserter, U, Condition, Comparator>(
+			vec,
+			MAX_SIZE,
+			maxDistance,
+			inserter,
+			condition,
+			comparator);
+	}
+
+  private:
+	static inline bool key_less(const Vec &a, const Vec &b)
+	{
+		return a.y < b.y || (a.y == b.y && a.x < b.x);
+	}
+};
+
+#endif // GAME_SPATIAL_SNAPSHOT
@@ -9,6 +9,8 @@
 
 #include <boost/container/stable_vector.hpp>
 
+#include "container/node_array.hpp"
+
 #ifdef __GNUC__
 
 #pragma GCC diagnostic push
@@ -129,12 +131,12 @@ struct SpawnInfo
 // Object container type must have:
 // Always valid iterators, even after change
 // begin() and end()
-// push_back()
+// push_back(), returning a handle for O(1) erase
 template <class T>
-using t_obj_ctr = std::list<T>;
+using t_obj_ctr = NodeArray<T>;
 
 template <class T>
-using t_obj_itr = typename std::list<T>::iterator;
+using t_obj_itr = typename NodeArray<T>::iterator;
 
 // Enums
 
@@ -149,6 +151,8 @@ typedef enum class ConstantNumeric
 	A_STAR_GREED_VALUE,
 	A_STAR_DIJKSTRA_VALUE,
 	PATH_COUNT,
+	// Microseconds of entity decisions per tick
+	AI_TICK_BUDGET,
 	COUNT
 } t_constnum;
 
@@ -174,6 +178,8 @@ static const std::unordered_map<std::string, int>
 			 (int)ConstantNumeric::A_STAR_DIJKSTRA_VALUE},
 			{"PATH_COUNT",
 			 (int)ConstantNumeric::PATH_COUNT},
+			{"AI_TICK_BUDGET",
+			 (int)ConstantNumeric::AI_TICK_BUDGET},
 
 			{"MAX_NETWORK_RADIUS",
 			 (int)ConstantFloating::MAX_NETWORK_RADIUS},
@@ -17,6 +17,7 @@
 
 #include "globals.hpp"
 #include "class/logger.hpp"
+#include "class/profiler.hpp"
 
 #ifdef __GNUC__
 
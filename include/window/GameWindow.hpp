@@ -4,6 +4,9 @@
 #include <SFML/Graphics.hpp>
 #include <nlohmann/json_fwd.hpp>
 
+#include <chrono>
+#include <string>
+
 class WindowManager;
 
 
@@ -26,6 +29,18 @@ struct GameWindow
 	int frameCount = 0;
 	float fps = -1.0f;
 	float time = 0.0f;
+	// How far the frame is between the last two updates, set before render
+	float alpha = 1.0f;
+	// Ticks run every frame in turbo, 0 runs them in real time
+	size_t turbo = 0;
+	// Ticks simulated in a second of the wall clock, measured by run_ticks
+	float tickRate = 0.0f;
+	// The real time ticks may cut their work by the wall clock instead of
+	// doing a fixed amount, set by "--ai-time-budget", never in run_ticks
+	bool timeBudget = false;
+	// False for the ticks nobody sees, widgets are only refreshed by
+	// the last tick before a frame is drawn
+	bool refreshGui = true;
 
 	sf::Vector2i mousePos = { -1, -1 };
 	bool mousePressed = false;
@@ -54,9 +69,36 @@ struct GameWindow
 	virtual void
 		update(float delta) {}
 
+	// Runs "ticks" updates of "step" seconds as fast as possible without
+	// drawing, only the last one refreshes the widgets
+	void run_ticks(size_t ticks, float step)
+	{
+		if (!ticks)
+			return;
+		const auto start = std::chrono::steady_clock::now();
+		const bool budget = timeBudget;
+		timeBudget = false;
+		for (size_t i = 0; i < ticks; ++i)
+		{
+			refreshGui = i + 1 == ticks;
+			update(step);
+		}
+		refreshGui = true;
+		timeBudget = budget;
+
+		const float seconds = std::chrono::duration<float>(
+			std::chrono::steady_clock::now() - start).count();
+		if (seconds > 0.0f)
+			tickRate = (float)ticks / seconds;
+	}
+
 	virtual void
 		close() { }
 
+	// Writes the game into the saves, for the runs without a window
+	virtual bool
+		save_game(const std::wstring& fileName) { return false; }
+
 	virtual void render() {}
 
 	virtual void mouse_pressed(const sf::Vector2i& mousePos) {}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <climits>
+#include <functional>
+#include <vector>
+
+#include "TGUI/TGUI.hpp"
+
+// The content of an info window, built once and updated in place.
+// Every row binds a label, and maybe a progress bar, to getters. A
+// refresh calls the getters and only touches the widgets whose values
+// changed. The rows are rebuilt only when the shape of the panel
+// changes, told by a key of the shown sections.
+struct InfoPanel
+{
+	typedef std::function<tgui::String()> t_text;
+	typedef std::function<void(int &value, int &max)> t_progress;
+
+	struct Row
+	{
+		tgui::Label::Ptr label;
+		tgui::ProgressBar::Ptr bar;
+		t_text text;
+		t_progress progress;
+		// Last values written to the widgets
+		tgui::String lastText;
+		int lastValue = INT_MIN;
+		int lastMax = INT_MIN;
+	};
+
+	tgui::ChildWindow::Ptr window;
+	tgui::VerticalLayout::Ptr layout;
+	std::vector<Row> rows;
+	// Sections of the current rows, -1 before the first build
+	long long key = -1;
+	// Waiting for the refresh of this frame
+	bool dirty = false;
+
+	InfoPanel() {}
+
+	InfoPanel(tgui::ChildWindow::Ptr window, tgui::VerticalLayout::Ptr layout);
+
+	// Clears the rows if the key changed, returns if they must be added
+	bool reshape(long long key);
+
+	void add_line();
+
+	// A label that isn't inside the layout
+	void bind(tgui::Label::Ptr label, t_text text);
+
+	void add_text(t_text text);
+
+	void add_progress(t_text text, t_progress progress);
+
+	// Returns how many widgets changed
+	size_t refresh();
+};
@@ -0,0 +1,298 @@
+#include "file/asset_loader.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+// Header of every cache file
+static const uint32_t CACHE_MAGIC = 0x31434749; // "IGC1"
+
+struct CacheHeader
+{
+	uint32_t magic = CACHE_MAGIC;
+	uint32_t size = 0u;
+	uint64_t hash = 0u;
+};
+
+// Returns the payload if the file exists and was made from "hash"
+static bool cache_read(const std::string &path, uint64_t hash, std::string &payload)
+{
+	std::string data;
+	if (!AssetLoader::read_file(path, data) || data.size() < sizeof(CacheHeader))
+		return false;
+
+	CacheHeader header;
+	memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != CACHE_MAGIC ||
+		header.hash != hash ||
+		header.size != data.size() - sizeof(header))
+		return false;
+
+	payload.assign(data, sizeof(header), std::string::npos);
+	return true;
+}
+
+// Written to a temporary file first, so a crash never leaves half a file
+static void cache_write(const std::string &path, uint64_t hash, const std::string &payload)
+{
+	CacheHeader header;
+	header.hash = hash;
+	header.size = (uint32_t)payload.size();
+
+	const std::string tmp = path + ".tmp";
+	{
+		std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return;
+		file.write((const char *)&header, sizeof(header));
+		file.write(payload.data(), payload.size());
+		if (!file)
+			return;
+	}
+	std::error_code ec;
+	std::filesystem::rename(tmp, path, ec);
+}
+
+AssetLoader::AssetLoader(size_t threads)
+	: m_pool(threads)
+{
+}
+
+uint64_t AssetLoader::hash_bytes(const char *data, size_t size)
+{
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= (uint8_t)data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+bool AssetLoader::read_file(const std::string &path, std::string &out)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+	const std::streamsize size = file.tellg();
+	if (size < 0)
+		return false;
+	out.resize((size_t)size);
+	file.seekg(0);
+	return (bool)file.read(&out[0], size);
+}
+
+std::string AssetLoader::cache_file(const std::string &dir, const std::string &name) const
+{
+	std::string file = name;
+	for (char &c : file)
+	{
+		if (c == '/' || c == '\\' || c == ':')
+			c = '_';
+	}
+	return cachePath + "/" + dir + "/" + file + ".bin";
+}
+
+bool AssetLoader::load_json(
+	std::map<std::string, nlohmann::json> &out,
+	const std::map<std::string, std::string> &files)
+{
+	if (useCache)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(cachePath + "/json", ec);
+	}
+
+	std::map<std::string, JsonJob> jobs;
+	for (const auto &pair : files)
+		jobs[pair.first].path = pair.second;
+
+	std::vector<size_t> tasks;
+	for (auto &pair : jobs)
+	{
+		JsonJob *job = &pair.second;
+		tasks.push_back(m_pool.add([this, job]() { run_json(*job); }));
+	}
+	for (size_t task : tasks)
+		m_pool.wait(task);
+
+	bool success = true;
+	for (auto &pair : jobs)
+	{
+		JsonJob &job = pair.second;
+		if (!job.error.empty())
+		{
+			LOG_ERROR("%s", job.error.c_str());
+			success = false;
+			continue;
+		}
+		if (job.cached)
+			++cacheHits;
+		else
+			++cacheMisses;
+		LOG("%s parsed succesfully%s", job.path.c_str(), job.cached ? " (cached)" : "");
+		out[pair.first] = std::move(job.json);
+	}
+	return success;
+}
+
+void AssetLoader::run_json(JsonJob &job) const
+{
+	std::string text;
+	if (!read_file(job.path, text))
+	{
+		job.error = job.path + " not found";
+		return;
+	}
+
+	const uint64_t hash = hash_bytes(text.data(), text.size());
+	const std::string cache = cache_file("json", job.path);
+	std::string payload;
+	if (useCache && cache_read(cache, hash, payload))
+	{
+		job.json = nlohmann::json::from_cbor(payload, true, false);
+		if (!job.json.is_discarded())
+		{
+			job.cached = true;
+			return;
+		}
+	}
+
+	try
+	{
+		job.json = nlohmann::json::parse(text, nullptr, true, true);
+	}
+	catch (nlohmann::detail::parse_error &e)
+	{
+		job.error = job.path + " parsing error " + e.what();
+		return;
+	}
+
+	if (job.json.is_discarded())
+	{
+		job.error = job.path + " parse error";
+		return;
+	}
+
+	if (useCache)
+	{
+		const std::vector<uint8_t> cbor = nlohmann::json::to_cbor(job.json);
+		cache_write(cache, hash, std::string(cbor.begin(), cbor.end()));
+	}
+}
+
+void AssetLoader::begin_textures(
+	const AssetManager &assets,
+	const std::vector<TextureRequest> &requests)
+{
+	if (useCache)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(cachePath + "/textures", ec);
+	}
+
+	for (const TextureRequest &request : requests)
+	{
+		m_textures.emplace_back(new TextureJob{});
+		TextureJob *job = m_textures.back().get();
+		job->request = request;
+		job->path = assets.texture_path(request.name.c_str());
+		m_textureTasks.push_back(m_pool.add([this, job]() { run_texture(*job); }));
+	}
+}
+
+size_t AssetLoader::finish_textures(AssetManager &assets)
+{
+	size_t loaded = 0u;
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		m_pool.wait(m_textureTasks[i]);
+		TextureJob &job = *m_textures[i];
+		if (!job.error.empty())
+		{
+			LOG_ERROR("%s", job.error.c_str());
+			assets.add_missing_texture(
+				job.request.name.c_str(),
+				job.request.count,
+				job.request.divisions);
+			continue;
+		}
+		if (job.cached)
+			++cacheHits;
+		else
+			++cacheMisses;
+
+		if (assets.add_texture(
+				job.request.name.c_str(),
+				job.image,
+				std::move(job.alphaGrid),
+				job.request.count,
+				job.request.divisions) != -1)
+			++loaded;
+
+		// The pixels are on the GPU now
+		job.image = sf::Image();
+	}
+	m_textures.clear();
+	m_textureTasks.clear();
+	return loaded;
+}
+
+void AssetLoader::run_texture(TextureJob &job) const
+{
+	std::string file;
+	if (!read_file(job.path, file))
+	{
+		job.error = "Can't load image \"" + job.path + "\"";
+		return;
+	}
+
+	// Payload: width, height, RGBA pixels, alpha grid bits
+	const uint64_t hash = hash_bytes(file.data(), file.size());
+	const std::string cache = cache_file("textures", job.request.name);
+	std::string payload;
+	if (useCache && cache_read(cache, hash, payload) && payload.size() >= 8u)
+	{
+		uint32_t w, h;
+		memcpy(&w, payload.data(), 4u);
+		memcpy(&h, payload.data() + 4u, 4u);
+		const size_t pixels = (size_t)w * h * 4u;
+		if (payload.size() >= 8u + pixels &&
+			job.alphaGrid.loadFromBits(
+				(const sf::Uint8 *)payload.data() + 8u + pixels,
+				payload.size() - 8u - pixels,
+				w, h))
+		{
+			job.image.create(w, h, (const sf::Uint8 *)payload.data() + 8u);
+			job.cached = true;
+			return;
+		}
+	}
+
+	if (!job.image.loadFromMemory(file.data(), file.size()))
+	{
+		job.error = "Can't load image \"" + job.path + "\"";
+		return;
+	}
+
+	const sf::Vector2u size = job.image.getSize();
+	job.alphaGrid.loadFromPixels(job.image.getPixelsPtr(), size.x, size.y);
+
+	if (useCache)
+	{
+		std::vector<sf::Uint8> bits;
+		job.alphaGrid.toBits(bits);
+
+		const size_t pixels = (size_t)size.x * size.y * 4u;
+		payload.resize(8u + pixels + bits.size());
+		memcpy(&payload[0], &size.x, 4u);
+		memcpy(&payload[4], &size.y, 4u);
+		if (pixels)
+			memcpy(&payload[8], job.image.getPixelsPtr(), pixels);
+		if (!bits.empty())
+			memcpy(&payload[8 + pixels], bits.data(), bits.size());
+		cache_write(cache, hash, payload);
+	}
+}
@@ -166,8 +166,7 @@ _UNUSED void printBuildQuadTree(ChunkQuadTree<Tile*>::Node* tree)
 	{
 		T::printPtrPoint("", point);
 		printf("Point %d %d\n", point.pos.x, point.pos.y);
-		BuildingBody* b = point.type->building;
-		printf("Build type %d in %d %d\n", (int)b->base->buildType, b->tilePos.x, b->tilePos.y);
+		printf("Building slot %d\n", (int)point.type->building);
 	}
 
 	for (T::Node* node : tree->next)
@@ -226,9 +225,6 @@ bool WindowGameplay::init_window(sf::RenderWindow* window, sf::View* view)
 	REGISTER(
 		SERIALIZABLE_DATA,
 		GameData);
-	REGISTER(
-		SERIALIZABLE_BULLET,
-		BulletBody);
 	REGISTER(
 		SERIALIZABLE_CONSTRUCTION,
 		Constructions);
@@ -292,13 +288,64 @@ bool WindowGameplay::load()
 	const size_t FILES_NAMES_COUNT = sizeof(FILES_NAMES) / sizeof(*FILES_NAMES);
 	std::map< std::string, nlohmann::json> jsonMap;
 
+	// Parsing and decoding run on the loader's threads
+	const t_seconds loadStart = GameData::get_real_time();
+	AssetLoader loader;
+
+	std::map<std::string, std::string> jsonFiles;
 	for (size_t i = 0u; i < FILES_NAMES_COUNT; ++i)
 	{
 		std::string path;
 		path = std::string("assets/json/") + FILES_NAMES[i] + ".json";
-		if (!json_file_load(jsonMap[FILES_NAMES[i]], path))
-			return false;
+		jsonFiles[FILES_NAMES[i]] = path;
 	}
+	if (!loader.load_json(jsonMap, jsonFiles))
+		return false;
+
+	// Texture data, decoded while the rest of the json is read
+	std::vector<AssetLoader::TextureRequest> textureRequests;
+	for (auto& texInfo : jsonMap["textures"]["textures"])
+	{
+		if (!texInfo.contains("name"))
+			continue;
+
+		IVec count = { 1, 1 };
+		IVec divisions = { 1, 1 };
+		if (texInfo.contains("count"))
+		{
+			auto nums = str_split(texInfo["count"], ",");
+			if (nums.size() >= 2)
+				count = {
+					str_to_int(nums[0]),
+					str_to_int(nums[1]) };
+		}
+		if (texInfo.contains("divisions"))
+		{
+			auto nums = str_split(texInfo["divisions"], ",");
+			if (nums.size() >= 2)
+				divisions = {
+					str_to_int(nums[0]),
+					str_to_int(nums[1]) };
+		}
+		else
+		{
+			divisions = count;
+		}
+
+		try
+		{
+			AssetLoader::TextureRequest request;
+			request.name = texInfo["name"].get<std::string>();
+			request.count = count;
+			request.divisions = divisions;
+			textureRequests.push_back(request);
+		}
+		catch (nlohmann::detail::type_error& e)
+		{
+			WARNING("Can't load texture because of a json parsing error: %s", e.what());
+		}
+	}
+	loader.begin_textures(assets, textureRequests);
 
 	try
 	{
@@ -381,45 +428,8 @@ bool WindowGameplay::load()
 	// Generate null/missing texture
 	assets.generate_null_texture();
 
-	// Load texture data
-	for (auto& texInfo : jsonMap["textures"]["textures"])
-	{
-		if (!texInfo.contains("name"))
-			continue;
-
-		IVec count = { 1, 1 };
-		IVec divisions = { 1, 1 };
-		if (texInfo.contains("count"))
-		{
-			auto nums = str_split(texInfo["count"], ",");
-			if (nums.size() >= 2)
-				count = {
-					str_to_int(nums[0]),
-					str_to_int(nums[1]) };
-		}
-		if (texInfo.contains("divisions"))
-		{
-			auto nums = str_split(texInfo["divisions"], ",");
-			if (nums.size() >= 2)
-				divisions = {
-					str_to_int(nums[0]),
-					str_to_int(nums[1]) };
-		}
-		else
-		{
-			divisions = count;
-		}
-
-		try
-		{
-			std::string name = texInfo["name"].get<std::string>();
-			assets.load_texture(name.c_str(), count, divisions);
-		}
-		catch (nlohmann::detail::type_error& e)
-		{
-			WARNING("Can't load texture because of a json parsing error: %s", e.what());
-		}
-	}
+	// Upload the textures in order, as they're decoded
+	loader.finish_textures(assets);
 	LOG("Successfuply load textures");
 
 	std::map<std::string, size_t> mapSerTree;
@@ -480,6 +490,11 @@ bool WindowGameplay::load()
 	}
 	LOG("Successfuply load bullets");
 
+	LOG("Assets loaded in %.3f seconds, %zu from cache, %zu parsed",
+		GameData::get_real_time() - loadStart,
+		loader.cacheHits,
+		loader.cacheMisses);
+
 	//for (auto& x : data.bodyConfigMap.at(ENUM_BULLET_TYPE))
 	//{
 	//	DEBUG("%s", x.second.at(0)->to_string().c_str());
@@ -536,6 +551,14 @@ bool WindowGameplay::init()
 
 	LOG("\tInit start");
 
+	// Info panels point to their building or entity
+	data.beforeDeleteBuilding = [this](BuildingBase* b) {
+		close_build_info(b);
+		};
+	data.beforeDeleteEntity = [this](EntityBody* e) {
+		close_entity_info(e);
+		};
+
 	text.setFont(font);
 	text.setCharacterSize(16);
 	text.setFillColor(sf::Color::Black);
@@ -822,7 +845,15 @@ bool WindowGameplay::init()
 	static const int TEST_BULLETS = 10;
 	static const int TEST_MASS_PATHFIND = 11;
 	static const int TEST_SHOOTING = 12;
-	static const int TESTS_COUNT = 13;
+	static const int TEST_BULLET_POOL = 13;
+	static const int TEST_WORLD_SNAPSHOT = 14;
+	static const int TEST_KNN_BENCHMARK = 15;
+	static const int TEST_CROWD_BENCHMARK = 16;
+	static const int TEST_WORLDGEN = 17;
+	static const int TEST_PAGING = 18;
+	static const int TEST_TREES_BENCHMARK = 19;
+	static const int TEST_FIXED_STEP = 20;
+	static const int TESTS_COUNT = 21;
 
 
 	int selected = TEST_SHOOTING;
@@ -946,6 +977,7 @@ bool WindowGameplay::init()
 						{ (t_group)ENUM_CITIZEN_JOB ,(t_id)CitizenJob::TEST01});
 					b->entityLimit = 1;
 					b->actionTimer->set_length(0.01f);
+					b->timers_schedule();
 
 					focus_on((sf::Vector2f)b->get_center_pos());
 				}
@@ -1017,7 +1049,6 @@ bool WindowGameplay::init()
 				false);
 		}
 
-		BulletBody* bb;
 		BulletStats* bulletStat =
 			data.get_generic_stats<BulletStats>(
 				ENUM_BULLET_TYPE,
@@ -1028,15 +1059,523 @@ bool WindowGameplay::init()
 				int x = (i % 5);
 				int y = (i / 5);
 				if (1 <= x && x < 5 && 1 <= y && y < 5) continue;
-				bb = dynamic_cast<BulletBody*>(data.add_game_body(
-					SERIALIZABLE_BULLET,
+				data.add_bullet(
+					{ 6.5f + (float)x, 6.5f + (float)y },
+					{ 0.f, 0.f },
 					bulletStat,
-					{ 6.5f + (float)x, 6.5f + (float)y }));
+					bulletStat->alignment);
+			}
+
+		focus_on({ 8, 8 });
+		};
+
+	tests[TEST_BULLET_POOL] = [this, &generateChunks]() {
+		generateChunks(3);
+
+		// A ring of enemy walls for the bullets to hit
+		UpgradeTree* ut = dynamic_cast<UpgradeTree*>(
+			data.bodyConfigMap.at(ENUM_BUILDING_TYPE, (t_id)BuildingType::WALL)[0]);
+		ut->alignment = ALIGNMENT_ENEMY;
+		for (int i = -6; i <= 6; i++)
+		{
+			data.add_building(IVec{ 8 + i, 2 }, ut, false);
+			data.add_building(IVec{ 8 + i, 14 }, ut, false);
+			data.add_building(IVec{ 2, 8 + i }, ut, false);
+			data.add_building(IVec{ 14, 8 + i }, ut, false);
+		}
+
+		BulletStats* bulletStat =
+			data.get_generic_stats<BulletStats>(
+				ENUM_BULLET_TYPE,
+				(t_id)BulletType::ENEMY_BULLET_01);
+		assert(bulletStat);
+
+		// Find how many shots per second are sustained while
+		// the bullets of a tick stay inside the budget.
+		// Measured on a bigger pool so the capacity isn't the limit.
+		const float TICK = 1.f / 60.f;
+		const t_seconds BUDGET = 0.002f;
+		const int TICKS = 120;
+
+		BulletPool pool(&data, BulletPool::CAPACITY * 32u);
+		std::swap(data.bulletPool, pool);
+
+		size_t shots = 64u;
+		size_t sustained = 0u;
+		while (true)
+		{
+			data.bulletPool.clear();
+			t_seconds total = 0.f;
+			for (int t = 0; t < TICKS; ++t)
+			{
+				const t_seconds start = GameData::get_real_time();
+				for (size_t s = 0; s < shots; ++s)
+				{
+					const float angle = (float)M_2PI * (float)s / (float)shots;
+					data.add_bullet(
+						{ 8.5f, 8.5f },
+						{ cosf(angle), sinf(angle) },
+						bulletStat,
+						ALIGNMENT_FRIENDLY);
+				}
+				data.update_bullets(TICK);
+				total += GameData::get_real_time() - start;
+			}
+
+			const t_seconds average = total / (t_seconds)TICKS;
+			LOG("Bullet pool: %zu shots per tick, %.3f ms per tick, %zu alive, %zu dropped",
+				shots,
+				average * 1000.f,
+				data.bulletPool.size(),
+				data.bulletPool.dropped);
+			if (average > BUDGET || data.bulletPool.dropped)
+				break;
+			sustained = (size_t)((float)shots / TICK);
+			shots *= 2u;
+		}
+		LOG("Bullet pool sustains %zu shots per second in %.1f ms per tick",
+			sustained,
+			BUDGET * 1000.f);
+
+		std::swap(data.bulletPool, pool);
+		focus_on({ 8, 8 });
+		};
+
+	tests[TEST_WORLD_SNAPSHOT] = [this, &generateChunks]() {
+		generateChunks(2);
+
+		// Stress test, readers query the snapshots on their own threads
+		// while this thread keeps changing the trees and publishing
+		const int READERS = 4;
+		const int PUBLISHES = 2000;
+		const int AREA = 16;
+
+		std::atomic_bool done = false;
+		std::atomic_size_t queries = 0u;
+		std::atomic_size_t errors = 0u;
+
+		std::vector<std::thread> readers;
+		for (int r = 0; r < READERS; ++r)
+		{
+			readers.emplace_back([this, r, AREA, &done, &queries, &errors]() {
+				long lastFrame = 0;
+				size_t i = (size_t)r;
+				while (!done)
+				{
+					auto snapshot = data.read_world_snapshot();
+					if (!snapshot)
+						continue;
+					if (snapshot->frame < lastFrame)
+						++errors;
+					lastFrame = snapshot->frame;
+
+					const FVec pos{ (float)(i * 7 % AREA), (float)(i * 13 % AREA) };
+					++i;
+					const std::vector<GameBody *> nearest =
+						snapshot->nearest_bodies(pos, 8u);
+
+					// Must be ordered and inside the tree that was pinned
+					const t_tilesnapshot *tree = snapshot->get_tree(
+						{ ENUM_BODY_TYPE, (t_id)BodyType::BUILDING });
+					if (nearest.size() > 8u || (tree && nearest.size() > tree->size()))
+						++errors;
+					++queries;
+				}
+			});
+		}
+
+		for (int i = 0; i < PUBLISHES; ++i)
+		{
+			const IVec tilePos{ i * 7 % AREA, i * 11 % AREA };
+			if (chunks.get_build(tilePos.x, tilePos.y))
+				data.delete_building(tilePos);
+			else
+				data.add_building(tilePos, BuildingType::WALL, false);
+			++data.frameCount;
+			data.publish_world_snapshot();
+		}
+
+		done = true;
+		for (std::thread &reader : readers)
+			reader.join();
+		data.worldSnapshots.collect();
+
+		LOG("World snapshot: %d publishes, %zu queries, %zu still retired, %zu errors",
+			PUBLISHES,
+			(size_t)queries,
+			data.worldSnapshots.retired(),
+			(size_t)errors);
+		ASSERT_ERROR(errors == 0u, "World snapshot readers saw an invalid snapshot.");
+
+		focus_on({ 8, 8 });
+		};
+
+	tests[TEST_KNN_BENCHMARK] = [this, &generateChunks]() {
+		generateChunks(1);
+
+		// Compares the best first search of the quad tree against a
+		// comparator (which can't prune) and checks both by brute force
+		typedef ChunkQuadTree<size_t> t_tree;
+		const int QUERIES = 2000;
+		const int CHECKED = 50;
+		const size_t COUNTS[] = { 10000u, 30000u, 100000u };
+		const size_t LIMITS[] = { 1u, 8u, 64u };
+
+		const auto comparator = [](
+			const IVec &center,
+			const IVec &a,
+			const size_t,
+			const IVec &b,
+			const size_t) {
+			return vec_distsq(center, a) < vec_distsq(center, b);
+		};
+
+		srand(1);
+		size_t errors = 0u;
+		for (size_t count : COUNTS)
+		{
+			// A quarter of the tiles are taken
+			const int side = (int)sqrtf((float)count) * 2;
+			t_tree tree;
+			std::vector<IVec> points;
+			while (points.size() < count)
+			{
+				const IVec pos{ rand() % side - side / 2, rand() % side - side / 2 };
+				if (tree.insert(pos, points.size()))
+					points.push_back(pos);
 			}
 
+			std::vector<IVec> queries(QUERIES);
+			for (IVec &q : queries)
+				q = { rand() % side - side / 2, rand() % side - side / 2 };
+
+			for (size_t limit : LIMITS)
+			{
+				std::vector<t_tree::Point *> result;
+				t_seconds start = GameData::get_real_time();
+				for (const IVec &q : queries)
+				{
+					result.clear();
+					tree.k_nearest(result, q, limit);
+				}
+				const t_seconds bestFirst = GameData::get_real_time() - start;
+
+				start = GameData::get_real_time();
+				for (int i = 0; i < QUERIES / 20; ++i)
+				{
+					result.clear();
+					tree.k_nearest_rec(result, queries[i], limit, t_tree::MAX_FLOAT,
+						t_tree::DEFAULT_CONDITION, comparator);
+				}
+				const t_seconds compared = (GameData::get_real_time() - start) * 20.f;
+
+				NearestBatch<size_t> batch;
+				start = GameData::get_real_time();
+				for (const IVec &q : queries)
+					batch.add(&tree, q, limit);
+				batch.solve();
+				const t_seconds batched = GameData::get_real_time() - start;
+
+				std::vector<int> expected, found;
+				for (int i = 0; i < CHECKED; ++i)
+				{
+					expected.clear();
+					for (const IVec &p : points)
+						expected.push_back(vec_distsq(p, queries[i]));
+					std::sort(expected.begin(), expected.end());
+					expected.resize(limit);
+
+					result.clear();
+					tree.k_nearest(result, queries[i], limit);
+					found.clear();
+					for (t_tree::Point *p : result)
+						found.push_back(vec_distsq(p->pos, queries[i]));
+					if (found != expected)
+						++errors;
+
+					found.clear();
+					for (auto itr = batch.begin(i); itr != batch.end(i); ++itr)
+						found.push_back(vec_distsq(points[*itr], queries[i]));
+					if (found != expected)
+						++errors;
+
+					result.clear();
+					tree.k_nearest_rec(result, queries[i], limit, t_tree::MAX_FLOAT,
+						t_tree::DEFAULT_CONDITION, comparator);
+					found.clear();
+					for (t_tree::Point *p : result)
+						found.push_back(vec_distsq(p->pos, queries[i]));
+					if (found != expected)
+						++errors;
+				}
+
+				LOG("KNN %zu points, k %zu: best first %.2f us, batched %.2f us (%zu groups), comparator %.2f us per query",
+					count,
+					limit,
+					bestFirst * 1e6f / (float)QUERIES,
+					batched * 1e6f / (float)QUERIES,
+					batch.groups,
+					compared * 1e6f / (float)QUERIES);
+			}
+			tree.clear();
+		}
+		ASSERT_ERROR(errors == 0u, "K nearest search doesn't match the brute force.");
+
 		focus_on({ 8, 8 });
 		};
 
+	tests[TEST_CROWD_BENCHMARK] = [this, &generateChunks]() {
+		generateChunks(1);
+
+		// A dense crowd, compares the separation of the crowd pass
+		// against a radius search per entity
+		const int COUNT = 5000;
+		const int SIDE = 24;
+		EntityStats *stats = data.get_entity_stats(
+			ENUM_CITIZEN_JOB,
+			(t_id)CitizenJob::NONE);
+
+		Logger::set_priority(0);
+		srand(1);
+		std::vector<EntityCitizen *> crowd;
+		for (int i = 0; i < COUNT; ++i)
+		{
+			const FVec pos{
+				(float)(rand() % (SIDE * 100)) / 100.f - SIDE / 2.f,
+				(float)(rand() % (SIDE * 100)) / 100.f - SIDE / 2.f };
+			EntityCitizen *e = data.add_entity_citizen(pos, stats);
+			if (e)
+				crowd.push_back(e);
+		}
+		Logger::set_priority(99);
+
+		t_seconds start = GameData::get_real_time();
+		std::vector<int> expected;
+		for (EntityCitizen *e : crowd)
+		{
+			FVec force{ 0.f, 0.f };
+			int counter = 0;
+			for (GameBody *body : data.nearest_bodies_radius(e->pos, e->radius))
+			{
+				if (body->type != BodyType::ENTITY)
+					continue;
+				FVec dif = e->pos - body->pos;
+				float len = vec_normalize(dif);
+				force += dif * (1.f / len);
+				++counter;
+			}
+			expected.push_back(counter);
+		}
+		const t_seconds searched = GameData::get_real_time() - start;
+
+		start = GameData::get_real_time();
+		data.crowd.update();
+		const t_seconds swept = GameData::get_real_time() - start;
+
+		size_t errors = 0u;
+		for (size_t i = 0; i < crowd.size(); ++i)
+		{
+			if (crowd[i]->separationFrame != data.frameCount ||
+				crowd[i]->separationCount != expected[i])
+				++errors;
+		}
+
+		LOG("Crowd of %zu: radius searches %.2f ms, crowd pass %.2f ms (%zu cells)",
+			crowd.size(),
+			searched * 1e3f,
+			swept * 1e3f,
+			data.crowd.cells);
+		ASSERT_ERROR(errors == 0u, "Crowd separation doesn't match the radius search.");
+
+		focus_on({ 0, 0 });
+		};
+
+	tests[TEST_WORLDGEN] = [this]() {
+		// A 9x9 chunks map, generated by the workers and added over the
+		// first ticks, nothing here waits for it
+		const auto start = std::chrono::steady_clock::now();
+		worldGen.request_area({ 0, 0 }, 4);
+		const float requested = std::chrono::duration<float>(
+			std::chrono::steady_clock::now() - start).count();
+		LOG("Requested %zu chunks in %.2f ms",
+			worldGen.pending(),
+			requested * 1e3f);
+
+		focus_on({ 0, 0 });
+		};
+
+	tests[TEST_PAGING] = [this]() {
+		// A 13x13 chunks map, everything further than a chunk from the
+		// camera is paged out and then read back
+		worldGen.request_area({ 0, 0 }, 6);
+		worldGen.wait();
+		worldGen.commit(data, chunks);
+		const size_t generated = chunks.available.size();
+		const size_t resources = data.buildingBases.size();
+
+		pager.settings.keepRadius = 1;
+		pager.settings.margin = 0;
+		pager.settings.evictPerTick = SIZE_MAX;
+		pager.update(data, chunks, { 0, 0 });
+		LOG("Paged out %zu of %zu chunks, %zu bytes written",
+			pager.paged_count(),
+			generated,
+			pager.bytes_written());
+		ASSERT_ERROR(chunks.available.size() + pager.paged_count() == generated,
+			"Paged out chunks are missing.");
+
+		// Negative x, their keys don't split back into the chunk
+		const IVec negative[] = { { -3, 2 }, { -6, -6 }, { -2, 0 }, { -5, 6 } };
+		for (const IVec &chunk : negative)
+			ASSERT_ERROR(pager.paged_out(chunk) && !chunks.get(chunk.x, chunk.y),
+				"A chunk with a negative x wasn't paged out.");
+
+		const auto start = std::chrono::steady_clock::now();
+		pager.restore_all(data, chunks);
+		const float restored = std::chrono::duration<float>(
+			std::chrono::steady_clock::now() - start).count();
+		LOG("Read back in %.2f ms", restored * 1e3f);
+		ASSERT_ERROR(chunks.available.size() == generated &&
+			data.buildingBases.size() == resources,
+			"Paged out chunks weren't read back whole.");
+		for (const IVec &chunk : negative)
+		{
+			const Grid *grid = chunks.get(chunk.x, chunk.y);
+			ASSERT_ERROR(grid && grid->idx == chunk.x && grid->idy == chunk.y,
+				"A chunk with a negative x wasn't read back in it's place.");
+		}
+
+		pager.settings = ChunkPager::Settings{};
+		focus_on({ 0, 0 });
+		};
+
+	tests[TEST_TREES_BENCHMARK] = [this, &generateChunks]() {
+		generateChunks(1);
+
+		// Citizens stepping back and forth, compares moving them with
+		// their cached trees against working the trees out every move
+		const int COUNT = 2000;
+		const int ROUNDS = 50;
+		const int SIDE = 24;
+		EntityStats *stats = data.get_entity_stats(
+			ENUM_CITIZEN_JOB,
+			(t_id)CitizenJob::NONE);
+
+		Logger::set_priority(0);
+		srand(1);
+		std::vector<EntityCitizen *> walkers;
+		for (int i = 0; i < COUNT; ++i)
+		{
+			const FVec pos{
+				(float)(rand() % SIDE - SIDE / 2) + 0.5f,
+				(float)(rand() % SIDE - SIDE / 2) + 0.5f };
+			EntityCitizen *e = data.add_entity_citizen(pos, stats);
+			if (e)
+				walkers.push_back(e);
+		}
+		Logger::set_priority(99);
+
+		const auto walk = [this, &walkers](int round) {
+			const FVec step{ round % 2 ? -1.f : 1.f, 0.f };
+			for (EntityCitizen *e : walkers)
+			{
+				const FVec from = e->pos;
+				e->pos += step;
+				data.move_entity(e, from, e->pos);
+			}
+		};
+
+		t_seconds start = GameData::get_real_time();
+		for (int r = 0; r < ROUNDS; ++r)
+			walk(r);
+		const t_seconds cached = GameData::get_real_time() - start;
+
+		// What every move used to pay before moving in the trees
+		size_t errors = 0u;
+		start = GameData::get_real_time();
+		for (int r = 0; r < ROUNDS; ++r)
+		{
+			for (EntityCitizen *e : walkers)
+			{
+				const BodyTrees trees = data.classify_trees(e);
+				errors += trees.count != e->trees.count;
+			}
+			walk(r);
+		}
+		const t_seconds classified = GameData::get_real_time() - start;
+
+		for (GameBody *body : data.bodies)
+		{
+			if (body->dead)
+				continue;
+			const BodyTrees trees = data.classify_trees(body);
+			if (trees.count != body->trees.count ||
+				!std::equal(trees.begin(), trees.end(), body->trees.begin()))
+				++errors;
+		}
+
+		LOG("%zu walkers, %d moves each: cached trees %.2f ms, classified every move %.2f ms",
+			walkers.size(),
+			ROUNDS,
+			cached * 1e3f,
+			classified * 1e3f);
+		ASSERT_ERROR(errors == 0u, "Cached trees don't match the bodies.");
+
+		focus_on({ 0, 0 });
+		};
+
+	tests[TEST_FIXED_STEP] = [this, &generateChunks]() {
+		// Citizens against enemies for a fixed number of ticks, the same
+		// seed and ticks must log the same checksum on every machine
+		const unsigned SEED = 1;
+		const int TICKS = 600;
+		const float STEP = 1.f / 60.f;
+
+		prng_seed_bytes((const unsigned char*)&SEED, sizeof(SEED));
+		generateChunks(2);
+
+		for (int i = 0; i < 4; ++i)
+			data.add_building({ 2 + i * 2, -1 }, BuildingType::ARMORY, 0);
+		for (int i = 0; i < 20; ++i)
+		{
+			const float x = (float)prng_get_double() * 10.f;
+			const float y = (float)prng_get_double() * 5.f;
+			if (i % 2)
+				data.add_entity_enemy({ x, y + 5.f }, data.get_entity_stats(
+					ENUM_ENEMY_TYPE,
+					(t_id)EnemyType::BRUTE));
+			else
+				data.add_entity_citizen({ x, y }, data.get_entity_stats(
+					ENUM_CITIZEN_JOB,
+					(t_id)CitizenJob::NONE));
+		}
+
+		run_ticks(TICKS, STEP);
+
+		// Doesn't depend on the order of the bodies
+		uint64_t checksum = 0u;
+		for (const GameBody* body : data.bodies)
+		{
+			uint32_t bits[2];
+			memcpy(&bits[0], &body->pos.x, sizeof(float));
+			memcpy(&bits[1], &body->pos.y, sizeof(float));
+			uint64_t h = 0xcbf29ce484222325ull ^
+				((uint64_t)body->objectType << 32 | (uint64_t)body->objectId);
+			h = (h ^ bits[0]) * 0x100000001b3ull;
+			h = (h ^ bits[1]) * 0x100000001b3ull;
+			checksum ^= h;
+		}
+		LOG("%d ticks at %.0f ticks/s, %zu bodies, %zu bullets, game time %.3f, checksum %016llx",
+			TICKS,
+			tickRate,
+			data.bodies.size(),
+			data.bulletPool.active.size(),
+			data.get_time(),
+			(unsigned long long)checksum);
+
+		focus_on({ 0, 0 });
+		};
+
 	tests[TEST_ENEMY] = [this, &generateChunks]() {
 		generateChunks(0);
 
@@ -1079,12 +1618,14 @@ bool WindowGameplay::init()
 		{
 			DEBUG("%d", (int)e->objectId);
 			DEBUG("%s", e->workplace->name);
+			BuildingBase* dest = data.chunks->get_base(
+				e->pathData.destPos.x,
+				e->pathData.destPos.y);
 			DEBUG("%d %s",
 				(int)e->action,
-				e->pathData.destination->building->base->name);
+				dest->name);
 			DEBUG("%d",
-				(int)data.constructions.count(
-					e->pathData.destination->building->base));
+				(int)data.constructions.count(dest));
 			printf("\n");
 		}
 		};
@@ -1131,6 +1672,7 @@ bool WindowGameplay::init()
 					b = data.add_building(p, BuildingType::HOME, false);
 					b->entityLimit = 50;
 					b->actionTimer->set_length(0.1f);
+					b->timers_schedule();
 					break;
 				case 0xFF0000FF:
 					b = data.add_building(p, BuildingType::GENRATOR, false);
@@ -1168,6 +1710,7 @@ bool WindowGameplay::init()
 		b = data.add_building({ 10, 6 }, "HOME", 0);
 		assert(b);
 		b->actionTimer->set_length(0.01f);
+		b->timers_schedule();
 
 		b = data.add_building({ 11, 11 }, BuildingType::RAW_ORE);
 		assert(b);
@@ -1220,16 +1763,33 @@ void WindowGameplay::close()
 
 void WindowGameplay::update(float delta)
 {
+	PROFILE_ZONE("Update");
 	// Todo account add_build
 	bool gridChange = false;
-	t_seconds start = data.get_time();
+	t_seconds start = GameData::get_real_time();
 	static t_seconds max = 0.0f;
 
+	// A tick of "delta" seconds, timers see the same time every run
+	data.advance_time(delta);
+
+	// Drawn between where the bodies were and where the tick moves them
+	for (GameBody* body : data.bodies)
+	{
+		body->prevPos = body->pos;
+		body->hasPrevPos = true;
+	}
+
 	// Remove buildings that are marked for deletion
 	auto& buildings = data.buildingBases;
 
 	
 
+	// Fire every timer that expired since the last tick
+	{
+		PROFILE_ZONE("Scheduler");
+		data.update_scheduler();
+	}
+
 	// Add all building that pending to be added
 	while (data.buildingQueue.size())
 	{
@@ -1237,135 +1797,173 @@ void WindowGameplay::update(float delta)
 		data.buildingQueue.pop_front();
 	}
 
-	
-
-	// Calculate total power
-	data.powerTotal = 0;
-	for (auto& network : data.networks)
+	// Chunks the workers finished since the last tick
 	{
-		network->powerValue =
-			math_min(
-				network->powerStore,
-				network->powerOut);
-		network->storeCount = network->powerValue;
-		data.powerTotal += network->storeCount;
+		PROFILE_ZONE("Chunks");
+		if (worldGen.commit(data, chunks, worldGenChunksPerTick) &&
+			!worldGen.pending())
+		{
+			LOG("World generation done");
+		}
+
+		// Far chunks out of memory, the near ones back in
+		pager.update(data, chunks, vec_pos_to_tile(screen_pos_to_world_pos(
+			(sf::Vector2i)view->getCenter(),
+			renderer.orientation)));
 	}
 
+	
+
 	data.resources = Resources::res_empty(&data.resourceWeights);
-	data.power = 0;
 	auto itr = buildings.begin();
 
-	while (itr != buildings.end())
+	PROFILE_COUNT("Buildings updated", buildings.size());
 	{
-		bool removed = false;
-		BuildingBase* b = (*itr);
-		assert(b);
-		b->update();
-
-		// Calculate power networks power values
-		if (b->props.bool_is(PropertyBool::POWER_NETWORK) &&
-			b->network)
+		PROFILE_ZONE("Buildings");
+		while (itr != buildings.end())
 		{
-			auto& network = *b->network;
-			if (b->powerIn)
+			bool removed = false;
+			BuildingBase* b = (*itr);
+			assert(b);
+			b->update();
+
+			// Update info window
+			if (b->updateInfo && refreshGui)
 			{
-				network.powerValue -= b->powerIn;
-				b->sufficient = network.powerValue >= 0;
+				b->updateInfo = false;
+				if (has_build_info(b))
+				{
+					show_build_info(b, true);
+				}
 			}
 
-			if (b->powerStore)
+			// Calculate all storage
+			if (b->is_any_storage() &&
+				!b->props.bool_is(PropertyBool::HARVESTABLE))
 			{
-				b->powerValue = math_min(
-					network.storeCount,
-					b->powerStore);
-				network.storeCount -= b->powerValue;
-				b->powerValue = math_max(0, b->powerValue);
+				data.resources += b->rStorage;
+			}
 
-				data.power += b->powerValue;
+			// Delete buildings that are flagged to be deleted
+			// Must be last
+			if (b->flagDelete)
+			{
+				itr = data.delete_building(b->tilePos);
+				removed = true;
+				gridChange = true;
 			}
-		}
 
-		// Update info window
-		if (b->updateInfo)
-		{
-			b->updateInfo = false;
-			if (has_build_info(b))
+			if (refreshGui)
 			{
-				show_build_info(b, true);
+				gui_update_resources_tab(UiResources::BODIES, data.resources[Resources::BODIES]);
+				gui_update_resources_tab(UiResources::ORE, data.resources[Resources::ORE]);
+				gui_update_resources_tab(UiResources::GEM, data.resources[Resources::GEMS]);
+				gui_update_resources_tab(UiResources::ELECTRICITY, data.powerTotal);
+				gui_update_resources_tab(UiResources::PEOPLE, (int)data.entityCitizens.size());
 			}
-		}
 
-		// Calculate all storage
-		if (b->is_any_storage() &&
-			!b->props.bool_is(PropertyBool::HARVESTABLE))
-		{
-			data.resources += b->rStorage;
+			// If not removed, go the the next building
+			if (!removed)
+				itr++;
 		}
+	}
 
-		// Delete buildings that are flagged to be deleted
-		// Must be last
-		if (b->flagDelete)
-		{
-			itr = data.delete_building(b->tilePos);
-			removed = true;
-			gridChange = true;
-		}
+	// Solve every power network once per tick
+	{
+		PROFILE_ZONE("Power");
+		data.powerTotal = data.powerGrid.solve(data.power);
+	}
+
+	// Nothing iterates the building lists here
+	data.compact_buildings();
 
-		gui_update_resources_tab(UiResources::BODIES, data.resources[Resources::BODIES]);
-		gui_update_resources_tab(UiResources::ORE, data.resources[Resources::ORE]);
-		gui_update_resources_tab(UiResources::GEM, data.resources[Resources::GEMS]);
-		gui_update_resources_tab(UiResources::ELECTRICITY, data.powerTotal);
-		gui_update_resources_tab(UiResources::PEOPLE, (int)data.entityCitizens.size());
 
-		// If not removed, go the the next building
-		if (!removed)
-			itr++;
+	{
+		PROFILE_ZONE("Path changes");
+		data.update_path_changes();
 	}
+	if (refreshGui)
+		update_suggestions();
 
+	data.simulationLod.set_camera(screen_pos_to_world_pos(
+		(sf::Vector2i)view->getCenter(),
+		renderer.orientation));
+	{
+		PROFILE_ZONE("Crowd");
+		data.crowd.update();
+	}
 
 	size_t removedEntities = 0u;
-	for (auto itr = data.bodies.begin(); itr != data.bodies.end(); )
 	{
-		GameBody* body = *itr;
-		assert(body);
-
-		if (body->dead)
+		PROFILE_ZONE("Bodies");
+		for (auto itr = data.bodies.begin(); itr != data.bodies.end(); )
 		{
-			for (auto& x : data.bodyQueue)
-			{
-				if (x.target == body)
-					x.target = nullptr;
-			}
+			GameBody* body = *itr;
+			assert(body);
 
-			if (body->type == BodyType::ENTITY)
+			if (body->dead)
 			{
-				data.delete_entity(dynamic_cast<EntityBody*>(body));
+				for (auto& x : data.bodyQueue)
+				{
+					if (x.target == body)
+						x.target = nullptr;
+				}
+
+				if (body->type == BodyType::ENTITY)
+				{
+					data.delete_entity(dynamic_cast<EntityBody*>(body));
+				}
+				
+				data.delete_game_body_generic(body);
+				itr = data.bodies.erase(itr);
+
+				continue;
 			}
+			else
+				++itr;
 			
-			data.delete_game_body_generic(body);
-			itr = data.bodies.erase(itr);
+			// Distant entities update less often, but their paths see
+			// the barriers of every tick, the changes last one tick
+			float bodyDelta = delta;
+			if (body->type == BodyType::ENTITY &&
+				!data.simulationLod.schedule(dynamic_cast<EntityBody*>(body), bodyDelta))
+			{
+				dynamic_cast<EntityBody*>(body)->update_grid_change();
+				continue;
+			}
 
-			continue;
-		}
-		else
-			++itr;
-		
-		// Movement
-		body->update(delta);
-		
-		if (body->type == BodyType::ENTITY)
-		{
-			EntityBody* entity = dynamic_cast<EntityBody*>(body);
-			if (entity->updateInfo)
+			// Movement
+			body->update(bodyDelta);
+			PROFILE_COUNT("Bodies updated", 1);
+			
+			if (body->type == BodyType::ENTITY)
 			{
-				entity->updateInfo = false;
-				if (has_entity_info(entity))
+				EntityBody* entity = dynamic_cast<EntityBody*>(body);
+				if (entity->updateInfo && refreshGui)
 				{
-					show_entity_info(entity, true);
+					entity->updateInfo = false;
+					if (has_entity_info(entity))
+					{
+						show_entity_info(entity, true);
+					}
 				}
 			}
+			
 		}
-		
+	}
+
+	{
+		PROFILE_ZONE("Bullets");
+		data.update_bullets(delta);
+	}
+	{
+		PROFILE_ZONE("AI");
+		data.aiScheduler.timeBudget = timeBudget;
+		data.aiScheduler.run();
+	}
+	{
+		PROFILE_ZONE("Dispatcher");
+		data.dispatcher.solve();
 	}
 
 	while (!data.entityQueue.empty())
@@ -1384,6 +1982,27 @@ void WindowGameplay::update(float delta)
 		const SpawnInfo& spawn =
 			bodyData.spawn;
 
+		// Bullets go to their pool instead of becoming bodies
+		if (spawn.serializableID == SERIALIZABLE_BULLET)
+		{
+			BulletStats* bulletStats = data.get_generic_stats<BulletStats>(
+				spawn.id.group,
+				spawn.id.id);
+			if (!bulletStats)
+			{
+				WARNING("Bullet config %s was not found.",
+					spawn.id.to_string().c_str());
+				continue;
+			}
+			data.add_bullet(
+				bodyData.pos,
+				bodyData.vel,
+				bulletStats,
+				bodyData.alignment,
+				bodyData.target);
+			continue;
+		}
+
 		bool isEntity = false;
 		// Is the spawn info spawns an entity
 		if (bodyData.spawn.id.group == ENUM_CITIZEN_JOB ||
@@ -1454,10 +2073,19 @@ void WindowGameplay::update(float delta)
 	}
 
 	
+	// Readers on other threads see the world as it's now
+	if (data.publishSnapshots)
+	{
+		PROFILE_ZONE("Snapshot");
+		data.publish_world_snapshot();
+	}
+	data.clear_nearest();
 
-	data.addedTiles.clear();
-	data.removedTiles.clear();
-	float dif = data.get_time() - start;
+	// Info windows marked during the tick
+	if (refreshGui)
+		refresh_info_panels();
+
+	float dif = GameData::get_real_time() - start;
 	max = std::max(dif, max);
 
 	++data.frameCount;
@@ -1465,15 +2093,27 @@ void WindowGameplay::update(float delta)
 
 void WindowGameplay::render()
 {
-	data.depth_sort(renderer.orientation.rotation);
-	renderer.render_grid(&chunks);
+	PROFILE_ZONE("Render");
+	renderer.alpha = alpha;
+	{
+		PROFILE_ZONE("Depth sort");
+		data.depth_sort(renderer.orientation.rotation);
+	}
+	{
+		PROFILE_ZONE("Render grid");
+		renderer.render_grid(&chunks);
+	}
 
 	GameBody* selectedBody = nullptr;
 
-	if ((selectedBody = renderer.render_objects(
-		data.bodies,
-		searchEntity,
-		searchEntityPos)))
+	{
+		PROFILE_ZONE("Render objects");
+		selectedBody = renderer.render_objects(
+			data.bodies,
+			searchEntity,
+			searchEntityPos);
+	}
+	if (selectedBody)
 	{
 		switch (selectedBody->type)
 		{
@@ -1497,6 +2137,8 @@ void WindowGameplay::render()
 		}
 	}
 
+	renderer.render_bullets(data.bulletPool);
+
 	searchEntity = false;
 
 	// If a building aws selected
@@ -1516,11 +2158,27 @@ void WindowGameplay::render()
 	str += '\n';
 	IVec mouseTilePos = screen_pos_to_tile_pos(mousePos, renderer.orientation);
 	str += vec_str(mouseTilePos);
+	str += '\n';
+	str += "AI " + std::to_string(data.aiScheduler.depth) + " queued, " +
+		std::to_string(data.aiScheduler.maxLatency) + " ticks late";
+	str += "\nLOD " +
+		std::to_string(data.simulationLod.counts[SimulationLod::FULL]) + "/" +
+		std::to_string(data.simulationLod.counts[SimulationLod::REDUCED]) + "/" +
+		std::to_string(data.simulationLod.counts[SimulationLod::FAR]);
+	if (turbo)
+		str += "\nTurbo " + std::to_string(turbo) + " ticks a frame, " +
+			std::to_string((int)tickRate) + " ticks/s";
+	if (Profiler::overlay_shown())
+		str += "\n" + Profiler::overlay();
 
 	get_widget<tgui::Label>("LabelFramerate")->setText(
 		str);
 
-	gui.draw();
+	{
+		PROFILE_ZONE("Render GUI");
+		gui.draw();
+		labelBatcher.flush(*window);
+	}
 }
 
 void WindowGameplay::mouse_start(const sf::Vector2i& mousePos)
@@ -1613,7 +2271,7 @@ void WindowGameplay::mouse_pressed(const sf::Vector2i& mousePos)
 	{
 		if (!data.chunks->has_tile(p.x, p.y))
 			break;
-		BuildingBody* body = data.chunks->get_tile(p.x, p.y).building;
+		BuildingBody* body = data.chunks->get_build(p.x, p.y);
 		if (body && !body->base->props.bool_is(PropertyBool::UNREMOVABLE))
 		{
 			if (suggestionBuilds.count(p))
@@ -1638,7 +2296,7 @@ void WindowGameplay::mouse_pressed(const sf::Vector2i& mousePos)
 		break;
 	case GameMode::UPGRADE:
 	{
-		BuildingBody* body = data.chunks->get_tile(p.x, p.y).building;
+		BuildingBody* body = data.chunks->get_build(p.x, p.y);
 		if (body)
 		{
 			this->data.infoBuild = body->base;
@@ -1735,7 +2393,7 @@ void WindowGameplay::mouse_focus(const sf::Vector2i& a, const sf::Vector2i& b)
 			case GameMode::DELETE:
 			{
 				suggestionBuilds.insert(sf::Vector2i{ x, y });
-				BuildingBody* body = data.chunks->get_tile(x, y).building;
+				BuildingBody* body = data.chunks->get_build(x, y);
 				if (!body)
 					continue;
 
@@ -1751,9 +2409,8 @@ void WindowGameplay::mouse_focus(const sf::Vector2i& a, const sf::Vector2i& b)
 			case GameMode::UPGRADE:
 			{
 				// Get body
-				BuildingBody* body = data.chunks->get_tile(
-					pos.x, pos.y)
-					.building;
+				BuildingBody* body = data.chunks->get_build(
+					pos.x, pos.y);
 				// If there is no body
 				if (!body)
 				{
@@ -1797,14 +2454,12 @@ void WindowGameplay::mouse_focus_end(const sf::Vector2i& a, const sf::Vector2i&
 
 void WindowGameplay::on_focus()
 {
-	data.timerManager.stop_all(
-		data.get_time());
+	data.time_pause();
 }
 
 void WindowGameplay::on_unfocus()
 {
-	data.timerManager.resume_all(
-		data.get_time());
+	data.time_resume();
 }
 
 std::map<int, std::wstring> WindowGameplay::list_saved_games()
@@ -1971,7 +2626,10 @@ bool WindowGameplay::file_delete(const std::wstring& fileName)
 
 bool WindowGameplay::jsonpack_to_game(const t_jsonpack& jsonPack)
 {
+	PROFILE_ZONE("Load");
+	close_info_panels();
 	this->data.clean_world();
+	pager.reset();
 	data.variantFactory.list_types();
 
 	auto jsonToVariants = [](
@@ -2087,10 +2745,19 @@ bool WindowGameplay::jsonpack_to_game(const t_jsonpack& jsonPack)
 	return true;
 }
 
+bool WindowGameplay::save_game(const std::wstring& fileName)
+{
+	return file_write_jsonpack(fileName, jsonpack_from_game(), false);
+}
+
 t_jsonpack WindowGameplay::jsonpack_from_game()
 {
+	PROFILE_ZONE("Save");
 	t_jsonpack out{};
 
+	// Saves hold the whole world
+	pager.restore_all(data, chunks);
+
 	const bool COMPRESSED = false;
 
 	json
@@ -2204,6 +2871,7 @@ void WindowGameplay::gui_init_resource_tab()
 		data.ptr = FastLabel::create();
 		data.ptr->setCharSpriteSheet(&charSpriteSheet);
 		data.ptr->renderWindow = window;
+		data.ptr->batcher = &labelBatcher;
 		data.ptr->set(get_widget<tgui::Label>(data.title));
 		data.ptr->setText("Test");
 		gui.add(data.ptr);
@@ -2849,26 +3517,38 @@ void WindowGameplay::filter_suggestions()
 	for (auto itr = suggestionBuilds.begin();
 		itr != suggestionBuilds.end();)
 	{
-		bool skipDelete;
-		if (gameMode == GameMode::BUILD)
-		{
-			skipDelete =
-				data.chunks->get_tile(itr->x, itr->y).building;
-		}
-		else
-		{
-			BuildingBody* body =
-				data.chunks->get_tile(itr->x, itr->y).building;
-			skipDelete = !(body &&
-				!body->base->props.bool_is(PropertyBool::UNREMOVABLE));
-		}
-		if (skipDelete)
+		if (!suggestion_valid(*itr))
 			itr = suggestionBuilds.erase(itr);
 		else
 			++itr;
 	}
 }
 
+bool WindowGameplay::suggestion_valid(const IVec& pos)
+{
+	if (gameMode == GameMode::BUILD)
+		return !data.chunks->get_tile(pos.x, pos.y).has_building();
+
+	BuildingBody* body =
+		data.chunks->get_build(pos.x, pos.y);
+	return body &&
+		!body->base->props.bool_is(PropertyBool::UNREMOVABLE);
+}
+
+void WindowGameplay::update_suggestions()
+{
+	// Only the tiles that changed since the last tick
+	const bool complete = data.worldEvents.read(
+		suggestionCursor,
+		[this](const WorldEvent& e) {
+			auto itr = suggestionBuilds.find(e.tile);
+			if (itr != suggestionBuilds.end() && !suggestion_valid(e.tile))
+				suggestionBuilds.erase(itr);
+		});
+	if (!complete)
+		filter_suggestions();
+}
+
 void WindowGameplay::filter_upgrade_buildings(const IVec& latest)
 {
 	BuildingBody* beginBuild = data.chunks->get_build(
@@ -2912,21 +3592,23 @@ void WindowGameplay::show_build_info(BuildingBase* infoBuild, bool update)
 			guiBInfoPtr.size() * 20,
 			newWindow->getPosition().y);
 
-		guiBInfoWin.insert({ infoBuild->id, newWindow });
+		guiBInfoWin.insert({ infoBuild->id, InfoPanel(
+			newWindow,
+			get_widget<tgui::VerticalLayout>(newWindow, "LayoutBuildInfo")) });
 		guiBInfoPtr.insert({ infoBuild->id, infoBuild });
 
 		get_widget<tgui::Button>(newWindow, "ButtonBuildBack")->onClick(
 			[](
 				WindowGameplay* window,
-				BuildingBase* infoBuild,
+				size_t id,
 				tgui::ChildWindow::Ptr childWindow,
 				tgui::Gui* gui)
 			{
 				childWindow->setVisible(false);
-				window->guiBInfoPtr.erase(infoBuild->id);
-				window->guiBInfoWin.erase(infoBuild->id);
+				window->guiBInfoPtr.erase(id);
+				window->guiBInfoWin.erase(id);
 				gui->remove(childWindow);
-			}, this, infoBuild, newWindow, &gui);
+			}, this, (size_t)infoBuild->id, newWindow, &gui);
 
 		get_widget<tgui::Label>(newWindow, "LabelBuildTitle")->setText(
 			tgui::String(infoBuild->get_format_name())
@@ -2934,244 +3616,182 @@ void WindowGameplay::show_build_info(BuildingBase* infoBuild, bool update)
 	}
 	else
 	{
-		newWindow = guiBInfoWin.at(infoBuild->id);
-		if (!update)
+		InfoPanel& panel = guiBInfoWin.at(infoBuild->id);
+		// Refreshed once at the end of the frame
+		if (update)
 		{
-			newWindow->setVisible(false);
-			guiBInfoPtr.erase(infoBuild->id);
-			guiBInfoWin.erase(infoBuild->id);
-			gui.remove(newWindow);
+			panel.dirty = true;
 			return;
 		}
+		close_build_info(infoBuild);
+		return;
 	}
 
+	refresh_build_info(infoBuild);
+}
 
-	get_widget<tgui::Label>(newWindow, "LabelBuildHp")->setText(
-		tgui::String("HP: ") + tgui::String::fromNumber(infoBuild->hp)
-	);
-
-	tgui::VerticalLayout::Ptr layout;
-	layout =
-		get_widget<tgui::VerticalLayout>(newWindow, "LayoutBuildInfo");
-
-	layout->removeAllWidgets();
-
-	auto makeLine = []()
-		{
-			tgui::Panel::Ptr panel;
-			panel = tgui::Panel::create();
-
-			tgui::SeparatorLine::Ptr lineSep;
-			lineSep = tgui::SeparatorLine::create();
-			lineSep->setPosition("10%, 50%");
-			lineSep->setSize({ "80%", "5" });
-			lineSep->setWidgetName("coolLine");
+void WindowGameplay::close_build_info(BuildingBase* infoBuild)
+{
+	auto itr = guiBInfoWin.find(infoBuild->id);
+	if (itr == guiBInfoWin.end())
+		return;
+	tgui::ChildWindow::Ptr window = itr->second.window;
+	window->setVisible(false);
+	guiBInfoPtr.erase(infoBuild->id);
+	guiBInfoWin.erase(itr);
+	gui.remove(window);
+}
 
-			panel->add(lineSep);
-			panel->getRenderer()->setBackgroundColor(tgui::Color::Transparent);
+void WindowGameplay::refresh_build_info(BuildingBase* infoBuild)
+{
+	InfoPanel& panel = guiBInfoWin.at(infoBuild->id);
+
+	// The sections shown, the rows are added again only if they change
+	const bool storage =
+		infoBuild->weightCap != NULL_INT || !infoBuild->rStoreCap.empty();
+	const bool workplace = infoBuild->props.bool_is(PropertyBool::WORKPLACE);
+	const bool network = (bool)infoBuild->network;
+	const long long key =
+		(long long)storage |
+		(long long)workplace << 1 |
+		(long long)!infoBuild->rIn.empty() << 2 |
+		(long long)!infoBuild->rOut.empty() << 3 |
+		(long long)network << 4 |
+		(long long)(network && infoBuild->powerIn > 0) << 5 |
+		(long long)(network && infoBuild->powerOut > 0) << 6 |
+		(long long)(network && infoBuild->powerStore > 0) << 7;
+
+	if (!panel.reshape(key))
+	{
+		panel.refresh();
+		return;
+	}
 
-			return panel;
-		};
+	panel.bind(
+		get_widget<tgui::Label>(panel.window, "LabelBuildHp"),
+		[infoBuild]() {
+			return tgui::String("HP: ") + tgui::String::fromNumber(infoBuild->hp);
+		});
 
-	auto x = makeLine();
-	layout->add(x);
+	panel.add_line();
 
 	// Add how much of the building's storage is full
-	if (infoBuild->weightCap != NULL_INT || !infoBuild->rStoreCap.empty())
+	if (storage)
 	{
-		// Add how many resources in the building
-		tgui::Label::Ptr labelRes = tgui::Label::create();
-		labelRes->setText(
-			"Stored Resources: " +
-			data.resources_to_str(infoBuild->rStorage));
-		layout->add(labelRes);
-
-
-		int max = -1, val = 0;
-		tgui::String weightVal, weightMax;
-		if (infoBuild->weightCap != NULL_INT)
-		{
-			val = infoBuild->rStorage.weight(&data.resourceWeights);
-			max = infoBuild->weightCap;
-		}
-		else if (!infoBuild->rStoreCap.empty())
-		{
+		const auto capacity = [this, infoBuild](int& val, int& max) {
 			val = infoBuild->rStorage.weight(&data.resourceWeights);
-			max = infoBuild->rStoreCap.weight(&data.resourceWeights);
-		}
-
-		if (max != -1)
-		{
-			weightVal = tgui::String::fromNumber(val);
-			weightMax = tgui::String::fromNumber(max);
-
-
-			tgui::HorizontalLayout::Ptr layoutRes;
-			layoutRes = tgui::HorizontalLayout::create();
-
-			tgui::Label::Ptr labelResCapPer = tgui::Label::create();
-			labelResCapPer->setText(
-				"Capacity: " +
-				weightVal +
-				" / " +
-				weightMax);
-
-			tgui::ProgressBar::Ptr pb;
-			pb = tgui::ProgressBar::create();
-			pb->setMinimum(0);
-			pb->setMaximum(max);
-			pb->setValue(val);
+			if (infoBuild->weightCap != NULL_INT)
+				max = infoBuild->weightCap;
+			else
+				max = infoBuild->rStoreCap.weight(&data.resourceWeights);
+		};
 
-			layoutRes->add(labelResCapPer);
-			layoutRes->add(pb);
-			layout->add(layoutRes);
+		// Add how many resources in the building
+		panel.add_text([this, infoBuild]() {
+			return tgui::String(
+				"Stored Resources: " +
+				data.resources_to_str(infoBuild->rStorage));
+		});
+
+		panel.add_progress(
+			[capacity]() {
+				int val = 0, max = 0;
+				capacity(val, max);
+				return "Capacity: " +
+					tgui::String::fromNumber(val) +
+					" / " +
+					tgui::String::fromNumber(max);
+			},
+			capacity);
 
-			layout->add(makeLine());
-		}
+		panel.add_line();
 	}
 
-	if (infoBuild->props.bool_is(PropertyBool::WORKPLACE))
+	if (workplace)
 	{
-
 		std::string strEntityType = "workers";
 		if (infoBuild->props.bool_is(PropertyBool::HOME))
 			strEntityType = "residents";
-		// Add how many resources in the building
-		tgui::Label::Ptr label = tgui::Label::create();
-		label->setText(
-			"Entity " +
-			strEntityType +
-			": " +
-			tgui::String::fromNumber(infoBuild->entities.size()));
-		layout->add(label);
-
-
-		tgui::HorizontalLayout::Ptr layoutRes;
-		layoutRes = tgui::HorizontalLayout::create();
-
-		tgui::Label::Ptr labelResCapPer = tgui::Label::create();
-		labelResCapPer->setText(
-			tgui::String::fromNumber(infoBuild->entities.size()) +
-			" / " +
-			tgui::String::fromNumber(infoBuild->entityLimit));
-
-		tgui::ProgressBar::Ptr pb;
-		pb = tgui::ProgressBar::create();
-		pb->setMinimum(0);
-		pb->setMaximum(infoBuild->entityLimit);
-		pb->setValue((unsigned)infoBuild->entities.size());
-
-		layoutRes->add(labelResCapPer);
-		layoutRes->add(pb);
-		layout->add(layoutRes);
+		panel.add_text([infoBuild, strEntityType]() {
+			return "Entity " +
+				tgui::String(strEntityType) +
+				": " +
+				tgui::String::fromNumber(infoBuild->entities.size());
+		});
+
+		panel.add_progress(
+			[infoBuild]() {
+				return tgui::String::fromNumber(infoBuild->entities.size()) +
+					" / " +
+					tgui::String::fromNumber(infoBuild->entityLimit);
+			},
+			[infoBuild](int& val, int& max) {
+				val = (int)infoBuild->entities.size();
+				max = (int)infoBuild->entityLimit;
+			});
 
-		layout->add(makeLine());
+		panel.add_line();
 	}
 
 	if (!infoBuild->rIn.empty())
 	{
-		// Add how many resources in the building
-		tgui::Label::Ptr label = tgui::Label::create();
-		label->setText(
-			"Resource requirement: " +
-			data.resources_to_str(infoBuild->rIn));
-		layout->add(label);
+		panel.add_text([this, infoBuild]() {
+			return tgui::String(
+				"Resource requirement: " +
+				data.resources_to_str(infoBuild->rIn));
+		});
 
-		layout->add(makeLine());
+		panel.add_line();
 	}
 
 	if (!infoBuild->rOut.empty())
 	{
-		// Add how many resources in the building
-		tgui::Label::Ptr label = tgui::Label::create();
-		label->setText(
-			"Resource output: " +
-			data.resources_to_str(infoBuild->rOut));
-		layout->add(label);
+		panel.add_text([this, infoBuild]() {
+			return tgui::String(
+				"Resource output: " +
+				data.resources_to_str(infoBuild->rOut));
+		});
 
-		layout->add(makeLine());
+		panel.add_line();
 	}
 
-	if (infoBuild->network)
+	if (network)
 	{
 		if (infoBuild->powerIn > 0)
 		{
-			tgui::Label::Ptr label = tgui::Label::create();
-			label->setText(
-				"Power input: " +
-				tgui::String::fromNumber(infoBuild->powerIn));
-			layout->add(label);
+			panel.add_text([infoBuild]() {
+				return "Power input: " +
+					tgui::String::fromNumber(infoBuild->powerIn);
+			});
 		}
 
 		if (infoBuild->powerOut > 0)
 		{
-			tgui::Label::Ptr label = tgui::Label::create();
-			label->setText(
-				"Power output: " +
-				tgui::String::fromNumber(infoBuild->powerOut));
-			layout->add(label);
+			panel.add_text([infoBuild]() {
+				return "Power output: " +
+					tgui::String::fromNumber(infoBuild->powerOut);
+			});
 		}
 
 		if (infoBuild->powerStore > 0)
 		{
-			tgui::HorizontalLayout::Ptr layoutRes;
-			layoutRes = tgui::HorizontalLayout::create();
-
-			tgui::Label::Ptr label = tgui::Label::create();
-			label->setText(
-				"Power stored: " +
-				tgui::String::fromNumber(infoBuild->powerValue) +
-				" / " +
-				tgui::String::fromNumber(infoBuild->powerStore));
-			layout->add(label);
-
-			tgui::ProgressBar::Ptr pb;
-			pb = tgui::ProgressBar::create();
-			pb->setMinimum(0);
-			pb->setMaximum(infoBuild->powerStore);
-			pb->setValue(infoBuild->powerValue);
-
-			layoutRes->add(label);
-			layoutRes->add(pb);
-			layout->add(layoutRes);
+			panel.add_progress(
+				[infoBuild]() {
+					return "Power stored: " +
+						tgui::String::fromNumber(infoBuild->powerValue) +
+						" / " +
+						tgui::String::fromNumber(infoBuild->powerStore);
+				},
+				[infoBuild](int& val, int& max) {
+					val = (int)infoBuild->powerValue;
+					max = (int)infoBuild->powerStore;
+				});
 		}
 
-		layout->add(makeLine());
+		panel.add_line();
 	}
 
-	// todo
-	auto str = infoBuild->to_string();
-	if (infoBuild->buildType ==
-		(t_id)BuildingType::CONSTRUCTION)
-	{
-		assert(0);
-
-		str = "In Construction:";
-		ConstructionData* construct = nullptr;
-		try
-		{
-			construct = &data.constructions.at(infoBuild);
-		}
-		catch (std::out_of_range& e)
-		{
-			LOG_ERROR("Invalid construction building: %s", e.what());
-		}
-
-		if (construct)
-		{
-			int wn = construct->work_needed();
-			str += std::to_string(wn - construct->work_left()) +
-				" : " +
-				std::to_string(wn);
-			str += "\n";
-			str += str_unfold(
-				construct->queueData.step->to_string(&data, false));
-		}
-		else
-		{
-			str += "\nMissing construction data";
-		}
-	}
+	panel.refresh();
 }
 
 bool WindowGameplay::has_entity_info(EntityBody* entity)
@@ -3197,177 +3817,188 @@ void WindowGameplay::show_entity_info(EntityBody* entity, bool update)
 			guiBInfoPtr.size() * 20,
 			newWindow->getPosition().y);
 
-		guiEInfoWin.insert({ entity->objectId, newWindow });
+		guiEInfoWin.insert({ entity->objectId, InfoPanel(
+			newWindow,
+			get_widget<tgui::VerticalLayout>(newWindow, "LayoutEntity")) });
 		guiEInfoPtr.insert({ entity->objectId, entity });
 
 		get_widget<tgui::Button>(newWindow, "ButtonEntityClose")->onClick(
 			[](
 				WindowGameplay* window,
-				EntityBody* entity,
+				size_t id,
 				tgui::ChildWindow::Ptr childWindow,
 				tgui::Gui* gui)
 			{
 				childWindow->setVisible(false);
-				window->guiEInfoPtr.erase(entity->objectId);
-				window->guiEInfoWin.erase(entity->objectId);
+				window->guiEInfoPtr.erase(id);
+				window->guiEInfoWin.erase(id);
 				gui->remove(childWindow);
-			}, this, entity, newWindow, &gui);
+			}, this, (size_t)entity->objectId, newWindow, &gui);
 	}
 	else
 	{
-		newWindow = guiEInfoWin.at(entity->objectId);
-		if (!update)
+		InfoPanel& panel = guiEInfoWin.at(entity->objectId);
+		// Refreshed once at the end of the frame
+		if (update)
 		{
-			newWindow->setVisible(false);
-			gui.remove(newWindow);
-			guiEInfoPtr.erase(entity->objectId);
-			guiEInfoWin.erase(entity->objectId);
+			panel.dirty = true;
 			return;
 		}
+		close_entity_info(entity);
+		return;
 	}
 
-	auto makeLine = []()
-		{
-			tgui::Panel::Ptr panel;
-			panel = tgui::Panel::create();
-
-			tgui::SeparatorLine::Ptr lineSep;
-			lineSep = tgui::SeparatorLine::create();
-			lineSep->setPosition("10%, 50%");
-			lineSep->setSize({ "80%", "5" });
-			lineSep->setWidgetName("coolLine");
+	refresh_entity_info(entity);
+}
 
-			panel->add(lineSep);
-			panel->getRenderer()->setBackgroundColor(tgui::Color::Transparent);
+void WindowGameplay::close_entity_info(EntityBody* entity)
+{
+	auto itr = guiEInfoWin.find(entity->objectId);
+	if (itr == guiEInfoWin.end())
+		return;
+	tgui::ChildWindow::Ptr window = itr->second.window;
+	window->setVisible(false);
+	gui.remove(window);
+	guiEInfoPtr.erase(entity->objectId);
+	guiEInfoWin.erase(itr);
+}
 
-			return panel;
-		};
+void WindowGameplay::refresh_entity_info(EntityBody* entity)
+{
+	InfoPanel& panel = guiEInfoWin.at(entity->objectId);
 
+	EntityCitizen* citizen = nullptr;
 	if (entity->entityType == EntityType::CITIZEN)
-	{
-		EntityCitizen* citizen =
-			dynamic_cast<EntityCitizen*>(entity);
-
-		std::string jobName;
-		jobName = str_lowercase(data.enum_get_str(
-			ENUM_CITIZEN_JOB,
-			(t_id)citizen->job,
-			true));
-		jobName += " - " + std::to_string((int)citizen->objectId);
-
-		get_widget<tgui::Label>(newWindow, "LabelEntityJob")->setText(
-			tgui::String(jobName)
-		);
-
-		tgui::VerticalLayout::Ptr layout;
-		layout =
-			get_widget<tgui::VerticalLayout>(newWindow, "LayoutEntity");
-
-		layout->removeAllWidgets();
+		citizen = dynamic_cast<EntityCitizen*>(entity);
 
-		auto x = makeLine();
-		layout->add(x);
+	// The sections shown, the rows are added again only if they change
+	const bool inventory = citizen &&
+		(citizen->inventorySize != NULL_INT || !citizen->rInventoryCap.empty());
+	const long long key =
+		(long long)(citizen != nullptr) |
+		(long long)inventory << 1;
 
-		{
-			std::string strAction = EntityBodyStr::ACTION_STRS[(size_t)citizen->action];
-			if (strAction.find("#destination") != std::string::npos &&
-				citizen->pathData.valid())
-			{
-				BuildingBase* buildDest =
-					citizen->pathData.destination->get_building();
-				std::string destStr = "";
-				if (buildDest)
-				{
-					destStr += buildDest->get_format_name();
-					destStr += " at position ";
-					destStr += vec_str(buildDest->tilePos);
-					// todo remove magic string
-					str_replace(strAction, "#destination", destStr);
-				}
-				else
-				{
-					destStr += "position ";
-					destStr += vec_str(citizen->pathData.destPos);
-					// todo remove magic string
-					str_replace(strAction, "#destination", destStr);
-				}
-				;
-
-			}
-			tgui::Label::Ptr labelAction = tgui::Label::create();
-			labelAction->setText(
-				strAction);
-			layout->add(labelAction);
-		}
+	if (!panel.reshape(key))
+	{
+		panel.refresh();
+		return;
+	}
 
-		layout->add(makeLine());
+	if (!citizen)
+	{
+		panel.refresh();
+		return;
+	}
 
-		{
-			str_lowercase(data.enum_get_str(
+	panel.bind(
+		get_widget<tgui::Label>(panel.window, "LabelEntityJob"),
+		[this, citizen]() {
+			std::string jobName;
+			jobName = str_lowercase(data.enum_get_str(
 				ENUM_CITIZEN_JOB,
 				(t_id)citizen->job,
 				true));
-		}
+			jobName += " - " + std::to_string((int)citizen->objectId);
+			return tgui::String(jobName);
+		});
 
+	panel.add_line();
 
-		// Add how much of the building's storage is full
-		if (citizen->inventorySize != NULL_INT || !citizen->rInventoryCap.empty())
+	panel.add_text([citizen]() {
+		std::string strAction = EntityBodyStr::ACTION_STRS[(size_t)citizen->action];
+		if (strAction.find("#destination") != std::string::npos &&
+			citizen->pathData.valid())
 		{
-			// Add how many resources in the building
-			tgui::Label::Ptr labelRes = tgui::Label::create();
-			labelRes->setText(
-				"Stored Resources: " +
-				data.resources_to_str(citizen->rInventory));
-			layout->add(labelRes);
-
-
-			int max = -1, val = 0;
-			tgui::String weightVal, weightMax;
-			if (citizen->inventorySize != NULL_INT)
+			BuildingBase* buildDest = citizen->context->chunks->get_base(
+				citizen->pathData.destPos.x,
+				citizen->pathData.destPos.y);
+			std::string destStr = "";
+			if (buildDest)
 			{
-				val = citizen->rInventory.weight(&data.resourceWeights);
-				max = citizen->inventorySize;
+				destStr += buildDest->get_format_name();
+				destStr += " at position ";
+				destStr += vec_str(buildDest->tilePos);
 			}
-			else if (!citizen->rInventoryCap.empty())
+			else
 			{
-				val = citizen->rInventory.weight(&data.resourceWeights);
-				max = citizen->rInventoryCap.weight(&data.resourceWeights);
+				destStr += "position ";
+				destStr += vec_str(citizen->pathData.destPos);
 			}
+			// todo remove magic string
+			str_replace(strAction, "#destination", destStr);
+		}
+		return tgui::String(strAction);
+	});
 
-			if (max != -1)
-			{
-				weightVal = tgui::String::fromNumber(val);
-				weightMax = tgui::String::fromNumber(max);
-
+	panel.add_line();
 
-				tgui::HorizontalLayout::Ptr layoutRes;
-				layoutRes = tgui::HorizontalLayout::create();
+	// Add how much of the citizen's inventory is full
+	if (inventory)
+	{
+		const auto capacity = [this, citizen](int& val, int& max) {
+			val = citizen->rInventory.weight(&data.resourceWeights);
+			if (citizen->inventorySize != NULL_INT)
+				max = citizen->inventorySize;
+			else
+				max = citizen->rInventoryCap.weight(&data.resourceWeights);
+		};
 
-				tgui::Label::Ptr labelResCapPer = tgui::Label::create();
-				labelResCapPer->setText(
-					"Capacity: " +
-					weightVal +
+		panel.add_text([this, citizen]() {
+			return tgui::String(
+				"Stored Resources: " +
+				data.resources_to_str(citizen->rInventory));
+		});
+
+		panel.add_progress(
+			[capacity]() {
+				int val = 0, max = 0;
+				capacity(val, max);
+				return "Capacity: " +
+					tgui::String::fromNumber(val) +
 					" / " +
-					weightMax);
-
-				tgui::ProgressBar::Ptr pb;
-				pb = tgui::ProgressBar::create();
-				pb->setMinimum(0);
-				pb->setMaximum(max);
-				pb->setValue(val);
+					tgui::String::fromNumber(max);
+			},
+			capacity);
 
-				layoutRes->add(labelResCapPer);
-				layoutRes->add(pb);
-				layout->add(layoutRes);
+		panel.add_line();
+	}
 
-				layout->add(makeLine());
-			}
-		}
+	panel.refresh();
+}
 
+void WindowGameplay::refresh_info_panels()
+{
+	for (auto& pair : guiBInfoWin)
+	{
+		if (!pair.second.dirty)
+			continue;
+		// Deleting a building closes it's panel, so it's still alive
+		BuildingBase* infoBuild = guiBInfoPtr.at(pair.first);
+		assert(data.buildingBases.get(infoBuild->slot) &&
+			*data.buildingBases.get(infoBuild->slot) == infoBuild);
+		refresh_build_info(infoBuild);
+	}
 
+	for (auto& pair : guiEInfoWin)
+	{
+		if (!pair.second.dirty)
+			continue;
+		// Dead entities are freed, and their panel closed, next tick
+		EntityBody* infoEntity = guiEInfoPtr.at(pair.first);
+		if (infoEntity->dead)
+			continue;
+		refresh_entity_info(infoEntity);
 	}
 }
 
+void WindowGameplay::close_info_panels()
+{
+	while (!guiBInfoWin.empty())
+		close_build_info(guiBInfoPtr.at(guiBInfoWin.begin()->first));
+	while (!guiEInfoWin.empty())
+		close_entity_info(guiEInfoPtr.at(guiEInfoWin.begin()->first));
+}
+
 void WindowGameplay::grid_change_confirmation(IVec latest)
 
 {
@@ -3495,7 +4126,14 @@ void WindowGameplay::upgrade_building(BuildingBase* build, UpgradeTree* step)
 	assert(step);
 
 	// Upgrade the building
+	const bool wasBarrier = build->props.bool_is(PropertyBool::BARRIER);
 	build->load_upgrade_step(step);
+	if (wasBarrier != build->props.bool_is(PropertyBool::BARRIER))
+	{
+		for (BuildingBody* body : build->get_bodies())
+			data.worldEvents.push(
+				{ WorldEvent::BARRIER_CHANGED, !wasBarrier, body->tilePos, build });
+	}
 
 	// Get the upgrade tree's leafs 
 	std::vector<UpgradeTree*> steps =
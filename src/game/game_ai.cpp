@@ -0,0 +1,131 @@
+#include "game/game_ai.hpp"
+
+#include "game/game_data.hpp"
+
+#include <algorithm>
+
+AIScheduler::AIScheduler(GameData *context)
+	: context(context)
+{
+}
+
+void AIScheduler::queue(EntityBody *entity)
+{
+	assert(entity);
+	if (entity->decisionQueued)
+		return;
+	entity->decisionQueued = true;
+
+	Entry entry;
+	entry.entity = entity;
+	entry.frame = context->frameCount;
+	buckets[priority(entity)].push_back(entry);
+}
+
+void AIScheduler::forget(const GameBody *body)
+{
+	if (body->type != BodyType::ENTITY)
+		return;
+	for (auto &bucket : buckets)
+	{
+		bucket.erase(
+			std::remove_if(bucket.begin(), bucket.end(),
+				[body](const Entry &entry) {
+					return entry.entity == body;
+				}),
+			bucket.end());
+	}
+}
+
+size_t AIScheduler::run()
+{
+	const t_seconds start = GameData::get_real_time();
+	int budgetUs = (int)context->get_const(ConstantNumeric::AI_TICK_BUDGET);
+	if (budgetUs <= 0)
+		budgetUs = DEFAULT_BUDGET;
+	const t_seconds budget = (t_seconds)budgetUs / 1e6f;
+
+	// Aging, the oldest entries are at the front
+	for (size_t p = 1; p < PRIORITY_COUNT; ++p)
+	{
+		auto &bucket = buckets[p];
+		auto &above = buckets[p - 1];
+		while (!bucket.empty() &&
+			context->frameCount - bucket.front().frame > MAX_WAIT)
+		{
+			const Entry entry = bucket.front();
+			bucket.pop_front();
+			// Ahead of the entries queued after it
+			above.insert(
+				std::upper_bound(above.begin(), above.end(), entry,
+					[](const Entry &a, const Entry &b) { return a.frame < b.frame; }),
+				entry);
+		}
+	}
+
+	ran = 0u;
+	maxLatency = 0;
+	long latencySum = 0;
+	for (auto &bucket : buckets)
+	{
+		// Decisions queued while running wait for the next tick
+		size_t count = bucket.size();
+		while (count--)
+		{
+			if (timeBudget)
+			{
+				if (ran >= MIN_DECISIONS &&
+					GameData::get_real_time() - start > budget)
+					break;
+			}
+			else if (ran >= decisionLimit)
+				break;
+
+			const Entry entry = bucket.front();
+			bucket.pop_front();
+
+			const long latency = context->frameCount - entry.frame;
+			maxLatency = math_max(maxLatency, latency);
+			latencySum += latency;
+
+			entry.entity->decisionQueued = false;
+			entry.entity->logic_reset();
+			++ran;
+		}
+	}
+
+	used = GameData::get_real_time() - start;
+	depth = size();
+	averageLatency = ran ? (float)latencySum / (float)ran : 0.f;
+	return ran;
+}
+
+size_t AIScheduler::size() const
+{
+	size_t count = 0u;
+	for (const auto &bucket : buckets)
+		count += bucket.size();
+	return count;
+}
+
+// The entities might be deleted already
+void AIScheduler::clear()
+{
+	for (auto &bucket : buckets)
+		bucket.clear();
+	ran = 0u;
+	depth = 0u;
+	used = 0.f;
+	maxLatency = 0;
+	averageLatency = 0.f;
+}
+
+AIScheduler::Priority AIScheduler::priority(const EntityBody *entity)
+{
+	if (entity->aggressive || entity->entityType == EntityType::ENEMY)
+		return COMBAT;
+	const EntityCitizen *citizen = dynamic_cast<const EntityCitizen *>(entity);
+	if (citizen && citizen->job == CitizenJob::TEST01)
+		return COSMETIC;
+	return IDLE;
+}
@@ -10,7 +10,7 @@ PowerNetwork::PowerNetwork(size_t id)
 json PowerNetwork::to_json() const
 {
 	json j;
-	j["builds"] = {output, input, station};
+	j["counts"] = counts;
 	j["vals"] = {powerOut, powerIn, powerStore,
 				 powerValue, storeCount};
 	return j;
@@ -20,9 +20,8 @@ void PowerNetwork::from_json(const json &j)
 {
 	try
 	{
-		j.at("builds").at(0).get_to(output);
-		j.at("builds").at(1).get_to(input);
-		j.at("builds").at(2).get_to(station);
+		if (j.contains("counts"))
+			j.at("counts").get_to(counts);
 
 		j.at("vals").at(0).get_to(powerOut);
 		j.at("vals").at(1).get_to(powerIn);
@@ -38,12 +37,6 @@ void PowerNetwork::from_json(const json &j)
 
 void PowerNetwork::serialize_post(const SerializeMap &map)
 {
-	for (auto &v : output)
-		map.apply(v);
-	for (auto &v : input)
-		map.apply(v);
-	for (auto &v : station)
-		map.apply(v);
 	GameData *g = map.get<GameData>(SERIALIZABLE_DATA, 0);
 	assert(g);
 	this->objectId = g->objectIdCounter.advance<PowerNetwork>();
@@ -57,7 +50,7 @@ std::string PowerNetwork::to_string()
 	{
 		static const std::string NAMES[3] = {"In", "Out", "Store"};
 		ss << NAMES[i] << ": { ";
-		ss << "Count: " << itr((Use)i).size();
+		ss << "Count: " << counts[i];
 		ss << ", Value: " << value((Use)i);
 		ss << " }" << ((i == 2) ? ("") : (", "));
 	}
@@ -65,21 +58,6 @@ std::string PowerNetwork::to_string()
 	return ss.str();
 }
 
-PowerNetwork::t_builds &PowerNetwork::itr(Use use)
-{
-	switch (use)
-	{
-	case IN:
-		return input;
-	case OUT:
-		return output;
-	case STATION:
-		return station;
-	default:
-		return input;
-	}
-}
-
 int &PowerNetwork::value(Use use)
 {
 	switch (use)
@@ -95,64 +73,12 @@ int &PowerNetwork::value(Use use)
 	}
 }
 
-void PowerNetwork::add(BuildingBase *base, Use use, bool changeValue)
-{
-	base->network = this;
-	if (changeValue)
-		value(use) += resource(base, use);
-	auto &vec = itr(use);
-	if (std::find(vec.begin(), vec.end(), base) == vec.end())
-		vec.insert(
-			std::upper_bound(vec.begin(), vec.end(), base),
-			base);
-}
-
-void PowerNetwork::add(const t_builds &builds, Use use)
-{
-	for (auto &b : builds)
-		add(b, use);
-}
-
-void PowerNetwork::add(BuildingBase *base)
-{
-	for (int i = 0; i < 3; ++i)
-	{
-		auto u = (PowerNetwork::Use)i;
-		if (resource(base, u))
-			add(base, u);
-	}
-}
-
-void PowerNetwork::remove(BuildingBase *base, Use use)
-{
-	base->network = nullptr;
-	value(use) -= resource(base, use);
-	auto &vec = itr(use);
-	vec.erase(
-		std::remove(
-			std::begin(vec),
-			std::end(vec),
-			base),
-		std::end(vec));
-}
-
-void PowerNetwork::remove(BuildingBase *base)
-{
-	for (int i = 0; i < 3; ++i)
-	{
-		auto u = (PowerNetwork::Use)i;
-		if (resource(base, u))
-			remove(base, u);
-	}
-}
-
 void PowerNetwork::clear()
 {
-	for (int i = 0; i < 3; ++i)
-	{
-		auto u = (PowerNetwork::Use)i;
-		itr(u).clear();
-	}
+	powerOut = 0;
+	powerStore = 0;
+	powerIn = 0;
+	counts = {0, 0, 0};
 }
 
 int PowerNetwork::resource(BuildingBase *base, Use use)
@@ -170,26 +96,6 @@ int PowerNetwork::resource(BuildingBase *base, Use use)
 	}
 }
 
-void PowerNetwork::merge(PowerNetwork &a, PowerNetwork &b)
-{
-	for (int i = 0; i < 3; ++i)
-	{
-		auto u = (PowerNetwork::Use)i;
-		a.add(b.itr(u), u);
-	}
-	b.clear();
-}
-
-void PowerNetwork::merge(PowerNetwork *a, PowerNetwork *b)
-{
-	for (int i = 0; i < 3; ++i)
-	{
-		auto u = (PowerNetwork::Use)i;
-		a->add(b->itr(u), u);
-	}
-	b->clear();
-}
-
 static std::vector<UpgradeTree*> recursive_get_available_tree(
 	UpgradeTree *step,
 	const std::vector<int> &upgrades)
@@ -529,8 +435,8 @@ void BuildingBase::serialize_publish(const SerializeMap &map)
 	GameData *g = map.get<GameData>(SERIALIZABLE_DATA, 0);
 	assert(g);
 
-	g->add_timer(costTimer);
-	g->add_timer(actionTimer);
+	this->context = g;
+	timers_schedule();
 
 	this->tree = dynamic_cast<UpgradeTree *>(
 		g->bodyConfigMap.at(
@@ -679,6 +585,7 @@ void BuildingBase::load_upgrade_step(UpgradeTree *step, void *tree)
 		this->costTimer->set_length(step->delayCost);
 	if (step->delayAction != NULL_FLOAT)
 		this->actionTimer->set_length(step->delayAction);
+	timers_schedule();
 
 	if (step->effectRadius != NULL_FLOAT)
 		this->effectRadius = step->effectRadius;
@@ -733,6 +640,22 @@ void BuildingBase::load_upgrade_step(UpgradeTree *step, void *tree)
 	}
 
 	props.append(step->props);
+
+	// The tiles keep a copy of BARRIER, the bodies move to the trees
+	// of the new properties
+	if (context && context->chunks)
+	{
+		for (int x = 0; x < tilesSize.x; ++x)
+		{
+			for (int y = 0; y < tilesSize.y; ++y)
+			{
+				context->chunks->update_barrier(tilePos.x + x, tilePos.y + y);
+				BuildingBody *body = context->chunks->get_build(tilePos.x + x, tilePos.y + y);
+				if (body && body->base == this)
+					context->refresh_trees(body);
+			}
+		}
+	}
 }
 
 bool BuildingBase::tree_similar(BuildingBase *other)
@@ -762,6 +685,25 @@ bool BuildingBase::tree_similar(BuildingBase *other)
 	return true;
 }
 
+void BuildingBase::timers_schedule()
+{
+	if (!context)
+		return;
+	timers_cancel();
+	costWake = context->schedule_timer(costTimer, &costPasses);
+	actionWake = context->schedule_timer(actionTimer, &actionPasses);
+}
+
+void BuildingBase::timers_cancel()
+{
+	if (!context)
+		return;
+	context->scheduler.cancel(costWake);
+	context->scheduler.cancel(actionWake);
+	costPasses = 0u;
+	actionPasses = 0u;
+}
+
 void BuildingBase::damage(int attack)
 {
 	hp -= attack;
@@ -809,8 +751,7 @@ double BuildingBase::num_get(PropertyNum x)
 
 BuildingBody *BuildingBase::get_body() const
 {
-	Tile &t = context->chunks->get_tile(tilePos.x, tilePos.y);
-	return t.building;
+	return context->chunks->get_build(tilePos.x, tilePos.y);
 }
 
 inline std::list<BuildingBody *> BuildingBase::get_bodies()
@@ -820,8 +761,7 @@ inline std::list<BuildingBody *> BuildingBase::get_bodies()
 	{
 		for (int y = 0; y < tilesSize.y; ++y)
 		{
-			Tile &t = context->chunks->get_tile(tilePos.x + x, tilePos.y + y);
-			ret.push_back(t.building);
+			ret.push_back(context->chunks->get_build(tilePos.x + x, tilePos.y + y));
 		}
 	}
 	return ret;
@@ -871,7 +811,7 @@ std::vector<UpgradeTree *> BuildingBase::get_upgrades()
 void BuildingBase::accept_entity(EntityCitizen *e)
 {
 	e->workplace = this;
-	this->entities.push_back(e);
+	e->workSlot = this->entities.push_back(e);
 
 	// Can not accept an entity that already has a job
 	assert(e->job == CitizenJob::NONE);
@@ -879,23 +819,13 @@ void BuildingBase::accept_entity(EntityCitizen *e)
 	// If workplace's full, remove it from the "NEEDS_WORKERS" tree
 	if (entities.size() >= entityLimit)
 	{
-		const static auto nw = (t_id)IngameProperties::NEEDS_WORKERS;
-
-		const auto &bodies = get_bodies();
-		std::for_each(bodies.cbegin(), bodies.cend(), [this](GameBody *body) {
-			context
-				->get_tree(ENUM_INGAME_PROPERTIES, nw)
-				->remove(tilePos, body);
-		});
+		for (BuildingBody *body : get_bodies())
+			context->refresh_trees(body);
 	}
 }
 
 void BuildingBase::accept_entity_job(EntityCitizen* e)
 {
-	context
-		->get_tree(ENUM_CITIZEN_JOB, (t_id)e->job)
-		->remove(vec_pos_to_tile(e->pos), e);
-	
 	e->job = (CitizenJob)this->job;
 	bool success;
 	EntityStats* stats = context->get_entity_stats(
@@ -908,10 +838,8 @@ void BuildingBase::accept_entity_job(EntityCitizen* e)
 		e->spriteHolder = e->spriteWalk;
 	}
 	
-	// Insert the worker to his quad tree
-	context
-		->get_tree(ENUM_CITIZEN_JOB, (t_id)e->job)
-		->insert(vec_pos_to_tile(e->pos), e);
+	// Move the worker to his job's quad tree
+	context->refresh_trees(e);
 }
 
 void BuildingBase::enter_entity(EntityCitizen *e)
@@ -920,9 +848,10 @@ void BuildingBase::enter_entity(EntityCitizen *e)
 	{
 		e->reset();
 		e->insideWorkplace = true;
-		this->storedEntities.push_back(e);
+		e->storedSlot = this->storedEntities.push_back(e);
 		auto v = vec_pos_to_tile(e->pos);
-		ASSERT_ERROR(context->chunks->get_tile(v.x, v.y).remove_entity(e), "Failed attempt to remove entity from tile");
+		bool removed = context->chunks->remove_entity(v.x, v.y, e);
+		ASSERT_ERROR(removed, "Failed attempt to remove entity from tile");
 		context->hide_entity(e);
 		e->action = EntityBody::Action::WORK;
 		e->timerPath->reset(context->get_time());
@@ -944,20 +873,19 @@ void BuildingBase::exit_entity(EntityCitizen *e)
 	{
 		e->reset();
 		e->insideWorkplace = false;
-		auto itr = std::find(
-			storedEntities.begin(),
-			storedEntities.end(),
-			dynamic_cast<EntityBody *>(e));
+		auto itr = storedEntities.find(
+			dynamic_cast<EntityBody *>(e),
+			e->storedSlot);
 		assert(itr != storedEntities.end());
 		storedEntities.erase(itr);
 		auto v = vec_pos_to_tile(e->pos);
-		context->chunks->get_tile(v.x, v.y).entities.push_back(e);
+		context->chunks->add_entity(v.x, v.y, e);
 		e->action = EntityBody::Action::IDLE;
 		context->show_entity(e);
 	}
 }
 
-std::vector<VariantPtr<EntityBody>>::iterator
+t_obj_ctr<VariantPtr<EntityBody>>::iterator
 BuildingBase::remove_entity(EntityCitizen *e)
 {
 	assert(e->workplace == this);
@@ -966,43 +894,22 @@ BuildingBase::remove_entity(EntityCitizen *e)
 	// entty get the job.
 	// assert((size_t)e->job == this->job);
 
-	// If work space was created, add to the "NEEDS_WORKERS" tree
-	if (entities.size() <= entityLimit)
-	{
-		static const auto nw = (t_id)IngameProperties::NEEDS_WORKERS;
-		const auto &bodies = get_bodies();
-		std::for_each(bodies.cbegin(), bodies.cend(), [this](GameBody *body) {
-			assert(body);
-			// Don't add a building if it has a null body
-			// The quad trees should never hold null values
-			if (!body)
-				return;
-
-			context->get_tree(
-					   ENUM_INGAME_PROPERTIES,
-					   nw)
-				->insert(tilePos, body);
-				
-		});
-	}
-
 	e->workplace = nullptr;
 	e->job = CitizenJob::NONE;
 
-	auto itr = std::find(entities.begin(), entities.end(), e);
+	auto itr = entities.find(e, e->workSlot);
 	assert(itr != entities.end());
 	auto ret = this->entities.erase(itr);
-	/*
-	for (t_idwtree& gb : context->get_trees(e))
+
+	// Out of it's job's tree
+	context->refresh_trees(e);
+
+	// If work space was created, add to the "NEEDS_WORKERS" tree
+	if (entities.size() < entityLimit)
 	{
-		gb.second->remove(vec_pos_to_tile(e->pos), e);
+		for (BuildingBody *body : get_bodies())
+			context->refresh_trees(body);
 	}
-	*/
-	context
-		->get_tree(ENUM_CITIZEN_JOB,
-				   (t_id)e->job)
-		->remove(
-			vec_pos_to_tile(e->pos), e);
 	
 	return ret;
 }
@@ -1105,7 +1012,12 @@ void BuildingBase::update()
 
 	// From here, everything can only work if the building active
 	if (!active)
+	{
+		// Don't catch up on the passes once it's active again
+		costPasses = 0u;
+		actionPasses = 0u;
 		return;
+	}
 
 	// If the building is a workplace, multiply every resource
 	// related logic by the workers count.
@@ -1114,11 +1026,16 @@ void BuildingBase::update()
 		: 1;
 
 	bool wasSufficient = sufficient;
-	unsigned ioTime = 0;
 
-	// Resource io goes here
-	while (costTimer->next_surplus(context->get_time()))
-		++ioTime;
+	// Resource io goes here, the passes are counted by the scheduler
+	const unsigned ioTime = costPasses;
+	const unsigned actionTime = actionPasses;
+	costPasses = 0u;
+	actionPasses = 0u;
+
+	// Nothing happened since the last tick
+	if (!ioTime && !actionTime)
+		return;
 
 	// If it's time to gemerateqconsume resources
 	for (unsigned i = 0; i < ioTime; ++i)
@@ -1134,8 +1051,8 @@ void BuildingBase::update()
 			// If the building had the ability to geenrate power
 			if (wasSufficient && !sufficient)
 			{
-				// Slowly dampen the power it's generate until it's 0s
-				network->powerOut -= this->lastPowerOut;
+				// The network output is solved by the power grid
+				// from finalPowerOut, zeroing it is enough
 				this->finalPowerOut = 0;
 				this->updateInfo = true;
 			}
@@ -1176,9 +1093,6 @@ void BuildingBase::update()
 				? math_min(newOut, powerOut2)
 				: math_max(newOut, powerOut2);
 
-			network->powerOut += newOut;
-			network->powerOut -= this->finalPowerOut;
-
 			this->finalPowerOut = newOut;
 
 			this->updateInfo = true;
@@ -1205,6 +1119,10 @@ void BuildingBase::update()
 	bool isOffensive = props.bool_is(PropertyBool::OFFENSIVE);
 	bool isHome = props.bool_is(PropertyBool::HOME);
 
+	// Search for targets only when it's time to spawn
+	if (!actionTime)
+		return;
+
 	GameBody* target = nullptr;
 
 	if (isOffensive)
@@ -1232,7 +1150,7 @@ void BuildingBase::update()
 		return;
 
 	// Spawning
-	while (actionTimer->next_surplus(context->get_time()))
+	for (unsigned i = 0; i < actionTime; ++i)
 	{
 		if (!is_operational())
 			break;
@@ -1383,23 +1301,21 @@ bool BuildingBody::confirm_body(GameData *context)
 	BuildingBody *body = this;
 	body->context = context;
 
-	Tile &tile = context->chunks->get_tile(body->tilePos.x, body->tilePos.y);
-	tile.building = body;
+	context->chunks->set_build(body->tilePos.x, body->tilePos.y, body);
 	context->bodies.push_back(body);
 
 
-	context->buildings.push_back(body);
+	body->slot = context->buildings.push_back(body);
 
 
 	// Insert building body to quad trees
-	auto trees = context->get_trees(dynamic_cast<GameBody *>(body));
-	for (auto& pair : trees)
+	for (uint16_t id : context->get_trees(body))
 	{
 		GameBody *b = dynamic_cast<GameBody *>(body);
-		t_tiletree *tree = pair.second;
+		t_tiletree *tree = context->treeTable[id];
 		assert(b);
-		assert(tree && tile.building);
-		if (!tree || !tile.building)
+		assert(tree);
+		if (!tree)
 			continue;
 		bool bb = tree->insert(body->tilePos, b);
 		if (!bb)
@@ -2,230 +2,455 @@
 
 #include "game/game_data.hpp"
 
-BulletBody::BulletBody() :
-	GameBody(nullptr, -1, 0, { 0.0f, 0.0f }, -1, BodyType::BULLET,
-		ENTITY_COLLISION_SIZE)
+// Bullet Collision
+
+size_t BulletCollision::add(
+	uint32_t slot,
+	const FVec &from,
+	const FVec &to,
+	float radius,
+	t_alignment alignment)
 {
+	x0.push_back(from.x);
+	y0.push_back(from.y);
+	x1.push_back(to.x);
+	y1.push_back(to.y);
+	this->radius.push_back(radius);
+	this->alignment.push_back(alignment);
+	this->slot.push_back(slot);
+	return this->slot.size() - 1;
 }
 
-BulletBody::BulletBody(
-	GameData* context,
-	size_t id,
-	const sf::Vector2f& pos,
-	const sf::Vector2f& dir,
-	t_sprite spriteHolder,
-	t_id alignment)
-	: GameBody(
-		context,
-		-1,
-		id,
-		pos,
-		spriteHolder,
-		BodyType::BULLET,
-		ENTITY_COLLISION_SIZE)
-{
-	this->dir = dir;
-	this->alignment = alignment;
-	this->z = 0.0f;
-	this->radius = 0.1f;
+void BulletCollision::clear()
+{
+	x0.clear();
+	y0.clear();
+	x1.clear();
+	y1.clear();
+	radius.clear();
+	alignment.clear();
+	slot.clear();
+	hit.clear();
+	hitTime.clear();
 }
 
-int BulletBody::get_hp() const {
-	return INT_MAX;
+void BulletCollision::solve(const Chunks *chunks)
+{
+	const size_t count = size();
+	hit.assign(count, nullptr);
+	hitTime.assign(count, 1.0f);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		float time = 1.0f;
+		hit[i] = sweep(chunks, i, time);
+		hitTime[i] = time;
+	}
 }
 
-void BulletBody::apply_data(GameBodyConfig* config)
+// First time [0, 1] the segment touches a circle, -1 if it doesn't
+static float sweep_circle(
+	float ax, float ay, float dx, float dy,
+	float cx, float cy, float r)
 {
-	if (static_cast<EntityStats*>(config) == nullptr)
+	const float fx = ax - cx, fy = ay - cy;
+	const float c = fx * fx + fy * fy - r * r;
+	// Starts inside
+	if (c <= 0.0f)
+		return 0.0f;
+	const float a = dx * dx + dy * dy;
+	if (a == 0.0f)
+		return -1.0f;
+	const float b = fx * dx + fy * dy;
+	const float disc = b * b - a * c;
+	if (disc < 0.0f)
+		return -1.0f;
+	const float t = (-b - sqrtf(disc)) / a;
+	return (t >= 0.0f && t <= 1.0f) ? t : -1.0f;
+}
+
+// First time [0, 1] the segment touches a box, -1 if it doesn't
+static float sweep_box(
+	float ax, float ay, float dx, float dy,
+	float minX, float minY, float maxX, float maxY)
+{
+	float tMin = 0.0f, tMax = 1.0f;
+	const float o[2] = {ax, ay}, d[2] = {dx, dy};
+	const float lo[2] = {minX, minY}, hi[2] = {maxX, maxY};
+	for (int k = 0; k < 2; ++k)
 	{
-		WARNING(
-			"In function %s invalid type of input function parameter, should be of type GameBodyConfig",
-			__PRETTY_FUNCTION__);
-		return;
+		if (d[k] == 0.0f)
+		{
+			if (o[k] < lo[k] || o[k] > hi[k])
+				return -1.0f;
+			continue;
+		}
+		float t1 = (lo[k] - o[k]) / d[k];
+		float t2 = (hi[k] - o[k]) / d[k];
+		if (t1 > t2)
+			std::swap(t1, t2);
+		tMin = math_max(tMin, t1);
+		tMax = math_min(tMax, t2);
+		if (tMin > tMax)
+			return -1.0f;
 	}
+	return tMin;
+}
 
-	auto& stats = *static_cast<BulletStats*>(config);
+GameBody *BulletCollision::sweep(const Chunks *chunks, size_t i, float &time)
+{
+	const float ax = x0[i], ay = y0[i];
+	const float dx = x1[i] - ax, dy = y1[i] - ay;
+	const float r = radius[i];
+	const t_alignment algn = alignment[i];
+
+	// Bodies are kept in the tile of their center, so
+	// every tile in reach of the radius must be tested
+	const int reach = (int)ceilf(r);
+	const float length = sqrtf(dx * dx + dy * dy);
+
+	GameBody *best = nullptr;
+	float bestTime = 2.0f;
+	m_tested.clear();
+
+	const auto test = [&](int tx, int ty) {
+		const IVec tilePos{tx, ty};
+		if (std::find(m_tested.begin(), m_tested.end(), tilePos) != m_tested.end())
+			return;
+		m_tested.push_back(tilePos);
+
+		if (!chunks->has_tile(tx, ty))
+			return;
+		auto pair = chunks->get_pair(tx, ty);
+		const Grid &grid = *pair.first;
+		const Tile &tile = pair.second;
+
+		BuildingBody *build = grid.get_building(tile);
+		if (build &&
+			!build->dead &&
+			GameData::alignment_compare(build->alignment, algn) == ALIGNMENTS_ENEMIES)
+		{
+			// The building's position is the center of it's tile
+			float t = sweep_box(ax, ay, dx, dy,
+				build->pos.x - 0.5f - r, build->pos.y - 0.5f - r,
+				build->pos.x + 0.5f + r, build->pos.y + 0.5f + r);
+			if (t >= 0.0f && t < bestTime)
+			{
+				bestTime = t;
+				best = build;
+			}
+		}
+
+		if (tile.is_barrier())
+			return;
+
+		grid.for_each_entity(tile, [&](EntityBody *e) {
+			GameBody *body = e;
+			if (body->dead ||
+				GameData::alignment_compare(body->alignment, algn) != ALIGNMENTS_ENEMIES)
+				return;
+			float t = sweep_circle(ax, ay, dx, dy, body->pos.x, body->pos.y, r);
+			if (t >= 0.0f && t < bestTime)
+			{
+				bestTime = t;
+				best = body;
+			}
+		});
+	};
 
-	this->alignment = stats.alignment;
-	this->damage = stats.damage;
-	this->lifeSpan = stats.lifeSpan;
-	this->maxDist = stats.maxDist;
-	this->maxSpeed = stats.maxSpeed;
-	this->maxForce = stats.maxForce;
-	this->spriteHolder = stats.sprite;
-	this->radius = stats.radius;
+	// Amanatides-Woo grid traversal
+	int x = (int)math_floor(ax), y = (int)math_floor(ay);
+	const int endX = (int)math_floor(ax + dx), endY = (int)math_floor(ay + dy);
+	const int stepX = dx > 0.0f ? 1 : -1, stepY = dy > 0.0f ? 1 : -1;
+	const float tDeltaX = dx != 0.0f ? math_abs(1.0f / dx) : FLT_MAX;
+	const float tDeltaY = dy != 0.0f ? math_abs(1.0f / dy) : FLT_MAX;
+	float tMaxX = dx != 0.0f
+		? ((dx > 0.0f ? (float)(x + 1) - ax : ax - (float)x) * tDeltaX)
+		: FLT_MAX;
+	float tMaxY = dy != 0.0f
+		? ((dy > 0.0f ? (float)(y + 1) - ay : ay - (float)y) * tDeltaY)
+		: FLT_MAX;
+	// How early a body of a neighbour tile can be hit
+	const float margin = length > 0.0f ? (float)(reach + 2) / length : 1.0f;
+
+	float tEntry = 0.0f;
+	int steps = math_abs(endX - x) + math_abs(endY - y) + 1;
+	while (steps-- > 0)
+	{
+		// Nothing further can be hit before the best hit
+		if (tEntry - margin > bestTime)
+			break;
+
+		for (int ox = -reach; ox <= reach; ++ox)
+			for (int oy = -reach; oy <= reach; ++oy)
+				test(x + ox, y + oy);
 
-	this->props.append(stats.props);
+		if (x == endX && y == endY)
+			break;
 
-	assert(config);
+		if (tMaxX < tMaxY)
+		{
+			tEntry = tMaxX;
+			tMaxX += tDeltaX;
+			x += stepX;
+		}
+		else
+		{
+			tEntry = tMaxY;
+			tMaxY += tDeltaY;
+			y += stepY;
+		}
+	}
+
+	if (!best)
+		return nullptr;
+	time = bestTime;
+	return best;
 }
 
-bool BulletBody::confirm_body(GameData* context)
+// Bullet Pool
+
+BulletPool::BulletPool(GameData *context, size_t capacity)
+	: context(context)
 {
-	this->context = context;
-	context->bodies.push_back(dynamic_cast<GameBody*>(this));
-	return true;
+	// Allocated once, the pool never grows
+	x.resize(capacity);
+	y.resize(capacity);
+	px.resize(capacity);
+	py.resize(capacity);
+	vx.resize(capacity);
+	vy.resize(capacity);
+	life.resize(capacity);
+	damage.resize(capacity);
+	radius.resize(capacity);
+	alignment.resize(capacity);
+	sprite.resize(capacity);
+	flags.resize(capacity);
+	target.resize(capacity);
+	activeIndex.resize(capacity);
+	active.reserve(capacity);
+	freeList.reserve(capacity);
+	clear();
 }
 
-int BulletBody::get_direction_frame(int rotation)
+uint32_t BulletPool::spawn(
+	const FVec &pos,
+	const FVec &vel,
+	const BulletStats *stats,
+	t_alignment alignment,
+	GameBody *target)
 {
-	float angle = atan2f(dir.y, dir.x);
-	angle += (float)M_PI / 2.f;
-	angle -= (float)M_PI_2 / 8.f;
-	angle = math_mod<float>(angle, (float)M_2PI);
-	angle = math_map(angle, 0.0f, (float)M_2PI, 0.f, 8.f);
-	if (rotation % 2 == 1)
-		angle += (float)M_PI_2;
-	return math_mod((int)angle, 8);
+	if (freeList.empty())
+	{
+		++dropped;
+		return NONE;
+	}
+	const uint32_t slot = freeList.back();
+	freeList.pop_back();
+
+	x[slot] = pos.x;
+	y[slot] = pos.y;
+	px[slot] = pos.x;
+	py[slot] = pos.y;
+	vx[slot] = vel.x;
+	vy[slot] = vel.y;
+	this->alignment[slot] = alignment;
+	this->target[slot] = aim(target);
+	if (stats)
+	{
+		life[slot] = stats->lifeSpan;
+		damage[slot] = stats->damage;
+		radius[slot] = stats->radius;
+		sprite[slot] = stats->sprite;
+		flags[slot] =
+			(stats->props.bool_is(BulletPropertyBools::HOMING) ? FLAG_HOMING : 0u) |
+			(stats->props.bool_is(BulletPropertyBools::SPECTRAL) ? FLAG_SPECTRAL : 0u);
+	}
+	else
+	{
+		life[slot] = 1.0f;
+		damage[slot] = 10.0f;
+		radius[slot] = 0.1f;
+		sprite[slot] = -1;
+		flags[slot] = 0u;
+	}
+
+	activeIndex[slot] = (uint32_t)active.size();
+	active.push_back(slot);
+	++spawned;
+	return slot;
+}
+
+void BulletPool::release(uint32_t slot)
+{
+	const uint32_t index = activeIndex[slot];
+	if (index == NONE)
+		return;
+
+	// Swap remove
+	const uint32_t last = active.back();
+	active[index] = last;
+	activeIndex[last] = index;
+	active.pop_back();
+
+	activeIndex[slot] = NONE;
+	target[slot] = {};
+	freeList.push_back(slot);
 }
 
-void BulletBody::update(float delta)
+void BulletPool::update(float delta, BulletCollision &collision)
 {
 	const float maxSpeed = 1.1f;
 	const float maxForce = 10;
-	
-	 if (dead)
-		 return;
 
-	if (lifeTimer->time_passed(context->get_time()) > lifeSpan)
+	// Targets of the homing bullets are searched in one batch
+	seeking.clear();
+	for (const uint32_t slot : active)
 	{
-		dead = true;
-		return;
+		if (!(flags[slot] & FLAG_HOMING) || get_target(slot) || life[slot] <= delta)
+			continue;
+		size_t targetAlgn = GameData::alignment_opposite(alignment[slot]);
+		if (targetAlgn == ALIGNMENT_NONE)
+			continue;
+
+		const bool spectral = flags[slot] & FLAG_SPECTRAL;
+		const size_t query = context->queue_nearest(
+			{ x[slot], y[slot] },
+			1,
+			{ ENUM_ALIGNMENT, targetAlgn },
+			[=](const sf::Vector2i&, GameBody* const& b, const int&)
+			{
+				if (b->type == BodyType::BUILDING && spectral)
+					return false;
+				return true;
+			});
+		seeking.emplace_back(slot, query);
+	}
+	if (!seeking.empty())
+	{
+		context->solve_nearest();
+		for (const auto &seek : seeking)
+			target[seek.first] = aim(context->get_nearest(seek.second));
 	}
 
-
-	struct BulletCondition
+	// Backwards, so released slots don't skip the swapped one
+	for (size_t i = active.size(); i-- > 0; )
 	{
-		size_t alignment;
-		BulletCondition(size_t alignment)
-		{
-			this->alignment = alignment;
-		}
+		const uint32_t slot = active[i];
 
-		inline bool operator()(const GameBody* b, const int, const int) const
+		life[slot] -= delta;
+		if (life[slot] <= 0.0f)
 		{
-			bool ret = GameData::alignment_compare(b->alignment, alignment) ==
-				ALIGNMENTS_ENEMIES;
-			return ret;
+			release(slot);
+			continue;
 		}
-	};
 
-	if (props.bool_is(BulletPropertyBools::HOMING))
-	{
-		if (!target)
+		if (flags[slot] & FLAG_HOMING)
 		{
-			size_t targetAlgn = GameData::alignment_opposite(this->alignment);
-			if (targetAlgn != ALIGNMENT_NONE)
+			const FVec pos{ x[slot], y[slot] };
+			// If target was found...
+			if (const GameBody *aimed = get_target(slot))
 			{
-				// Find a new target
-				auto nearLst = context->nearest_bodies_quad(
-					this->pos,
-					1,
-					{ ENUM_ALIGNMENT, targetAlgn },
-					[=](const sf::Vector2i&, const GameBody* b, const int)
-					{
-						if (b->type == BodyType::BUILDING &&
-							props.bool_is(BulletPropertyBools::SPECTRAL))
-							return false;
-						return true;
-					}
-				);
-				if (nearLst.size())
+				FVec dif = aimed->pos - pos;
+				FVec vel{ vx[slot], vy[slot] };
+				if (dif != FVec{ 0.0f, 0.0f })
 				{
-					set_target(nearLst.back());
+					vec_normalize(dif);
+					FVec force = dif;
+					vec_limit(force, maxForce);
+					vel += force;
+					vec_limit(vel, maxSpeed);
 				}
+				else
+				{
+					vel = { 0.0f, 0.0f };
+				}
+				vx[slot] = vel.x;
+				vy[slot] = vel.y;
 			}
 		}
-		// If target was found...
-		if (target)
-		{
-			FVec dif = target.get()->pos - this->pos;
-			if (dif != FVec{ 0.0f, 0.0f })
-			{
-				float ls = vec_normalize(dif);
-				this->dir = dif;
-				force = dif;
-				vec_limit(force, maxForce);
-				vel += force;
-				vec_limit(vel, maxSpeed);
-			}
-			else
-			{
-				vel = { 0.0f, 0.0f };
-			}
-		}
-	}
-
-	FVec newPos = this->pos + vel * delta;
-	this->pos = newPos;
-
-	std::list<GameBody*> nearbyBodies = this->context->nearest_bodies_radius(
-		this->pos,
-		this->radius,
-		1ull,
-		BulletCondition{this->alignment}
-	);
 
-	if (nearbyBodies.empty())
-		return;
-
-	GameBody* gb = nearbyBodies.front();
-	GameData::damage_body(gb, this->damage);
-	this->dead = true;
+		const FVec from{ x[slot], y[slot] };
+		px[slot] = from.x;
+		py[slot] = from.y;
+		x[slot] += vx[slot] * delta;
+		y[slot] += vy[slot] * delta;
+
+		// The hit is solved later with all the other bullets
+		collision.add(
+			slot,
+			from,
+			{ x[slot], y[slot] },
+			radius[slot],
+			alignment[slot]);
+	}
+}
 
-	if (gb->get_hp() <= 0)
+void BulletPool::resolve(const BulletCollision &collision)
+{
+	for (size_t i = 0; i < collision.size(); ++i)
 	{
-		set_target(nullptr);
+		GameBody *gb = collision.hit[i];
+		if (!gb)
+			continue;
+
+		const uint32_t slot = collision.slot[i];
+		const float t = collision.hitTime[i];
+		// Stop the bullet where it hit
+		x[slot] = collision.x0[i] + (collision.x1[i] - collision.x0[i]) * t;
+		y[slot] = collision.y0[i] + (collision.y1[i] - collision.y0[i]) * t;
+
+		GameData::damage_body(gb, damage[slot]);
+		release(slot);
 	}
 }
 
-json BulletBody::to_json() const
+void BulletPool::forget_target(GameBody *body)
 {
-	json ret = GameBody::to_json();
-
-	ret["lifeTimer"] = lifeTimer;
-
-	return ret;
+	targets.erase(body->bulletTarget);
+	body->bulletTarget = {};
 }
 
-void BulletBody::from_json(const json &j)
+GameBody *BulletPool::get_target(uint32_t slot) const
 {
-	GameBody::from_json(j);
-
-	if (!lifeTimer.get())
-	{
-		lifeTimer = t_time_manager::make_independent_timer(
-			context->get_time());
-		context->add_timer(lifeTimer);
-	}
-
-	if (j.count("lifeTimer"))
-		j.at("lifeTimer").get_to(lifeTimer);
+	GameBody *const *body = targets.get(target[slot]);
+	return body ? *body : nullptr;
 }
 
-void BulletBody::serialize_publish(const SerializeMap &map)
+NodeHandle BulletPool::aim(GameBody *body)
 {
-	GameBody::serialize_publish(map);
-	GameData* g = map.get<GameData>(SERIALIZABLE_DATA, 0);
-	assert(g);
-
-
-	if (!lifeTimer.get())
-	{
-		lifeTimer = t_time_manager::make_independent_timer(g->get_time());
-		g->add_timer(lifeTimer);
-		lifeTimer->init(g->get_time());
-	}
-
-	map.apply(this->target);
+	if (!body)
+		return {};
+	if (!targets.contains(body->bulletTarget))
+		body->bulletTarget = targets.insert(body);
+	return body->bulletTarget;
 }
 
-void BulletBody::serialize_initialize(const SerializeMap& map)
+int BulletPool::get_direction_frame(uint32_t slot, int rotation) const
 {
-	GameBody::serialize_initialize(map);
+	float angle = atan2f(vy[slot], vx[slot]);
+	angle += (float)M_PI / 2.f;
+	angle -= (float)M_PI_2 / 8.f;
+	angle = math_mod<float>(angle, (float)M_2PI);
+	angle = math_map(angle, 0.0f, (float)M_2PI, 0.f, 8.f);
+	if (rotation % 2 == 1)
+		angle += (float)M_PI_2;
+	return math_mod((int)angle, 8);
+}
 
-	GameData* g = map.get<GameData>(SERIALIZABLE_DATA, 0);
-	assert(g);
-	this->objectId = g->objectIdCounter.advance<EntityEnemy>();
-	this->confirm_body(g);
+void BulletPool::clear()
+{
+	active.clear();
+	freeList.clear();
+	// Lower slots are given first
+	for (size_t slot = capacity(); slot-- > 0; )
+	{
+		freeList.push_back((uint32_t)slot);
+		activeIndex[slot] = NONE;
+		target[slot] = {};
+	}
+	// The bodies' handles stop resolving
+	targets.clear();
+	spawned = 0u;
+	dropped = 0u;
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "game/game_crowd.hpp"
+
+#include "game/game_data.hpp"
+
+#include <algorithm>
+
+CrowdSteering::CrowdSteering(GameData *context)
+	: context(context)
+{
+}
+
+void CrowdSteering::update()
+{
+	clear();
+	for (GameBody *body : context->bodies)
+	{
+		if (body->type != BodyType::ENTITY || body->dead)
+			continue;
+		EntityBody *entity = dynamic_cast<EntityBody *>(body);
+		// Entities inside barriers don't push anyone
+		if (context->is_barrier(vec_pos_to_tile(entity->pos)))
+			continue;
+		add(entity);
+	}
+	solve();
+
+	for (size_t i = 0; i < entities.size(); ++i)
+	{
+		EntityBody *entity = entities[i];
+		entity->separation = forces[i];
+		entity->separationCount = counts[i];
+		entity->separationFrame = context->frameCount;
+	}
+}
+
+void CrowdSteering::add(EntityBody *entity)
+{
+	assert(entity);
+	entities.push_back(entity);
+	xs.push_back(entity->pos.x);
+	ys.push_back(entity->pos.y);
+	radii.push_back(entity->radius);
+}
+
+void CrowdSteering::add(const FVec &pos, float radius)
+{
+	entities.push_back(nullptr);
+	xs.push_back(pos.x);
+	ys.push_back(pos.y);
+	radii.push_back(radius);
+}
+
+void CrowdSteering::solve()
+{
+	const size_t n = xs.size();
+	forces.assign(n, FVec{ 0.f, 0.f });
+	counts.assign(n, 0);
+	cells = 0u;
+	if (!n)
+		return;
+
+	const t_seconds start = GameData::get_real_time();
+
+	float maxRadius = 0.f;
+	FVec min{ xs[0], ys[0] }, max = min;
+	for (size_t i = 0; i < n; ++i)
+	{
+		maxRadius = math_max(maxRadius, radii[i]);
+		min.x = math_min(min.x, xs[i]);
+		min.y = math_min(min.y, ys[i]);
+		max.x = math_max(max.x, xs[i]);
+		max.y = math_max(max.y, ys[i]);
+	}
+
+	// Neighbours are never more than a cell away, sparse crowds get
+	// bigger cells so the grid doesn't outgrow them
+	m_cellSize = math_max(maxRadius, 0.25f);
+	while (true)
+	{
+		m_origin = {
+			(int)floorf(min.x / m_cellSize),
+			(int)floorf(min.y / m_cellSize) };
+		m_width = (int)floorf(max.x / m_cellSize) - m_origin.x + 1;
+		m_height = (int)floorf(max.y / m_cellSize) - m_origin.y + 1;
+		if ((size_t)m_width * (size_t)m_height <= n * MAX_CELLS_RATIO + 64u)
+			break;
+		m_cellSize *= 2.f;
+	}
+	cells = (size_t)m_width * (size_t)m_height;
+
+	// Counting sort by cell
+	m_start.assign(cells + 1u, 0u);
+	m_cell.resize(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		m_cell[i] = cell_of(xs[i], ys[i]);
+		++m_start[m_cell[i] + 1u];
+	}
+	for (size_t c = 0; c < cells; ++c)
+		m_start[c + 1u] += m_start[c];
+
+	m_fill.assign(m_start.begin(), m_start.end() - 1);
+	m_xs.resize(n);
+	m_ys.resize(n);
+	m_index.resize(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		const uint32_t k = m_fill[m_cell[i]]++;
+		m_xs[k] = xs[i];
+		m_ys[k] = ys[i];
+		m_index[k] = (uint32_t)i;
+	}
+
+	// Walk the entities by cell, the neighbouring runs stay in the cache
+	for (size_t k = 0; k < n; ++k)
+	{
+		const uint32_t i = m_index[k];
+		const uint32_t cell = m_cell[i];
+		const int cx = (int)(cell % (uint32_t)m_width);
+		const int cy = (int)(cell / (uint32_t)m_width);
+		const int x1 = math_max(cx - 1, 0);
+		const int x2 = math_min(cx + 1, m_width - 1);
+		const float radiusSq = radii[i] * radii[i];
+		for (int y = math_max(cy - 1, 0); y <= math_min(cy + 1, m_height - 1); ++y)
+		{
+			sweep(
+				m_xs.data(),
+				m_ys.data(),
+				m_start[y * m_width + x1],
+				m_start[y * m_width + x2 + 1],
+				m_xs[k],
+				m_ys[k],
+				radiusSq,
+				forces[i],
+				counts[i]);
+		}
+	}
+
+	used = GameData::get_real_time() - start;
+}
+
+void CrowdSteering::query(const FVec &pos, float radius, FVec &force, int &count) const
+{
+	force = { 0.f, 0.f };
+	count = 0;
+	if (!cells)
+		return;
+
+	const float radiusSq = radius * radius;
+	const int x1 = math_max((int)floorf((pos.x - radius) / m_cellSize) - m_origin.x, 0);
+	const int x2 = math_min((int)floorf((pos.x + radius) / m_cellSize) - m_origin.x, m_width - 1);
+	const int y1 = math_max((int)floorf((pos.y - radius) / m_cellSize) - m_origin.y, 0);
+	const int y2 = math_min((int)floorf((pos.y + radius) / m_cellSize) - m_origin.y, m_height - 1);
+	if (x1 > x2)
+		return;
+	for (int y = y1; y <= y2; ++y)
+	{
+		sweep(
+			m_xs.data(),
+			m_ys.data(),
+			m_start[y * m_width + x1],
+			m_start[y * m_width + x2 + 1],
+			pos.x,
+			pos.y,
+			radiusSq,
+			force,
+			count);
+	}
+}
+
+void CrowdSteering::sweep(
+	const float *xs,
+	const float *ys,
+	size_t first,
+	size_t last,
+	float x,
+	float y,
+	float radiusSq,
+	FVec &force,
+	int &count)
+{
+	// The push of every neighbour is it's direction over it's distance,
+	// which is the offset over the squared distance
+	float fx[LANES]{}, fy[LANES]{};
+	int in[LANES]{};
+	size_t j = first;
+	for (; j + LANES <= last; j += LANES)
+	{
+		for (size_t l = 0; l < LANES; ++l)
+		{
+			const float dx = x - xs[j + l];
+			const float dy = y - ys[j + l];
+			const float distSq = dx * dx + dy * dy;
+			const bool inside = distSq > 0.f && distSq <= radiusSq;
+			const float inv = inside ? 1.f / distSq : 0.f;
+			fx[l] += dx * inv;
+			fy[l] += dy * inv;
+			in[l] += inside;
+		}
+	}
+	for (; j < last; ++j)
+	{
+		const float dx = x - xs[j];
+		const float dy = y - ys[j];
+		const float distSq = dx * dx + dy * dy;
+		if (distSq > 0.f && distSq <= radiusSq)
+		{
+			fx[0] += dx / distSq;
+			fy[0] += dy / distSq;
+			++in[0];
+		}
+	}
+
+	for (size_t l = 0; l < LANES; ++l)
+	{
+		force.x += fx[l];
+		force.y += fy[l];
+		count += in[l];
+	}
+}
+
+uint32_t CrowdSteering::cell_of(float x, float y) const
+{
+	const int cx = (int)floorf(x / m_cellSize) - m_origin.x;
+	const int cy = (int)floorf(y / m_cellSize) - m_origin.y;
+	return (uint32_t)(cy * m_width + cx);
+}
+
+// The entities might be deleted already
+void CrowdSteering::clear()
+{
+	entities.clear();
+	xs.clear();
+	ys.clear();
+	radii.clear();
+	forces.clear();
+	counts.clear();
+	cells = 0u;
+}
@@ -236,13 +236,18 @@ void GameData::clean_world()
 
 	LOG("Cleared building bases successfully");
 
-	for (VariantPtr<PowerNetwork>& vptrNetwork : networks)
-	{
-		delete vptrNetwork.get();
-	}
-	networks.clear();
+	powerGrid.clear();
 	LOG("Cleared networks successfully");
 
+	scheduler.clear();
+	bulletPool.clear();
+	bulletCollision.clear();
+	nearestQueries.clear();
+	dispatcher.clear();
+	aiScheduler.clear();
+	simulationLod.clear();
+	crowd.clear();
+
 	chunks->clear();
 	buildings.clear();
 	entityCitizens.clear();
@@ -258,8 +263,9 @@ void GameData::clean_world()
 	entityQueue.clear();
 	buildingQueue.clear();
 	bodyQueue.clear();
-	addedTiles.clear();
-	removedTiles.clear();
+	worldEvents.clear();
+	pathChanges.blocked.clear();
+	pathChanges.opened = false;
 
 	entityRemoveQueue.clear();
 
@@ -310,45 +316,81 @@ t_idwtree GameData::get_pair(const t_group group, const t_id id)
 	return ret;
 }
 
-std::list<t_idwtree> GameData::get_trees(GameBody *body)
+void GameData::publish_world_snapshot()
 {
-	std::list<t_idwtree> ret;
-	const auto checkValid = [](const std::list<t_idwtree> &ret, const char *type) {
-		return;
-		if (ret.empty())
-			return;
-		return;
+	const WorldSnapshot *last = worldSnapshots.current();
+	WorldSnapshot *snapshot = new WorldSnapshot();
+	snapshot->frame = frameCount;
 
-		LOG_ERROR("Failed search for type \"%s\"", type);
-		assert(0);
-	};
+	for (t_group group = 0; group < ENUM_GROUP_COUNT; ++group)
+	{
+		for (auto &pair : mapEnumTree.groups[group])
+		{
+			t_tiletree &tree = pair.second;
+			const t_idpair treeId{ group, (t_id)pair.first };
+
+			// Share the last copy if the tree didn't change
+			if (last)
+			{
+				auto itr = last->trees.find(treeId);
+				if (itr != last->trees.end() &&
+					itr->second->version == tree.version)
+				{
+					snapshot->trees.emplace(treeId, itr->second);
+					continue;
+				}
+			}
+
+			auto copy = std::make_shared<t_tilesnapshot>();
+			copy->build(tree);
+			snapshot->trees.emplace(treeId, std::move(copy));
+		}
+	}
+
+	worldSnapshots.publish(snapshot);
+}
+
+EpochPublisher<WorldSnapshot>::Guard GameData::read_world_snapshot()
+{
+	return worldSnapshots.read();
+}
 
-	ret.push_back(get_pair(ENUM_BODY_TYPE, (t_id)BodyType::NONE));
+uint16_t GameData::tree_index(const t_group group, const t_id id)
+{
+	auto itr = treeIndices.find({ group, id });
+	if (itr != treeIndices.end())
+		return itr->second;
 
-	ret.push_back(get_pair(ENUM_BODY_TYPE, (t_id)body->type));
-	checkValid(ret, "Body Type");
+	t_tiletree *tree = get_tree(group, id);
+	if (!tree)
+		return UINT16_MAX;
+	assert(treeTable.size() < UINT16_MAX);
+	const uint16_t index = (uint16_t)treeTable.size();
+	treeTable.push_back(tree);
+	treeIndices.emplace(std::make_pair(group, id), index);
+	return index;
+}
 
-	ret.push_back(get_pair(ENUM_ALIGNMENT, (t_id)body->alignment));
-	checkValid(ret, "Aligment");
+BodyTrees GameData::classify_trees(GameBody *body)
+{
+	BodyTrees ret;
+	ret.valid = true;
+	const auto add = [this, &ret](const t_group group, const t_id id) {
+		const uint16_t index = tree_index(group, id);
+		if (index != UINT16_MAX)
+			ret.add(index);
+	};
+
+	add(ENUM_BODY_TYPE, (t_id)BodyType::NONE);
+	add(ENUM_BODY_TYPE, (t_id)body->type);
+	add(ENUM_ALIGNMENT, (t_id)body->alignment);
 
 	switch (body->type)
 	{
 	case BodyType::ENTITY:
 	{
 		EntityBody *entity = dynamic_cast<EntityBody *>(body);
-
-		ret.push_back(get_pair(ENUM_ENTITY_TYPE, (t_id)entity->entityType));
-		checkValid(ret, "Entity Type");
-		/*
-		for (size_t i = (size_t)EntityUse::NONE + 1; i < (size_t)EntityUse::LAST; ++i)
-		{
-			if (build->props.bool_is((PropertyBool)i))
-			{
-				// DEBUG("%d\n", (int)i);
-				ret.push_back(get_pair(ENUM_PROPERTY_BOOL, i));
-				checkValid(ret, "Enum Use");
-			}
-		}*/
+		add(ENUM_ENTITY_TYPE, (t_id)entity->entityType);
 
 		switch (entity->entityType)
 		{
@@ -356,29 +398,18 @@ std::list<t_idwtree> GameData::get_trees(GameBody *body)
 		{
 			EntityCitizen *citizen = dynamic_cast<EntityCitizen *>(entity);
 			if (citizen->job != CitizenJob::NONE)
-			{
-				ret.push_back(get_pair(ENUM_CITIZEN_JOB, (t_id)citizen->job));
-				checkValid(ret, "Citizen Job");
-			}
+				add(ENUM_CITIZEN_JOB, (t_id)citizen->job);
 			break;
 		}
-		break;
 		case EntityType::ENEMY:
 		{
-			EntityEnemy *enemy =
-				dynamic_cast<EntityEnemy *>(entity);
+			EntityEnemy *enemy = dynamic_cast<EntityEnemy *>(entity);
 			if (enemy->enemyType != EntityEnemyType::NONE)
-			{
-				ret.push_back(
-					get_pair(ENUM_ENEMY_TYPE,
-							 (t_id)enemy->enemyType));
-				checkValid(ret, "Enemy Type");
-			}
+				add(ENUM_ENEMY_TYPE, (t_id)enemy->enemyType);
 			break;
 		}
-		break;
 		default:
-			WARNING("Unknown entity type: ", (int)entity->entityType);
+			WARNING("Unknown entity type: %d", (int)entity->entityType);
 			assert(0);
 			break;
 		};
@@ -388,27 +419,18 @@ std::list<t_idwtree> GameData::get_trees(GameBody *body)
 	{
 		BuildingBase *build = dynamic_cast<BuildingBody *>(body)->base;
 		assert(build);
-		ret.push_back(get_pair(ENUM_BUILDING_TYPE, (t_id)build->buildType));
+		add(ENUM_BUILDING_TYPE, (t_id)build->buildType);
 
 		for (size_t i = (size_t)PropertyBool::NONE + 1; i < (size_t)PropertyBool::LAST; ++i)
 		{
 			if (build->props.bool_is((PropertyBool)i))
-			{
-				// DEBUG("%d\n", (int)i);
-				ret.push_back(
-					get_pair(ENUM_PROPERTY_BOOL, i));
-				checkValid(ret, "Enum Use");
-			}
+				add(ENUM_PROPERTY_BOOL, i);
 		}
 
 		// Specified unique enums
 		if (build->props.bool_is(PropertyBool::WORKPLACE) &&
 			build->entities.size() < build->entityLimit)
-		{
-			ret.push_back(get_pair(ENUM_INGAME_PROPERTIES,
-								   (t_id)IngameProperties::NEEDS_WORKERS));
-			checkValid(ret, "Ingame Proeprties");
-		}
+			add(ENUM_INGAME_PROPERTIES, (t_id)IngameProperties::NEEDS_WORKERS);
 	}
 	break;
 	default:
@@ -420,6 +442,43 @@ std::list<t_idwtree> GameData::get_trees(GameBody *body)
 	return ret;
 }
 
+const BodyTrees &GameData::get_trees(GameBody *body)
+{
+	if (!body->trees.valid)
+		body->trees = classify_trees(body);
+	return body->trees;
+}
+
+void GameData::refresh_trees(GameBody *body)
+{
+	// Not in the trees yet, get_trees classifies it when it's added
+	if (!body->trees.valid)
+		return;
+
+	const BodyTrees old = body->trees;
+	body->trees = classify_trees(body);
+
+	// Hidden entities and deleted bodies keep only the classification
+	if (body->dead || (body->type == BodyType::ENTITY && !body->visible))
+		return;
+
+	IVec ipos = vec_pos_to_tile(body->pos);
+	if (body->type == BodyType::BUILDING)
+		ipos = dynamic_cast<BuildingBody *>(body)->tilePos;
+
+	std::lock_guard<std::recursive_mutex> glock(quadTreeMutex);
+	for (uint16_t id : old)
+	{
+		if (!body->trees.has(id))
+			treeTable[id]->remove(ipos, body);
+	}
+	for (uint16_t id : body->trees)
+	{
+		if (!old.has(id))
+			treeTable[id]->insert(ipos, body);
+	}
+}
+
 static std::string make_shorter(const std::string& str)
 {
 	std::vector<std::string> vec;
@@ -429,14 +488,70 @@ static std::string make_shorter(const std::string& str)
 	return vec.at(1);
 }
 
+void GameData::time_pause()
+{
+	if (timePaused >= 0.0f)
+		return;
+	timePaused = get_time();
+}
+
+void GameData::time_resume()
+{
+	timePaused = -1.0f;
+}
+
+void GameData::advance_time(t_seconds step)
+{
+	if (timePaused >= 0.0f)
+		return;
+	if ((double)step != simStep)
+	{
+		simBase = sim_time();
+		simTicks = 0u;
+		simStep = step;
+	}
+	++simTicks;
+}
+
+double GameData::sim_time() const
+{
+	return simBase + (double)simTicks * simStep;
+}
+
 t_body_timer GameData::create_timer(t_seconds start)
 {
-	return timerManager.make_new(start);
+	return t_time_manager::make_independent_timer(start);
+}
+
+TimerHandle GameData::schedule_timer(t_body_timer timer, unsigned *passes)
+{
+	assert(timer && passes);
+	const t_seconds length = timer->m_length;
+	if (length <= 0.0f)
+		return TimerHandle{};
+
+	// Don't fire for every pass that happened while the timer wasn't scheduled
+	const t_seconds time = get_time();
+	if (!timer->bInit ||
+		timer->m_start < 0.0f ||
+		timer->m_start + length < time)
+	{
+		timer->reset(time);
+		timer->bInit = true;
+	}
+
+	return scheduler.schedule(
+		timer->m_start + length,
+		[timer, passes, length]() {
+			timer->m_start += length;
+			++(*passes);
+		},
+		length);
 }
 
-void GameData::add_timer(t_body_timer& timer)
+size_t GameData::update_scheduler()
 {
-	timerManager.add_new(timer);
+	return scheduler.advance(get_time());
 }
 
 std::string GameData::enum_get_str(const t_idpair& pair, bool outShort)
@@ -638,6 +753,8 @@ void GameData::damage_body(GameBody *a, float damage)
 	}
 
 	a->get_hp() -= (int)damage;
+	if (a->context)
+		a->context->simulationLod.mark_combat(a->pos);
 	/*
 	switch (a->type)
 	{
@@ -862,6 +979,9 @@ bool GameData::queue_add_body(BodyQueueData& data)
 
 void GameData::delete_game_body_generic(GameBody* gb)
 {
+	bulletPool.forget_target(gb);
+	dispatcher.forget(gb);
+	aiScheduler.forget(gb);
 	gb->set_target(nullptr);
 
 	// Clear all targets from this object
@@ -914,7 +1034,7 @@ bool GameData::can_build(const BuildingQueueData &data)
 	for (int x = 0; x < step->size.x; ++x)
 		for (int y = 0; y < step->size.y; ++y)
 			if (!this->chunks->has_tile(pos.x + x, pos.y + y) ||
-				this->chunks->get_tile(pos.x + x, pos.y + y).building)
+				this->chunks->get_tile(pos.x + x, pos.y + y).has_building())
 				return false;
 
 	if (useResources)
@@ -933,12 +1053,17 @@ bool GameData::can_build(const BuildingQueueData &data)
 	return true;
 }
 
-std::vector<BuildingBase *>::iterator GameData::delete_building(BuildingBase *build)
+t_obj_ctr<BuildingBase *>::iterator GameData::delete_building(BuildingBase *build, bool silent)
 {
 
 	assert(build);
 	assert(build->get_body());
 
+	if (beforeDeleteBuilding)
+		beforeDeleteBuilding(build);
+	if (infoBuild == build)
+		infoBuild = nullptr;
+
 	auto pos = build->get_body()->tilePos;
 	LOG("Deleting build \"%s\" on: %d %d", build->name, pos.x, pos.y);
 
@@ -1016,23 +1141,28 @@ std::vector<BuildingBase *>::iterator GameData::delete_building(BuildingBase *bu
 	// Remove all workers from building
 	build->entities.clear();
 
+	// Disconnect from the power grid, might split it's network
+	powerGrid.remove(build);
+	build->timers_cancel();
+
 	// Remove all bodies
 	for (BuildingBody *body : build->get_bodies())
 	{
 		sf::Vector2i &tilePos = body->tilePos;
-		removedTiles.push_back(tilePos);
+		if (!silent)
+		{
+			worldEvents.push({ WorldEvent::BUILDING_REMOVED, false, tilePos, build });
+			if (build->props.bool_is(PropertyBool::BARRIER))
+				worldEvents.push({ WorldEvent::BARRIER_CHANGED, false, tilePos, build });
+		}
 		body->dead = true;
-		this->buildings.erase(
-			std::find(this->buildings.begin(),
-			this->buildings.end(),
-			body));
-		Tile &tile = chunks->get_tile(tilePos.x, tilePos.y);
-		tile.building = nullptr;
+		this->buildings.erase_value(body, body->slot);
+		chunks->set_build(tilePos.x, tilePos.y, nullptr);
 
 		// Erase that buiding pointer from the list and the quadTree
-		for (auto& pair : get_trees(body))
+		for (uint16_t id : get_trees(body))
 		{
-			t_tiletree *tree = pair.second;
+			t_tiletree *tree = treeTable[id];
 
 			//std::lock_guard<std::recursive_mutex> glock(quadTreeMutex);
 			bool b = tree->remove(tilePos, body);
@@ -1065,10 +1195,7 @@ std::vector<BuildingBase *>::iterator GameData::delete_building(BuildingBase *bu
 
 	constructions.erase_value(build);
 
-	auto itrBuildBase = std::find(
-		this->buildingBases.begin(),
-		this->buildingBases.end(),
-		build);
+	auto itrBuildBase = buildingBases.find(build, build->slot);
 	ASSERT_ERROR(itrBuildBase != buildingBases.end(),
 				 "Deleted building base cannot be found in the buildings list.");
 	auto itr = buildingBases.erase(itrBuildBase);
@@ -1077,16 +1204,61 @@ std::vector<BuildingBase *>::iterator GameData::delete_building(BuildingBase *bu
 	return itr;
 }
 
-std::vector<BuildingBase *>::iterator GameData::delete_building(const sf::Vector2i &pos)
+t_obj_ctr<BuildingBase *>::iterator GameData::delete_building(const sf::Vector2i &pos)
 {
 	// Find tile
-	Tile &tile = this->chunks->get_tile(pos.x, pos.y);
-	assert(tile.building);
-	BuildingBase *build = tile.building->base;
+	BuildingBase *build = this->chunks->get_base(pos.x, pos.y);
+	assert(build);
 
 	return delete_building(build);
 }
 
+size_t GameData::compact_buildings()
+{
+	size_t moved = 0u;
+	if (buildings.holes() > buildings.size())
+	{
+		moved += buildings.compact(
+			[](VariantPtr<BuildingBody> &body, NodeHandle h) {
+				body->slot = h;
+			});
+	}
+	if (buildingBases.holes() > buildingBases.size())
+	{
+		moved += buildingBases.compact(
+			[](BuildingBase *build, NodeHandle h) {
+				build->slot = h;
+			});
+	}
+
+	for (BuildingBase *build : buildingBases)
+	{
+		if (build->entities.holes() > build->entities.size())
+		{
+			moved += build->entities.compact(
+				[build](VariantPtr<EntityBody> &e, NodeHandle h) {
+					EntityCitizen *citizen = dynamic_cast<EntityCitizen *>(e.get());
+					if (!citizen)
+						return;
+					if (citizen->home == build)
+						citizen->homeSlot = h;
+					if (citizen->workplace == build)
+						citizen->workSlot = h;
+				});
+		}
+		if (build->storedEntities.holes() > build->storedEntities.size())
+		{
+			moved += build->storedEntities.compact(
+				[](VariantPtr<EntityBody> &e, NodeHandle h) {
+					EntityCitizen *citizen = dynamic_cast<EntityCitizen *>(e.get());
+					if (citizen)
+						citizen->storedSlot = h;
+				});
+		}
+	}
+	return moved;
+}
+
 bool GameData::confirm_building_base(BuildingBase *build)
 {
 	Vec<int> pos = build->tilePos;
@@ -1094,7 +1266,7 @@ bool GameData::confirm_building_base(BuildingBase *build)
 	LOG("Building build \"%s\" on: %d %d", build->name, pos.x, pos.y);
 
 	// Add to bases list
-	this->buildingBases.push_back(build);
+	build->slot = this->buildingBases.push_back(build);
 
 	build->network = nullptr;
 	build->context = this;
@@ -1104,71 +1276,8 @@ bool GameData::confirm_building_base(BuildingBase *build)
 	if (!isNetwork)
 		return true;
 
-	// Search for nearest network
+	// Every power building in reach is a neighbour in the grid
 	auto nearest = nearest_buildings_radius_quad(
-		(sf::Vector2f)pos + sf::Vector2f{0.5f, 0.5f},
-		1,
-		(int)get_const(t_constflt::MAX_NETWORK_RADIUS),
-		t_idpair{ENUM_PROPERTY_BOOL, (t_id)PropertyBool::POWER_NETWORK},
-		[build](const sf::Vector2i &, const GameBody *gb, const int dist) {
-			const BuildingBody *other = dynamic_cast<const BuildingBody *>(gb);
-			const BuildingBase *base = other->base;
-			if (base->network)
-			{
-				return dist < powf(math_min(
-									   base->effectRadius,
-									   build->effectRadius),
-								   2);
-			}
-			return false;
-		});
-
-	constexpr bool ONE_NETWORK = false;
-	// If there's a nearby network
-	if (nearest.size())
-	{
-		build->network = nearest.front()->base->network;
-		LOG("%s", nearest.front()->base->name);
-	}
-	else if (networks.size() && ONE_NETWORK)
-	{
-		// Use an existing network
-		build->network = networks.back();
-	}
-	else
-	{
-		// Create new network
-		networks.push_back(new PowerNetwork(objectIdCounter.advance<PowerNetwork>()));
-		build->network = networks.back();
-	}
-
-	// If the building doesn't generates electricity
-	if (build->powerOut == 0 || build->entityLimit == 0)
-	{
-		// Add to the network
-		build->network->add(build);
-	}
-	else
-	{
-		// Enumurate through the 3 types of power building:
-		// IN, OUT and STORE
-		for (int i = 0; i < 3; ++i)
-		{
-			PowerNetwork::Use u = (PowerNetwork::Use)i;
-			assert(build->network);
-			if (!PowerNetwork::resource(
-					build,
-					(PowerNetwork::Use)i))
-				continue;
-			// Add the building to it's corresponding use'
-			build->network->add(build, u, false);
-		}
-	}
-
-	// Search and combine networks
-	// todo: there's must be a more efficient way
-	// two combine two networks
-	nearest = nearest_buildings_radius_quad(
 		(sf::Vector2f)pos + sf::Vector2f{0.5f, 0.5f},
 		SMALL_INFINITY,
 		(int)get_const(t_constflt::MAX_NETWORK_RADIUS),
@@ -1176,31 +1285,19 @@ bool GameData::confirm_building_base(BuildingBase *build)
 		[build](const sf::Vector2i &, const GameBody *gb, const int dist) {
 			const BuildingBody *other = dynamic_cast<const BuildingBody *>(gb);
 			const BuildingBase *base = other->base;
+			if (base == build || base->powerNode == PowerGrid::NULL_NODE)
+				return false;
 			float maxD = math_max(base->effectRadius, build->effectRadius);
-			return dist < maxD;
+			return dist < maxD * maxD;
 		});
 
-	for (auto &bodyBuild : nearest)
-	{
-		// Merge first network with the second
-		if ((intptr_t)bodyBuild->base->network != (intptr_t)build->network)
-			PowerNetwork::merge(bodyBuild->base->network, build->network);
-		// todo better performance?
+	std::vector<BuildingBase *> neighbours;
+	neighbours.reserve(nearest.size());
+	for (BuildingBody *body : nearest)
+		neighbours.push_back(body->base);
 
-		// Replace old network with new one for all buildings
-		for (auto &treeBody : *get_tree(ENUM_PROPERTY_BOOL, (t_id)PropertyBool::POWER_NETWORK))
-		{
-			BuildingBase *base = dynamic_cast<BuildingBody *>(treeBody)->base;
-			if (base->network == build->network)
-				base->network = bodyBuild->base->network;
-		}
-
-		// Remove deleted network from the container
-		*std::find(
-			networks.begin(),
-			networks.end(),
-			build->network) = bodyBuild->base->network;
-	}
+	// Connect and merge networks
+	powerGrid.add(build, neighbours);
 
 	return true;
 }
@@ -1272,11 +1369,6 @@ BuildingBase* GameData::add_building(const BuildingQueueData& queue, bool update
 
 	LOG("Building build \"%s\" on: %d %d", build->name, pos.x, pos.y);
 
-	// Confirm that the path hs been changed
-	if (updatePath)
-		for (int x = 0; x < build->tilesSize.x; ++x)
-			for (int y = 0; y < build->tilesSize.y; ++y)
-				addedTiles.push_back({ x, y });
 	//DEBUG("%s", VEC_CSTR(build->tilesSize));
 
 	// Add construction data
@@ -1321,6 +1413,11 @@ BuildingBase* GameData::add_building(const BuildingQueueData& queue, bool update
 				objectIdCounter.advance<BuildingBody>());
 
 			body->confirm_body(this);
+
+			worldEvents.push({ WorldEvent::BUILDING_PLACED, true, pos + tileIndex, build });
+			// Confirm that the path has been changed
+			if (updatePath && build->props.bool_is(PropertyBool::BARRIER))
+				worldEvents.push({ WorldEvent::BARRIER_CHANGED, true, pos + tileIndex, build });
 		}
 	}
 
@@ -1391,10 +1488,10 @@ bool GameData::get_free_neighbor(sf::Vector2f& outPos, const FVec& pos)
 		return true;
 	}
 
-	if (tile.building != nullptr)
+	if (BuildingBase *b = chunks->get_base(ipos.x, ipos.y))
 	{
-		tilePos = tile.building->base->tilePos;
-		tileSize = tile.building->base->tilesSize;
+		tilePos = b->tilePos;
+		tileSize = b->tilesSize;
 	}
 	
 	std::vector<sf::Vector2i> pendingPositions;
@@ -1480,7 +1577,7 @@ EntityCitizen* GameData::add_entity_citizen(
 				(sf::Vector2f)posi + sf::Vector2f{ .5f, .5f },
 				stats);
 			e->home = build;
-			build->entities.push_back(e);
+			e->homeSlot = build->entities.push_back(e);
 			return true;
 		}
 		return false;
@@ -1502,18 +1599,62 @@ EntityCitizen* GameData::add_entity_citizen(
 	return e;
 }
 
-BulletBody* GameData::add_bullet(
+uint32_t GameData::add_bullet(
 	const FVec& pos,
-	const FVec& dir,
-	EntityStats* stats)
-{
-	BulletBody* e = new BulletBody(
-		this, objectIdCounter.advance<BulletBody>(),
-		pos, dir, 
-		-1, (t_id)EnumAlignment::NEUTRAL);
-	if (stats)
-		e->apply_data(dynamic_cast<GameBodyConfig*>(stats));
-	return (e->confirm_body(this) ? e : nullptr);
+	const FVec& vel,
+	const BulletStats* stats,
+	t_alignment alignment,
+	GameBody* target)
+{
+	return bulletPool.spawn(pos, vel, stats, alignment, target);
+}
+
+void GameData::update_bullets(float delta)
+{
+	bulletPool.update(delta, bulletCollision);
+	bulletCollision.solve(chunks);
+	bulletPool.resolve(bulletCollision);
+	bulletCollision.clear();
+}
+
+size_t GameData::queue_nearest(
+	const FVec &pos,
+	size_t limit,
+	t_idpair treeId,
+	t_nearest_batch::t_condition condition)
+{
+	PROFILE_COUNT("Quadtree queries", 1);
+	return nearestQueries.add(
+		get_tree(treeId.group, treeId.id),
+		vec_pos_to_tile(pos),
+		limit,
+		t_tiletree::MAX_FLOAT,
+		std::move(condition),
+		DEFAULT_SCORER(pos));
+}
+
+void GameData::solve_nearest()
+{
+	PROFILE_ZONE("Nearest queries");
+	std::lock_guard<std::recursive_mutex> lock(quadTreeMutex);
+	nearestQueries.solve();
+}
+
+void GameData::clear_nearest()
+{
+	nearestQueries.clear();
+}
+
+size_t GameData::get_nearest_count(size_t query) const
+{
+	return nearestQueries.size(query);
+}
+
+GameBody *GameData::get_nearest(size_t query, size_t index) const
+{
+	if (index >= nearestQueries.size(query))
+		return nullptr;
+	return nearestQueries.begin(query)[index];
 }
 
 
@@ -1591,9 +1732,9 @@ void GameData::move_entity(EntityBody *entity, const sf::Vector2f &posA, const s
 	sf::Vector2i iposA = vec_pos_to_tile(posA);
 	sf::Vector2i iposB = vec_pos_to_tile(posB);
 
-	for (auto& pair : get_trees(entity))
+	for (uint16_t id : get_trees(entity))
 	{
-		t_tiletree* tree = pair.second;
+		t_tiletree *tree = treeTable[id];
 		//std::lock_guard<std::recursive_mutex> glock(quadTreeMutex);
 		bool bol = tree->move(iposA, iposB, dynamic_cast<GameBody*>(entity));
 		if (!bol)
@@ -1635,13 +1776,16 @@ void GameData::move_entity(EntityBody *entity, const sf::Vector2f &posA, const s
 		{
 			gridA->remove_entity(entity);
 			gridB->insert_entity(entity);
+			worldEvents.push({ WorldEvent::ENTITY_LEFT_CHUNK, false, iposA, entity });
+			worldEvents.push({ WorldEvent::ENTITY_ENTERED_CHUNK, true, iposB, entity });
 		}
 		//assert(chunks->has_tile(iposA.x, iposA.y));
 		Tile& a = chunks->get_tile(iposA.x, iposA.y);
 		//assert(chunks->has_tile(iposB.x, iposB.y));
 		Tile& b = chunks->get_tile(iposB.x, iposB.y);
-		assert(a.remove_entity(entity));
-		b.entities.push_back(entity);
+		// Hidden entities aren't on any tile
+		if (gridA->unlink_entity(a, entity))
+			gridB->link_entity(b, entity);
 	}
 
 	entity->pos = posB;
@@ -1654,9 +1798,9 @@ void GameData::move_body(GameBody* body, const sf::Vector2f& posA, const sf::Vec
 	sf::Vector2i iposA = vec_pos_to_tile(posA);
 	sf::Vector2i iposB = vec_pos_to_tile(posB);
 
-	for (auto& pair : get_trees(body))
+	for (uint16_t id : get_trees(body))
 	{
-		t_tiletree* tree = pair.second;
+		t_tiletree *tree = treeTable[id];
 		//std::lock_guard<std::recursive_mutex> glock(quadTreeMutex);
 		bool bol = tree->move(iposA, iposB, body);
 		if (!bol)
@@ -1703,6 +1847,8 @@ void GameData::move_body(GameBody* body, const sf::Vector2f& posA, const sf::Vec
 				EntityBody* entity = dynamic_cast<EntityBody*>(body);
 				gridA->remove_entity(entity);
 				gridB->insert_entity(entity);
+				worldEvents.push({ WorldEvent::ENTITY_LEFT_CHUNK, false, iposA, entity });
+				worldEvents.push({ WorldEvent::ENTITY_ENTERED_CHUNK, true, iposB, entity });
 			}
 		}
 		//assert(chunks->has_tile(iposA.x, iposA.y));
@@ -1713,8 +1859,8 @@ void GameData::move_body(GameBody* body, const sf::Vector2f& posA, const sf::Vec
 		if (body->type == BodyType::ENTITY)
 		{
 			EntityBody* entity = dynamic_cast<EntityBody*>(body);
-			assert(a.remove_entity(entity));
-			b.entities.push_back(entity);
+			if (gridA->unlink_entity(a, entity))
+				gridB->link_entity(b, entity);
 		}
 	}
 	
@@ -1723,28 +1869,37 @@ void GameData::move_body(GameBody* body, const sf::Vector2f& posA, const sf::Vec
 
 void GameData::delete_entity(EntityBody*e)
 {
+	if (beforeDeleteEntity)
+		beforeDeleteEntity(e);
+	if (infoEntity == e)
+		infoEntity = nullptr;
+
 	sf::Vector2i ipos = vec_pos_to_tile(e->pos);
 
 	chunks->get_grid(ipos.x, ipos.y)->remove_entity(e);
+	// Hidden entities left already
+	if (e->visible)
+		worldEvents.push({ WorldEvent::ENTITY_LEFT_CHUNK, false, ipos, e });
 
 	// mapEnumTree
 
 	if (this->chunks->has_tile(ipos.x, ipos.y))
 	{
-		Tile &t = chunks->get_tile(ipos.x, ipos.y);
-		t.remove_entity(e);
+		chunks->remove_entity(ipos.x, ipos.y, e);
 
 		// horrible! just bcuase an entity is not visible does not exists it doesn't exists at all
 		if (e->visible)
 		{
-			for (auto& pair : get_trees(e))
+			for (uint16_t id : get_trees(e))
 			{
-				auto tree = pair.second;
+				t_tiletree *tree = treeTable[id];
 				std::lock_guard<std::recursive_mutex> glock(quadTreeMutex);
 				ASSERT_ERROR(IGNORE_ASSERT | tree->remove(ipos, e), "QuadTree Citizen remove failed");
 			}
 		}
 	}
+	// Out of every tree, leaving the workplace below doesn't move it
+	e->trees.valid = false;
 
 	switch (e->entityType)
 	{
@@ -1766,13 +1921,11 @@ void GameData::delete_entity(EntityBody*e)
 		{
 			BuildingBase *home;
 			home = citizen->home;
-			auto itr = std::find(
-				home->entities.begin(),
-				home->entities.end(),
-				citizen);
+			auto itr = home->entities.find(citizen, citizen->homeSlot);
 			assert(itr != home->entities.end());
 			home->entities.erase(itr);
 			home->actionTimer->reset(get_time());
+			home->timers_schedule();
 		}
 
 		break;
@@ -1787,9 +1940,9 @@ void GameData::show_entity(EntityBody*e)
 	e->visible = true;
 
 	sf::Vector2i ipos = vec_pos_to_tile(e->pos);
-	for (auto &pair : get_trees(e))
+	for (uint16_t id : get_trees(e))
 	{
-		auto tree = pair.second;
+		t_tiletree *tree = treeTable[id];
 		std::lock_guard<std::recursive_mutex> glock(quadTreeMutex);
 		ASSERT_ERROR(IGNORE_ASSERT | tree->insert(ipos, e), "QuadTree insert failed");
 		assert(tree->get_pair(ipos, e).second->type);
@@ -1797,6 +1950,7 @@ void GameData::show_entity(EntityBody*e)
 
 	Grid* gridA = chunks->get_grid(ipos.x, ipos.y);
 	gridA->insert_entity(e);
+	worldEvents.push({ WorldEvent::ENTITY_ENTERED_CHUNK, true, ipos, e });
 }
 
 void GameData::hide_entity(EntityBody*e)
@@ -1804,9 +1958,9 @@ void GameData::hide_entity(EntityBody*e)
 	e->visible = false;
 
 	IVec ipos = vec_pos_to_tile(e->pos);
-	for (auto &pair : get_trees(e))
+	for (uint16_t id : get_trees(e))
 	{
-		auto tree = pair.second;
+		t_tiletree *tree = treeTable[id];
 		std::lock_guard<std::recursive_mutex> glock(quadTreeMutex);
 		bool b = tree->remove(ipos, e);
 		if (!b)
@@ -1818,6 +1972,7 @@ void GameData::hide_entity(EntityBody*e)
 
 	Grid* gridA = chunks->get_grid(ipos.x, ipos.y);
 	gridA->remove_entity(e);
+	worldEvents.push({ WorldEvent::ENTITY_LEFT_CHUNK, false, ipos, e });
 
 	for (GameBody* follower : e->followers)
 	{
@@ -1826,6 +1981,21 @@ void GameData::hide_entity(EntityBody*e)
 	}
 }
 
+void GameData::update_path_changes()
+{
+	pathChanges.blocked.clear();
+	pathChanges.opened = false;
+	const bool complete = worldEvents.read(pathCursor, [this](const WorldEvent &e) {
+		if (e.value)
+			pathChanges.blocked.mark(e.tile);
+		else
+			pathChanges.opened = true;
+	});
+	// Lost track, every path is checked again
+	if (!complete)
+		pathChanges.opened = true;
+}
+
 std::list<EntityBody*> GameData::nearest_entities_radius(
 	const sf::Vector2f &pos,
 	float radius,
@@ -1860,10 +2030,9 @@ GameData::nearest_buildings_aabb(const sf::Vector2f &pos, float radius, size_t l
 	{
 		for (int j = y1; j <= y2; ++j)
 		{
-			Tile &tile = this->chunks->get_tile(i, j);
-			if (!tile.building)
+			BuildingBody *b = this->chunks->get_build(i, j);
+			if (!b)
 				continue;
-			BuildingBody *b = tile.building;
 			float dist = aabb_distance_point(pos, b->pos, {1.f, 1.f});
 			if (dist >= radiusSq)
 				continue;
@@ -1889,6 +2058,8 @@ std::list<BuildingBody *> GameData::nearest_buildings_radius(const sf::Vector2f
 
 std::list<BuildingBody *> GameData::nearest_buildings_aabb(const sf::Vector2f &pos, const sf::Vector2f &size, const float radius, const size_t limit)
 {
+	PROFILE_ZONE("Quadtree query");
+	PROFILE_COUNT("Quadtree queries", 1);
 	const auto pairLess = [pos, size](const BuildingBody *a, const BuildingBody *b) {
 		return aabb_distance_rectangle(pos, size, a->pos, a->rectSize) <
 			   aabb_distance_rectangle(pos, size, b->pos, b->rectSize);
@@ -1902,13 +2073,9 @@ std::list<BuildingBody *> GameData::nearest_buildings_aabb(const sf::Vector2f &p
 	{
 		for (int j = y1; j <= y2; ++j)
 		{
-			if (!this->chunks->has_tile(i, j))
-				continue;
-
-			Tile &tile = this->chunks->get_tile(i, j);
-			if (!tile.building)
+			BuildingBody *b = this->chunks->get_build(i, j);
+			if (!b)
 				continue;
-			BuildingBody *b = tile.building;
 			float dist = aabb_distance_rectangle(
 				pos,
 				size,
@@ -1927,6 +2094,8 @@ std::list<BuildingBody *> GameData::nearest_buildings_aabb(const sf::Vector2f &p
 
 std::list<BuildingBody *> GameData::nearest_bodies_quad(const sf::Vector2f &pos, size_t limit)
 {
+	PROFILE_ZONE("Quadtree query");
+	PROFILE_COUNT("Quadtree queries", 1);
 	std::list<BuildingBody *> ret;
 	auto inserter = std::back_inserter(ret);
 
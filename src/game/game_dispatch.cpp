@@ -0,0 +1,318 @@
+#include "game/game_dispatch.hpp"
+
+#include "game/game_data.hpp"
+#include "../pathfind.hpp"
+
+#include <algorithm>
+
+JobDispatcher::JobDispatcher(GameData *context)
+	: context(context)
+{
+}
+
+bool JobDispatcher::request(
+	EntityCitizen *citizen,
+	Demand demand,
+	const Resources &resources)
+{
+	assert(citizen);
+	if (citizen->dispatchSkip & (1u << (unsigned)demand))
+		return false;
+	if (citizen->dispatchQueued)
+		return true;
+	citizen->dispatchQueued = true;
+
+	Request request;
+	request.citizen = citizen;
+	request.demand = demand;
+	request.resources = resources;
+	requests.push_back(request);
+	return true;
+}
+
+void JobDispatcher::forget(const GameBody *body)
+{
+	requests.erase(
+		std::remove_if(requests.begin(), requests.end(),
+			[body](const Request &request) {
+				return request.citizen == body;
+			}),
+		requests.end());
+}
+
+bool JobDispatcher::valid(const Request &request) const
+{
+	const EntityCitizen *citizen = request.citizen;
+	if (citizen->get_hp() <= 0)
+		return false;
+	if (request.demand == Demand::WORKPLACE)
+		return citizen->workplace == nullptr && citizen->job == CitizenJob::NONE;
+	return citizen->workplace != nullptr;
+}
+
+size_t JobDispatcher::queue(const Request &request)
+{
+	t_weights *weights = &context->resourceWeights;
+	EntityCitizen *citizen = request.citizen;
+
+	switch (request.demand)
+	{
+	case Demand::WORKPLACE:
+		return context->queue_nearest(
+			citizen->pos,
+			CANDIDATES,
+			{ ENUM_INGAME_PROPERTIES, (t_id)IngameProperties::NEEDS_WORKERS },
+			[](const sf::Vector2i&, GameBody* const& gb, const int&)
+			{
+				// The entityLimit can be changed manually in the
+				// init function, so the tree might be inaccurate
+				const BuildingBase* b = dynamic_cast<const BuildingBody*>(gb)->base;
+				return b->entities.size() < b->entityLimit;
+			});
+	case Demand::STORAGE:
+	{
+		const Resources *resources = &request.resources;
+		return context->queue_nearest(
+			citizen->pos,
+			CANDIDATES,
+			{ ENUM_PROPERTY_BOOL, (t_id)PropertyBool::ANY_STORAGE },
+			[citizen, resources, weights](const sf::Vector2i&, GameBody* const& gb, const int&)
+			{
+				const BuildingBase* b = dynamic_cast<const BuildingBody*>(gb)->base;
+				return Resources::can_transfer(
+					citizen->rInventory,
+					b->rStorage,
+					weights,
+					b->weightCap,
+					b->rStoreCap,
+					*resources);
+			});
+	}
+	case Demand::GATHER:
+		return context->queue_nearest(
+			citizen->pos,
+			CANDIDATES,
+			{ ENUM_PROPERTY_BOOL, (t_id)PropertyBool::ANY_STORAGE },
+			[citizen, weights](const sf::Vector2i&, GameBody* const& gb, const int&)
+			{
+				const BuildingBase* b = dynamic_cast<const BuildingBody*>(gb)->base;
+				return Resources::can_transfer(
+					b->rStorage,
+					citizen->rInventory,
+					weights,
+					citizen->inventorySize,
+					citizen->rInventoryCap,
+					citizen->workplace->rIn);
+			});
+	case Demand::DELIVER:
+		return context->queue_nearest(
+			citizen->pos,
+			CANDIDATES,
+			{ ENUM_PROPERTY_BOOL, (t_id)PropertyBool::WORKPLACE },
+			[citizen, weights](const sf::Vector2i&, GameBody* const& gb, const int&)
+			{
+				const BuildingBase* b = dynamic_cast<const BuildingBody*>(gb)->base;
+				if (!citizen->rInventory.has_bool(b->rIn))
+					return false;
+				return Resources::can_transfer(
+					citizen->rInventory,
+					b->rStorage,
+					weights,
+					b->weightCap,
+					b->rStoreCap,
+					b->rIn);
+			});
+	case Demand::PICKUP:
+		return context->queue_nearest(
+			citizen->pos,
+			CANDIDATES,
+			{ ENUM_PROPERTY_BOOL, (t_id)PropertyBool::WORKPLACE },
+			[weights](const sf::Vector2i&, GameBody* const& gb, const int&)
+			{
+				const BuildingBase* b = dynamic_cast<const BuildingBody*>(gb)->base;
+				// If the building has resources, and it doesn't use them
+				return !b->rStorage.empty() &&
+					b->rStorage.has_bool(b->rIn.reverse_bool(weights));
+			});
+	}
+	return SIZE_MAX;
+}
+
+void JobDispatcher::solve()
+{
+	assigned = 0u;
+	paths = 0u;
+	if (requests.empty())
+		return;
+
+	t_weights *weights = &context->resourceWeights;
+
+	// Search the candidates of every request at once
+	for (Request &request : requests)
+		request.query = valid(request) ? queue(request) : SIZE_MAX;
+	context->solve_nearest();
+
+	m_pairs.clear();
+	m_slots.clear();
+	m_reserved.clear();
+	m_taken.clear();
+	for (size_t r = 0; r < requests.size(); ++r)
+	{
+		const Request &request = requests[r];
+		if (request.query == SIZE_MAX)
+			continue;
+		const IVec tile = vec_pos_to_tile(request.citizen->pos);
+		for (size_t i = 0; i < context->get_nearest_count(request.query); ++i)
+		{
+			BuildingBody *body = dynamic_cast<BuildingBody *>(
+				context->get_nearest(request.query, i));
+			assert(body);
+			m_pairs.push_back({ vec_distsq(tile, body->tilePos), r, body });
+
+			BuildingBase *base = body->base;
+			m_slots.emplace(base, (int)base->entityLimit - (int)base->entities.size());
+			m_reserved.emplace(base, 0);
+			m_taken.emplace(base, 0);
+		}
+	}
+
+	// Closest pairs first
+	std::stable_sort(m_pairs.begin(), m_pairs.end(),
+		[](const Pair &a, const Pair &b) { return a.distsq < b.distsq; });
+
+	m_done.assign(requests.size(), 0);
+	for (const Pair &pair : m_pairs)
+	{
+		if (m_done[pair.request])
+			continue;
+		const Request &request = requests[pair.request];
+		EntityCitizen *citizen = request.citizen;
+		BuildingBase *base = pair.body->base;
+
+		int moved = 0;
+		switch (request.demand)
+		{
+		case Demand::WORKPLACE:
+			if (m_slots[base] <= 0)
+				continue;
+			break;
+		case Demand::STORAGE:
+		case Demand::DELIVER:
+		{
+			// Other citizens may already be carrying stuff there
+			const Resources &filter = request.demand == Demand::STORAGE ?
+				request.resources : base->rIn;
+			moved = citizen->rInventory.bool_pass(filter).weight(weights);
+			if (base->weightCap != -1 &&
+				base->rStorage.bool_pass(filter).weight(weights) +
+				m_reserved[base] >= base->weightCap)
+				continue;
+			break;
+		}
+		case Demand::GATHER:
+		case Demand::PICKUP:
+		{
+			// Other citizens may already be taking it
+			const Resources filter = request.demand == Demand::GATHER ?
+				citizen->workplace->rIn : base->rIn.reverse_bool(weights);
+			const int left =
+				base->rStorage.bool_pass(filter).weight(weights) - m_taken[base];
+			if (left <= 0)
+				continue;
+			const int space =
+				citizen->inventorySize - citizen->rInventory.weight(weights);
+			moved = math_min(left, math_max(space, 1));
+			break;
+		}
+		}
+
+		if (!assign(request, pair.body))
+			continue;
+
+		m_done[pair.request] = 1;
+		if (request.demand == Demand::WORKPLACE)
+			--m_slots[base];
+		else if (request.demand == Demand::STORAGE ||
+			request.demand == Demand::DELIVER)
+			m_reserved[base] += moved;
+		else
+			m_taken[base] += moved;
+		++assigned;
+	}
+
+	// Every request is answered, now the citizens may queue new ones
+	std::vector<Request> unanswered;
+	for (size_t r = 0; r < requests.size(); ++r)
+	{
+		requests[r].citizen->dispatchQueued = false;
+		if (!m_done[r] && requests[r].query != SIZE_MAX &&
+			requests[r].demand != Demand::WORKPLACE)
+			unanswered.push_back(requests[r]);
+	}
+	requests.clear();
+
+	// Nothing found, the worker goes on with it's next choice
+	for (const Request &request : unanswered)
+	{
+		EntityCitizen *citizen = request.citizen;
+		citizen->dispatchSkip |= 1u << (unsigned)request.demand;
+		citizen->dispatchRetry = true;
+		citizen->logic_reset_worker();
+	}
+}
+
+bool JobDispatcher::assign(const Request &request, BuildingBody *body)
+{
+	EntityCitizen *citizen = request.citizen;
+
+	const int dijkstra = (int)context->get_const(
+		t_constnum::A_STAR_DIJKSTRA_VALUE);
+	const int greed = (int)context->get_const(
+		t_constnum::A_STAR_GREED_VALUE);
+	PathData path = generate_path(
+		vec_pos_to_tile(citizen->pos),
+		body->tilePos,
+		context->chunks,
+		dijkstra,
+		greed);
+	++paths;
+	if (!path.valid())
+		return false;
+
+	switch (request.demand)
+	{
+	case Demand::WORKPLACE:
+		body->base->accept_entity(citizen);
+		citizen->nextAction = Action::GET_JOB;
+		break;
+	case Demand::STORAGE:
+		citizen->nextAction = Action::TRANSFER;
+		citizen->rActionBool = request.resources;
+		break;
+	case Demand::GATHER:
+		citizen->nextAction = Action::COLLECT;
+		citizen->rActionBool = citizen->workplace->rIn.to_bool();
+		break;
+	case Demand::DELIVER:
+		citizen->nextAction = Action::TRANSFER;
+		citizen->rActionBool = body->base->rIn;
+		break;
+	case Demand::PICKUP:
+		citizen->nextAction = Action::COLLECT;
+		citizen->rActionBool = body->base->rStorage.to_bool();
+		break;
+	}
+	citizen->set_path(std::move(path));
+	return true;
+}
+
+// The citizens might be deleted already
+void JobDispatcher::clear()
+{
+	requests.clear();
+	m_pairs.clear();
+	m_done.clear();
+	m_slots.clear();
+	m_reserved.clear();
+	m_taken.clear();
+}
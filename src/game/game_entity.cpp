@@ -22,6 +22,23 @@ extern "C"
 #include "../libs/prng.h"
 };
 
+// Building at the end of the path, null if there is none
+static BuildingBody *path_building(const GameData *context, const PathData &path)
+{
+	if (!path.hasDestination)
+		return nullptr;
+	return context->chunks->get_build(path.destPos.x, path.destPos.y);
+}
+
+// Walking speed multiplier of the ground under "pos"
+static float terrain_speed(const Chunks *chunks, const FVec &pos)
+{
+	const IVec tile = vec_pos_to_tile(pos);
+	if (!chunks->has_tile(tile.x, tile.y))
+		return 1.f;
+	return chunks->get_tile(tile.x, tile.y).speed();
+}
+
 #define EPIC_TEST2()
 
 #define TRANSFER_TB_DEBUG(entity, build)                                                         \
@@ -41,9 +58,9 @@ PathData::PathData(size_t id)
 
 bool PathData::valid() const
 {
-	return destination &&
+	return hasDestination &&
 		   path.size() &&
-		   path.back().value == destination->tilePos;
+		   path.back().value == destPos;
 }
 
 inline bool PathData::finished() const
@@ -71,11 +88,11 @@ constexpr std::size_t constexpr_strlen(const char* s)
 
 std::string PathData::why_invalid() const
 {
-	if (!destination)
+	if (!hasDestination)
 		return std::string("No destination");
 	else if (path.empty())
 		return std::string("No path");
-	else if (path.back().value != destination->tilePos)
+	else if (path.back().value != destPos)
 	{
 		constexpr const char ogMsg[] =
 			"Path doesn't lead to destination: Path stops in %s while dest is %s";
@@ -83,7 +100,7 @@ std::string PathData::why_invalid() const
 		sprintf(msg,
 				ogMsg,
 				VEC_CSTR(path.back().value),
-				VEC_CSTR(destination->tilePos));
+				VEC_CSTR(destPos));
 		return std::string(msg);
 	}
 
@@ -103,7 +120,7 @@ void PathData::pop()
 
 void PathData::clear()
 {
-	destination = nullptr;
+	hasDestination = false;
 	path.clear();
 }
 
@@ -191,8 +208,7 @@ void PathData::serialize_initialize(const SerializeMap &map)
 	GameData *g = map.get<GameData>(SERIALIZABLE_DATA, 0);
 	assert(g);
 	this->objectId = g->objectIdCounter.advance<PathData>();
-	this->destination =
-		&g->chunks->get_tile(destPos.x, destPos.y);
+	this->hasDestination = true;
 }
 
 // Json stuff
@@ -443,17 +459,16 @@ bool EntityBody::confirm_body(GameData* context)
 	grid->insert_entity(dynamic_cast<EntityBody *>(this));
 	if (!context->chunks->has_tile(ipos.x, ipos.y))
 		return false;
-	Tile &tile = context->chunks->get_tile(ipos.x, ipos.y);
 
-	for (auto& pair : context->get_trees(this))
+	for (uint16_t id : context->get_trees(this))
 	{
-		auto tree = pair.second;
+		t_tiletree *tree = context->treeTable[id];
 		ASSERT_ERROR(
 			(tree->insert(ipos, dynamic_cast<GameBody *>(this))),
 			"QuadTree Citizen can't insert citizen.");
 	}
 
-	tile.entities.push_back(this);
+	context->chunks->add_entity(ipos.x, ipos.y, this);
 	
 	// For entity enemy and entity citizen
 	if (!confirm_body_derived(context))
@@ -565,7 +580,23 @@ bool EntityBody::search_entity()
 		size_t thisAligment = alignment;
 		FVec opos = this->pos;
 
-		auto entities = context->nearest_bodies_quad(
+		// calculateWeight never scales the distance down (the weight
+		// and the multiplier are at least 1), so the default bound holds
+		struct WeightScorer : GameData::DEFAULT_SCORER
+		{
+			decltype(calculateWeight) weight;
+
+			inline float operator()(
+				const IVec&,
+				const IVec&,
+				const GameBody* a,
+				const int) const
+			{
+				return weight(a);
+			}
+		};
+
+		auto entities = context->nearest_bodies_scored(
 				this->pos,
 				pathMax,
 				targetType,
@@ -580,20 +611,7 @@ bool EntityBody::search_entity()
 							thisAligment) ==
 						ALIGNMENTS_ENEMIES;
 				},
-				[this, calculateWeight](
-					const IVec& center,
-					const IVec&,
-					const GameBody* a,
-					const IVec&,
-					const GameBody* b) {
-						float distA, distB;
-						// distA = vec_distsq(this->pos, a->pos);
-						// distB = vec_distsq(this->pos, b->pos);
-						distA = calculateWeight(a);
-						distB = calculateWeight(b);
-						// Prefer a over b
-						return distA < distB;
-				});
+				WeightScorer{ GameData::DEFAULT_SCORER(this->pos), calculateWeight });
 
 		if (entities.empty())
 			return false;
@@ -734,6 +752,11 @@ void EntityBody::reset_timer()
 	timerPath->reset(time);
 }
 
+void EntityBody::queue_decision()
+{
+	context->aiScheduler.queue(this);
+}
+
 void EntityBody::logic_aggresive()
 {
 	
@@ -743,7 +766,7 @@ void EntityBody::logic_aggresive()
 	{
 		while (timerPath->next_surplus(context->get_time()))
 		{
-			logic_reset();
+			queue_decision();
 		}
 		break;
 	}
@@ -751,7 +774,7 @@ void EntityBody::logic_aggresive()
 	{
 		if (!this->target)
 		{
-			logic_reset();
+			queue_decision();
 			break;
 		}
 		EPIC_TEST2()
@@ -794,7 +817,7 @@ void EntityBody::logic_aggresive()
 		EPIC_TEST2()
 		if (!this->target)
 		{
-			logic_reset();
+			queue_decision();
 			break;
 		}
 		EPIC_TEST2()
@@ -845,7 +868,7 @@ void EntityBody::logic_aggresive()
 			
 			if (!this->target)
 			{
-				logic_reset();
+				queue_decision();
 				break;
 			}
 
@@ -855,7 +878,7 @@ void EntityBody::logic_aggresive()
 			if (target->get_hp() <= 0)
 			{
 				this->set_target(nullptr);
-				logic_reset();
+				queue_decision();
 			}
 			
 			/*
@@ -867,7 +890,7 @@ void EntityBody::logic_aggresive()
 				if (e->hp <= 0)
 				{
 					this->target = nullptr;
-					logic_reset();
+					queue_decision();
 					break;
 				}
 			}
@@ -897,7 +920,7 @@ void EntityBody::logic_aggresive()
 		EPIC_TEST2()
 		if (!this->target)
 		{
-			logic_reset();
+			queue_decision();
 			break;
 		}
 		EPIC_TEST2()
@@ -905,7 +928,7 @@ void EntityBody::logic_aggresive()
 		// If the target moved too far, find another target
 		if (dist > MIN_FOLLOW_RANGED_DISTANCE)
 		{
-			logic_reset();
+			queue_decision();
 			break;
 		}
 
@@ -986,18 +1009,28 @@ void EntityBody::update(float delta)
 	{
 		sf::Vector2i tilePos = vec_pos_to_tile(this->pos);
 		Tile &tile = context->chunks->get_tile(tilePos.x, tilePos.y);
-		if (!tile.is_barrier() && tile.building)
+		BuildingBase *b = context->chunks->get_base(tilePos.x, tilePos.y);
+		if (!tile.is_barrier() && b)
 		{
-			BuildingBase *b = tile.building->base;
 			if (b->props.num_is(PropertyNum::SPEED_BONUS))
 				speedScale = ((float)b->props.num_get(PropertyNum::SPEED_BONUS));
 		}
 	}
+
+	// Distant chunk, see SimulationLod
+	if (lodLevel != SimulationLod::FULL)
+	{
+		update_reduced(speedScale);
+		logic();
+		update_grid_change();
+		return;
+	}
 	
 	//				Calculate velocity
 
 	float maxSpeed =
 		speedMultiplier *
+		terrain_speed(context->chunks, this->pos) *
 		this->maxSpeed;
 
 	FVec destination;
@@ -1071,59 +1104,52 @@ void EntityBody::update(float delta)
 	// Seperation
 	if (true)
 	{
-		std::list<GameBody*> nearest =
-			context->nearest_bodies_radius(
-				this->pos,
-				radius);
-
-		FVec dif;
 		FVec seperationForce = { 0.0f, 0.0f };
 		int counter = 0;
-		nearbyBuilds.clear();
-		for (auto& body : nearest)
+
+		// Entities, from the crowd pass at the start of the tick
+		if (separationFrame == context->frameCount)
 		{
-			FVec pos = { 0.0f, 0.0f };
-			float dist = 0.0f;
-			if (body->type == BodyType::ENTITY)
-			{
-				pos = body->pos;
-			}
-			else if (body->type == BodyType::BUILDING && !ignoreBarriers)
-			{
-				BuildingBody* b = dynamic_cast<BuildingBody*>(body);
-				nearbyBuilds.push_back(b);
+			seperationForce = separation;
+			counter = separationCount;
+		}
+		else
+		{
+			context->crowd.query(
+				this->pos,
+				radius,
+				seperationForce,
+				counter);
+		}
 
-				if (!b->base->props.bool_is(PropertyBool::BARRIER))
-					continue;
+		// Barriers
+		collect_nearby_builds();
+		for (auto& b : nearbyBuilds)
+		{
+			if (ignoreBarriers ||
+				!b->base->props.bool_is(PropertyBool::BARRIER))
+				continue;
 
-				pos = aabb_closest_point(
-					body->pos,
-					FVec{ 1.f, 1.f },
-					this->pos);
-			}
+			FVec pos = aabb_closest_point(
+				b->pos,
+				FVec{ 1.f, 1.f },
+				this->pos);
 
-			dist = vec_distsq(pos, this->pos);
+			float dist = vec_distsq(pos, this->pos);
 			if (dist > 0.0f && dist <= radius * radius)
 			{
 				FVec dif = this->pos - pos;
 				float len = vec_normalize(dif);
-				FVec thisForce = dif * (1.f / len);
-
-				if (vec_lensq(this->vel) < (this->maxSpeed * this->maxSpeed) / 2.f)
-				{
-					thisForce *= 50.2f;
-				}
-				else
-				{
-					thisForce *= 0.8f;
-				}
-
-				seperationForce += thisForce;
-
+				seperationForce += dif * (1.f / len);
 				++counter;
 			}
 		}
 
+		if (vec_lensq(this->vel) < (this->maxSpeed * this->maxSpeed) / 2.f)
+			seperationForce *= 50.2f;
+		else
+			seperationForce *= 0.8f;
+
 		// Average seperation force
 		if (counter)
 			force += seperationForce / (float)counter;
@@ -1180,22 +1206,110 @@ void EntityBody::update(float delta)
 			context->move_entity(this, ogPos, pos);
 	}
 
+	update_grid_change();
+}
+
+void EntityBody::update_reduced(float speedScale)
+{
+	// The most a full update moves in the skipped ticks
+	float step =
+		speedScale *
+		speedMultiplier *
+		terrain_speed(context->chunks, this->pos) *
+		this->maxSpeed *
+		(float)lodTicks;
+
+	FVec newPos = this->pos;
+	if (action == Action::MOVE && pathData.valid())
+	{
+		// Jump from node to node
+		while (step > 0.f && !pathData.finished())
+		{
+			// Wait in front of a wall until the path is found again,
+			// the destination can be a building
+			const IVec tile = pathData.front();
+			if (tile != pathData.destPos && context->is_barrier(tile))
+				break;
+			const FVec node = vec_tile_to_pos(pathData.front());
+			const FVec dif = node - newPos;
+			const float len = vec_len(dif);
+			if (len > step)
+			{
+				newPos += dif * (step / len);
+				break;
+			}
+			newPos = node;
+			step -= len;
+			pathData.pop();
+		}
+	}
+	vel = { 0.f, 0.f };
+
+	if (newPos != this->pos)
+	{
+		this->animTime += vec_len(newPos - this->pos) * 4;
+		this->animFrame = (int)(this->animTime);
+		context->move_entity(this, this->pos, newPos);
+	}
+
+	collect_nearby_builds();
+}
+
+void EntityBody::collect_nearby_builds()
+{
+	nearbyBuilds.clear();
+	const int x1 = (int)math_floor(pos.x - radius), x2 = (int)math_floor(pos.x + radius);
+	const int y1 = (int)math_floor(pos.y - radius), y2 = (int)math_floor(pos.y + radius);
+	for (int x = x1; x <= x2; ++x)
+	{
+		for (int y = y1; y <= y2; ++y)
+		{
+			BuildingBody *b = context->chunks->get_build(x, y);
+			if (!b)
+				continue;
+			if (b->pos == pos ||
+				!aabb_intersect_circle(b->pos, FVec{ 1.f, 1.f }, pos, radius))
+				continue;
+			nearbyBuilds.push_back(b);
+		}
+	}
+}
+
+void EntityBody::update_grid_change()
+{
 	IVec tilePos = vec_pos_to_tile(this->pos);
 	// Update path on grid change
 	EntityBody *e = dynamic_cast<EntityBody *>(this);
-	if ((context->addedTiles.size() ||
-		 context->removedTiles.size()) &&
+	const GameData::PathChanges &changes = context->pathChanges;
+	if (!changes.opened && changes.blocked.empty())
+		return;
+
+	// Only new barriers on the path can block it
+	bool changed = changes.opened;
+	if (!changed)
+	{
+		for (const PathData::IndexVec &node : e->pathData.path)
+		{
+			if (changes.blocked.tile_dirty(node.value))
+			{
+				changed = true;
+				break;
+			}
+		}
+	}
+
+	if (changed &&
 		!context->is_barrier(tilePos) &&
 		e->pathData.valid())
 	{
-		Tile *d = e->pathData.destination;
+		const IVec d = e->pathData.destPos;
 		const int dijkstra = (int)context->get_const(
 			t_constnum::A_STAR_DIJKSTRA_VALUE);
 		const int greed = (int)context->get_const(
 			t_constnum::A_STAR_GREED_VALUE);
 		auto path = generate_path(
 			vec_pos_to_tile(e->pos),
-			d->tilePos,
+			d,
 			context->chunks,
 			dijkstra,
 			greed,
@@ -1209,9 +1323,8 @@ void EntityBody::update(float delta)
 		}
 		else
 		{
-			auto &list = d->building->base->storedEntities;
-			if (d->building)
-				list.erase(std::find(list.begin(), list.end(), e));
+			if (BuildingBase *b = context->chunks->get_base(d.x, d.y))
+				b->storedEntities.erase_value(e);
 			pathData.clear();
 		}
 	}
@@ -1300,10 +1413,6 @@ void EntityBody::serialize_publish(const SerializeMap &map)
 	GameData* g = map.get<GameData>(SERIALIZABLE_DATA, 0);
 	assert(g);
 
-	g->add_timer(timerAction);
-	g->add_timer(timerPath);
-	g->add_timer(localClock);
-
 	localClock->init(g->get_time());
 	timerAction->init(context->get_time());
 	timerPath->init(context->get_time());
@@ -1592,6 +1701,12 @@ void EntityCitizen::logic_reset()
 	// This class is for friendly entities only!
 	assert(this->alignment == ALIGNMENT_FRIENDLY);
 
+	if (job == CitizenJob::TEST01)
+	{
+		logic_reset_test01();
+		return;
+	}
+
 	this->nextAction = Action::IDLE;
 
 	if (this->aggressive && search_entity())
@@ -1606,43 +1721,11 @@ void EntityCitizen::logic_reset()
 	}
 
 
-	PathData pathData;
-	auto condition =
-		[](const sf::Vector2i&, const GameBody* gb, const int)
-		{
-			// Sometimes a building's entityLimit can be changed mannualy in
-			// the init function, so the "NEEDS_WORKERS" tag might be
-			// innacurate.
-			const BuildingBody* bb = dynamic_cast<const BuildingBody*>(gb);
-			assert(bb);
-			BuildingBase* b = bb->base;
-			if (b->entities.size() >= b->entityLimit)
-			{
-				return false;
-			}
-			return true;
-		};
-
 	if (job != CitizenJob::NONE)
 		return;
 
-	if ((pathData = find_building_and_path(
-		context,
-		pos,
-		{ ENUM_INGAME_PROPERTIES, (t_id)IngameProperties::NEEDS_WORKERS },
-		-1.f,
-		std::move(condition)))
-		.valid())
-		{
-
-			if (pathData.destination->building && pathData.valid())
-				pathData.destination
-				->building
-				->base->accept_entity(this);
-
-			nextAction = Action::GET_JOB;
-			set_path(std::move(pathData));
-	}
+	// The workplace and the path are given by the dispatcher
+	context->dispatcher.request(this, JobDispatcher::Demand::WORKPLACE);
 }
 
 PathData EntityCitizen::generate_path_worker(const IVec& end)
@@ -1662,6 +1745,11 @@ PathData EntityCitizen::generate_path_worker(const IVec& end)
 
 void EntityCitizen::logic_reset_worker()
 {
+	// A retry from the dispatcher goes on to the next choice
+	if (!dispatchRetry)
+		dispatchSkip = 0u;
+	dispatchRetry = false;
+
 	bool bIn = !workplace->rIn.empty();
 	bool bOut = !workplace->rOut.empty();
 	t_globalenum destType = 0;
@@ -1680,34 +1768,10 @@ void EntityCitizen::logic_reset_worker()
 	auto inReverse =
 		workplace->rIn.reverse_bool(&context->resourceWeights);
 	// Also, this behvoiur does not apply to couriers
-	if (rInventory.has_bool(inReverse) && this->job != CitizenJob::COURIER)
-	{
-		t_id storageId = (t_id)PropertyBool::ANY_STORAGE;
-		// If the character's a courier, move stuff from buildings to destinated 
-		// main storage.
-		PathData path = find_building_and_path(
-			context,
-			this->pos,
-			t_idpair{ ENUM_PROPERTY_BOOL, storageId },
-			workplace->effectRadius,
-			[this](const sf::Vector2i&, const GameBody* gb, int) {
-				const BuildingBase* b =
-					dynamic_cast<const BuildingBody*>(gb)->base;
-				return //!b->rStorage.empty() &&
-					Resources::can_transfer(rInventory, b->rStorage,
-						&context->resourceWeights,
-						b->weightCap, b->rStoreCap,
-						workplace->rIn.reverse_bool(
-							context->resourceWeights));
-			});
-		if (path.valid())
-		{
-			nextAction = Action::TRANSFER;
-			rActionBool = inReverse;
-			set_path(std::move(path));
-			return;
-		}
-	}
+	// The dispatcher finds the storage, unless it found none last time
+	if (rInventory.has_bool(inReverse) && this->job != CitizenJob::COURIER &&
+		context->dispatcher.request(this, JobDispatcher::Demand::STORAGE, inReverse))
+		return;
 
 	// Does the entity's workplace has free space to be filled with the
 	// building's output production
@@ -1788,35 +1852,11 @@ void EntityCitizen::logic_reset_worker()
 
 	if (bIn)
 	{
-		// If workplace and entity dont have enough go gather
-		if (!inventory_full())
-		{
-			auto path = find_building_and_path(
-				context, 
-				this->pos,
-				{ ENUM_PROPERTY_BOOL, (t_id)PropertyBool::ANY_STORAGE },
-				workplace->effectRadius,
-				[this](const sf::Vector2i, const GameBody* gb, const int) {
-					const BuildingBase* b =
-						dynamic_cast<const BuildingBody*>(gb)->base;
-					bool x = Resources::can_transfer(
-						b->rStorage,
-						rInventory,
-						&context->resourceWeights,
-						inventorySize,
-						rInventoryCap,
-						workplace->rIn);
-					return x;
-				});
-			if (path.valid())
-			{
-				nextAction = Action::COLLECT;
-				rActionBool = workplace->rIn.to_bool();
-
-				set_path(std::move(path));
-				return;
-			}
-		}
+		// If workplace and entity dont have enough go gather,
+		// the dispatcher finds the storage
+		if (!inventory_full() &&
+			context->dispatcher.request(this, JobDispatcher::Demand::GATHER))
+			return;
 	}
 
 	// Building generates resources and has space for those
@@ -1863,8 +1903,7 @@ void EntityCitizen::logic_reset_worker()
 			if (path.valid())
 			{
 				nextAction = Action::COLLECT;
-				rActionBool = path.destination->
-					get_building()->rStorage.to_bool();
+				rActionBool = path_building(context, path)->base->rStorage.to_bool();
 
 				set_path(std::move(path));
 				return;
@@ -1899,30 +1938,10 @@ void EntityCitizen::logic_reset_worker()
 		// If the entity carrying any resources
 		if (!rInventory.empty())
 		{
-			// Find a building that needs the resources the entity has
-			path = find_building_and_path(
-				context, 
-				this->pos,
-				t_idpair{ ENUM_PROPERTY_BOOL, (t_id)PropertyBool::WORKPLACE },
-				workplace->effectRadius,
-				[this](const sf::Vector2i&, const GameBody* gb, int) {
-					const BuildingBase* b =
-						dynamic_cast<const BuildingBody*>(gb)->base;
-					if (!rInventory.has_bool(b->rIn))
-						return false;
-					return
-						Resources::can_transfer(rInventory, b->rStorage,
-							&context->resourceWeights,
-							b->weightCap, b->rStoreCap,
-							b->rIn);
-				});
-			if (path.valid())
-			{
-				nextAction = Action::TRANSFER;
-				rActionBool = path.destination->get_building()->rIn;
-				set_path(std::move(path));
+			// The dispatcher finds a building that needs the
+			// resources the entity has
+			if (context->dispatcher.request(this, JobDispatcher::Demand::DELIVER))
 				return;
-			}
 
 			// Find a storage building with space
 			
@@ -1970,37 +1989,16 @@ void EntityCitizen::logic_reset_worker()
 			if (path.valid())
 			{
 				nextAction = Action::COLLECT;
-				rActionBool = path.destination->
-					get_building()->rStorage.to_bool();
+				rActionBool = path_building(context, path)->base->rStorage.to_bool();
 
 				set_path(std::move(path));
 				return;
 			}
 			
 
-			// Move stuff out of workplaces
-			path = find_building_and_path(
-				context,
-				this->pos,
-				t_idpair{ ENUM_PROPERTY_BOOL, (t_id)PropertyBool::WORKPLACE },
-				workplace->effectRadius,
-				[this](sf::Vector2i, const GameBody* gb, int) {
-					const BuildingBase* b = dynamic_cast<const BuildingBody*>(gb)->base;
-					assert(b);
-					// If the building has resources, and it doesn't use them
-					return !b->rStorage.empty() && 
-						b->rStorage.has_bool(
-							b->rIn.reverse_bool(b->context->resourceWeights));
-				});
-			if (path.valid())
-			{
-				nextAction = Action::COLLECT;
-				rActionBool = path.destination->
-					get_building()->rStorage.to_bool();
-
-				set_path(std::move(path));
+			// Move stuff out of workplaces, found by the dispatcher
+			if (context->dispatcher.request(this, JobDispatcher::Demand::PICKUP))
 				return;
-			}
 			
 
 			
@@ -2048,7 +2046,7 @@ void EntityCitizen::logic_reset_worker()
 						// If the building has resources, and it doesn't use them
 						return !b->rStorage.empty() &&
 							b->rStorage.has_bool(
-								path.destination->get_building()->rIn);
+								path_building(context, path)->base->rIn);
 					});
 
 				if (path2.valid())
@@ -2056,8 +2054,7 @@ void EntityCitizen::logic_reset_worker()
 					DEBUG("%d %s\n", (int)objectId, path2.to_string().c_str());
 
 					nextAction = Action::COLLECT;
-					rActionBool = path.destination->
-						get_building()->rIn.to_bool();
+					rActionBool = path_building(context, path)->base->rIn.to_bool();
 
 					set_path(std::move(path2));
 					return;
@@ -2088,7 +2085,7 @@ void EntityCitizen::logic_worker()
 	case Action::IDLE:
 	{
 		while (timerPath->next_surplus(context->get_time()))
-			logic_reset();
+			queue_decision();
 
 		break;
 	}
@@ -2096,11 +2093,11 @@ void EntityCitizen::logic_worker()
 	case Action::MOVE:
 	{
 		// If path is invalid, reset
-		auto destination = pathData.destination;
-		if (!destination || !destination->building || !pathData.valid())
+		BuildingBody *destination = path_building(context, pathData);
+		if (!destination || !pathData.valid())
 		{
 			while (timerPath->next_surplus(context->get_time()))
-				logic_reset();
+				queue_decision();
 			break;
 		}
 
@@ -2111,9 +2108,8 @@ void EntityCitizen::logic_worker()
 		assert(destination);
 
 		// Check if the destination in one of the nearby buildings
-		auto itrWorkplace = std::find(nearest.begin(), nearest.end(), destination->building);
-		if (!destination->building ||
-			(itr = std::find(nearest.begin(), nearest.end(), destination->building)) == nearest.end())
+		auto itrWorkplace = std::find(nearest.begin(), nearest.end(), destination);
+		if ((itr = std::find(nearest.begin(), nearest.end(), destination)) == nearest.end())
 		{
 			break;
 		}
@@ -2138,14 +2134,14 @@ void EntityCitizen::logic_worker()
 		{
 			workplace->enter_entity(this);
 			if (!insideWorkplace)
-				logic_reset();
+				queue_decision();
 		}
 		else
 			change_action(nextAction);
 
 		// If the entity still idling, reset
 		if (action == Action::IDLE)
-			logic_reset();
+			queue_decision();
 
 		break;
 	}
@@ -2183,7 +2179,7 @@ void EntityCitizen::logic_worker()
 				{
 					// If all resources are gone, go outside.
 					workplace->exit_entity(this);
-					logic_reset();
+					queue_decision();
 					break;
 				}
 			}
@@ -2211,7 +2207,7 @@ void EntityCitizen::logic_worker()
 				{
 					// If all resources are gone, go outside.
 					workplace->exit_entity(this);
-					logic_reset();
+					queue_decision();
 					break;
 				}
 			}
@@ -2220,14 +2216,14 @@ void EntityCitizen::logic_worker()
 	break;
 	case Action::COLLECT:
 	{
-		auto destination = pathData.destination;
-		if (!destination || !destination->building || !pathData.valid())
+		BuildingBody *destination = path_building(context, pathData);
+		if (!destination || !pathData.valid())
 		{
-			logic_reset();
+			queue_decision();
 			break;
 		}
 
-		BuildingBody *body = destination->building;
+		BuildingBody *body = destination;
 		BuildingBase *build = body->base;
 		while (timerAction->next_surplus(context->get_time()))
 		{
@@ -2250,18 +2246,17 @@ void EntityCitizen::logic_worker()
 					  CSTR(rInventoryCap),
 					  (int)inventorySize,
 					  CSTR(boolResource));*/
-				logic_reset();
+				queue_decision();
 			}
 		}
 	}
 	break;
 	case Action::TRANSFER:
 	{
-		auto destination = pathData.destination;
-		BuildingBody *body = destination->building;
+		BuildingBody *body = path_building(context, pathData);
 		if (!body)
 		{
-			logic_reset();
+			queue_decision();
 			break;
 		}
 
@@ -2281,25 +2276,24 @@ void EntityCitizen::logic_worker()
 					build->weightCap,
 					boolResource))
 			{
-				logic_reset();
+				queue_decision();
 			}
 		}
 	}
 	break;
 	case Action::BUILD:
 	{
-		auto destination = pathData.destination;
-		BuildingBody *body = destination->building;
+		BuildingBody *body = path_building(context, pathData);
 		if (!body)
 		{
-			logic_reset();
+			queue_decision();
 			break;
 		}
 		BuildingBase *build = body->base;
 		auto itr = context->constructions.find(build);
 		if (itr == context->constructions.end())
 		{
-			logic_reset();
+			queue_decision();
 			break;
 		}
 
@@ -2333,13 +2327,13 @@ void EntityCitizen::logic_worker()
 				newBuild->updateInfo = true;
 			}
 
-			logic_reset();
+			queue_decision();
 		}
 	}
 	break;
 	case Action::ATTACKED:
 		if (followers.empty())
-			logic_reset();
+			queue_decision();
 		break;
 	default:
 		WARNING("Wrong action \"%d\" for building named \"%s\" of type \"%d\"", (int)action, workplace->name, (int)workplace->buildType);
@@ -2348,38 +2342,38 @@ void EntityCitizen::logic_worker()
 	}
 }
 
-// Logic Test01
-void EntityCitizen::logic_test01()
+// Logic Test01, random wandering
+void EntityCitizen::logic_reset_test01()
 {
-	static auto resetActionTest01 = [](EntityCitizen *e) {
-		e->reset();
+	reset();
 
-		/*
+	/*
         PathData pathData = find_building_and_path(
-            e->context, e->pos,
-			t_idpair{ ENUM_BODY_TYPE, (t_id)BodyType::BUILDING },
-			-1.f,
+            context, pos,
+		t_idpair{ ENUM_BODY_TYPE, (t_id)BodyType::BUILDING },
+		-1.f,
             [](const sf::Vector2i &, const GameBody *, int) {
                 //const BuildingBase *b = dynamic_cast<const BuildingBody *>(gb)->base;
-				return true;// prng_get_double() > 0.75f;
+			return true;// prng_get_double() > 0.75f;
             });
-		e->set_path(std::move(pathData));
-			*/
-		
-		auto b = add_request_find_building(
-			*e->context->threadPath,
-			e->context, e->pos,
-			t_idpair{ENUM_BODY_TYPE, (t_id)BodyType::BUILDING},
-			[](const sf::Vector2i &, const GameBody *, int) {
-				return prng_get_double() > 0.75f;
-			});
+	set_path(std::move(pathData));
+		*/
+	
+	auto b = add_request_find_building(
+		*context->threadPath,
+		context, pos,
+		t_idpair{ENUM_BODY_TYPE, (t_id)BodyType::BUILDING},
+		[](const sf::Vector2i &, const GameBody *, int) {
+			return prng_get_double() > 0.75f;
+		});
 
-		delete e->buildFind;
-		e->buildFind = new QueryThreadInstance<PathData>(
-			std::move(b));
-			
-	};
+	delete buildFind;
+	buildFind = new QueryThreadInstance<PathData>(
+		std::move(b));
+}
 
+void EntityCitizen::logic_test01()
+{
 	switch (action)
 	{
 	case Action::IDLE:
@@ -2388,7 +2382,7 @@ void EntityCitizen::logic_test01()
 		{
 			while (timerPath->next_surplus(context->get_time()))
 			{
-				resetActionTest01(this);
+				queue_decision();
 			}
 		}
 		else if (buildFind->ready())
@@ -2402,12 +2396,12 @@ void EntityCitizen::logic_test01()
 	break;
 	case Action::MOVE:
 	{
-		auto destination = pathData.destination;
-		assert(destination && "Moving without destination");
-		if (!destination || !destination->building || !pathData.valid())
+		assert(pathData.hasDestination && "Moving without destination");
+		BuildingBody *destination = path_building(context, pathData);
+		if (!destination || !pathData.valid())
 		{
 			while (timerPath->next_surplus(context->get_time()))
-				resetActionTest01(this);
+				queue_decision();
 			break;
 		}
 
@@ -2416,9 +2410,8 @@ void EntityCitizen::logic_test01()
 		assert(destination);
 
 		// Check if the destination in one of the nearby buildings
-		auto itrWorkplace = std::find(nearest.begin(), nearest.end(), destination->building);
-		if (!destination->building ||
-			(itr = std::find(nearest.begin(), nearest.end(), destination->building)) == nearest.end())
+		auto itrWorkplace = std::find(nearest.begin(), nearest.end(), destination);
+		if ((itr = std::find(nearest.begin(), nearest.end(), destination)) == nearest.end())
 		{
 			break;
 		}
@@ -2429,7 +2422,7 @@ void EntityCitizen::logic_test01()
 		BuildingBase* build = body->base;
 
 		{
-			resetActionTest01(this);
+			queue_decision();
 			timerAction->reset(context->get_time());
 		}
 	}
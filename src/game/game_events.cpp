@@ -0,0 +1,100 @@
+#include "game/game_events.hpp"
+
+#include "game/game_data.hpp"
+
+IVec ChunkDirtyMap::chunk_of(const IVec &tile)
+{
+	return {
+		math_floordiv(tile.x, CHUNK_W),
+		math_floordiv(tile.y, CHUNK_H) };
+}
+
+void ChunkDirtyMap::mark(const IVec &tile)
+{
+	const IVec chunk = chunk_of(tile);
+	const IVec local = tile - IVec{ chunk.x * CHUNK_W, chunk.y * CHUNK_H };
+	chunks[Chunks::gen_key(chunk.x, chunk.y)].set(local.y * CHUNK_W + local.x);
+}
+
+bool ChunkDirtyMap::tile_dirty(const IVec &tile) const
+{
+	const IVec chunk = chunk_of(tile);
+	const t_bits *bits = get(chunk);
+	if (!bits)
+		return false;
+	const IVec local = tile - IVec{ chunk.x * CHUNK_W, chunk.y * CHUNK_H };
+	return bits->test(local.y * CHUNK_W + local.x);
+}
+
+bool ChunkDirtyMap::chunk_dirty(const IVec &chunk) const
+{
+	return get(chunk) != nullptr;
+}
+
+const ChunkDirtyMap::t_bits *ChunkDirtyMap::get(const IVec &chunk) const
+{
+	auto itr = chunks.find(Chunks::gen_key(chunk.x, chunk.y));
+	return itr != chunks.end() ? &itr->second : nullptr;
+}
+
+WorldEventBus::WorldEventBus(GameData *context)
+	: context(context)
+{
+}
+
+WorldEventBus::t_cursor WorldEventBus::subscribe(uint32_t types)
+{
+	Cursor c;
+	c.pos = m_head;
+	c.types = types;
+	c.active = true;
+
+	for (size_t i = 0; i < m_cursors.size(); ++i)
+	{
+		if (!m_cursors[i].active)
+		{
+			m_cursors[i] = c;
+			return i;
+		}
+	}
+	m_cursors.push_back(c);
+	return m_cursors.size() - 1u;
+}
+
+void WorldEventBus::unsubscribe(t_cursor cursor)
+{
+	m_cursors[cursor].active = false;
+}
+
+void WorldEventBus::push(WorldEvent event)
+{
+	// Nobody listens
+	bool any = false;
+	for (const Cursor &c : m_cursors)
+		any |= c.active && (c.types & WorldEvent::mask(event.type));
+	if (!any)
+		return;
+
+	if (m_ring.empty())
+		m_ring.resize(CAPACITY);
+	if (context)
+		event.frame = context->frameCount;
+	m_ring[m_head % CAPACITY] = event;
+	++m_head;
+}
+
+bool WorldEventBus::read(t_cursor cursor, ChunkDirtyMap &out)
+{
+	return read(cursor, [&out](const WorldEvent &e) {
+		out.mark(e.tile);
+	});
+}
+
+void WorldEventBus::clear()
+{
+	for (Cursor &c : m_cursors)
+	{
+		c.pos = m_head;
+		c.lost = c.active;
+	}
+}
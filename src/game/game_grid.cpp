@@ -6,44 +6,6 @@
 
 // Tile
 
-bool Tile::is_barrier() const
-{
-	return (building &&
-			building->base->props.bool_is(PropertyBool::BARRIER));
-}
-
-bool Tile::remove_entity(EntityBody *e)
-{
-	auto it = std::find(entities.begin(), entities.end(), e);
-	if (it != entities.end())
-	{
-		entities.erase(it);
-		return true;
-	}
-	return false;
-}
-
-BuildingBase* Tile::get_building()
-{
-	if (building && building->base)
-		return building->base;
-	return nullptr;
-}
-
-static void serialize_post(const SerializeMap &map, Tile &tile)
-{
-	for (auto &v : tile.entities)
-	{
-		// DEBUG("%s", v.to_json_verbose().dump().c_str());
-		map.apply(v);
-	}
-	if (tile.building.is_valid())
-	{
-		// DEBUG("%s", tile.building.to_json_verbose().dump().c_str());
-		map.apply(tile.building);
-	}
-}
-
 inline uint64_t code_write(
 	size_t &codeFollower,
 	uint64_t code,
@@ -64,14 +26,16 @@ inline uint64_t code_write(
 	return code;
 }
 
+// "size" is in bits
 template <typename T>
 inline T code_read(
 	size_t &codeFollower,
 	uint64_t code,
-	size_t size = sizeof(T))
+	size_t size = sizeof(T) * 8u)
 {
 	code = code >> codeFollower;
-	code &= ((1 << size) - 1);
+	code &= ((1ull << size) - 1u);
+	codeFollower += size;
 	return static_cast<T>(code);
 }
 
@@ -82,51 +46,39 @@ inline bool code_read_bool(
 	return code_read<bool>(follower, code, 1);
 }
 
-inline bool code_read_uint8(
+inline uint8_t code_read_uint8(
 	size_t &follower,
 	uint64_t code)
 {
 	return code_read<uint8_t>(follower, code);
 }
 
-static void to_json(json &j, const Tile &v)
+// The building and the entities aren't written,
+// they put themselves back on their tiles when confirmed
+static json tile_to_json(const Tile &t, const IVec &pos)
 {
-	const Tile *t = &v;
-
 	uint64_t code = 0u;
 	size_t follower = 0;
-	j[0] = t->tilePos;
-	code = code_write(follower, code, t->visible);
-	code = code_write(follower, code, t->active);
-	code = code_write(follower, code, t->speedBonus);
-	code = code_write(follower, code, t->attackBonud);
-	code = code_write(follower, code, t->bodyBonus);
-	j[1] = code;
-	if (t->building)
-		j[2] = t->building->to_ptr_json();
-	if (t->entities.size())
-		j[3] = t->entities;
+	code = code_write(follower, code, (bool)t.visible);
+	code = code_write(follower, code, (bool)t.active);
+	code = code_write(follower, code, t.roughness);
+	code = code_write(follower, code, t.attackBonud);
+	code = code_write(follower, code, t.bodyBonus);
+	return json{ pos, code };
 }
 
-static void from_json(const json &j, Tile &v)
+static void tile_from_json(const json &j, Tile &t)
 {
 	try
 	{
-		Tile *t = &v;
 		uint64_t code = 0u;
 		size_t follower = 0;
-		j.at(0).get_to(t->tilePos);
 		j.at(1).get_to(code);
-		t->visible = code_read_bool(follower, code);
-		t->active = code_read_bool(follower, code);
-		t->speedBonus = code_read_uint8(follower, code);
-		t->attackBonud = code_read_uint8(follower, code);
-		t->bodyBonus = code_read_uint8(follower, code);
-
-		if (j.size() > 2 && !j.at(2).is_null())
-			j.at(2).get_to(t->building);
-		if (j.size() > 3 && !j.at(3).is_null())
-			j.at(3).get_to(t->entities);
+		t.visible = code_read_bool(follower, code);
+		t.active = code_read_bool(follower, code);
+		t.roughness = code_read_uint8(follower, code);
+		t.attackBonud = code_read_uint8(follower, code);
+		t.bodyBonus = code_read_uint8(follower, code);
 	}
 	catch (json::exception &e)
 	{
@@ -145,15 +97,7 @@ Grid::Grid(int cx, int cy, int idx, int idy)
 	: cx(cx), cy(cy), idx(idx), idy(idy)
 {
 	if (cx != 0 && cy != 0)
-	{
 		grid = new Tile[cx * cy];
-		for (int i = 0; i < cx * cy; ++i)
-		{
-			auto &p = grid[i].tilePos;
-			p.x = i % cx + cx * idx;
-			p.y = i / cx + cy * idy;
-		}
-	}
 }
 
 Grid::~Grid()
@@ -174,7 +118,7 @@ static void to_json(json &j, const Grid &vr)
 	for (size_t i = 0; i < v->cx * v->cy; ++i, ++t)
 	{
 		if (t)
-			j["t"][i] = *t;
+			j["t"][i] = tile_to_json(*t, v->tile_pos(*t));
 	}
 }
 
@@ -197,7 +141,7 @@ static void from_json(const json &j, Grid &v)
 		v.grid = new Tile[gridCount];
 		for (size_t i = 0; i < gridCount; ++i)
 		{
-			j.at("t").at(i).get_to(v.grid[i]);
+			tile_from_json(j.at("t").at(i), v.grid[i]);
 		}
 	}
 	catch (json::exception &e)
@@ -214,6 +158,98 @@ Tile &Grid::operator()(int x, int y) const
 	return grid[y * cx + x];
 }
 
+IVec Grid::tile_pos(const Tile &tile) const
+{
+	const int i = (int)(&tile - grid);
+	assert(0 <= i && i < cx * cy);
+	return { i % cx + cx * idx, i / cx + cy * idy };
+}
+
+BuildingBody *Grid::get_building(const Tile &tile) const
+{
+	return tile.has_building() ? buildings[tile.building] : nullptr;
+}
+
+void Grid::set_building(Tile &tile, BuildingBody *building)
+{
+	if (tile.has_building())
+	{
+		buildings[tile.building] = nullptr;
+		freeBuildings.push_back(tile.building);
+		tile.building = Tile::NONE;
+	}
+	tile.barrier = false;
+	if (!building)
+		return;
+
+	if (freeBuildings.size())
+	{
+		tile.building = freeBuildings.back();
+		freeBuildings.pop_back();
+		buildings[tile.building] = building;
+	}
+	else
+	{
+		assert(buildings.size() < Tile::NONE);
+		tile.building = (uint16_t)buildings.size();
+		buildings.push_back(building);
+	}
+	update_barrier(tile);
+}
+
+void Grid::update_barrier(Tile &tile)
+{
+	BuildingBody *b = get_building(tile);
+	tile.barrier = b && b->base &&
+		b->base->props.bool_is(PropertyBool::BARRIER);
+}
+
+void Grid::link_entity(Tile &tile, EntityBody *entity)
+{
+	uint16_t i = freeEntityNode;
+	if (i != Tile::NONE)
+		freeEntityNode = entityNodes[i].next;
+	else
+	{
+		assert(entityNodes.size() < Tile::NONE);
+		i = (uint16_t)entityNodes.size();
+		entityNodes.emplace_back();
+	}
+
+	TileEntityNode &node = entityNodes[i];
+	node.entity = entity;
+	node.tile = (uint16_t)(&tile - grid);
+	node.prev = Tile::NONE;
+	node.next = tile.entities;
+	if (tile.entities != Tile::NONE)
+		entityNodes[tile.entities].prev = i;
+	tile.entities = i;
+	entity->tileNode = i;
+}
+
+bool Grid::unlink_entity(Tile &tile, EntityBody *entity)
+{
+	const uint16_t i = entity->tileNode;
+	if (i >= entityNodes.size() ||
+		entityNodes[i].entity != entity ||
+		entityNodes[i].tile != (uint16_t)(&tile - grid))
+		return false;
+
+	TileEntityNode &node = entityNodes[i];
+	if (node.prev != Tile::NONE)
+		entityNodes[node.prev].next = node.next;
+	else
+		tile.entities = node.next;
+	if (node.next != Tile::NONE)
+		entityNodes[node.next].prev = node.prev;
+
+	node = TileEntityNode{};
+	node.next = freeEntityNode;
+	freeEntityNode = i;
+	entity->tileNode = Tile::NONE;
+	return true;
+}
+
 void Grid::remove_entity(EntityBody *entity)
 {
 	// std::lock_guard<std::mutex> glock(gridMutex);
@@ -268,6 +304,7 @@ void Chunks::clear()
 		delete (*itr).second;
 	}
 	available.clear();
+	summaries.clear();
 }
 
 json Chunks::to_json() const
@@ -311,13 +348,6 @@ void Chunks::serialize_publish(const SerializeMap &map)
 	{
 		auto &grid = *p.second;
 
-		Tile *buffFollower = grid.grid;
-		for (size_t i = 0; i < grid.cx * grid.cy; ++i, ++buffFollower)
-		{
-			assert(buffFollower);
-			::serialize_post(map, *buffFollower);
-		}
-
 		// Unsafe iteration over keys of a hash set
 		// It's okay because the hash value stayes the same
 		for (auto &v : grid.setBuildings)
@@ -359,6 +389,16 @@ void Chunks::add(Grid *grid)
 	available[v] = grid;
 }
 
+Grid *Chunks::remove(short indexX, short indexY)
+{
+	auto itr = available.find(gen_key(indexX, indexY));
+	if (itr == available.end())
+		return nullptr;
+	Grid *grid = itr->second;
+	available.erase(itr);
+	return grid;
+}
+
 bool Chunks::has_tile(int x, int y) const
 {
 	short idx = (short)math_floordiv(x, (int)gridw);
@@ -427,7 +467,6 @@ std::pair<Grid *, Tile &> Chunks::get_pair(int x, int y) const
 	Tile &tile = (*grid)(
 		math_mod(x, (int)gridw),
 		math_mod(y, (int)gridh));
-	tile.tilePos = {x, y};
 	return std::pair<Grid *, Tile &>{grid, tile};
 }
 
@@ -436,14 +475,73 @@ bool Chunks::has_build(int x, int y) const
 	// std::lock_guard<std::recursive_mutex> olock(chunksMutex);
 	if (!has_tile(x, y))
 		return false;
-	auto ret = get_tile(x, y).building != nullptr;
+	auto ret = get_tile(x, y).has_building();
 	return ret;
 }
 
 BuildingBody *Chunks::get_build(int x, int y) const
 {
 	// std::lock_guard<std::recursive_mutex> glock(chunksMutex);
-	if (!has_build(x, y))
+	if (!has_tile(x, y))
 		return nullptr;
-	return get_tile(x, y).building;
+	auto pair = get_pair(x, y);
+	return pair.first->get_building(pair.second);
+}
+
+BuildingBase *Chunks::get_base(int x, int y) const
+{
+	BuildingBody *b = get_build(x, y);
+	if (b && b->base)
+		return b->base;
+	return nullptr;
+}
+
+void Chunks::set_build(int x, int y, BuildingBody *building)
+{
+	auto pair = get_pair(x, y);
+	pair.first->set_building(pair.second, building);
+}
+
+void Chunks::update_barrier(int x, int y)
+{
+	if (!has_tile(x, y))
+		return;
+	auto pair = get_pair(x, y);
+	pair.first->update_barrier(pair.second);
+}
+
+void Chunks::add_entity(int x, int y, EntityBody *entity)
+{
+	auto pair = get_pair(x, y);
+	pair.first->link_entity(pair.second, entity);
+}
+
+bool Chunks::remove_entity(int x, int y, EntityBody *entity)
+{
+	if (!get_grid(x, y))
+		return false;
+	auto pair = get_pair(x, y);
+	return pair.first->unlink_entity(pair.second, entity);
+}
+
+const ChunkSummary *Chunks::get_summary(short indexX, short indexY) const
+{
+	auto itr = summaries.find(gen_key(indexX, indexY));
+	return itr != summaries.end() ? &itr->second : nullptr;
+}
+
+bool Chunks::is_paged_barrier(int x, int y) const
+{
+	const ChunkSummary *s = get_summary(
+		(short)math_floordiv(x, CHUNK_W),
+		(short)math_floordiv(y, CHUNK_H));
+	return s && s->is_barrier(math_mod(x, CHUNK_W), math_mod(y, CHUNK_H));
+}
+
+bool Chunks::is_sealed(int x, int y) const
+{
+	const ChunkSummary *s = get_summary(
+		(short)math_floordiv(x, CHUNK_W),
+		(short)math_floordiv(y, CHUNK_H));
+	return s && s->sealed();
 }
\ No newline at end of file
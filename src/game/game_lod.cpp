@@ -0,0 +1,91 @@
+#include "game/game_lod.hpp"
+
+#include "game/game_data.hpp"
+
+SimulationLod::SimulationLod(GameData *context)
+	: context(context)
+{
+}
+
+IVec SimulationLod::chunk_of(const FVec &pos)
+{
+	return {
+		math_floordiv((int)floorf(pos.x), CHUNK_W),
+		math_floordiv((int)floorf(pos.y), CHUNK_H) };
+}
+
+void SimulationLod::set_camera(const FVec &pos)
+{
+	camera = chunk_of(pos);
+	for (size_t i = 0; i < LEVEL_COUNT; ++i)
+		counts[i] = 0u;
+
+	// Forget fights that are over
+	const t_seconds now = context->get_time();
+	for (auto itr = combat.begin(); itr != combat.end(); )
+	{
+		if (now - itr->second > COMBAT_TIME)
+			itr = combat.erase(itr);
+		else
+			++itr;
+	}
+}
+
+void SimulationLod::mark_combat(const FVec &pos)
+{
+	const IVec chunk = chunk_of(pos);
+	combat[Chunks::gen_key(chunk.x, chunk.y)] = context->get_time();
+}
+
+SimulationLod::Level SimulationLod::level(const EntityBody *entity) const
+{
+	// Fighting entities are never simplified
+	if (entity->aggressive ||
+		entity->entityType == EntityType::ENEMY ||
+		entity->action == EntityBody::Action::FOLLOW)
+		return FULL;
+
+	const IVec chunk = chunk_of(entity->pos);
+	const int dist = math_max(
+		math_abs(chunk.x - camera.x),
+		math_abs(chunk.y - camera.y));
+	if (dist <= FULL_RADIUS)
+		return FULL;
+
+	if (combat.count(Chunks::gen_key(chunk.x, chunk.y)))
+		return FULL;
+	const Grid *grid = context->chunks->get(chunk.x, chunk.y);
+	if (grid && !grid->setEnemies.empty())
+		return FULL;
+
+	return dist <= REDUCED_RADIUS ? REDUCED : FAR;
+}
+
+bool SimulationLod::schedule(EntityBody *entity, float &delta)
+{
+	const Level current = level(entity);
+	++counts[current];
+
+	entity->lodDelta += delta;
+	++entity->lodPending;
+
+	// Spread the entities of a chunk over the period
+	const unsigned period = PERIODS[current];
+	if (period > 1u &&
+		(unsigned)(context->frameCount + (long)entity->objectId) % period != 0u)
+		return false;
+
+	delta = entity->lodDelta;
+	entity->lodLevel = current;
+	entity->lodTicks = entity->lodPending;
+	entity->lodDelta = 0.f;
+	entity->lodPending = 0u;
+	return true;
+}
+
+void SimulationLod::clear()
+{
+	combat.clear();
+	for (size_t i = 0; i < LEVEL_COUNT; ++i)
+		counts[i] = 0u;
+}
@@ -0,0 +1,520 @@
+#include "game/game_paging.hpp"
+
+#include "game/game_data.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+// Region files
+
+static const uint32_t REGION_MAGIC = 0x31474552; // "REG1"
+static const int REGION_SLOTS = ChunkPager::REGION_SIZE * ChunkPager::REGION_SIZE;
+
+// Where every chunk's record is, a size of zero if it has none
+struct RegionHeader
+{
+	uint32_t magic = REGION_MAGIC;
+	uint32_t offsets[REGION_SLOTS] = {};
+	uint32_t sizes[REGION_SLOTS] = {};
+};
+
+static std::string region_path(const std::string &dir, const IVec &chunk)
+{
+	return dir + "/r." +
+		std::to_string(math_floordiv(chunk.x, ChunkPager::REGION_SIZE)) + "." +
+		std::to_string(math_floordiv(chunk.y, ChunkPager::REGION_SIZE)) + ".bin";
+}
+
+static int region_slot(const IVec &chunk)
+{
+	return math_mod(chunk.y, ChunkPager::REGION_SIZE) * ChunkPager::REGION_SIZE +
+		math_mod(chunk.x, ChunkPager::REGION_SIZE);
+}
+
+static bool region_read_header(std::istream &file, RegionHeader &header)
+{
+	file.seekg(0);
+	return file.read((char *)&header, sizeof(header)) &&
+		header.magic == REGION_MAGIC;
+}
+
+// Rewrites the file with only the current records
+static void region_compact(const std::string &path, RegionHeader &header)
+{
+	RegionHeader compact;
+	std::string records;
+	{
+		std::ifstream file(path, std::ios::binary);
+		for (int i = 0; i < REGION_SLOTS; ++i)
+		{
+			if (!header.sizes[i])
+				continue;
+			std::string record(header.sizes[i], '\0');
+			file.seekg(header.offsets[i]);
+			if (!file.read(&record[0], record.size()))
+				continue;
+			compact.offsets[i] = (uint32_t)(sizeof(compact) + records.size());
+			compact.sizes[i] = header.sizes[i];
+			records += record;
+		}
+	}
+
+	const std::string tmp = path + ".tmp";
+	{
+		std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return;
+		file.write((const char *)&compact, sizeof(compact));
+		file.write(records.data(), records.size());
+		if (!file)
+			return;
+	}
+	std::error_code ec;
+	std::filesystem::rename(tmp, path, ec);
+	if (!ec)
+		header = compact;
+}
+
+// The record is appended and the header points to it, the file is
+// compacted once most of it is old records
+static bool region_write(const std::string &dir, const IVec &chunk, const std::string &record)
+{
+	const std::string path = region_path(dir, chunk);
+	RegionHeader header;
+	std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+	if (!file || !region_read_header(file, header))
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		file.close();
+		file.clear();
+		file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+		if (!file)
+			return false;
+		header = RegionHeader{};
+	}
+
+	file.seekp(0, std::ios::end);
+	const uint32_t offset = (uint32_t)std::max((std::streamoff)sizeof(header), (std::streamoff)file.tellp());
+	file.seekp(offset);
+	file.write(record.data(), record.size());
+
+	const int slot = region_slot(chunk);
+	header.offsets[slot] = offset;
+	header.sizes[slot] = (uint32_t)record.size();
+	file.seekp(0);
+	file.write((const char *)&header, sizeof(header));
+	if (!file)
+		return false;
+	file.close();
+
+	size_t live = 0u;
+	for (int i = 0; i < REGION_SLOTS; ++i)
+		live += header.sizes[i];
+	if (offset + record.size() > sizeof(header) + 2u * live)
+		region_compact(path, header);
+	return true;
+}
+
+static bool region_read(const std::string &dir, const IVec &chunk, std::string &record)
+{
+	std::ifstream file(region_path(dir, chunk), std::ios::binary);
+	RegionHeader header;
+	if (!file || !region_read_header(file, header))
+		return false;
+
+	const int slot = region_slot(chunk);
+	if (!header.sizes[slot])
+		return false;
+	record.resize(header.sizes[slot]);
+	file.seekg(header.offsets[slot]);
+	return (bool)file.read(&record[0], record.size());
+}
+
+// Chunk records
+
+template <class T>
+static void record_put(std::string &out, const T &v)
+{
+	out.append((const char *)&v, sizeof(v));
+}
+
+template <class T>
+static bool record_take(const std::string &in, size_t &pos, T &v)
+{
+	if (pos + sizeof(v) > in.size())
+		return false;
+	memcpy(&v, in.data() + pos, sizeof(v));
+	pos += sizeof(v);
+	return true;
+}
+
+// Four bytes for every tile, then the resources
+static std::string record_encode(const Grid &grid, const std::vector<WorldGenerator::Spawn> &spawns)
+{
+	std::string out;
+	out.reserve(8u + grid.cx * grid.cy * 4u + 4u + spawns.size() * 9u);
+	record_put(out, (int16_t)grid.idx);
+	record_put(out, (int16_t)grid.idy);
+	record_put(out, (uint16_t)grid.cx);
+	record_put(out, (uint16_t)grid.cy);
+	for (int i = 0; i < grid.cx * grid.cy; ++i)
+	{
+		const Tile &t = grid.grid[i];
+		record_put(out, (uint8_t)(t.visible | t.active << 1));
+		record_put(out, (uint8_t)t.roughness);
+		record_put(out, (uint8_t)t.attackBonud);
+		record_put(out, (uint8_t)t.bodyBonus);
+	}
+
+	record_put(out, (uint32_t)spawns.size());
+	for (const WorldGenerator::Spawn &s : spawns)
+	{
+		record_put(out, (uint8_t)math_mod(s.pos.x, grid.cx));
+		record_put(out, (uint8_t)math_mod(s.pos.y, grid.cy));
+		record_put(out, (uint16_t)s.type);
+		record_put(out, (uint8_t)s.resourceId);
+		record_put(out, (int32_t)s.amount);
+	}
+	return out;
+}
+
+static bool record_decode(const std::string &in, const IVec &chunk, WorldGenerator::ChunkPlan &plan)
+{
+	size_t pos = 0u;
+	int16_t idx, idy;
+	uint16_t cx, cy;
+	if (!record_take(in, pos, idx) || !record_take(in, pos, idy) ||
+		!record_take(in, pos, cx) || !record_take(in, pos, cy) ||
+		idx != chunk.x || idy != chunk.y ||
+		pos + cx * cy * 4u > in.size())
+		return false;
+
+	Grid *grid = new Grid(cx, cy, idx, idy);
+	for (int i = 0; i < cx * cy; ++i)
+	{
+		Tile &t = grid->grid[i];
+		uint8_t flags;
+		record_take(in, pos, flags);
+		record_take(in, pos, t.roughness);
+		record_take(in, pos, t.attackBonud);
+		record_take(in, pos, t.bodyBonus);
+		t.visible = flags & 1u;
+		t.active = (flags >> 1) & 1u;
+	}
+
+	uint32_t count = 0u;
+	record_take(in, pos, count);
+	plan.spawns.clear();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint8_t x, y, resourceId;
+		uint16_t type;
+		int32_t amount;
+		if (!record_take(in, pos, x) || !record_take(in, pos, y) ||
+			!record_take(in, pos, type) || !record_take(in, pos, resourceId) ||
+			!record_take(in, pos, amount))
+		{
+			delete grid;
+			return false;
+		}
+
+		WorldGenerator::Spawn s;
+		s.pos = IVec{ idx * cx + x, idy * cy + y };
+		s.type = (BuildingType)type;
+		s.resourceId = resourceId;
+		s.amount = amount;
+		plan.spawns.push_back(s);
+	}
+
+	plan.index = chunk;
+	plan.grid = grid;
+	return true;
+}
+
+// ChunkPager
+
+ChunkPager::ChunkPager()
+{
+	// Never a directory somebody else made, nothing from another run
+	// or game is read or deleted
+	std::error_code ec;
+	std::filesystem::path base = std::filesystem::temp_directory_path(ec);
+	if (ec)
+		base = ".";
+	std::random_device device;
+	const uint64_t id = ((uint64_t)device() << 32) ^
+		(uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	char name[48];
+	snprintf(name, sizeof(name), "isometric_regions_%016llx", (unsigned long long)id);
+	m_directory = (base / name).string();
+}
+
+ChunkPager::~ChunkPager()
+{
+	m_io.wait_all();
+	for (size_t i = m_nextLoad; i < m_loads.size(); ++i)
+		delete m_loads[i]->plan.grid;
+	remove_regions();
+}
+
+void ChunkPager::remove_regions()
+{
+	std::error_code ec;
+	for (const std::string &path : m_regions)
+	{
+		std::filesystem::remove(path, ec);
+		std::filesystem::remove(path + ".tmp", ec);
+	}
+	m_regions.clear();
+	// Fails if anything else was put there
+	std::filesystem::remove(m_directory, ec);
+}
+
+void ChunkPager::update(GameData &data, Chunks &chunks, const IVec &cameraTile)
+{
+	if (m_tick++ % std::max(1u, settings.interval) == 0u)
+		scan(data, chunks, cameraTile);
+
+	commit(data, chunks, settings.loadPerTick);
+
+	size_t evicted = 0u;
+	while (evicted < settings.evictPerTick && !m_evictions.empty())
+	{
+		const IVec chunk = m_evictions.back();
+		m_evictions.pop_back();
+		if (page_out(data, chunks, chunk))
+			++evicted;
+	}
+}
+
+void ChunkPager::scan(GameData &data, Chunks &chunks, const IVec &cameraTile)
+{
+	// Chunks the kept areas are around
+	std::vector<IVec> colonies, crowds;
+	std::unordered_set<unsigned> seen;
+	const auto addCenter = [&seen](std::vector<IVec> &centers, const IVec &tile) {
+		const IVec c = ChunkDirtyMap::chunk_of(tile);
+		if (seen.insert(Chunks::gen_key(c.x, c.y)).second)
+			centers.push_back(c);
+	};
+
+	addCenter(colonies, cameraTile);
+	for (BuildingBase *b : data.buildingBases)
+	{
+		if (!b->props.bool_is(PropertyBool::HARVESTABLE))
+			addCenter(colonies, b->tilePos);
+	}
+	seen.clear();
+	for (GameBody *body : data.bodies)
+	{
+		if (body->type == BodyType::ENTITY && !body->dead)
+			addCenter(crowds, vec_pos_to_tile(body->pos));
+	}
+
+	// Paged out chunks in the kept area are read back, loaded chunks
+	// past it and the margin are paged out
+	std::unordered_set<unsigned> keep;
+	const auto expand = [&](const std::vector<IVec> &centers, int radius) {
+		const int outer = radius + settings.margin;
+		for (const IVec &c : centers)
+		{
+			for (int y = -outer; y <= outer; ++y)
+			{
+				for (int x = -outer; x <= outer; ++x)
+				{
+					const IVec chunk = c + IVec{ x, y };
+					const unsigned key = Chunks::gen_key(chunk.x, chunk.y);
+					keep.insert(key);
+					if (math_abs(x) <= radius && math_abs(y) <= radius &&
+						m_paged.count(key) && !m_loading.count(key))
+						page_in(chunk);
+				}
+			}
+		}
+	};
+	expand(colonies, settings.keepRadius);
+	expand(crowds, settings.entityRadius);
+
+	m_evictions.clear();
+	for (const auto &p : chunks.available)
+	{
+		if (!keep.count(p.first))
+			m_evictions.push_back({ p.second->idx, p.second->idy });
+	}
+}
+
+bool ChunkPager::can_page_out(const Grid &grid) const
+{
+	if (grid.cx != CHUNK_W || grid.cy != CHUNK_H ||
+		!grid.setCitizens.empty() || !grid.setEnemies.empty())
+		return false;
+
+	// Only untouched resources, anything else would need the whole
+	// building written
+	for (int i = 0; i < grid.cx * grid.cy; ++i)
+	{
+		const Tile &t = grid.grid[i];
+		if (t.has_entities())
+			return false;
+		if (!t.has_building())
+			continue;
+
+		const BuildingBody *body = grid.get_building(t);
+		const BuildingBase *b = body->base;
+		if (!b ||
+			!b->props.bool_is(PropertyBool::HARVESTABLE) ||
+			b->tilesSize != IVec{ 1, 1 } ||
+			b->flagDelete ||
+			!b->entities.empty() ||
+			!b->storedEntities.empty() ||
+			!b->followers.empty() ||
+			!body->followers.empty())
+			return false;
+	}
+	return true;
+}
+
+bool ChunkPager::page_out(GameData &data, Chunks &chunks, const IVec &chunk)
+{
+	Grid *grid = chunks.get(chunk.x, chunk.y);
+	if (!grid || !can_page_out(*grid))
+		return false;
+
+	std::vector<WorldGenerator::Spawn> spawns;
+	std::vector<BuildingBase *> removed;
+	for (int i = 0; i < grid->cx * grid->cy; ++i)
+	{
+		Tile &t = grid->grid[i];
+		if (!t.has_building())
+			continue;
+
+		BuildingBase *b = grid->get_building(t)->base;
+		WorldGenerator::Spawn s;
+		s.pos = grid->tile_pos(t);
+		s.type = (BuildingType)b->buildType;
+		// Raw resources hold a single resource
+		for (int r = 0; r < Resources::COUNT; ++r)
+		{
+			if (b->rStorage.get(r))
+			{
+				s.resourceId = r;
+				s.amount = b->rStorage.get(r);
+				break;
+			}
+		}
+		spawns.push_back(s);
+		removed.push_back(b);
+	}
+
+	const unsigned key = Chunks::gen_key(chunk.x, chunk.y);
+	const ChunkSummary summary = ChunkSummary::from_grid(*grid);
+	std::string record = record_encode(*grid, spawns);
+	m_written += record.size();
+
+	Logger::set_priority(0);
+	// Nothing changed for the paths or the suggestions
+	for (BuildingBase *b : removed)
+	{
+		data.delete_building(b, true);
+	}
+	Logger::set_priority(99);
+
+	delete chunks.remove(chunk.x, chunk.y);
+	chunks.summaries[key] = summary;
+	m_paged.emplace(key, chunk);
+
+	const std::string dir = m_directory;
+	m_regions.insert(region_path(dir, chunk));
+	m_io.add([dir, chunk, record = std::move(record)]() {
+		if (!region_write(dir, chunk, record))
+			LOG_ERROR("Can't write chunk %d %d to \"%s\"", chunk.x, chunk.y, dir.c_str());
+	});
+	return true;
+}
+
+void ChunkPager::page_in(const IVec &chunk)
+{
+	m_loading.insert(Chunks::gen_key(chunk.x, chunk.y));
+	m_loads.emplace_back(new Load{});
+	Load *load = m_loads.back().get();
+	load->plan.index = chunk;
+
+	const std::string dir = m_directory;
+	load->task = m_io.add([load, dir]() {
+		std::string record;
+		if (region_read(dir, load->plan.index, record))
+			record_decode(record, load->plan.index, load->plan);
+	});
+}
+
+size_t ChunkPager::commit(GameData &data, Chunks &chunks, size_t maxChunks)
+{
+	size_t added = 0u;
+	if (m_nextLoad >= m_loads.size() || !m_io.done(m_loads[m_nextLoad]->task))
+		return added;
+
+	Logger::set_priority(0);
+	while (added < maxChunks &&
+		m_nextLoad < m_loads.size() &&
+		m_io.done(m_loads[m_nextLoad]->task))
+	{
+		WorldGenerator::ChunkPlan &plan = m_loads[m_nextLoad]->plan;
+		++m_nextLoad;
+
+		const unsigned key = Chunks::gen_key(plan.index.x, plan.index.y);
+		m_loading.erase(key);
+		m_paged.erase(key);
+		chunks.summaries.erase(key);
+		if (!plan.grid)
+		{
+			LOG_ERROR("Can't read paged out chunk %d %d", plan.index.x, plan.index.y);
+			continue;
+		}
+		if (WorldGenerator::place(data, chunks, plan))
+			++added;
+	}
+	Logger::set_priority(99);
+
+	if (m_nextLoad == m_loads.size())
+	{
+		m_loads.clear();
+		m_nextLoad = 0u;
+	}
+	return added;
+}
+
+void ChunkPager::restore_all(GameData &data, Chunks &chunks)
+{
+	for (const auto &p : m_paged)
+	{
+		if (!m_loading.count(p.first))
+			page_in(p.second);
+	}
+	m_io.wait_all();
+	commit(data, chunks, SIZE_MAX);
+	m_evictions.clear();
+}
+
+void ChunkPager::reset()
+{
+	m_io.wait_all();
+	for (size_t i = m_nextLoad; i < m_loads.size(); ++i)
+		delete m_loads[i]->plan.grid;
+	m_loads.clear();
+	m_nextLoad = 0u;
+	m_paged.clear();
+	m_loading.clear();
+	m_evictions.clear();
+	remove_regions();
+}
+
+bool ChunkPager::paged_out(const IVec &chunk) const
+{
+	return m_paged.count(Chunks::gen_key(chunk.x, chunk.y)) != 0u;
+}
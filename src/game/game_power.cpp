@@ -0,0 +1,462 @@
+#include "game/game_power.hpp"
+
+#include "game/game_data.hpp"
+
+PowerGrid::PowerGrid(GameData *context)
+	: context(context)
+{
+}
+
+PowerGrid::~PowerGrid()
+{
+	clear();
+}
+
+void PowerGrid::add(BuildingBase *base, const std::vector<BuildingBase *> &neighbours)
+{
+	assert(base);
+	ASSERT_ERROR(base->powerNode == NULL_NODE,
+				 "Building is already part of the power grid.");
+
+	const size_t index = nodes.size();
+	nodes.emplace_back();
+	{
+		Node &node = nodes.back();
+		node.base = base;
+		node.parent = index;
+		node.size = 1u;
+		node.alive = true;
+	}
+	base->powerNode = index;
+	++aliveCount;
+
+	// Connect the edges
+	for (BuildingBase *other : neighbours)
+	{
+		if (!other || other == base || other->powerNode == NULL_NODE)
+			continue;
+		const size_t j = other->powerNode;
+		auto &adj = nodes[index].adj;
+		if (std::find(adj.begin(), adj.end(), j) != adj.end())
+			continue;
+		adj.push_back(j);
+		nodes[j].adj.push_back(index);
+	}
+
+	for (size_t i = 0; i < nodes[index].adj.size(); ++i)
+		unite(index, nodes[index].adj[i]);
+
+	// The building isn't connected to anything, make a new network
+	Node &root = nodes[find(index)];
+	if (!root.network)
+		root.network = network_new();
+	base->network = root.network;
+}
+
+void PowerGrid::remove(BuildingBase *base)
+{
+	assert(base);
+	const size_t index = base->powerNode;
+	if (index == NULL_NODE)
+		return;
+	ASSERT_ERROR(nodes[index].alive, "Removed power node isn't alive.");
+
+	const size_t root = find(index);
+
+	// Disconnect the edges
+	std::vector<size_t> neighbours = std::move(nodes[index].adj);
+	nodes[index].adj.clear();
+	for (size_t j : neighbours)
+	{
+		auto &adj = nodes[j].adj;
+		adj.erase(std::remove(adj.begin(), adj.end(), index), adj.end());
+	}
+
+	// Keep it as a tombstone
+	nodes[index].alive = false;
+	nodes[index].base = nullptr;
+	base->powerNode = NULL_NODE;
+	base->network = nullptr;
+	--aliveCount;
+	++deadCount;
+	--nodes[root].size;
+
+	if (nodes[root].size == 0u)
+	{
+		network_retire(nodes[root].network);
+		nodes[root].network = nullptr;
+	}
+	else
+	{
+		split(neighbours, root);
+	}
+
+	if (deadCount > COMPACT_LIMIT && deadCount > aliveCount)
+		compact();
+}
+
+size_t PowerGrid::find(size_t node)
+{
+	// Path halving
+	while (nodes[node].parent != node)
+	{
+		size_t &parent = nodes[node].parent;
+		parent = nodes[parent].parent;
+		node = parent;
+	}
+	return node;
+}
+
+void PowerGrid::unite(size_t a, size_t b)
+{
+	a = find(a);
+	b = find(b);
+	if (a == b)
+		return;
+
+	// Union by rank
+	if (nodes[a].rank < nodes[b].rank)
+		std::swap(a, b);
+	if (nodes[a].rank == nodes[b].rank)
+		++nodes[a].rank;
+
+	Node &winner = nodes[a];
+	Node &loser = nodes[b];
+	loser.parent = a;
+	winner.size += loser.size;
+	loser.size = 0u;
+
+	if (!winner.network)
+		winner.network = loser.network;
+	else if (loser.network)
+		network_retire(loser.network);
+	loser.network = nullptr;
+}
+
+PowerNetwork *PowerGrid::get_network(const BuildingBase *base)
+{
+	if (!base || base->powerNode == NULL_NODE)
+		return nullptr;
+	return nodes[find(base->powerNode)].network;
+}
+
+void PowerGrid::split(const std::vector<size_t> &neighbours, size_t root)
+{
+	const size_t count = neighbours.size();
+	if (count < 2u)
+		return;
+
+	if (m_stamp.size() < nodes.size())
+	{
+		m_stamp.resize(nodes.size(), 0u);
+		m_owner.resize(nodes.size(), 0u);
+	}
+	if (++m_stampCounter == 0u)
+	{
+		std::fill(m_stamp.begin(), m_stamp.end(), 0u);
+		m_stampCounter = 1u;
+	}
+	const unsigned stamp = m_stampCounter;
+
+	// One search per neighbour, searches that meet are joined
+	// together with a small union-find of their own.
+	std::vector<std::deque<size_t>> open(count);
+	std::vector<std::vector<size_t>> visited(count);
+	std::vector<size_t> group(count);
+	std::vector<char> done(count, 0);
+	size_t groups = count;
+
+	const auto groupFind = [&group](size_t s) {
+		while (group[s] != s)
+		{
+			group[s] = group[group[s]];
+			s = group[s];
+		}
+		return s;
+	};
+
+	for (size_t s = 0; s < count; ++s)
+	{
+		group[s] = s;
+		const size_t n = neighbours[s];
+		m_stamp[n] = stamp;
+		m_owner[n] = s;
+		open[s].push_back(n);
+		visited[s].push_back(n);
+	}
+
+	std::vector<char> active(count, 0);
+	while (groups > 1u)
+	{
+		// A group that has nothing left to search is cut from the rest
+		std::fill(active.begin(), active.end(), 0);
+		for (size_t s = 0; s < count; ++s)
+			if (!open[s].empty())
+				active[groupFind(s)] = 1;
+
+		for (size_t g = 0; g < count && groups > 1u; ++g)
+		{
+			if (groupFind(g) != g || active[g] || done[g])
+				continue;
+
+			std::vector<size_t> piece;
+			for (size_t s = 0; s < count; ++s)
+				if (groupFind(s) == g)
+					piece.insert(piece.end(), visited[s].begin(), visited[s].end());
+			detach(piece, root);
+			done[g] = 1;
+			--groups;
+		}
+
+		if (groups <= 1u)
+			break;
+
+		// Advance every search by a single node
+		for (size_t s = 0; s < count; ++s)
+		{
+			if (open[s].empty())
+				continue;
+			const size_t u = open[s].front();
+			open[s].pop_front();
+
+			for (size_t v : nodes[u].adj)
+			{
+				if (m_stamp[v] == stamp)
+				{
+					const size_t a = groupFind(m_owner[v]);
+					const size_t b = groupFind(s);
+					if (a != b)
+					{
+						group[a] = b;
+						--groups;
+					}
+					continue;
+				}
+				m_stamp[v] = stamp;
+				m_owner[v] = s;
+				open[s].push_back(v);
+				visited[s].push_back(v);
+			}
+		}
+	}
+}
+
+void PowerGrid::detach(const std::vector<size_t> &piece, size_t oldRoot)
+{
+	const size_t first = nodes.size();
+	nodes.resize(first + piece.size());
+
+	// The piece is disconnected from the other searches, so it's safe
+	// to reuse the owner buffer for mapping old nodes to new ones.
+	for (size_t k = 0; k < piece.size(); ++k)
+		m_owner[piece[k]] = first + k;
+
+	PowerNetwork *network = network_new();
+	for (size_t k = 0; k < piece.size(); ++k)
+	{
+		Node &from = nodes[piece[k]];
+		Node &to = nodes[first + k];
+		to.base = from.base;
+		to.alive = true;
+		to.parent = first;
+		to.adj = std::move(from.adj);
+		for (size_t &j : to.adj)
+			j = m_owner[j];
+		to.base->powerNode = first + k;
+		to.base->network = network;
+
+		from.adj.clear();
+		from.base = nullptr;
+		from.alive = false;
+	}
+
+	Node &root = nodes[first];
+	root.rank = piece.size() > 1u ? 1u : 0u;
+	root.size = piece.size();
+	root.network = network;
+
+	nodes[oldRoot].size -= piece.size();
+	deadCount += piece.size();
+}
+
+void PowerGrid::compact()
+{
+	std::vector<size_t> remap(nodes.size(), NULL_NODE);
+	std::vector<size_t> rootMap(nodes.size(), NULL_NODE);
+	std::vector<Node> compacted;
+	compacted.reserve(aliveCount);
+
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (!nodes[i].alive)
+			continue;
+		const size_t index = compacted.size();
+		const size_t root = find(i);
+		remap[i] = index;
+		compacted.emplace_back();
+		Node &node = compacted.back();
+		node.base = nodes[i].base;
+		node.alive = true;
+		node.base->powerNode = index;
+
+		// The first living node of a component becomes it's new root
+		if (rootMap[root] == NULL_NODE)
+		{
+			rootMap[root] = index;
+			node.parent = index;
+			node.size = nodes[root].size;
+			node.rank = node.size > 1u ? 1u : 0u;
+			node.network = nodes[root].network;
+		}
+		else
+		{
+			node.parent = rootMap[root];
+		}
+	}
+
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (!nodes[i].alive)
+			continue;
+		auto &adj = compacted[remap[i]].adj;
+		adj = std::move(nodes[i].adj);
+		for (size_t &j : adj)
+			j = remap[j];
+	}
+
+	nodes = std::move(compacted);
+	deadCount = 0u;
+	m_stamp.clear();
+	m_owner.clear();
+	m_stampCounter = 0u;
+}
+
+int PowerGrid::solve(int &power)
+{
+	// Every building will get it's network below,
+	// so merged networks aren't referenced anymore
+	for (PowerNetwork *network : retired)
+		delete network;
+	retired.clear();
+
+	flows.assign(networks.size(), Flow{});
+	for (auto &network : networks)
+		network->clear();
+
+	// Sum every network in a single pass over the nodes
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (!nodes[i].alive)
+			continue;
+		BuildingBase *base = nodes[i].base;
+		PowerNetwork *network = nodes[find(i)].network;
+		assert(network);
+		base->network = network;
+
+		Flow &flow = flows[network->index];
+		flow.out += output(base);
+		flow.in += base->powerIn;
+		flow.store += base->powerStore;
+		for (int u = 0; u < 3; ++u)
+			if (PowerNetwork::resource(base, (PowerNetwork::Use)u))
+				++network->counts[u];
+	}
+
+	int total = 0;
+	for (size_t i = 0; i < flows.size(); ++i)
+	{
+		Flow &flow = flows[i];
+		flow.value = math_min(flow.store, flow.out);
+		flow.storeCount = flow.value;
+		total += flow.storeCount;
+
+		PowerNetwork *network = networks[i].get();
+		network->powerOut = flow.out;
+		network->powerIn = flow.in;
+		network->powerStore = flow.store;
+	}
+
+	// Give the power to the consumers and the stations
+	power = 0;
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (!nodes[i].alive)
+			continue;
+		BuildingBase *base = nodes[i].base;
+		Flow &flow = flows[base->network->index];
+
+		if (base->powerIn)
+		{
+			flow.value -= base->powerIn;
+			base->sufficient = flow.value >= 0;
+		}
+
+		if (base->powerStore)
+		{
+			base->powerValue = math_max(0, math_min(
+				flow.storeCount,
+				base->powerStore));
+			flow.storeCount -= base->powerValue;
+			power += base->powerValue;
+		}
+	}
+
+	for (size_t i = 0; i < flows.size(); ++i)
+	{
+		networks[i]->powerValue = flows[i].value;
+		networks[i]->storeCount = flows[i].storeCount;
+	}
+
+	return total;
+}
+
+void PowerGrid::clear()
+{
+	for (VariantPtr<PowerNetwork> &network : networks)
+		delete network.get();
+	networks.clear();
+	for (PowerNetwork *network : retired)
+		delete network;
+	retired.clear();
+
+	nodes.clear();
+	flows.clear();
+	aliveCount = 0u;
+	deadCount = 0u;
+	m_stamp.clear();
+	m_owner.clear();
+	m_stampCounter = 0u;
+}
+
+int PowerGrid::output(const BuildingBase *base)
+{
+	// Buildings without workers output a constant power, generators
+	// slowly accelerate their output (finalPowerOut) in their update.
+	int out = base->finalPowerOut;
+	if (base->powerOut != 0 && base->entityLimit == 0)
+		out += base->powerOut;
+	return out;
+}
+
+PowerNetwork *PowerGrid::network_new()
+{
+	PowerNetwork *network = new PowerNetwork(
+		context ? context->objectIdCounter.advance<PowerNetwork>() : 0);
+	network->index = networks.size();
+	networks.push_back(network);
+	return network;
+}
+
+void PowerGrid::network_retire(PowerNetwork *network)
+{
+	if (!network)
+		return;
+	const size_t index = network->index;
+	assert(index < networks.size() && networks[index].get() == network);
+
+	networks[index] = networks.back();
+	networks[index]->index = index;
+	networks.pop_back();
+
+	retired.push_back(network);
+}
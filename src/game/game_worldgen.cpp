@@ -0,0 +1,204 @@
+#include "game/game_worldgen.hpp"
+
+#include "game/game_data.hpp"
+
+#include <algorithm>
+
+// Seed of a chunk's random numbers, from the world's seed and it's index
+static uint64_t chunk_seed(int seed, const IVec &chunk)
+{
+	uint64_t x = (uint64_t)(uint32_t)seed;
+	x = x * 0x9e3779b97f4a7c15ull ^ (uint64_t)(uint32_t)chunk.x;
+	x = x * 0x9e3779b97f4a7c15ull ^ (uint64_t)(uint32_t)chunk.y;
+	return x;
+}
+
+// SplitMix64
+static uint64_t chunk_random(uint64_t &state)
+{
+	uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static int chunk_random_range(uint64_t &state, int min, int max)
+{
+	if (max <= min)
+		return min;
+	return min + (int)(chunk_random(state) % (uint64_t)(max - min + 1));
+}
+
+WorldGenerator::WorldGenerator(size_t threads)
+	: m_pool(threads)
+{
+}
+
+WorldGenerator::~WorldGenerator()
+{
+	m_pool.wait_all();
+	for (size_t i = m_next; i < m_plans.size(); ++i)
+		delete m_plans[i]->grid;
+}
+
+void WorldGenerator::request(const IVec &chunk)
+{
+	if (!m_requested.insert(Chunks::gen_key(chunk.x, chunk.y)).second)
+		return;
+
+	m_plans.emplace_back(new ChunkPlan{});
+	ChunkPlan *plan = m_plans.back().get();
+	plan->index = chunk;
+	const Settings s = settings;
+	m_tasks.push_back(m_pool.add([plan, s]() {
+		*plan = generate(s, plan->index);
+	}));
+}
+
+void WorldGenerator::request_area(const IVec &center, int radius)
+{
+	// Rings around the center, the chunks near the camera come first
+	request(center);
+	for (int r = 1; r <= radius; ++r)
+	{
+		for (int i = -r; i <= r; ++i)
+		{
+			request(center + IVec{ i, -r });
+			request(center + IVec{ i, r });
+		}
+		for (int i = -r + 1; i <= r - 1; ++i)
+		{
+			request(center + IVec{ -r, i });
+			request(center + IVec{ r, i });
+		}
+	}
+}
+
+void WorldGenerator::wait()
+{
+	m_pool.wait_all();
+}
+
+size_t WorldGenerator::commit(GameData &data, Chunks &chunks, size_t maxChunks)
+{
+	size_t added = 0u;
+	if (m_next >= m_plans.size() || !m_pool.done(m_tasks[m_next]))
+		return added;
+
+	// Resources are placed one after another, don't log every one
+	Logger::set_priority(0);
+	while (added < maxChunks &&
+		m_next < m_plans.size() &&
+		m_pool.done(m_tasks[m_next]))
+	{
+		ChunkPlan &plan = *m_plans[m_next];
+		++m_next;
+		if (place(data, chunks, plan))
+			++added;
+	}
+	Logger::set_priority(99);
+
+	// The plans are kept until all of them are committed, the tasks
+	// hold their pointers
+	if (m_next == m_plans.size())
+	{
+		m_pool.wait_all();
+		m_plans.clear();
+		m_tasks.clear();
+		m_next = 0u;
+	}
+	return added;
+}
+
+bool WorldGenerator::place(GameData &data, Chunks &chunks, ChunkPlan &plan)
+{
+	// Made by something else meanwhile, or paged out
+	if (chunks.get(plan.index.x, plan.index.y) ||
+		chunks.get_summary(plan.index.x, plan.index.y))
+	{
+		delete plan.grid;
+		plan.grid = nullptr;
+		return false;
+	}
+
+	chunks.add(plan.grid);
+	plan.grid = nullptr;
+	for (const Spawn &spawn : plan.spawns)
+	{
+		BuildingBase *b = data.add_building(spawn.pos, spawn.type, false);
+		if (b)
+			b->rStorage[spawn.resourceId] = spawn.amount;
+	}
+	return true;
+}
+
+WorldGenerator::ChunkPlan WorldGenerator::generate(const Settings &s, const IVec &chunk)
+{
+	ChunkPlan plan;
+	plan.index = chunk;
+	plan.grid = new Grid(CHUNK_W, CHUNK_H, chunk.x, chunk.y);
+
+	// Every job has it's own copies, the noises aren't shared
+	FastNoiseLite terrain(s.seed);
+	terrain.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+	terrain.SetFrequency(s.terrainFrequency);
+	terrain.SetFractalType(FastNoiseLite::FractalType_FBm);
+	terrain.SetFractalOctaves(s.terrainOctaves);
+
+	FastNoiseLite deposit(s.seed + 1);
+	deposit.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
+	deposit.SetFrequency(s.depositFrequency);
+	deposit.SetCellularDistanceFunction(FastNoiseLite::CellularDistanceFunction_Euclidean);
+	deposit.SetCellularJitter(0.8f);
+	deposit.SetCellularReturnType(FastNoiseLite::CellularReturnType_Distance);
+
+	// Same cells as "deposit", a random value for each
+	FastNoiseLite cell = deposit;
+	cell.SetCellularReturnType(FastNoiseLite::CellularReturnType_CellValue);
+
+	// Sample the whole chunk one noise at a time into flat arrays
+	const int count = CHUNK_W * CHUNK_H;
+	const float x0 = (float)(chunk.x * CHUNK_W);
+	const float y0 = (float)(chunk.y * CHUNK_H);
+	std::vector<float> heights(count), distances(count), values(count);
+	for (int i = 0; i < count; ++i)
+		heights[i] = terrain.GetNoise(x0 + (float)(i % CHUNK_W), y0 + (float)(i / CHUNK_W));
+	for (int i = 0; i < count; ++i)
+		distances[i] = deposit.GetNoise(x0 + (float)(i % CHUNK_W), y0 + (float)(i / CHUNK_W));
+	for (int i = 0; i < count; ++i)
+		values[i] = cell.GetNoise(x0 + (float)(i % CHUNK_W), y0 + (float)(i / CHUNK_W));
+
+	uint64_t state = chunk_seed(s.seed, chunk);
+	for (int i = 0; i < count; ++i)
+	{
+		Tile &tile = plan.grid->grid[i];
+		// Rough ground on the heights
+		tile.roughness = (t_byte)math_clamp(
+			(int)((heights[i] + 1.f) * 2.f), 0, (int)Tile::MAX_ROUGHNESS);
+
+		// Distance returns the distance minus one
+		if (distances[i] + 1.f > s.depositRadius)
+			continue;
+
+		const float v = (values[i] + 1.f) * 0.5f;
+		Spawn spawn;
+		spawn.pos = plan.grid->tile_pos(tile);
+		if (v < s.gemChance)
+		{
+			spawn.type = BuildingType::RAW_GEMS;
+			spawn.resourceId = Resources::GEMS;
+			spawn.amount = chunk_random_range(state, s.gemMin, s.gemMax);
+		}
+		else if (v < s.gemChance + s.oreChance)
+		{
+			spawn.type = BuildingType::RAW_ORE;
+			spawn.resourceId = Resources::ORE;
+			spawn.amount = chunk_random_range(state, s.oreMin, s.oreMax);
+		}
+		else
+			continue;
+		plan.spawns.push_back(spawn);
+	}
+
+	return plan;
+}
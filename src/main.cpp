@@ -6,6 +6,7 @@
 
 #include "game/MyGameWindow.hpp"
 #include "window/WindowManager.hpp"
+#include "utils/class/fixed_step.hpp"
 
 
 
@@ -21,6 +22,28 @@ static chrono_clock sChronoStart = chrono_namespace::now(), sChronoCurrent;
 constexpr int MIN_CLICK_DISTANCE = 16;
 constexpr t_seconds FOCUS_TIME = 0.5f;
 
+// The simulation runs in ticks of the same length whatever the frame
+// rate is, at most MAX_TICKS a frame
+constexpr float TICK_STEP = 1.f / 60.f;
+constexpr size_t MAX_TICKS = 5;
+
+// Ticks a frame of the turbo speeds F6 goes through, 0 is real time
+static const size_t TURBO_SPEEDS[] = { 0, 10, 50, 250 };
+constexpr size_t TURBO_SPEEDS_COUNT = sizeof(TURBO_SPEEDS) / sizeof(*TURBO_SPEEDS);
+
+// Game seconds simulated without a window by "--fast-forward", the
+// game is then written to the save "--save" and the program exits
+static float sFastForward = 0.f;
+static std::wstring sSaveName;
+
+// The AI of the real time ticks stops on the wall clock, see
+// AIScheduler::timeBudget
+static bool sTimeBudget = false;
+
+// Frames written by F9 or "--profile"
+constexpr size_t PROFILE_FRAMES = 300;
+static const char* PROFILE_PATH = "profile.json";
+
 
 int game_main()
 {
@@ -32,9 +55,14 @@ int game_main()
 #else
 	videoMode = sf::VideoMode(1920, 1080);
 #endif
-	sf::RenderWindow window(videoMode, "");
+	const bool headless = sFastForward > 0.f;
+	sf::RenderWindow window;
+	if (!headless)
+	{
+		window.create(videoMode, "");
+		window.setVerticalSyncEnabled(true);
+	}
 	sf::View view = window.getDefaultView();
-	window.setVerticalSyncEnabled(true);
 
 	// Make a manager for windows
 	WindowManager manager{ &window, &view };
@@ -119,6 +147,26 @@ int game_main()
 	}
 
 	GameWindow* game = manager.get_current();
+	game->timeBudget = sTimeBudget && !headless;
+
+	// Nothing is drawn, the time is simulated and the program exits
+	if (headless)
+	{
+		const size_t ticks = (size_t)std::ceil(sFastForward / TICK_STEP);
+		game->run_ticks(ticks, TICK_STEP);
+		LOG("Fast forward: %zu ticks, %.1f game seconds at %.0f ticks/s",
+			ticks,
+			(float)ticks * TICK_STEP,
+			game->tickRate);
+
+		bool saved = true;
+		if (!sSaveName.empty())
+			saved = game->save_game(sSaveName);
+		if (!saved)
+			LOG_ERROR("Unable to save the fast forward");
+		manager.close();
+		return saved ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
 	
 	bool enableLogic = true;
 	
@@ -134,6 +182,9 @@ int game_main()
 	
 	sf::Clock frameClock, deltaClock;
 	sf::Clock focusTimer;
+	FixedStep fixedStep{ TICK_STEP, MAX_TICKS };
+	size_t turboSpeed = 0;
+
 	sGlobalClock.restart();
 
 	size_t mainLoopFrame = 0;
@@ -148,6 +199,8 @@ int game_main()
 		if (manager.change_window())
 		{
 			game = manager.get_current();
+			game->turbo = TURBO_SPEEDS[turboSpeed];
+			fixedStep.reset();
 		}
 
 		// Event handling
@@ -167,6 +220,24 @@ int game_main()
 			case sf::Event::KeyPressed:
 				if (event.key.code == sf::Keyboard::Key::Escape)
 					window.close();
+				else if (event.key.code == sf::Keyboard::Key::F3)
+					Profiler::toggle_overlay();
+				else if (event.key.code == sf::Keyboard::Key::F6)
+				{
+					turboSpeed = (turboSpeed + 1) % TURBO_SPEEDS_COUNT;
+					game->turbo = TURBO_SPEEDS[turboSpeed];
+					// Frames aren't held back for the screen in turbo
+					window.setVerticalSyncEnabled(!game->turbo);
+					fixedStep.reset();
+					LOG("Turbo %zu ticks a frame", game->turbo);
+				}
+				else if (event.key.code == sf::Keyboard::Key::F9)
+				{
+					if (Profiler::capturing())
+						Profiler::end_capture();
+					else
+						Profiler::begin_capture(PROFILE_PATH, PROFILE_FRAMES);
+				}
 				break;
 
 			case sf::Event::MouseWheelScrolled:
@@ -183,6 +254,9 @@ int game_main()
 			case sf::Event::GainedFocus:
 				enableLogic = true;
 				game->on_unfocus();
+				// The time without focus isn't caught up
+				deltaClock.restart();
+				fixedStep.reset();
 				break;
 
 			case sf::Event::Closed:
@@ -313,14 +387,26 @@ int game_main()
 
 		{
 			game->time = sGlobalClock.getElapsedTime().asSeconds();
-			game->update(deltaClock.getElapsedTime().asSeconds());
+			const float elapsed = deltaClock.restart().asSeconds();
+			if (game->turbo)
+			{
+				game->run_ticks(game->turbo, fixedStep.step);
+				game->alpha = 1.f;
+			}
+			else
+			{
+				const size_t ticks = fixedStep.advance(elapsed);
+				for (size_t i = 0; i < ticks; ++i)
+					game->update(fixedStep.step);
+				game->alpha = fixedStep.alpha();
+			}
 		}
-		deltaClock.restart();
 
 
 		window.clear(sf::Color::White);
 		game->render();
 		window.display();
+		PROFILE_FRAME();
 
 
 
@@ -356,6 +442,13 @@ int game_main()
 }
 
 t_seconds GameData::get_time()
+{
+	if (timePaused >= 0.0f)
+		return timePaused;
+	return (t_seconds)sim_time();
+}
+
+t_seconds GameData::get_real_time()
 {
 	sChronoCurrent = chrono_namespace::now();
 	return std::chrono::duration_cast<float_duration>(
@@ -368,7 +461,27 @@ int main(int argc, char* argv[])
 {
 	LOG("Args: %s", array_to_string(argv, argc).c_str());
 
-	game_main();
+	Profiler::set_thread_name("Main");
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--profile") == 0)
+			Profiler::begin_capture(PROFILE_PATH, PROFILE_FRAMES);
+		else if (strcmp(argv[i], "--fast-forward") == 0 && i + 1 < argc)
+			sFastForward = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--ai-time-budget") == 0)
+			sTimeBudget = true;
+		else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			sSaveName.assign(name, name + strlen(name));
+		}
+	}
+
+	const int code = game_main();
+
+	// Closed before the capture was done
+	Profiler::end_capture();
+	return code;
 }
 
 #else // ENABLE_GAME
@@ -0,0 +1,108 @@
+#include "window/info_panel.hpp"
+
+#include "utils/math.hpp"
+
+InfoPanel::InfoPanel(tgui::ChildWindow::Ptr window, tgui::VerticalLayout::Ptr layout)
+	: window(window), layout(layout)
+{
+}
+
+bool InfoPanel::reshape(long long key)
+{
+	if (this->key == key)
+		return false;
+	this->key = key;
+	rows.clear();
+	layout->removeAllWidgets();
+	return true;
+}
+
+void InfoPanel::add_line()
+{
+	tgui::Panel::Ptr panel;
+	panel = tgui::Panel::create();
+
+	tgui::SeparatorLine::Ptr lineSep;
+	lineSep = tgui::SeparatorLine::create();
+	lineSep->setPosition("10%, 50%");
+	lineSep->setSize({ "80%", "5" });
+	lineSep->setWidgetName("coolLine");
+
+	panel->add(lineSep);
+	panel->getRenderer()->setBackgroundColor(tgui::Color::Transparent);
+
+	layout->add(panel);
+}
+
+void InfoPanel::bind(tgui::Label::Ptr label, t_text text)
+{
+	Row row;
+	row.label = label;
+	row.text = std::move(text);
+	rows.push_back(std::move(row));
+}
+
+void InfoPanel::add_text(t_text text)
+{
+	tgui::Label::Ptr label = tgui::Label::create();
+	layout->add(label);
+	bind(label, std::move(text));
+}
+
+void InfoPanel::add_progress(t_text text, t_progress progress)
+{
+	tgui::HorizontalLayout::Ptr layoutRes;
+	layoutRes = tgui::HorizontalLayout::create();
+
+	Row row;
+	row.label = tgui::Label::create();
+	row.bar = tgui::ProgressBar::create();
+	row.bar->setMinimum(0);
+	row.text = std::move(text);
+	row.progress = std::move(progress);
+
+	layoutRes->add(row.label);
+	layoutRes->add(row.bar);
+	layout->add(layoutRes);
+	rows.push_back(std::move(row));
+}
+
+size_t InfoPanel::refresh()
+{
+	dirty = false;
+	size_t changed = 0u;
+	for (Row &row : rows)
+	{
+		if (row.text)
+		{
+			tgui::String text = row.text();
+			if (text != row.lastText)
+			{
+				row.label->setText(text);
+				row.lastText = std::move(text);
+				++changed;
+			}
+		}
+
+		if (row.progress)
+		{
+			int value = 0, max = 0;
+			row.progress(value, max);
+			// The maximum first, the value is clamped to it
+			if (max != row.lastMax)
+			{
+				row.bar->setMaximum((unsigned)math_max(max, 0));
+				row.lastMax = max;
+				row.lastValue = INT_MIN;
+				++changed;
+			}
+			if (value != row.lastValue)
+			{
+				row.bar->setValue((unsigned)math_max(value, 0));
+				row.lastValue = value;
+				++changed;
+			}
+		}
+	}
+	return changed;
+}